@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if __has_include(<elf.h>)
+#include <elf.h>
+#endif
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Minimal, dependency-free helpers shared by the benchmarks. Every benchmark accepts --quick, which shrinks the
+// workload so CTest can check that it still builds and runs without spending real time on it.
+namespace bench {
+    template<class T>
+    inline void do_not_optimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    inline void clobber() {
+        asm volatile("" : : : "memory");
+    }
+
+    struct options {
+        bool quick = false;
+
+        // How many times the work of one measurement is repeated; the fastest repetition is reported.
+        [[nodiscard]] int repetitions() const { return quick ? 1 : 7; }
+        // Scales a full-size workload down for --quick runs.
+        [[nodiscard]] std::size_t scale(std::size_t n) const { return quick ? std::max<std::size_t>(n / 1000, 1) : n; }
+    };
+
+    [[nodiscard]] inline options parse_options(int argc, char** argv) {
+        options opts;
+        for (int i = 1; i < argc; ++i) {
+            if (std::string_view(argv[i]) == "--quick") {
+                opts.quick = true;
+            }
+        }
+        return opts;
+    }
+
+    // Counts user-space instructions retired by this thread, when the kernel lets us.
+    class instruction_counter {
+    public:
+        instruction_counter() {
+#if __has_include(<linux/perf_event.h>)
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+        instruction_counter(const instruction_counter&) = delete;
+        instruction_counter& operator=(const instruction_counter&) = delete;
+        ~instruction_counter() {
+#if __has_include(<linux/perf_event.h>)
+            if (fd >= 0) {
+                close(fd);
+            }
+#endif
+        }
+
+        [[nodiscard]] bool available() const { return fd >= 0; }
+
+        void start() {
+#if __has_include(<linux/perf_event.h>)
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        [[nodiscard]] std::optional<std::uint64_t> stop() {
+#if __has_include(<linux/perf_event.h>)
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                std::uint64_t count = 0;
+                if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+                    return count;
+                }
+            }
+#endif
+            return std::nullopt;
+        }
+
+    private:
+        int fd = -1;
+    };
+
+    struct measurement {
+        double ns_per_op = 0;
+        std::optional<double> instructions_per_op;
+    };
+
+    // Runs body (which performs ops operations) once to warm up, then the configured number of times, and reports
+    // the fastest run.
+    template<class F>
+    [[nodiscard]] measurement measure(const options& opts, std::size_t ops, F&& body) {
+        static instruction_counter counter;
+        body();
+        measurement best{std::numeric_limits<double>::max(), std::nullopt};
+        for (int rep = 0; rep < opts.repetitions(); ++rep) {
+            counter.start();
+            const auto begin = std::chrono::steady_clock::now();
+            body();
+            const auto end = std::chrono::steady_clock::now();
+            const auto instructions = counter.stop();
+            const double ns = std::chrono::duration<double, std::nano>(end - begin).count() / static_cast<double>(ops);
+            if (ns < best.ns_per_op) {
+                best.ns_per_op = ns;
+                if (instructions) {
+                    best.instructions_per_op = static_cast<double>(*instructions) / static_cast<double>(ops);
+                }
+            }
+        }
+        return best;
+    }
+
+    // Sums the sizes of the functions in this executable whose mangled names mention the given namespace or class.
+    // Only what survives inlining is counted, which is exactly the code a strategy adds to the binary.
+    [[nodiscard]] inline std::optional<std::size_t> code_size(std::string_view scope) {
+#if __has_include(<elf.h>)
+        std::ifstream file("/proc/self/exe", std::ios::binary);
+        const std::vector<char> image{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        if (image.size() < sizeof(Elf64_Ehdr)) {
+            return std::nullopt;
+        }
+        const auto* header = reinterpret_cast<const Elf64_Ehdr*>(image.data());
+        const auto* sections = reinterpret_cast<const Elf64_Shdr*>(image.data() + header->e_shoff);
+        const std::string needle = std::to_string(scope.size()) + std::string(scope);
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < header->e_shnum; ++i) {
+            if (sections[i].sh_type != SHT_SYMTAB) {
+                continue;
+            }
+            const char* names = image.data() + sections[sections[i].sh_link].sh_offset;
+            const auto* symbols = reinterpret_cast<const Elf64_Sym*>(image.data() + sections[i].sh_offset);
+            const std::size_t count = sections[i].sh_size / sizeof(Elf64_Sym);
+            for (std::size_t s = 0; s < count; ++s) {
+                if (ELF64_ST_TYPE(symbols[s].st_info) == STT_FUNC
+                    && std::string_view(names + symbols[s].st_name).find(needle) != std::string_view::npos) {
+                    total += symbols[s].st_size;
+                }
+            }
+            return total;
+        }
+#endif
+        return std::nullopt;
+    }
+
+    inline void print_header(std::string_view title) {
+        std::printf("\n## %.*s\n\n", static_cast<int>(title.size()), title.data());
+    }
+
+    inline std::string format_optional(const std::optional<double>& value, const char* format = "%.1f") {
+        if (!value) {
+            return "n/a";
+        }
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), format, *value);
+        return buffer;
+    }
+}
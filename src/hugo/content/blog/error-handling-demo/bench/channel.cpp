@@ -0,0 +1,268 @@
+// Hands expected<std::uint64_t, Fault> items (1% errors) from producer threads to consumer threads through a bounded
+// queue and reports throughput and the latency of single items, from push to pop, at several producer/consumer counts.
+// The baseline is the usual std::mutex + std::deque with two condition variables; mori's channels are measured one
+// item at a time and in batches of 32.
+
+#include "bench.h"
+#include "channel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    enum class Fault { bad_row };
+
+    using Item = mori::expected<std::uint64_t, Fault>;
+
+    constexpr std::size_t capacity = 1024;
+    constexpr std::size_t batch_size = 32;
+    // Every this many items, one is timestamped to sample latency.
+    constexpr std::uint64_t sample_every = 64;
+
+    [[nodiscard]] std::uint64_t now_ns() {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // The baseline: a bounded queue under one mutex.
+    class locked_queue {
+    public:
+        bool push(Item item) {
+            std::unique_lock lock(mutex);
+            not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+            if (closed) {
+                return false;
+            }
+            items.push_back(std::move(item));
+            lock.unlock();
+            not_empty.notify_one();
+            return true;
+        }
+        [[nodiscard]] std::optional<Item> pop() {
+            std::unique_lock lock(mutex);
+            not_empty.wait(lock, [&] { return closed || !items.empty(); });
+            if (items.empty()) {
+                return std::nullopt;
+            }
+            Item item = std::move(items.front());
+            items.pop_front();
+            lock.unlock();
+            not_full.notify_one();
+            return item;
+        }
+        void close() {
+            {
+                std::lock_guard lock(mutex);
+                closed = true;
+            }
+            not_empty.notify_all();
+            not_full.notify_all();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::deque<Item> items;
+        bool closed = false;
+    };
+
+    // What each producer puts in: a timestamp for sampled items, a sequence number otherwise, and every 100th an error.
+    [[nodiscard]] Item make_item(std::uint64_t i) {
+        if (i % 100 == 99) {
+            return mori::unexpected(Fault::bad_row);
+        }
+        return i % sample_every == 0 ? now_ns() : i;
+    }
+
+    struct result {
+        double ns_per_item = 0;
+        std::uint64_t p50 = 0;
+        std::uint64_t p99 = 0;
+        std::uint64_t p999 = 0;
+    };
+
+    // Runs producers and consumers over one queue and returns the elapsed time and latency percentiles. Producer p
+    // calls produce(p, count); consumer c calls consume(latencies) until the queue is closed; the last producer to
+    // finish closes it.
+    template<class Produce, class Consume, class Close>
+    [[nodiscard]] result run_once(unsigned producers, unsigned consumers, std::uint64_t per_producer,
+        Produce&& produce, Consume&& consume, Close&& close) {
+        std::atomic<unsigned> producing{producers};
+        std::vector<std::vector<std::uint64_t>> latencies(consumers);
+        std::vector<std::thread> threads;
+        const auto begin = std::chrono::steady_clock::now();
+        for (unsigned c = 0; c < consumers; ++c) {
+            threads.emplace_back([&, c] { consume(latencies[c]); });
+        }
+        for (unsigned p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                produce(p, per_producer);
+                if (producing.fetch_sub(1) == 1) {
+                    close();
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        std::vector<std::uint64_t> all;
+        for (const std::vector<std::uint64_t>& l : latencies) {
+            all.insert(all.end(), l.begin(), l.end());
+        }
+        std::sort(all.begin(), all.end());
+        const auto percentile = [&](double q) {
+            return all.empty() ? 0 : all[std::min(all.size() - 1, static_cast<std::size_t>(q * all.size()))];
+        };
+        return {std::chrono::duration<double, std::nano>(end - begin).count()
+                / static_cast<double>(producers * per_producer),
+            percentile(0.50), percentile(0.99), percentile(0.999)};
+    }
+
+    // Records the latency of a sampled item; the rest only feed a checksum.
+    void observe(const Item& item, std::vector<std::uint64_t>& latencies, std::uint64_t& sum) {
+        if (!item) {
+            return;
+        }
+        if (*item > std::numeric_limits<std::uint32_t>::max()) {
+            latencies.push_back(now_ns() - *item);
+        }
+        sum += *item;
+    }
+
+    // Runs a setup the configured number of times and keeps the fastest.
+    template<class Run>
+    [[nodiscard]] result best_of(const bench::options& opts, Run&& run) {
+        result best{std::numeric_limits<double>::max()};
+        for (int rep = 0; rep < opts.repetitions(); ++rep) {
+            const result r = run();
+            if (r.ns_per_item < best.ns_per_item) {
+                best = r;
+            }
+        }
+        return best;
+    }
+
+    [[nodiscard]] result locked(const bench::options& opts, unsigned producers, unsigned consumers,
+        std::uint64_t per_producer) {
+        return best_of(opts, [&] {
+            locked_queue q;
+            return run_once(producers, consumers, per_producer,
+                [&](unsigned, std::uint64_t n) {
+                    for (std::uint64_t i = 0; i < n; ++i) {
+                        q.push(make_item(i));
+                    }
+                },
+                [&](std::vector<std::uint64_t>& latencies) {
+                    std::uint64_t sum = 0;
+                    while (const std::optional<Item> item = q.pop()) {
+                        observe(*item, latencies, sum);
+                    }
+                    bench::do_not_optimize(sum);
+                },
+                [&] { q.close(); });
+        });
+    }
+
+    template<class Channel>
+    [[nodiscard]] result single(const bench::options& opts, unsigned producers, unsigned consumers,
+        std::uint64_t per_producer) {
+        return best_of(opts, [&] {
+            Channel ch(capacity);
+            return run_once(producers, consumers, per_producer,
+                [&](unsigned, std::uint64_t n) {
+                    for (std::uint64_t i = 0; i < n; ++i) {
+                        static_cast<void>(ch.push(make_item(i)));
+                    }
+                },
+                [&](std::vector<std::uint64_t>& latencies) {
+                    std::uint64_t sum = 0;
+                    while (const std::optional<Item> item = ch.pop()) {
+                        observe(*item, latencies, sum);
+                    }
+                    bench::do_not_optimize(sum);
+                },
+                [&] { ch.close(); });
+        });
+    }
+
+    template<class Channel>
+    [[nodiscard]] result batched(const bench::options& opts, unsigned producers, unsigned consumers,
+        std::uint64_t per_producer) {
+        return best_of(opts, [&] {
+            Channel ch(capacity);
+            return run_once(producers, consumers, per_producer,
+                [&](unsigned, std::uint64_t n) {
+                    std::vector<Item> batch;
+                    batch.reserve(batch_size);
+                    for (std::uint64_t i = 0; i < n; ++i) {
+                        batch.push_back(make_item(i));
+                        if (batch.size() == batch_size || i + 1 == n) {
+                            static_cast<void>(ch.push_all(batch));
+                            batch.clear();
+                        }
+                    }
+                },
+                [&](std::vector<std::uint64_t>& latencies) {
+                    std::uint64_t sum = 0;
+                    std::vector<Item> batch;
+                    while (ch.pop_some(batch, batch_size) != 0) {
+                        for (const Item& item : batch) {
+                            observe(item, latencies, sum);
+                        }
+                        batch.clear();
+                    }
+                    bench::do_not_optimize(sum);
+                },
+                [&] { ch.close(); });
+        });
+    }
+
+    void print(const char* name, unsigned producers, unsigned consumers, const result& r) {
+        std::printf("| %-22s | %2u / %-2u | %10.1f | %9llu | %9llu | %10llu |\n", name, producers, consumers,
+            r.ns_per_item, static_cast<unsigned long long>(r.p50), static_cast<unsigned long long>(r.p99),
+            static_cast<unsigned long long>(r.p999));
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::uint64_t items = opts.scale(2'000'000);
+
+    char title[128];
+    std::snprintf(title, sizeof(title), "%llu items, capacity %zu, %u hardware threads (ns/item; latency in ns)",
+        static_cast<unsigned long long>(items), capacity, std::thread::hardware_concurrency());
+    bench::print_header(title);
+    std::printf("| %-22s | %-7s | %10s | %9s | %9s | %10s |\n", "queue", "P / C", "throughput", "p50", "p99",
+        "p99.9");
+    std::printf("|------------------------|---------|------------|-----------|-----------|------------|\n");
+
+    using spsc = mori::spsc_channel<std::uint64_t, Fault>;
+    using mpmc = mori::mpmc_channel<std::uint64_t, Fault>;
+    print("mutex + deque", 1, 1, locked(opts, 1, 1, items));
+    print("spsc_channel", 1, 1, single<spsc>(opts, 1, 1, items));
+    print("spsc_channel, batched", 1, 1, batched<spsc>(opts, 1, 1, items));
+    print("mpmc_channel", 1, 1, single<mpmc>(opts, 1, 1, items));
+    print("mpmc_channel, batched", 1, 1, batched<mpmc>(opts, 1, 1, items));
+    for (const auto& [producers, consumers] : {std::pair{2u, 2u}, std::pair{4u, 4u}, std::pair{4u, 1u},
+             std::pair{1u, 4u}}) {
+        const std::uint64_t per_producer = std::max<std::uint64_t>(items / producers, 1);
+        print("mutex + deque", producers, consumers, locked(opts, producers, consumers, per_producer));
+        print("mpmc_channel", producers, consumers, single<mpmc>(opts, producers, consumers, per_producer));
+        print("mpmc_channel, batched", producers, consumers, batched<mpmc>(opts, producers, consumers, per_producer));
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Measures the compiler front end on expected.h: parsing the header alone, and instantiating expected with a few
+// hundred distinct value/error pairs (bench/compile_time/instantiations.cpp), with and without a precompiled header.
+// Each configuration runs the compiler with -fsyntax-only and reports its wall time and peak memory.
+
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+    struct compile_result {
+        double seconds;
+        long peak_kb;
+    };
+
+    // Runs the compiler with the given arguments and waits for it, or returns nothing if it could not run or failed.
+    [[nodiscard]] std::optional<compile_result> run_compiler(const std::vector<std::string>& args) {
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(MORI_CXX_COMPILER));
+        for (const std::string& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        const auto begin = std::chrono::steady_clock::now();
+        pid_t pid = 0;
+        if (posix_spawn(&pid, MORI_CXX_COMPILER, nullptr, nullptr, argv.data(), environ) != 0) {
+            return std::nullopt;
+        }
+        int status = 0;
+        rusage usage{};
+        if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return std::nullopt;
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return compile_result{std::chrono::duration<double>(end - begin).count(), usage.ru_maxrss};
+    }
+
+    // The fastest of a few runs; memory barely varies between them.
+    [[nodiscard]] std::optional<compile_result> best_of(const bench::options& opts, const std::vector<std::string>& args) {
+        std::optional<compile_result> best;
+        for (int rep = 0; rep < std::min(opts.repetitions(), 3); ++rep) {
+            const auto r = run_compiler(args);
+            if (!r) {
+                return std::nullopt;
+            }
+            if (!best || r->seconds < best->seconds) {
+                best = r;
+            }
+        }
+        return best;
+    }
+
+    void print_row(const char* name, const std::optional<compile_result>& r) {
+        if (!r) {
+            std::printf("| %-36s | %10s | %10s |\n", name, "failed", "failed");
+            return;
+        }
+        std::printf("| %-36s | %10.0f | %10.1f |\n", name, r->seconds * 1000, static_cast<double>(r->peak_kb) / 1024);
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const int pairs = opts.quick ? 4 : 300;
+    const std::string source_dir = MORI_SOURCE_DIR;
+    const std::string unit = source_dir + "/bench/compile_time/instantiations.cpp";
+    const std::vector<std::string> common{"-std=c++20", "-fsyntax-only"};
+
+    const auto with = [&](std::vector<std::string> extra, int count) {
+        std::vector<std::string> args = common;
+        args.insert(args.end(), extra.begin(), extra.end());
+        args.push_back("-DMORI_COMPILE_TIME_PAIRS=" + std::to_string(count));
+        args.push_back(unit);
+        return args;
+    };
+
+    char pch_dir[] = "/tmp/mori-pch-XXXXXX";
+    const bool have_dir = mkdtemp(pch_dir) != nullptr;
+    const std::string pch = std::string(pch_dir) + "/expected.h.gch";
+
+    bench::print_header("Front end, -fsyntax-only");
+    std::printf("| %-36s | %10s | %10s |\n", "configuration", "ms", "peak MB");
+    std::printf("|--------------------------------------|------------|------------|\n");
+    print_row("expected.h only", best_of(opts, with({"-I" + source_dir}, 0)));
+    char name[64];
+    std::snprintf(name, sizeof(name), "%d pairs", pairs);
+    print_row(name, best_of(opts, with({"-I" + source_dir}, pairs)));
+    if (have_dir) {
+        const auto built = run_compiler({"-std=c++20", "-w", "-x", "c++-header", source_dir + "/expected.h", "-o", pch});
+        print_row("building expected.h.gch (once)", built);
+        if (built) {
+            std::snprintf(name, sizeof(name), "expected.h only, precompiled");
+            print_row(name, best_of(opts, with({"-I" + std::string(pch_dir), "-I" + source_dir}, 0)));
+            std::snprintf(name, sizeof(name), "%d pairs, precompiled", pairs);
+            print_row(name, best_of(opts, with({"-I" + std::string(pch_dir), "-I" + source_dir}, pairs)));
+        }
+        std::remove(pch.c_str());
+        rmdir(pch_dir);
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Instantiates expected with MORI_COMPILE_TIME_PAIRS distinct value/error pairs and uses the members a typical caller
+// touches: construction from a value and from an unexpected, copies, assignment, the observers, one step of each
+// monadic operation and comparison. Half the pairs use types with non-trivial special members.
+// Compiled by the compile-time benchmark rather than linked into anything.
+
+#if defined(MORI_USE_STD_EXPECTED)
+#include <expected>
+namespace ns = std;
+#else
+#include "expected.h"
+namespace ns = mori;
+#endif
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#if !defined(MORI_COMPILE_TIME_PAIRS)
+#define MORI_COMPILE_TIME_PAIRS 300
+#endif
+
+namespace {
+    template<int N>
+    struct plain_value {
+        int v;
+        friend bool operator==(const plain_value&, const plain_value&) = default;
+    };
+    template<int N>
+    struct string_value {
+        std::string v;
+        friend bool operator==(const string_value&, const string_value&) = default;
+    };
+    template<int N>
+    struct failure {
+        int code;
+        friend bool operator==(const failure&, const failure&) = default;
+    };
+
+    template<int N>
+    using value_t = std::conditional_t<N % 2 == 0, plain_value<N>, string_value<N>>;
+    template<int N>
+    using error_t = failure<N % 97>;
+
+    template<int N>
+    int use(int seed) {
+        using T = value_t<N>;
+        using E = error_t<N>;
+        ns::expected<T, E> a(std::in_place);
+        ns::expected<T, E> b = ns::unexpected(E{seed});
+        ns::expected<T, E> c = a;
+        c = b;
+        c = std::move(a);
+        int total = c.has_value() ? 1 : c.error().code;
+        total += b.value_or(T{}) == T{} ? 1 : 0;
+        const auto mapped = b.transform([](const T&) { return N; });
+        const auto chained = b.and_then([](const T&) { return ns::expected<int, E>(N); });
+        const auto recovered = b.or_else([](const E&) { return ns::expected<T, E>(); });
+        const auto renamed = b.transform_error([](const E& e) { return e.code; });
+        total += mapped.value_or(0) + chained.value_or(0) + (recovered.has_value() ? 1 : 0) + renamed.error_or(0);
+        return total + (b == c ? 1 : 0);
+    }
+
+    template<std::size_t... N>
+    int use_all(int seed, std::index_sequence<N...>) {
+        return (0 + ... + use<static_cast<int>(N)>(seed));
+    }
+}
+
+int compile_time_instantiations(int seed) {
+    return use_all(seed, std::make_index_sequence<MORI_COMPILE_TIME_PAIRS>());
+}
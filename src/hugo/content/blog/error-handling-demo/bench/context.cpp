@@ -0,0 +1,129 @@
+// Measures what it costs to record where an error has been while it propagates through a deep chain of calls: no
+// context at all, a trace frame per call (Error::trace), a lazily formatted message per call, and the usual
+// alternative of formatting a context string at every level.
+
+#include "bench.h"
+#include "result.h"
+
+#include <array>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+    struct Request {
+        int id;
+        bool fail;
+    };
+
+    [[nodiscard]] mori::Result<int> leaf(const Request& request) {
+        if (request.fail) {
+            return mori::unexpected(mori::Error(std::errc::no_such_file_or_directory).with_payload(request.id));
+        }
+        return request.id;
+    }
+
+    enum class Style { none, trace, trace_message, eager_string };
+
+    template<Style S, int Depth>
+    [[gnu::noinline]] mori::Result<int> call(const Request& request) {
+        mori::Result<int> r = [&] {
+            if constexpr (Depth == 1) {
+                return leaf(request);
+            }
+            else {
+                return call<S, Depth - 1>(request);
+            }
+        }();
+        if (!r) {
+            if constexpr (S == Style::trace) {
+                r.error().trace();
+            }
+            else if constexpr (S == Style::trace_message) {
+                r.error().trace("propagating request {} at depth {}", request.id, Depth);
+            }
+            else if constexpr (S == Style::eager_string) {
+                r.error().attach(std::string(r.error().context()) + "\n    at " + __FILE__ + ':'
+                    + std::to_string(__LINE__) + ": propagating request " + std::to_string(request.id)
+                    + " at depth " + std::to_string(Depth));
+            }
+            return r;
+        }
+        return *r + 1;
+    }
+
+    [[nodiscard]] std::vector<Request> make_requests(std::size_t count, double error_rate) {
+        std::mt19937 rng(11);
+        std::bernoulli_distribution fails(error_rate);
+        std::vector<Request> requests(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            requests[i] = {static_cast<int>(i), fails(rng)};
+        }
+        return requests;
+    }
+
+    template<Style S, int Depth>
+    void report(const bench::options& opts, const char* name, const std::vector<std::vector<Request>>& sets) {
+        std::printf("| %-14s |", name);
+        for (const auto& requests : sets) {
+            const bench::measurement m = bench::measure(opts, requests.size(), [&] {
+                long long sum = 0;
+                for (const Request& request : requests) {
+                    const mori::Result<int> r = call<S, Depth>(request);
+                    sum += r ? *r : r.error().value();
+                }
+                bench::do_not_optimize(sum);
+            });
+            std::printf(" %8.2f | %8s |", m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str());
+        }
+        std::printf("\n");
+    }
+
+    template<int Depth>
+    void report_depth(const bench::options& opts, const std::vector<std::vector<Request>>& sets) {
+        report<Style::none, Depth>(opts, "no context", sets);
+        report<Style::trace, Depth>(opts, "trace()", sets);
+        report<Style::trace_message, Depth>(opts, "trace(message)", sets);
+        report<Style::eager_string, Depth>(opts, "eager string", sets);
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(100'000);
+    constexpr std::array error_rates{0.0, 0.1, 1.0};
+
+    std::vector<std::vector<Request>> sets;
+    for (const double rate : error_rates) {
+        sets.push_back(make_requests(count, rate));
+    }
+
+    for (const int depth : {4, 16, 64}) {
+        char title[64];
+        std::snprintf(title, sizeof(title), "Call depth %d (ns/op, instructions/op)", depth);
+        bench::print_header(title);
+        std::printf("| %-14s |", "context");
+        for (const double rate : error_rates) {
+            std::printf(" %5.1f%% ns | %5.1f%% in |", rate * 100, rate * 100);
+        }
+        std::printf("\n|----------------|");
+        for (std::size_t i = 0; i < error_rates.size(); ++i) {
+            std::printf("----------|----------|");
+        }
+        std::printf("\n");
+        switch (depth) {
+        case 4:
+            report_depth<4>(opts, sets);
+            break;
+        case 16:
+            report_depth<16>(opts, sets);
+            break;
+        default:
+            report_depth<64>(opts, sets);
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Compares propagating errors through a chain of calls by hand (if (!r) return unexpected(r.error())) against
+// writing every frame as a coroutine that co_awaits the one below it. Also counts the global allocations each call
+// makes, which should stay at zero once the frame pool is warm.
+
+#include "bench.h"
+#include "coroutine.h"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <system_error>
+#include <vector>
+
+namespace {
+    long long allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    using Ex = mori::expected<int, std::error_code>;
+
+    struct Request {
+        int id;
+        bool fail;
+    };
+
+    [[nodiscard]] Ex leaf(const Request& request) {
+        if (request.fail) {
+            return mori::unexpected(std::make_error_code(std::errc::no_such_file_or_directory));
+        }
+        return request.id * 3 + 1;
+    }
+
+    template<int Depth>
+    [[gnu::noinline]] Ex manual(const Request& request) {
+        Ex r = [&] {
+            if constexpr (Depth == 1) {
+                return leaf(request);
+            }
+            else {
+                return manual<Depth - 1>(request);
+            }
+        }();
+        if (!r) {
+            return mori::unexpected(r.error());
+        }
+        return *r + 1;
+    }
+
+    template<int Depth>
+    [[gnu::noinline]] Ex coroutine(const Request& request) {
+        if constexpr (Depth == 1) {
+            co_return co_await leaf(request) + 1;
+        }
+        else {
+            co_return co_await coroutine<Depth - 1>(request) + 1;
+        }
+    }
+
+    [[nodiscard]] std::vector<Request> make_requests(std::size_t count, double error_rate) {
+        std::mt19937 rng(42);
+        std::bernoulli_distribution fails(error_rate);
+        std::vector<Request> requests(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            requests[i] = {static_cast<int>(i), fails(rng)};
+        }
+        return requests;
+    }
+
+    template<class F>
+    void report(const bench::options& opts, const char* name, F&& call, const std::vector<std::vector<Request>>& sets) {
+        std::printf("| %-16s |", name);
+        for (const auto& requests : sets) {
+            const auto body = [&] {
+                long long sum = 0;
+                for (const Request& request : requests) {
+                    const Ex r = call(request);
+                    sum += r ? *r : r.error().value();
+                }
+                bench::do_not_optimize(sum);
+            };
+            const bench::measurement m = bench::measure(opts, requests.size(), body);
+            // measure() has already warmed the pool, so this pass only sees steady-state allocations.
+            const long long before = allocations;
+            body();
+            const double per_op = static_cast<double>(allocations - before) / static_cast<double>(requests.size());
+            std::printf(" %8.2f | %8s | %8.3f |", m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str(), per_op);
+        }
+        std::printf("\n");
+    }
+
+    template<int Depth>
+    void report_depth(const bench::options& opts, const std::vector<std::vector<Request>>& sets) {
+        report(opts, "manual", manual<Depth>, sets);
+        report(opts, "co_await", coroutine<Depth>, sets);
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(200'000);
+    constexpr std::array error_rates{0.0, 0.1, 0.5};
+
+    std::vector<std::vector<Request>> sets;
+    for (const double rate : error_rates) {
+        sets.push_back(make_requests(count, rate));
+    }
+
+    for (const int depth : {1, 4, 16}) {
+        char title[80];
+        std::snprintf(title, sizeof(title), "Call depth %d (ns/op, instructions/op, allocations/op)", depth);
+        bench::print_header(title);
+        std::printf("| %-16s |", "style");
+        for (const double rate : error_rates) {
+            std::printf(" %5.1f%% ns | %5.1f%% in | %5.1f%% al |", rate * 100, rate * 100, rate * 100);
+        }
+        std::printf("\n|------------------|");
+        for (std::size_t i = 0; i < error_rates.size(); ++i) {
+            std::printf("----------|----------|----------|");
+        }
+        std::printf("\n");
+        switch (depth) {
+        case 1:
+            report_depth<1>(opts, sets);
+            break;
+        case 4:
+            report_depth<4>(opts, sets);
+            break;
+        default:
+            report_depth<16>(opts, sets);
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Measures what MORI_ERROR_COUNTERS adds to constructing an error or a value. The whole program has to agree on the
+// setting, so this benchmark is built with counters on and compares the counted constructors with transform and
+// transform_error, which build the same object through the library's internal path without counting it. The error
+// rate of a real workload decides how often the error cost is paid; the value cost is paid on every success.
+
+#include "bench.h"
+#include "result.h"
+
+#include <cstdio>
+#include <utility>
+
+#if !MORI_ERROR_COUNTERS
+#error "error-counters-bench measures the counting constructors and must be built with MORI_ERROR_COUNTERS=1"
+#endif
+
+namespace {
+    using Outcome = mori::expected<int, int>;
+
+    const Outcome failed = mori::unexpected(0);
+    const Outcome succeeded = 0;
+
+    enum class Path { uncounted_error, unexpected, unexpect_tag, uncounted_value, value };
+
+    template<Path P, int Site>
+    [[gnu::noinline]] Outcome make(int x) {
+        if constexpr (P == Path::uncounted_error) {
+            return failed.transform_error([x](int) { return x + Site; });
+        }
+        else if constexpr (P == Path::unexpected) {
+            return mori::unexpected(x + Site);
+        }
+        else if constexpr (P == Path::unexpect_tag) {
+            return Outcome(mori::unexpect, x + Site);
+        }
+        else if constexpr (P == Path::uncounted_value) {
+            return succeeded.transform([x](int) { return x + Site; });
+        }
+        else {
+            return x + Site;
+        }
+    }
+
+    // Calls through a table of Sites distinct functions, so the counters see that many call sites.
+    template<Path P, int... Sites>
+    [[nodiscard]] double run(const bench::options& opts, std::size_t count, std::integer_sequence<int, Sites...>) {
+        constexpr Outcome (*functions[])(int) = {make<P, Sites>...};
+        constexpr std::size_t sites = sizeof...(Sites);
+        return bench::measure(opts, count, [&] {
+            long long sum = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                const Outcome r = functions[i % sites](static_cast<int>(i));
+                sum += r ? *r : r.error();
+            }
+            bench::do_not_optimize(sum);
+        }).ns_per_op;
+    }
+
+    template<Path P>
+    void report(const bench::options& opts, const char* name, std::size_t count, double baseline_one,
+        double baseline_many) {
+        const double one = run<P>(opts, count, std::make_integer_sequence<int, 1>());
+        const double many = run<P>(opts, count, std::make_integer_sequence<int, 64>());
+        std::printf("| %-26s | %8.2f | %+8.2f | %8.2f | %+8.2f |\n", name, one, one - baseline_one, many,
+            many - baseline_many);
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(10'000'000);
+
+    bench::print_header("Cost of counting per construction (ns/op; 1 call site, then 64)");
+    std::printf("| %-26s | %8s | %8s | %8s | %8s |\n", "construction", "1 site", "added", "64 sites", "added");
+    std::printf("|----------------------------|----------|----------|----------|----------|\n");
+    const double error_one = run<Path::uncounted_error>(opts, count, std::make_integer_sequence<int, 1>());
+    const double error_many = run<Path::uncounted_error>(opts, count, std::make_integer_sequence<int, 64>());
+    std::printf("| %-26s | %8.2f | %8s | %8.2f | %8s |\n", "error, uncounted", error_one, "", error_many, "");
+    report<Path::unexpected>(opts, "error, unexpected(e)", count, error_one, error_many);
+    report<Path::unexpect_tag>(opts, "error, expected(unexpect)", count, error_one, error_many);
+    const double value_one = run<Path::uncounted_value>(opts, count, std::make_integer_sequence<int, 1>());
+    const double value_many = run<Path::uncounted_value>(opts, count, std::make_integer_sequence<int, 64>());
+    std::printf("| %-26s | %8.2f | %8s | %8.2f | %8s |\n", "value, uncounted", value_one, "", value_many, "");
+    report<Path::value>(opts, "value, return v", count, value_one, value_many);
+
+    std::printf("\n");
+    mori::dump_error_counts(stdout, 3);
+    return 0;
+}
@@ -0,0 +1,186 @@
+// Passes a result up through 1 and 5 layers, each of which can fail in ways of its own, so its error type is wider
+// than the one below it. Every other call fails at the bottom, a pattern the branch predictor learns, so the tables
+// show the work of widening rather than mispredictions. Three ways of widening the error are compared:
+//
+//     error_set        each layer returns error_set<layer 0, ..., layer N>; the lower result converts as it is.
+//     transform_error  each layer has an enumeration of its own that wraps the errors below it, mapped by a switch.
+//     std::variant     each layer returns std::variant<layer 0, ..., layer N> and visits the lower one to widen it.
+//
+// The layers are either inlined into one another, as in a header-only library or with LTO, or called across a
+// function boundary each, as between translation units.
+
+#include "bench.h"
+#include "error_set.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace {
+    template<int N>
+    struct layer {
+        enum class fault { refused = 1, timed_out };
+    };
+
+    template<int N, class Seq = std::make_integer_sequence<int, N + 1>>
+    struct layers;
+    template<int N, int... Is>
+    struct layers<N, std::integer_sequence<int, Is...>> {
+        using set = mori::error_set<typename layer<Is>::fault...>;
+        using variant = std::variant<typename layer<Is>::fault...>;
+    };
+
+    [[nodiscard]] bool fails(int x) { return (x & 1) != 0; }
+
+    struct with_error_set {
+        static constexpr const char* name = "error_set";
+
+        template<int N>
+        using result = mori::expected<int, typename layers<N>::set>;
+
+        [[gnu::noinline]] static result<0> source(int x) {
+            if (fails(x)) {
+                return mori::unexpected(layer<0>::fault::timed_out);
+            }
+            return x;
+        }
+        template<int N>
+        static result<N> widen(result<N - 1> r) {
+            return r;
+        }
+        template<int N>
+        static int consume(const result<N>& r) {
+            return r ? *r : static_cast<int>(r.error().code());
+        }
+    };
+
+    // Layer N's own errors come first, followed by one wrapper for each error of layer N - 1.
+    template<int N>
+    struct wrapped {
+        enum class fault { refused = 1, timed_out, lower_refused, lower_timed_out, lower_wrapped };
+    };
+
+    struct with_transform_error {
+        static constexpr const char* name = "transform_error";
+
+        template<int N>
+        using result = mori::expected<int, typename wrapped<N>::fault>;
+
+        [[gnu::noinline]] static result<0> source(int x) {
+            if (fails(x)) {
+                return mori::unexpected(wrapped<0>::fault::timed_out);
+            }
+            return x;
+        }
+        template<int N>
+        static result<N> widen(result<N - 1> r) {
+            using lower = typename wrapped<N - 1>::fault;
+            using upper = typename wrapped<N>::fault;
+            return r.transform_error([](lower e) {
+                switch (e) {
+                case lower::refused:
+                    return upper::lower_refused;
+                case lower::timed_out:
+                    return upper::lower_timed_out;
+                default:
+                    return upper::lower_wrapped;
+                }
+            });
+        }
+        template<int N>
+        static int consume(const result<N>& r) {
+            return r ? *r : static_cast<int>(r.error());
+        }
+    };
+
+    struct with_variant {
+        static constexpr const char* name = "std::variant";
+
+        template<int N>
+        using result = mori::expected<int, typename layers<N>::variant>;
+
+        [[gnu::noinline]] static result<0> source(int x) {
+            if (fails(x)) {
+                return mori::unexpected(layer<0>::fault::timed_out);
+            }
+            return x;
+        }
+        template<int N>
+        static result<N> widen(result<N - 1> r) {
+            return r.transform_error([](const typename layers<N - 1>::variant& e) {
+                return std::visit([](auto f) { return typename layers<N>::variant(f); }, e);
+            });
+        }
+        template<int N>
+        static int consume(const result<N>& r) {
+            return r ? *r : static_cast<int>(r.error().index());
+        }
+    };
+
+    template<class Way, int N>
+    [[gnu::always_inline]] inline typename Way::template result<N> inlined(int x) {
+        if constexpr (N == 0) {
+            return Way::source(x);
+        }
+        else {
+            return Way::template widen<N>(inlined<Way, N - 1>(x));
+        }
+    }
+
+    template<class Way, int N>
+    [[gnu::noinline]] typename Way::template result<N> called(int x) {
+        if constexpr (N == 0) {
+            return Way::source(x);
+        }
+        else {
+            return Way::template widen<N>(called<Way, N - 1>(x));
+        }
+    }
+
+    template<class Way, int N, bool Inline>
+    [[nodiscard]] double propagate(const bench::options& opts, const std::vector<int>& inputs) {
+        return bench::measure(opts, inputs.size(), [&] {
+            std::uint64_t sum = 0;
+            for (const int x : inputs) {
+                if constexpr (Inline) {
+                    sum += Way::template consume<N>(inlined<Way, N>(x));
+                }
+                else {
+                    sum += Way::template consume<N>(called<Way, N>(x));
+                }
+            }
+            bench::do_not_optimize(sum);
+        }).ns_per_op;
+    }
+
+    template<class Way>
+    void row(const bench::options& opts, const std::vector<int>& inputs) {
+        std::printf("| %-16s | %6zu | %8.2f | %8.2f | %8.2f | %8.2f |\n", Way::name,
+            sizeof(typename Way::template result<5>), propagate<Way, 1, true>(opts, inputs),
+            propagate<Way, 5, true>(opts, inputs), propagate<Way, 1, false>(opts, inputs),
+            propagate<Way, 5, false>(opts, inputs));
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t calls = opts.scale(5'000'000);
+
+    std::vector<int> inputs(calls);
+    for (std::size_t i = 0; i < calls; ++i) {
+        inputs[i] = static_cast<int>(i);
+    }
+
+    char title[128];
+    std::snprintf(title, sizeof(title), "%zu calls through 1 and 5 layers, every other one an error (ns/call)", calls);
+    bench::print_header(title);
+    std::printf("| %-16s | %6s | %8s | %8s | %8s | %8s |\n", "widened by", "bytes", "inline 1", "inline 5", "calls 1",
+        "calls 5");
+    std::printf("|------------------|--------|----------|----------|----------|----------|\n");
+    row<with_error_set>(opts, inputs);
+    row<with_transform_error>(opts, inputs);
+    row<with_variant>(opts, inputs);
+    return 0;
+}
@@ -0,0 +1,409 @@
+// Measures the renameFile error-handling strategies from the blog post against each other: exceptions, an
+// std::error_code out-parameter, returning std::error_code, std::pair, a RenameResult struct, std::variant,
+// mori::expected and (when the standard library has it) std::expected.
+//
+// Each strategy propagates the result of a leaf "rename" through a chain of non-inlined frames, at several chain
+// depths and error rates, and reports ns/op, instructions/op and the code size the strategy adds to the binary.
+
+#include "bench.h"
+#include "expected.h"
+
+#include <array>
+#include <cstdio>
+#include <random>
+#include <system_error>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if __has_include(<expected>)
+#include <expected>
+#endif
+
+namespace {
+    struct Request {
+        int id;
+        bool fail;
+    };
+
+    struct Totals {
+        long long sum = 0;
+        long long errors = 0;
+    };
+
+    [[nodiscard]] std::error_code rename_error() {
+        return std::make_error_code(std::errc::no_such_file_or_directory);
+    }
+
+    [[nodiscard]] int renamed(const Request& request) {
+        return request.id * 3 + 1;
+    }
+}
+
+namespace strategies {
+    struct exceptions {
+        static int leaf(const Request& request) {
+            if (request.fail) {
+                throw std::system_error(rename_error());
+            }
+            return renamed(request);
+        }
+        template<int Depth>
+        [[gnu::noinline]] static int call(const Request& request) {
+            if constexpr (Depth == 1) {
+                return leaf(request) + 1;
+            }
+            else {
+                return call<Depth - 1>(request) + 1;
+            }
+        }
+        template<int Depth>
+        static void run(const Request& request, Totals& totals) {
+            try {
+                totals.sum += call<Depth>(request);
+            }
+            catch (const std::system_error& e) {
+                totals.sum += e.code().value();
+                ++totals.errors;
+            }
+        }
+    };
+
+    struct out_param {
+        static bool leaf(const Request& request, int& value, std::error_code& ec) {
+            if (request.fail) {
+                ec = rename_error();
+                return false;
+            }
+            value = renamed(request);
+            return true;
+        }
+        template<int Depth>
+        [[gnu::noinline]] static bool call(const Request& request, int& value, std::error_code& ec) {
+            bool ok = false;
+            if constexpr (Depth == 1) {
+                ok = leaf(request, value, ec);
+            }
+            else {
+                ok = call<Depth - 1>(request, value, ec);
+            }
+            if (!ok) {
+                return false;
+            }
+            value += 1;
+            return true;
+        }
+        template<int Depth>
+        static void run(const Request& request, Totals& totals) {
+            int value = 0;
+            std::error_code ec;
+            if (call<Depth>(request, value, ec)) {
+                totals.sum += value;
+            }
+            else {
+                totals.sum += ec.value();
+                ++totals.errors;
+            }
+        }
+    };
+
+    struct error_code_return {
+        static std::error_code leaf(const Request& request, int& value) {
+            if (request.fail) {
+                return rename_error();
+            }
+            value = renamed(request);
+            return {};
+        }
+        template<int Depth>
+        [[gnu::noinline]] static std::error_code call(const Request& request, int& value) {
+            std::error_code ec;
+            if constexpr (Depth == 1) {
+                ec = leaf(request, value);
+            }
+            else {
+                ec = call<Depth - 1>(request, value);
+            }
+            if (ec) {
+                return ec;
+            }
+            value += 1;
+            return {};
+        }
+        template<int Depth>
+        static void run(const Request& request, Totals& totals) {
+            int value = 0;
+            if (const std::error_code ec = call<Depth>(request, value)) {
+                totals.sum += ec.value();
+                ++totals.errors;
+            }
+            else {
+                totals.sum += value;
+            }
+        }
+    };
+
+    struct pair {
+        using result = std::pair<int, std::error_code>;
+
+        static result leaf(const Request& request) {
+            if (request.fail) {
+                return {0, rename_error()};
+            }
+            return {renamed(request), std::error_code()};
+        }
+        template<int Depth>
+        [[gnu::noinline]] static result call(const Request& request) {
+            result r;
+            if constexpr (Depth == 1) {
+                r = leaf(request);
+            }
+            else {
+                r = call<Depth - 1>(request);
+            }
+            if (r.second) {
+                return r;
+            }
+            return {r.first + 1, std::error_code()};
+        }
+        template<int Depth>
+        static void run(const Request& request, Totals& totals) {
+            const auto [value, ec] = call<Depth>(request);
+            if (ec) {
+                totals.sum += ec.value();
+                ++totals.errors;
+            }
+            else {
+                totals.sum += value;
+            }
+        }
+    };
+
+    struct result_struct {
+        struct RenameResult {
+            bool renamed;
+            int value;
+            std::error_code ec;
+        };
+
+        static RenameResult leaf(const Request& request) {
+            if (request.fail) {
+                return {false, 0, rename_error()};
+            }
+            return {true, renamed(request), std::error_code()};
+        }
+        template<int Depth>
+        [[gnu::noinline]] static RenameResult call(const Request& request) {
+            RenameResult r;
+            if constexpr (Depth == 1) {
+                r = leaf(request);
+            }
+            else {
+                r = call<Depth - 1>(request);
+            }
+            if (!r.renamed) {
+                return r;
+            }
+            return {true, r.value + 1, std::error_code()};
+        }
+        template<int Depth>
+        static void run(const Request& request, Totals& totals) {
+            const RenameResult r = call<Depth>(request);
+            if (r.renamed) {
+                totals.sum += r.value;
+            }
+            else {
+                totals.sum += r.ec.value();
+                ++totals.errors;
+            }
+        }
+    };
+
+    struct variant {
+        using result = std::variant<int, std::error_code>;
+
+        static result leaf(const Request& request) {
+            if (request.fail) {
+                return rename_error();
+            }
+            return renamed(request);
+        }
+        template<int Depth>
+        [[gnu::noinline]] static result call(const Request& request) {
+            result r;
+            if constexpr (Depth == 1) {
+                r = leaf(request);
+            }
+            else {
+                r = call<Depth - 1>(request);
+            }
+            if (const int* value = std::get_if<int>(&r)) {
+                return *value + 1;
+            }
+            return r;
+        }
+        template<int Depth>
+        static void run(const Request& request, Totals& totals) {
+            const result r = call<Depth>(request);
+            if (const int* value = std::get_if<int>(&r)) {
+                totals.sum += *value;
+            }
+            else {
+                totals.sum += std::get<std::error_code>(r).value();
+                ++totals.errors;
+            }
+        }
+    };
+
+    // Name only labels the instantiation so its code can be told apart from the other expected in the binary.
+    template<class Name, template<class, class> class Expected, template<class> class Unexpected>
+    struct expected_strategy {
+        using result = Expected<int, std::error_code>;
+
+        static result leaf(const Request& request) {
+            if (request.fail) {
+                return Unexpected<std::error_code>(rename_error());
+            }
+            return renamed(request);
+        }
+        template<int Depth>
+        [[gnu::noinline]] static result call(const Request& request) {
+            result r = [&] {
+                if constexpr (Depth == 1) {
+                    return leaf(request);
+                }
+                else {
+                    return call<Depth - 1>(request);
+                }
+            }();
+            if (!r) {
+                return r;
+            }
+            return *r + 1;
+        }
+        template<int Depth>
+        static void run(const Request& request, Totals& totals) {
+            const result r = call<Depth>(request);
+            if (r) {
+                totals.sum += *r;
+            }
+            else {
+                totals.sum += r.error().value();
+                ++totals.errors;
+            }
+        }
+    };
+
+    struct mori_expected_name;
+    using mori_expected = expected_strategy<mori_expected_name, mori::expected, mori::unexpected>;
+#if defined(__cpp_lib_expected)
+    struct std_expected_name;
+    using std_expected = expected_strategy<std_expected_name, std::expected, std::unexpected>;
+#endif
+}
+
+namespace {
+    constexpr std::array depths{1, 4, 16, 64};
+    constexpr std::array error_rates{0.0, 0.01, 0.1, 0.5};
+
+    [[nodiscard]] std::vector<Request> make_requests(std::size_t count, double error_rate) {
+        std::mt19937 rng(42);
+        std::bernoulli_distribution fails(error_rate);
+        std::vector<Request> requests(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            requests[i] = {static_cast<int>(i), fails(rng)};
+        }
+        return requests;
+    }
+
+    template<class Strategy, int Depth>
+    [[nodiscard]] bench::measurement measure_one(const bench::options& opts, const std::vector<Request>& requests) {
+        return bench::measure(opts, requests.size(), [&] {
+            Totals totals;
+            for (const Request& request : requests) {
+                Strategy::template run<Depth>(request, totals);
+            }
+            bench::do_not_optimize(totals);
+        });
+    }
+
+    template<class Strategy>
+    [[nodiscard]] bench::measurement measure_depth(
+        const bench::options& opts, int depth, const std::vector<Request>& requests) {
+        switch (depth) {
+        case 1:
+            return measure_one<Strategy, 1>(opts, requests);
+        case 4:
+            return measure_one<Strategy, 4>(opts, requests);
+        case 16:
+            return measure_one<Strategy, 16>(opts, requests);
+        default:
+            return measure_one<Strategy, 64>(opts, requests);
+        }
+    }
+
+    template<class Strategy>
+    void report(const bench::options& opts, const char* name, int depth, const std::vector<std::vector<Request>>& inputs) {
+        std::printf("| %-17s |", name);
+        for (const auto& requests : inputs) {
+            const bench::measurement m = measure_depth<Strategy>(opts, depth, requests);
+            std::printf(" %8.2f | %8s |", m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str());
+        }
+        std::printf("\n");
+    }
+
+    void report_size(const char* name, const char* scope) {
+        const auto size = bench::code_size(scope);
+        std::printf("| %-17s | %10s |\n", name, size ? std::to_string(*size).c_str() : "n/a");
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(50'000);
+
+    std::vector<std::vector<Request>> inputs;
+    for (const double rate : error_rates) {
+        inputs.push_back(make_requests(count, rate));
+    }
+
+    for (const int depth : depths) {
+        char title[64];
+        std::snprintf(title, sizeof(title), "Call depth %d (ns/op, instructions/op)", depth);
+        bench::print_header(title);
+        std::printf("| %-17s |", "strategy");
+        for (const double rate : error_rates) {
+            std::printf(" %5.1f%% ns | %5.1f%% in |", rate * 100, rate * 100);
+        }
+        std::printf("\n|-------------------|");
+        for (std::size_t i = 0; i < error_rates.size(); ++i) {
+            std::printf("----------|----------|");
+        }
+        std::printf("\n");
+
+        report<strategies::exceptions>(opts, "exceptions", depth, inputs);
+        report<strategies::out_param>(opts, "out-parameter", depth, inputs);
+        report<strategies::error_code_return>(opts, "error_code return", depth, inputs);
+        report<strategies::pair>(opts, "std::pair", depth, inputs);
+        report<strategies::result_struct>(opts, "RenameResult", depth, inputs);
+        report<strategies::variant>(opts, "std::variant", depth, inputs);
+        report<strategies::mori_expected>(opts, "mori::expected", depth, inputs);
+#if defined(__cpp_lib_expected)
+        report<strategies::std_expected>(opts, "std::expected", depth, inputs);
+#endif
+    }
+
+    bench::print_header("Code size (bytes of out-of-line functions)");
+    std::printf("| %-17s | %10s |\n|-------------------|------------|\n", "strategy", "bytes");
+    report_size("exceptions", "exceptions");
+    report_size("out-parameter", "out_param");
+    report_size("error_code return", "error_code_return");
+    report_size("std::pair", "pair");
+    report_size("RenameResult", "result_struct");
+    report_size("std::variant", "variant");
+    report_size("mori::expected", "mori_expected_name");
+#if defined(__cpp_lib_expected)
+    report_size("std::expected", "std_expected_name");
+#endif
+    return 0;
+}
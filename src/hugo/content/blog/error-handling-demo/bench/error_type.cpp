@@ -0,0 +1,125 @@
+// Compares error types on a validation path that rejects 30% of its inputs: a std::string message (what most
+// hand-rolled error types end up carrying), std::error_code, and mori::Error with an interned message and the
+// offending value as payload. Each rejection is propagated through four frames before it is inspected.
+
+#include "bench.h"
+#include "result.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+    long long allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    constexpr int limit = 1000;
+
+    struct string_error {
+        using error_type = std::string;
+
+        static error_type reject(int field) {
+            return "field out of range: " + std::to_string(field);
+        }
+        static long long inspect(const error_type& e) {
+            return static_cast<long long>(e.size());
+        }
+    };
+
+    struct error_code_error {
+        using error_type = std::error_code;
+
+        static error_type reject(int /*field*/) {
+            return std::make_error_code(std::errc::result_out_of_range);
+        }
+        static long long inspect(const error_type& e) {
+            return e.value();
+        }
+    };
+
+    struct mori_error {
+        using error_type = mori::Error;
+
+        static error_type reject(int field) {
+            return mori::Error(std::errc::result_out_of_range, mori::message<"field out of range">).with_payload(field);
+        }
+        static long long inspect(const error_type& e) {
+            return e.value() + e.payload<int>().value_or(0);
+        }
+    };
+
+    template<class Style, int Depth>
+    [[gnu::noinline]] mori::expected<int, typename Style::error_type> validate(int field) {
+        if constexpr (Depth == 0) {
+            if (field > limit) {
+                return mori::unexpected(Style::reject(field));
+            }
+            return field * 2;
+        }
+        else {
+            auto r = validate<Style, Depth - 1>(field);
+            if (!r) {
+                return mori::unexpected(std::move(r).error());
+            }
+            return *r + 1;
+        }
+    }
+
+    template<class Style>
+    void report(const bench::options& opts, const char* name, const std::vector<int>& fields) {
+        const auto body = [&] {
+            long long sum = 0;
+            for (const int field : fields) {
+                const auto r = validate<Style, 4>(field);
+                sum += r ? *r : Style::inspect(r.error());
+            }
+            bench::do_not_optimize(sum);
+        };
+        const bench::measurement m = bench::measure(opts, fields.size(), body);
+        const long long before = allocations;
+        body();
+        const double per_op = static_cast<double>(allocations - before) / static_cast<double>(fields.size());
+        std::printf("| %-16s | %8zu | %8.2f | %8s | %8.3f |\n", name, sizeof(mori::expected<int, typename Style::error_type>),
+            m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str(), per_op);
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(1'000'000);
+
+    std::mt19937 rng(3);
+    std::bernoulli_distribution rejected(0.3);
+    std::uniform_int_distribution<int> valid(0, limit);
+    std::vector<int> fields(count);
+    for (int& field : fields) {
+        field = rejected(rng) ? limit + valid(rng) + 1 : valid(rng);
+    }
+
+    bench::print_header("Validation with 30% rejects, four frames deep");
+    std::printf("| %-16s | %8s | %8s | %8s | %8s |\n", "error type", "bytes", "ns/op", "instr/op", "allocs");
+    std::printf("|------------------|----------|----------|----------|----------|\n");
+    report<string_error>(opts, "std::string", fields);
+    report<error_code_error>(opts, "std::error_code", fields);
+    report<mori_error>(opts, "mori::Error", fields);
+    return 0;
+}
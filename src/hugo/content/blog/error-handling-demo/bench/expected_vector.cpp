@@ -0,0 +1,119 @@
+// Compares a batch of results stored as std::vector<mori::expected<T, E>> with the same batch stored as a
+// mori::expected_vector<T, E> on the bulk operations a batch pipeline performs: mapping every value, counting the
+// failures and collecting the values.
+
+#include "bench.h"
+#include "expected_vector.h"
+
+#include <array>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    enum class Fault : int { unparseable = 1 };
+
+    struct Inputs {
+        std::vector<mori::expected<float, Fault>> array_of_structs;
+        mori::expected_vector<float, Fault> structure_of_arrays;
+    };
+
+    [[nodiscard]] Inputs make_inputs(std::size_t count, double error_rate) {
+        std::mt19937 rng(5);
+        std::bernoulli_distribution fails(error_rate);
+        std::uniform_real_distribution<float> value(0, 100);
+        Inputs inputs;
+        inputs.array_of_structs.reserve(count);
+        inputs.structure_of_arrays.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (fails(rng)) {
+                inputs.array_of_structs.push_back(mori::unexpected(Fault::unparseable));
+                inputs.structure_of_arrays.push_back(mori::unexpected(Fault::unparseable));
+            }
+            else {
+                const float v = value(rng);
+                inputs.array_of_structs.push_back(v);
+                inputs.structure_of_arrays.push_back(v);
+            }
+        }
+        return inputs;
+    }
+
+    constexpr auto scale = [](float x) { return x * 1.5f + 2.0f; };
+
+    template<class Body>
+    void report(const bench::options& opts, const char* name, const std::vector<Inputs>& sets, Body body) {
+        std::printf("| %-30s |", name);
+        for (const Inputs& inputs : sets) {
+            const bench::measurement m = bench::measure(opts, inputs.array_of_structs.size(), [&] { body(inputs); });
+            std::printf(" %8.2f | %8s |", m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str());
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(1'000'000);
+    constexpr std::array error_rates{0.0, 0.01, 0.3};
+
+    std::vector<Inputs> sets;
+    for (const double rate : error_rates) {
+        sets.push_back(make_inputs(count, rate));
+    }
+
+    bench::print_header("Bulk operations per element (ns/op, instructions/op)");
+    std::printf("| %-30s |", "operation");
+    for (const double rate : error_rates) {
+        std::printf(" %5.1f%% ns | %5.1f%% in |", rate * 100, rate * 100);
+    }
+    std::printf("\n|--------------------------------|");
+    for (std::size_t i = 0; i < error_rates.size(); ++i) {
+        std::printf("----------|----------|");
+    }
+    std::printf("\n");
+
+    report(opts, "transform, vector<expected>", sets, [](const Inputs& inputs) {
+        std::vector<mori::expected<float, Fault>> out;
+        out.reserve(inputs.array_of_structs.size());
+        for (const auto& e : inputs.array_of_structs) {
+            out.push_back(e.transform(scale));
+        }
+        bench::do_not_optimize(out.data());
+    });
+    report(opts, "transform, expected_vector", sets, [](const Inputs& inputs) {
+        const auto out = inputs.structure_of_arrays.transform(scale);
+        bench::do_not_optimize(out.size());
+    });
+    report(opts, "count_errors, vector<expected>", sets, [](const Inputs& inputs) {
+        std::size_t errors = 0;
+        for (const auto& e : inputs.array_of_structs) {
+            errors += !e.has_value();
+        }
+        bench::do_not_optimize(errors);
+    });
+    // The vector keeps the count of its error table; a view counts with popcount over the bitmask, as any sub-range would.
+    report(opts, "count_errors, expected_vector", sets, [](const Inputs& inputs) {
+        const auto& v = inputs.structure_of_arrays;
+        bench::do_not_optimize(v.size() - v.view().count_values());
+    });
+    report(opts, "partition, vector<expected>", sets, [](const Inputs& inputs) {
+        std::vector<float> values;
+        std::vector<Fault> errors;
+        for (const auto& e : inputs.array_of_structs) {
+            if (e.has_value()) {
+                values.push_back(*e);
+            }
+            else {
+                errors.push_back(e.error());
+            }
+        }
+        bench::do_not_optimize(values.data());
+        bench::do_not_optimize(errors.data());
+    });
+    report(opts, "partition, expected_vector", sets, [](const Inputs& inputs) {
+        const auto parts = inputs.structure_of_arrays.partition();
+        bench::do_not_optimize(parts.values.data());
+    });
+    return 0;
+}
@@ -0,0 +1,251 @@
+// Compares a synchronous std::filesystem loop with mori::fs, one call at a time and batched, on the spool-directory
+// workload that motivates it: stat, rename (there and back), read a small file, and create then remove a directory,
+// each over many files. Batches run once on io_uring, where available, and once on a thread pool of their own.
+
+#include "bench.h"
+#include "fs.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+    namespace stdfs = std::filesystem;
+
+    struct Spool {
+        std::vector<stdfs::path> files;
+        std::vector<stdfs::path> moved;
+        std::vector<stdfs::path> directories;
+    };
+
+    [[nodiscard]] Spool make_spool(const stdfs::path& root, std::size_t count) {
+        Spool spool;
+        const std::string text(1024, 's');
+        for (std::size_t i = 0; i < count; ++i) {
+            const stdfs::path shard = root / std::to_string(i % 64);
+            stdfs::create_directories(shard);
+            spool.files.push_back(shard / (std::to_string(i) + ".msg"));
+            spool.moved.push_back(shard / (std::to_string(i) + ".done"));
+            spool.directories.push_back(shard / std::to_string(i));
+            std::ofstream(spool.files.back(), std::ios::binary) << text;
+        }
+        return spool;
+    }
+
+    // One way of running each workload; every function returns a checksum so nothing can be skipped.
+    struct Strategy {
+        const char* name;
+        std::function<std::size_t(const Spool&)> stat;
+        std::function<std::size_t(const Spool&)> rename;
+        std::function<std::size_t(const Spool&)> read;
+        std::function<std::size_t(const Spool&)> mkdir_remove;
+    };
+
+    [[nodiscard]] Strategy std_filesystem() {
+        return {"std::filesystem",
+            [](const Spool& s) {
+                std::size_t sum = 0;
+                for (const stdfs::path& p : s.files) {
+                    std::error_code ec;
+                    sum += static_cast<std::size_t>(stdfs::file_size(p, ec));
+                }
+                return sum;
+            },
+            [](const Spool& s) {
+                std::size_t failures = 0;
+                for (std::size_t i = 0; i < s.files.size(); ++i) {
+                    std::error_code ec;
+                    stdfs::rename(s.files[i], s.moved[i], ec);
+                    failures += ec ? 1 : 0;
+                }
+                for (std::size_t i = 0; i < s.files.size(); ++i) {
+                    std::error_code ec;
+                    stdfs::rename(s.moved[i], s.files[i], ec);
+                    failures += ec ? 1 : 0;
+                }
+                return failures;
+            },
+            [](const Spool& s) {
+                std::size_t sum = 0;
+                for (const stdfs::path& p : s.files) {
+                    std::error_code ec;
+                    const auto size = stdfs::file_size(p, ec);
+                    if (ec) {
+                        continue;
+                    }
+                    std::string data(size, '\0');
+                    std::ifstream in(p, std::ios::binary);
+                    in.read(data.data(), static_cast<std::streamsize>(size));
+                    sum += data.size();
+                }
+                return sum;
+            },
+            [](const Spool& s) {
+                std::size_t made = 0;
+                for (const stdfs::path& p : s.directories) {
+                    std::error_code ec;
+                    made += stdfs::create_directories(p, ec) ? 1 : 0;
+                }
+                for (const stdfs::path& p : s.directories) {
+                    std::error_code ec;
+                    made += stdfs::remove(p, ec) ? 1 : 0;
+                }
+                return made;
+            }};
+    }
+
+    [[nodiscard]] Strategy mori_fs() {
+        return {"mori::fs",
+            [](const Spool& s) {
+                std::size_t sum = 0;
+                for (const stdfs::path& p : s.files) {
+                    const auto info = mori::fs::stat(p);
+                    sum += info ? info->size : 0;
+                }
+                return sum;
+            },
+            [](const Spool& s) {
+                std::size_t failures = 0;
+                for (std::size_t i = 0; i < s.files.size(); ++i) {
+                    failures += mori::fs::rename(s.files[i], s.moved[i]) ? 0 : 1;
+                }
+                for (std::size_t i = 0; i < s.files.size(); ++i) {
+                    failures += mori::fs::rename(s.moved[i], s.files[i]) ? 0 : 1;
+                }
+                return failures;
+            },
+            [](const Spool& s) {
+                std::size_t sum = 0;
+                for (const stdfs::path& p : s.files) {
+                    const auto data = mori::fs::read_file(p);
+                    sum += data ? data->size() : 0;
+                }
+                return sum;
+            },
+            [](const Spool& s) {
+                std::size_t made = 0;
+                for (const stdfs::path& p : s.directories) {
+                    made += mori::fs::create_directories(p).value_or(false) ? 1 : 0;
+                }
+                for (const stdfs::path& p : s.directories) {
+                    made += mori::fs::remove(p).value_or(false) ? 1 : 0;
+                }
+                return made;
+            }};
+    }
+
+    [[nodiscard]] Strategy batched(const char* name, mori::fs::backend backend, mori::thread_pool& pool) {
+        return {name,
+            [=, &pool](const Spool& s) {
+                mori::fs::batch b(backend, pool);
+                std::vector<mori::fs::ticket<mori::fs::status>> tickets;
+                tickets.reserve(s.files.size());
+                for (const stdfs::path& p : s.files) {
+                    tickets.push_back(b.stat(p));
+                }
+                b.wait();
+                std::size_t sum = 0;
+                for (const auto t : tickets) {
+                    sum += b[t] ? b[t]->size : 0;
+                }
+                return sum;
+            },
+            [=, &pool](const Spool& s) {
+                std::size_t failures = 0;
+                for (const bool back : {false, true}) {
+                    mori::fs::batch b(backend, pool);
+                    std::vector<mori::fs::ticket<void>> tickets;
+                    tickets.reserve(s.files.size());
+                    for (std::size_t i = 0; i < s.files.size(); ++i) {
+                        tickets.push_back(back ? b.rename(s.moved[i], s.files[i]) : b.rename(s.files[i], s.moved[i]));
+                    }
+                    b.wait();
+                    for (const auto t : tickets) {
+                        failures += b[t] ? 0 : 1;
+                    }
+                }
+                return failures;
+            },
+            [=, &pool](const Spool& s) {
+                mori::fs::batch b(backend, pool);
+                std::vector<mori::fs::ticket<std::string>> tickets;
+                tickets.reserve(s.files.size());
+                for (const stdfs::path& p : s.files) {
+                    tickets.push_back(b.read_file(p));
+                }
+                b.wait();
+                std::size_t sum = 0;
+                for (const auto t : tickets) {
+                    sum += b[t] ? b[t]->size() : 0;
+                }
+                return sum;
+            },
+            [=, &pool](const Spool& s) {
+                std::size_t made = 0;
+                for (const bool remove : {false, true}) {
+                    mori::fs::batch b(backend, pool);
+                    std::vector<mori::fs::ticket<bool>> tickets;
+                    tickets.reserve(s.directories.size());
+                    for (const stdfs::path& p : s.directories) {
+                        tickets.push_back(remove ? b.remove(p) : b.create_directories(p));
+                    }
+                    b.wait();
+                    for (const auto t : tickets) {
+                        made += b[t].value_or(false) ? 1 : 0;
+                    }
+                }
+                return made;
+            }};
+    }
+
+    void report(const bench::options& opts, const Strategy& strategy, const Spool& spool) {
+        const std::size_t n = spool.files.size();
+        const auto run = [&](const std::function<std::size_t(const Spool&)>& workload, std::size_t ops) {
+            return bench::measure(opts, ops, [&] { bench::do_not_optimize(workload(spool)); }).ns_per_op;
+        };
+        std::printf("| %-22s | %10.0f | %10.0f | %10.0f | %12.0f |\n", strategy.name, run(strategy.stat, n),
+            run(strategy.rename, 2 * n), run(strategy.read, n), run(strategy.mkdir_remove, 2 * n));
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(4'000);
+
+    std::string pattern = (stdfs::temp_directory_path() / "mori-fs-bench-XXXXXX").string();
+    if (::mkdtemp(pattern.data()) == nullptr) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    const stdfs::path root = pattern;
+    const Spool spool = make_spool(root, count);
+
+    constexpr unsigned threads = 8;
+    mori::thread_pool pool(threads);
+    const bool ring = mori::fs::batch(mori::fs::backend::automatic, pool).uses_io_uring();
+
+    char title[96];
+    std::snprintf(title, sizeof(title), "%zu spool files (ns/op)", count);
+    bench::print_header(title);
+    std::printf("| %-22s | %10s | %10s | %10s | %12s |\n", "strategy", "stat", "rename", "read 1 KiB", "mkdir+remove");
+    std::printf("|------------------------|------------|------------|------------|--------------|\n");
+    report(opts, std_filesystem(), spool);
+    report(opts, mori_fs(), spool);
+    if (ring) {
+        report(opts, batched("batch, io_uring", mori::fs::backend::automatic, pool), spool);
+    }
+    else {
+        std::printf("| %-22s | %10s | %10s | %10s | %12s |\n", "batch, io_uring", "n/a", "n/a", "n/a", "n/a");
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "batch, %u threads", threads);
+    report(opts, batched(name, mori::fs::backend::threads, pool), spool);
+
+    stdfs::remove_all(root);
+    return 0;
+}
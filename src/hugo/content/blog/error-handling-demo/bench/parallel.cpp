@@ -0,0 +1,101 @@
+// Shows how the parallel algorithms scale with the number of threads on a CPU-bound validation workload: every record
+// is checked by hashing its payload a few hundred times. One row per pool size, from one thread up to the machine's
+// core count, for a clean batch and for one that fails halfway through (where cancellation skips the rest).
+
+#include "bench.h"
+#include "parallel.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+    enum class Fault { corrupt };
+
+    struct Record {
+        std::uint64_t payload;
+        std::uint64_t checksum;
+    };
+
+    [[nodiscard]] std::uint64_t digest(std::uint64_t x) {
+        for (int round = 0; round < 256; ++round) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+        }
+        return x;
+    }
+
+    [[nodiscard]] mori::expected<std::uint64_t, Fault> validate(const Record& record) {
+        const std::uint64_t d = digest(record.payload);
+        if (d != record.checksum) {
+            return mori::unexpected(Fault::corrupt);
+        }
+        return d & 0xff;
+    }
+
+    [[nodiscard]] std::vector<Record> make_records(std::size_t count) {
+        std::vector<Record> records(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            records[i].payload = i * 0x9e3779b97f4a7c15ULL + 1;
+            records[i].checksum = digest(records[i].payload);
+        }
+        return records;
+    }
+
+    [[nodiscard]] std::vector<unsigned> pool_sizes() {
+        const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<unsigned> sizes;
+        for (unsigned n = 1; n < cores; n *= 2) {
+            sizes.push_back(n);
+        }
+        sizes.push_back(cores);
+        return sizes;
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(2'000'000);
+    const std::vector<Record> clean = make_records(count);
+    std::vector<Record> broken = clean;
+    broken[count / 2].checksum ^= 1;
+
+    bench::print_header("Validation, parallel_transform_reduce (ns/record)");
+    std::printf("| %7s | %8s | %8s | %12s | %8s |\n", "threads", "clean", "speedup", "fails at 50%", "speedup");
+    std::printf("|---------|----------|----------|--------------|----------|\n");
+    double clean_base = 0;
+    double broken_base = 0;
+    for (const unsigned threads : pool_sizes()) {
+        mori::thread_pool pool(threads);
+        const auto run = [&](const std::vector<Record>& records) {
+            const auto r = mori::parallel_transform_reduce(pool, records, std::uint64_t{0}, std::plus<>(), validate);
+            bench::do_not_optimize(r);
+        };
+        const bench::measurement ok = bench::measure(opts, count, [&] { run(clean); });
+        const bench::measurement failing = bench::measure(opts, count, [&] { run(broken); });
+        if (threads == 1) {
+            clean_base = ok.ns_per_op;
+            broken_base = failing.ns_per_op;
+        }
+        std::printf("| %7u | %8.2f | %7.2fx | %12.2f | %7.2fx |\n", threads, ok.ns_per_op, clean_base / ok.ns_per_op,
+            failing.ns_per_op, broken_base / failing.ns_per_op);
+    }
+
+    bench::print_header("Sequential baseline (ns/record)");
+    const bench::measurement loop = bench::measure(opts, count, [&] {
+        std::uint64_t sum = 0;
+        for (const Record& record : clean) {
+            const auto r = validate(record);
+            if (!r) {
+                break;
+            }
+            sum += *r;
+        }
+        bench::do_not_optimize(sum);
+    });
+    std::printf("plain loop: %.2f\n", loop.ns_per_op);
+    return 0;
+}
@@ -0,0 +1,158 @@
+// Compares an eight-stage chain of monadic operations written three ways: hand-written if/else propagation, the
+// eager member functions, and a lazy mori::pipe pipeline. The payload is a 64-byte record so that every extra move
+// the chain makes shows up in the timings.
+
+#include "bench.h"
+#include "pipeline.h"
+
+#include <array>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    struct Record {
+        std::array<long long, 8> fields;
+    };
+
+    enum class Fault { none, invalid, overflow, rejected };
+
+    using Ex = mori::expected<Record, Fault>;
+
+    struct Input {
+        long long seed;
+        bool invalid;
+    };
+
+    [[nodiscard]] inline Ex parse(const Input& input) {
+        if (input.invalid) {
+            return mori::unexpected(Fault::invalid);
+        }
+        return Record{{input.seed, input.seed + 1, 2, 3, 4, 5, 6, 7}};
+    }
+    [[nodiscard]] inline Record scale(const Record& r) {
+        Record out = r;
+        for (auto& field : out.fields) {
+            field *= 3;
+        }
+        return out;
+    }
+    [[nodiscard]] inline Ex validate(const Record& r) {
+        if (r.fields[0] < 0) {
+            return mori::unexpected(Fault::overflow);
+        }
+        return r;
+    }
+    [[nodiscard]] inline Record offset(const Record& r) {
+        Record out = r;
+        out.fields[7] += out.fields[0];
+        return out;
+    }
+    [[nodiscard]] inline Ex recover(Fault fault) {
+        if (fault == Fault::overflow) {
+            return Record{};
+        }
+        return mori::unexpected(fault);
+    }
+    [[nodiscard]] inline Fault classify(Fault fault) {
+        return fault == Fault::invalid ? Fault::rejected : fault;
+    }
+
+    [[nodiscard]] Ex hand_written(const Input& input) {
+        Ex parsed = parse(input);
+        if (!parsed) {
+            return mori::unexpected(classify(parsed.error()));
+        }
+        Ex valid = validate(scale(*parsed));
+        if (!valid) {
+            Ex recovered = recover(classify(valid.error()));
+            if (!recovered) {
+                return recovered;
+            }
+            return scale(offset(*recovered));
+        }
+        Ex checked = validate(offset(*valid));
+        if (!checked) {
+            return mori::unexpected(checked.error());
+        }
+        return scale(offset(*checked));
+    }
+
+    [[nodiscard]] Ex eager(const Input& input) {
+        return parse(input)
+            .transform(scale)
+            .and_then(validate)
+            .transform(offset)
+            .and_then(validate)
+            .transform_error(classify)
+            .or_else(recover)
+            .transform(offset)
+            .transform(scale);
+    }
+
+    [[nodiscard]] Ex lazy(const Input& input) {
+        return mori::pipe(parse(input))
+            .transform(scale)
+            .and_then(validate)
+            .transform(offset)
+            .and_then(validate)
+            .transform_error(classify)
+            .or_else(recover)
+            .transform(offset)
+            .transform(scale);
+    }
+
+    [[nodiscard]] std::vector<Input> make_inputs(std::size_t count, double error_rate) {
+        std::mt19937 rng(7);
+        std::bernoulli_distribution invalid(error_rate);
+        std::uniform_int_distribution<long long> seed(-5, 1000);
+        std::vector<Input> inputs(count);
+        for (auto& input : inputs) {
+            input = {seed(rng), invalid(rng)};
+        }
+        return inputs;
+    }
+
+    template<class F>
+    void report(const bench::options& opts, const char* name, F&& chain, const std::vector<std::vector<Input>>& sets) {
+        std::printf("| %-12s |", name);
+        for (const auto& inputs : sets) {
+            const bench::measurement m = bench::measure(opts, inputs.size(), [&] {
+                long long sum = 0;
+                for (const Input& input : inputs) {
+                    const Ex result = chain(input);
+                    sum += result ? result->fields[7] : static_cast<long long>(result.error());
+                }
+                bench::do_not_optimize(sum);
+            });
+            std::printf(" %8.2f | %8s |", m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str());
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(1'000'000);
+    constexpr std::array error_rates{0.0, 0.1, 0.5};
+
+    std::vector<std::vector<Input>> sets;
+    for (const double rate : error_rates) {
+        sets.push_back(make_inputs(count, rate));
+    }
+
+    bench::print_header("Eight-stage chain over a 64-byte record (ns/op, instructions/op)");
+    std::printf("| %-12s |", "style");
+    for (const double rate : error_rates) {
+        std::printf(" %5.1f%% ns | %5.1f%% in |", rate * 100, rate * 100);
+    }
+    std::printf("\n|--------------|");
+    for (std::size_t i = 0; i < error_rates.size(); ++i) {
+        std::printf("----------|----------|");
+    }
+    std::printf("\n");
+    report(opts, "if/else", hand_written, sets);
+    report(opts, "eager", eager, sets);
+    report(opts, "mori::pipe", lazy, sets);
+    return 0;
+}
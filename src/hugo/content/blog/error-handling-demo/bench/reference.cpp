@@ -0,0 +1,137 @@
+// Looks up 320-byte entries in a hash table, one lookup per call across a function boundary, the way a routing or
+// configuration layer is queried on a hot path. A tenth of the keys miss. Returning expected<Entry, Fault> copies the
+// entry on every hit; expected<const Entry&, Fault> returns its address in the same registers a raw pointer would
+// use. A second pass reads one field through transform, where the copy is still made before the field is taken.
+
+#include "bench.h"
+#include "result.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    enum class Fault { missing };
+
+    // The names fit the small-string buffer, so copying an entry copies bytes and never allocates.
+    struct Entry {
+        std::string name;
+        std::uint32_t port = 0;
+        std::uint32_t weight = 0;
+        std::array<std::uint64_t, 35> limits{};
+    };
+    static_assert(sizeof(Entry) == 320);
+
+    using Table = std::unordered_map<std::uint32_t, Entry>;
+
+    [[gnu::noinline]] mori::expected<Entry, Fault> find_copy(const Table& table, std::uint32_t key) {
+        const auto it = table.find(key);
+        if (it == table.end()) {
+            return mori::unexpected(Fault::missing);
+        }
+        return it->second;
+    }
+    [[gnu::noinline]] mori::expected<const Entry&, Fault> find_reference(const Table& table, std::uint32_t key) {
+        const auto it = table.find(key);
+        if (it == table.end()) {
+            return mori::unexpected(Fault::missing);
+        }
+        return it->second;
+    }
+    [[gnu::noinline]] const Entry* find_pointer(const Table& table, std::uint32_t key) {
+        const auto it = table.find(key);
+        return it == table.end() ? nullptr : &it->second;
+    }
+
+    enum class Lookup { copy, reference, pointer };
+
+    template<Lookup L>
+    [[nodiscard]] double whole_entry(const bench::options& opts, const Table& table,
+        const std::vector<std::uint32_t>& keys) {
+        return bench::measure(opts, keys.size(), [&] {
+            std::uint64_t sum = 0;
+            for (const std::uint32_t key : keys) {
+                if constexpr (L == Lookup::pointer) {
+                    if (const Entry* e = find_pointer(table, key)) {
+                        sum += e->port + e->limits[key % 35];
+                    }
+                }
+                else if constexpr (L == Lookup::copy) {
+                    if (const mori::expected<Entry, Fault> e = find_copy(table, key)) {
+                        sum += e->port + e->limits[key % 35];
+                    }
+                }
+                else {
+                    if (const mori::expected<const Entry&, Fault> e = find_reference(table, key)) {
+                        sum += e->port + e->limits[key % 35];
+                    }
+                }
+            }
+            bench::do_not_optimize(sum);
+        }).ns_per_op;
+    }
+
+    template<Lookup L>
+    [[nodiscard]] double one_field(const bench::options& opts, const Table& table,
+        const std::vector<std::uint32_t>& keys) {
+        const auto weight = [](const Entry& e) { return e.weight; };
+        return bench::measure(opts, keys.size(), [&] {
+            std::uint64_t sum = 0;
+            for (const std::uint32_t key : keys) {
+                if constexpr (L == Lookup::pointer) {
+                    const Entry* e = find_pointer(table, key);
+                    sum += e != nullptr ? weight(*e) : 0;
+                }
+                else if constexpr (L == Lookup::copy) {
+                    sum += find_copy(table, key).transform(weight).value_or(0);
+                }
+                else {
+                    sum += find_reference(table, key).transform(weight).value_or(0);
+                }
+            }
+            bench::do_not_optimize(sum);
+        }).ns_per_op;
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t lookups = opts.scale(5'000'000);
+    constexpr std::uint32_t entries = 4096;
+
+    Table table;
+    for (std::uint32_t i = 0; i < entries; ++i) {
+        Entry e;
+        e.name = "svc-" + std::to_string(i);
+        e.port = 1024 + i;
+        e.weight = i % 7;
+        e.limits.fill(i);
+        table.emplace(i, std::move(e));
+    }
+    std::mt19937 rng(42);
+    // Keys past the end of the table miss.
+    std::uniform_int_distribution<std::uint32_t> pick(0, entries + entries / 9);
+    std::vector<std::uint32_t> keys(lookups);
+    for (std::uint32_t& key : keys) {
+        key = pick(rng);
+    }
+
+    char title[128];
+    std::snprintf(title, sizeof(title), "%zu lookups in %u entries of %zu bytes, 10%% misses (ns/lookup)", lookups,
+        entries, sizeof(Entry));
+    bench::print_header(title);
+    std::printf("| %-34s | %6s | %12s | %9s |\n", "returned", "bytes", "whole entry", "one field");
+    std::printf("|------------------------------------|--------|--------------|-----------|\n");
+    std::printf("| %-34s | %6zu | %12.2f | %9.2f |\n", "expected<Entry, Fault>", sizeof(mori::expected<Entry, Fault>),
+        whole_entry<Lookup::copy>(opts, table, keys), one_field<Lookup::copy>(opts, table, keys));
+    std::printf("| %-34s | %6zu | %12.2f | %9.2f |\n", "expected<const Entry&, Fault>",
+        sizeof(mori::expected<const Entry&, Fault>), whole_entry<Lookup::reference>(opts, table, keys),
+        one_field<Lookup::reference>(opts, table, keys));
+    std::printf("| %-34s | %6zu | %12.2f | %9.2f |\n", "const Entry*", sizeof(const Entry*),
+        whole_entry<Lookup::pointer>(opts, table, keys), one_field<Lookup::pointer>(opts, table, keys));
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Measures what trivial relocation saves in expected: flipping a result between value and error the way a retry loop
+// does, swapping results in different states, and growing a std::vector of results. Each case is run twice, once
+// with the real types and once with wrappers that hide their relocatability, which is how expected behaved before.
+// std::vector only grows by memmove through libstdc++'s hook, which the build turns on for this benchmark with
+// MORI_LIBSTDCXX_RELOCATION.
+
+#include "bench.h"
+#include "result.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+    // The same type, minus its trivially_relocatable specialization.
+    template<class T>
+    struct opaque : T {
+        using T::T;
+        opaque(T t) : T(std::move(t)) {}
+    };
+
+    template<class Value, class Error>
+    void flip(const bench::options& opts, std::size_t count, const char* name) {
+        const Value seed(std::vector<int>{1, 2, 3});
+        const Error failure = Error(mori::Error(std::errc::resource_unavailable_try_again));
+        const bench::measurement m = bench::measure(opts, count, [&] {
+            mori::expected<Value, Error> r(mori::unexpect, failure);
+            for (std::size_t i = 0; i < count; ++i) {
+                r = seed;
+                bench::do_not_optimize(r);
+                r = mori::unexpected(failure);
+                bench::do_not_optimize(r);
+            }
+        });
+        std::printf("| %-34s | %8.2f | %8s |\n", name, m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str());
+    }
+
+    template<class Value, class Error>
+    void swap_states(const bench::options& opts, std::size_t count, const char* name) {
+        mori::expected<Value, Error> a(Value(std::vector<int>{1, 2, 3}));
+        mori::expected<Value, Error> b(mori::unexpect, Error(mori::Error(std::errc::timed_out)));
+        const bench::measurement m = bench::measure(opts, count, [&] {
+            for (std::size_t i = 0; i < count; ++i) {
+                swap(a, b);
+                bench::do_not_optimize(a);
+            }
+        });
+        std::printf("| %-34s | %8.2f | %8s |\n", name, m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str());
+    }
+
+    template<class Value, class Error>
+    void grow(const bench::options& opts, std::size_t count, const char* name) {
+        const bench::measurement m = bench::measure(opts, count, [&] {
+            std::vector<mori::expected<Value, Error>> results;
+            for (std::size_t i = 0; i < count; ++i) {
+                if (i % 4 == 0) {
+                    results.emplace_back(mori::unexpect, Error(mori::Error(std::errc::io_error)));
+                }
+                else {
+                    results.emplace_back(std::in_place);
+                }
+            }
+            bench::do_not_optimize(results.data());
+        });
+        std::printf("| %-34s | %8.2f | %8s |\n", name, m.ns_per_op, bench::format_optional(m.instructions_per_op).c_str());
+    }
+
+    void print_table_header(const char* title) {
+        bench::print_header(title);
+        std::printf("| %-34s | %8s | %8s |\n", "types", "ns/op", "instr/op");
+        std::printf("|------------------------------------|----------|----------|\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    const bench::options opts = bench::parse_options(argc, argv);
+    const std::size_t count = opts.scale(1'000'000);
+
+    using values = std::vector<int>;
+    using opaque_values = opaque<std::vector<int>>;
+    using opaque_error = opaque<mori::Error>;
+
+    print_table_header("Retry loop: value -> error -> value (one round trip per op)");
+    flip<opaque_values, opaque_error>(opts, count, "moved (not relocatable)");
+    flip<values, mori::Error>(opts, count, "relocated");
+
+    print_table_header("swap of a value and an error");
+    swap_states<opaque_values, opaque_error>(opts, count, "moved (not relocatable)");
+    swap_states<values, mori::Error>(opts, count, "relocated");
+
+    print_table_header("std::vector growth by doubling, per element");
+    grow<opaque_values, opaque_error>(opts, count, "moved (not relocatable)");
+    grow<values, mori::Error>(opts, count,
+        MORI_HAS_LIBSTDCXX_RELOCATION ? "relocated (memmove)" : "relocatable (vector moves them)");
+    return 0;
+}
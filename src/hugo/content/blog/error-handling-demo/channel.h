@@ -0,0 +1,505 @@
+#pragma once
+
+#include "expected.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free channels that hand expected<T, E> items from one pipeline stage to the next:
+//
+//     mori::spsc_channel<Row, Fault> rows(1024);
+//     std::jthread parse([&] {
+//         for (const std::string& line : lines) {
+//             if (!rows.push(parse_row(line))) {
+//                 return;                                 // closed downstream
+//             }
+//         }
+//         rows.close();
+//     });
+//     while (std::optional<mori::expected<Row, Fault>> row = rows.pop()) { ... }
+//     if (const Fault* fault = rows.error()) { ... }     // closed with an error
+//
+// Items are stored in a power-of-two ring; each side's index lives on a cache line of its own. spsc_channel allows
+// one producer and one consumer thread and costs a plain load and store per item; mpmc_channel allows any number of
+// either and claims slots with a compare-and-swap. push_all and pop_some move a whole batch per claim, which is where
+// most of the throughput comes from.
+//
+// close() ends the stream: pushes fail and consumers drain what is left before pop() returns nullopt. close(e)
+// poisons it: consumers stop at once, without draining, and error() returns e. Items pushed while the channel is
+// being closed may be dropped, so close once the producers are done, or to stop them. A thread that finds the channel
+// empty (or full) spins briefly and then sleeps until another thread makes progress or closes it.
+namespace mori {
+    enum class channel_status { ok, full, closed };
+
+    namespace detail {
+        // Sleeping and waking for the threads of one channel. Every push and pop checks for sleepers after it
+        // publishes, so a thread that found nothing to do never sleeps through the change it was waiting for. The
+        // first thread to make progress clears the flag and wakes them all; until one of them sleeps again, nobody
+        // else pays for a wake-up.
+        class channel_signal {
+        public:
+            // Calls attempt until it returns true, spinning a little before going to sleep between attempts.
+            template<class Attempt>
+            void wait_until(Attempt&& attempt) {
+                static const int spins = std::thread::hardware_concurrency() > 1 ? 256 : 0;
+                for (int i = 0;; ++i) {
+                    if (attempt()) {
+                        return;
+                    }
+                    if (i == spins) {
+                        break;
+                    }
+                    pause();
+                }
+                for (;;) {
+                    sleeping.store(true, std::memory_order_seq_cst);
+                    const std::uint32_t seen = epoch.load(std::memory_order_seq_cst);
+                    if (attempt()) {
+                        return;
+                    }
+                    epoch.wait(seen, std::memory_order_seq_cst);
+                    if (attempt()) {
+                        return;
+                    }
+                }
+            }
+
+            // Wakes the sleeping threads, if any, after this thread made progress.
+            void wake() noexcept {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false, std::memory_order_seq_cst)) {
+                    epoch.fetch_add(1, std::memory_order_seq_cst);
+                    epoch.notify_all();
+                }
+            }
+
+        private:
+            static void pause() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#elif defined(__aarch64__)
+                asm volatile("yield");
+#endif
+            }
+
+            std::atomic<std::uint32_t> epoch{0};
+            std::atomic<bool> sleeping{false};
+        };
+
+        // Raw storage for one item.
+        template<class V>
+        struct channel_cell {
+            [[nodiscard]] V* get() noexcept { return std::launder(reinterpret_cast<V*>(bytes)); }
+
+            alignas(V) std::byte bytes[sizeof(V)];
+        };
+
+        // Rings offer two operations. push(max, make) claims up to max free slots, calls make(p, i) to construct the
+        // i-th new item at p and publishes them; pop(max, take) claims up to max items, calls take(p, i) with each and
+        // frees their slots, destroying the items. Both return the number claimed, 0 when there was none.
+
+        // Single producer, single consumer. Each side keeps its own index and a cached copy of the other's, so it
+        // only touches the other side's cache line when the cached copy says the ring is full (or empty).
+        template<class V>
+        class spsc_ring {
+        public:
+            explicit spsc_ring(std::size_t capacity) :
+                mask(capacity - 1), cells(std::make_unique<channel_cell<V>[]>(capacity)) {}
+            spsc_ring(const spsc_ring&) = delete;
+            spsc_ring& operator=(const spsc_ring&) = delete;
+            ~spsc_ring() {
+                for (std::size_t i = consumer.head.load(std::memory_order_relaxed);
+                     i != producer.tail.load(std::memory_order_relaxed); ++i) {
+                    std::destroy_at(cells[i & mask].get());
+                }
+            }
+
+            template<class Make>
+            std::size_t push(std::size_t max, Make&& make) noexcept {
+                const std::size_t tail = producer.tail.load(std::memory_order_relaxed);
+                std::size_t free = mask + 1 - (tail - producer.cached_head);
+                if (free < max) {
+                    producer.cached_head = consumer.head.load(std::memory_order_acquire);
+                    free = mask + 1 - (tail - producer.cached_head);
+                }
+                const std::size_t n = std::min(max, free);
+                for (std::size_t i = 0; i < n; ++i) {
+                    make(cells[(tail + i) & mask].bytes, i);
+                }
+                if (n != 0) {
+                    producer.tail.store(tail + n, std::memory_order_release);
+                }
+                return n;
+            }
+
+            template<class Take>
+            std::size_t pop(std::size_t max, Take&& take) noexcept {
+                const std::size_t head = consumer.head.load(std::memory_order_relaxed);
+                std::size_t available = consumer.cached_tail - head;
+                if (available < max) {
+                    consumer.cached_tail = producer.tail.load(std::memory_order_acquire);
+                    available = consumer.cached_tail - head;
+                }
+                const std::size_t n = std::min(max, available);
+                for (std::size_t i = 0; i < n; ++i) {
+                    V* item = cells[(head + i) & mask].get();
+                    take(item, i);
+                    std::destroy_at(item);
+                }
+                if (n != 0) {
+                    consumer.head.store(head + n, std::memory_order_release);
+                }
+                return n;
+            }
+
+        private:
+            struct alignas(64) producer_side {
+                std::atomic<std::size_t> tail{0};
+                std::size_t cached_head = 0;
+            };
+            struct alignas(64) consumer_side {
+                std::atomic<std::size_t> head{0};
+                std::size_t cached_tail = 0;
+            };
+
+            producer_side producer;
+            consumer_side consumer;
+            const std::size_t mask;
+            std::unique_ptr<channel_cell<V>[]> cells;
+        };
+
+        // Any number of producers and consumers: a ring of slots with sequence numbers, after Dmitry Vyukov's bounded
+        // MPMC queue. A slot at position p is free for a producer when its sequence is p and holds an item for a
+        // consumer when it is p + 1. Claiming several slots takes one compare-and-swap on the shared index; a slot in
+        // the claimed range that the previous owner is still filling or emptying is waited for, which is never longer
+        // than that thread's copy of one item.
+        template<class V>
+        class mpmc_ring {
+        public:
+            explicit mpmc_ring(std::size_t capacity) :
+                mask(capacity - 1), slots(std::make_unique<slot[]>(capacity)) {
+                for (std::size_t i = 0; i < capacity; ++i) {
+                    slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+            mpmc_ring(const mpmc_ring&) = delete;
+            mpmc_ring& operator=(const mpmc_ring&) = delete;
+            ~mpmc_ring() {
+                for (std::size_t i = head.value.load(std::memory_order_relaxed);
+                     i != tail.value.load(std::memory_order_relaxed); ++i) {
+                    std::destroy_at(slots[i & mask].cell.get());
+                }
+            }
+
+            template<class Make>
+            std::size_t push(std::size_t max, Make&& make) noexcept {
+                std::size_t pos = tail.value.load(std::memory_order_relaxed);
+                std::size_t n = 0;
+                for (;;) {
+                    const std::size_t sequence = slots[pos & mask].sequence.load(std::memory_order_acquire);
+                    const auto lag = static_cast<std::ptrdiff_t>(sequence - pos);
+                    if (lag < 0) {
+                        return 0;
+                    }
+                    if (lag > 0) {
+                        pos = tail.value.load(std::memory_order_relaxed);
+                        continue;
+                    }
+                    // The slot at pos is free, so consumers have claimed everything before it.
+                    n = max == 1 ? 1
+                                 : std::clamp<std::size_t>(
+                                       mask + 1 - (pos - head.value.load(std::memory_order_acquire)), 1, max);
+                    if (tail.value.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                for (std::size_t i = 0; i < n; ++i) {
+                    slot& s = slots[(pos + i) & mask];
+                    await(s.sequence, pos + i);
+                    make(s.cell.bytes, i);
+                    s.sequence.store(pos + i + 1, std::memory_order_release);
+                }
+                return n;
+            }
+
+            template<class Take>
+            std::size_t pop(std::size_t max, Take&& take) noexcept {
+                std::size_t pos = head.value.load(std::memory_order_relaxed);
+                std::size_t n = 0;
+                for (;;) {
+                    const std::size_t sequence = slots[pos & mask].sequence.load(std::memory_order_acquire);
+                    const auto lag = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+                    if (lag < 0) {
+                        return 0;
+                    }
+                    if (lag > 0) {
+                        pos = head.value.load(std::memory_order_relaxed);
+                        continue;
+                    }
+                    // The slot at pos is filled, so producers have claimed everything before it.
+                    n = max == 1 ? 1
+                                 : std::clamp<std::size_t>(tail.value.load(std::memory_order_acquire) - pos, 1, max);
+                    if (head.value.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                for (std::size_t i = 0; i < n; ++i) {
+                    slot& s = slots[(pos + i) & mask];
+                    await(s.sequence, pos + i + 1);
+                    V* item = s.cell.get();
+                    take(item, i);
+                    std::destroy_at(item);
+                    s.sequence.store(pos + i + mask + 1, std::memory_order_release);
+                }
+                return n;
+            }
+
+        private:
+            struct slot {
+                std::atomic<std::size_t> sequence;
+                channel_cell<V> cell;
+            };
+            struct alignas(64) index {
+                std::atomic<std::size_t> value{0};
+            };
+
+            // Waits for the thread that claimed a slot's previous turn to finish with it.
+            static void await(const std::atomic<std::size_t>& sequence, std::size_t expected) noexcept {
+                while (sequence.load(std::memory_order_acquire) != expected) {
+                    std::this_thread::yield();
+                }
+            }
+
+            index tail;
+            index head;
+            const std::size_t mask;
+            std::unique_ptr<slot[]> slots;
+        };
+
+        // Everything the two channels share; Ring decides how many threads may use each end.
+        template<class T, class E, template<class> class Ring>
+        class basic_channel {
+        public:
+            using value_type = expected<T, E>;
+
+            static_assert(detail::nothrow_constructible<value_type, value_type>,
+                "channel items move between threads mid-claim and must be nothrow move constructible");
+
+            // Holds at least capacity items (rounded up to a power of two).
+            explicit basic_channel(std::size_t capacity) : ring(std::bit_ceil(std::max<std::size_t>(capacity, 2))) {}
+            basic_channel(const basic_channel&) = delete;
+            basic_channel& operator=(const basic_channel&) = delete;
+
+            // Adds item unless the channel is full or closed, in which case item is left untouched.
+            template<class U = value_type>
+            requires (detail::constructible<value_type, U>)
+            [[nodiscard]] channel_status try_push(U&& item) {
+                if (!accepting()) {
+                    return channel_status::closed;
+                }
+                if constexpr (detail::nothrow_constructible<value_type, U>) {
+                    if (!push_one<U>(item)) {
+                        return channel_status::full;
+                    }
+                }
+                else {
+                    value_type converted(std::forward<U>(item));
+                    if (!push_one<value_type>(converted)) {
+                        return channel_status::full;
+                    }
+                }
+                signal.wake();
+                return channel_status::ok;
+            }
+
+            // Adds item, waiting while the channel is full. Returns false, leaving item untouched, once it is closed.
+            template<class U = value_type>
+            requires (detail::constructible<value_type, U>)
+            bool push(U&& item) {
+                if constexpr (detail::nothrow_constructible<value_type, U>) {
+                    return push_waiting<U>(item);
+                }
+                else {
+                    value_type converted(std::forward<U>(item));
+                    return push_waiting<value_type>(converted);
+                }
+            }
+
+            // Moves every item in, as many per claim as fit, waiting while the channel is full. Returns false once it
+            // is closed; the items not yet moved in are left untouched.
+            bool push_all(std::span<value_type> items) {
+                std::size_t done = 0;
+                while (done != items.size()) {
+                    bool open = true;
+                    signal.wait_until([&] {
+                        if (!accepting()) {
+                            open = false;
+                            return true;
+                        }
+                        const std::size_t n = ring.push(items.size() - done, [&](void* p, std::size_t i) noexcept {
+                            std::construct_at(static_cast<value_type*>(p), std::move(items[done + i]));
+                        });
+                        done += n;
+                        return n != 0;
+                    });
+                    if (!open) {
+                        return false;
+                    }
+                    signal.wake();
+                }
+                return true;
+            }
+
+            // Takes the next item, if one is ready and the channel was not closed with an error.
+            [[nodiscard]] std::optional<value_type> try_pop() {
+                std::optional<value_type> item;
+                if (!poisoned() && pop_one(item)) {
+                    signal.wake();
+                }
+                return item;
+            }
+
+            // Takes the next item, waiting for one. Returns nullopt once the channel is closed and drained, or at once
+            // when it was closed with an error.
+            [[nodiscard]] std::optional<value_type> pop() {
+                std::optional<value_type> item;
+                signal.wait_until([&] { return poisoned() || pop_one(item) || drained(item); });
+                if (item) {
+                    signal.wake();
+                }
+                return item;
+            }
+
+            // Appends up to max items to out in one claim, waiting until there is at least one. Returns how many were
+            // appended, 0 when the channel is closed as for pop().
+            std::size_t pop_some(std::vector<value_type>& out, std::size_t max) {
+                std::size_t n = 0;
+                const auto take = [&] {
+                    n = ring.pop(max, [&](value_type* item, std::size_t) noexcept { out.push_back(std::move(*item)); });
+                    return n != 0;
+                };
+                out.reserve(out.size() + max);
+                signal.wait_until([&] {
+                    if (poisoned()) {
+                        return true;
+                    }
+                    if (take()) {
+                        return true;
+                    }
+                    // Items pushed before close() are visible once it is, so a last attempt picks up the stragglers.
+                    return state.value.load(std::memory_order_acquire) == closed && (take(), true);
+                });
+                if (n != 0) {
+                    signal.wake();
+                }
+                return n;
+            }
+
+            // Ends the stream: pushes fail from now on and consumers drain the items left. Returns false if the
+            // channel was already closed.
+            bool close() {
+                return close_with([] {});
+            }
+            // Poisons the stream: pushes fail and consumers stop at once, with e available from error(). Returns false,
+            // dropping e, if the channel was already closed.
+            bool close(E e) {
+                return close_with([&] { failure.emplace(std::move(e)); });
+            }
+
+            [[nodiscard]] bool is_closed() const noexcept { return state.value.load(std::memory_order_acquire) != open; }
+            // The error the channel was closed with, or null.
+            [[nodiscard]] const E* error() const noexcept {
+                return poisoned() ? std::addressof(*failure) : nullptr;
+            }
+
+        private:
+            enum : std::uint8_t { open, closing, closed, failed };
+
+            struct alignas(64) status {
+                std::atomic<std::uint8_t> value{open};
+            };
+
+            [[nodiscard]] bool accepting() const noexcept {
+                return state.value.load(std::memory_order_relaxed) == open;
+            }
+            [[nodiscard]] bool poisoned() const noexcept {
+                return state.value.load(std::memory_order_acquire) == failed;
+            }
+
+            // Both take the item as an lvalue and forward it as U, so it is only moved from once it is in the ring.
+            template<class U>
+            bool push_one(std::remove_reference_t<U>& item) noexcept {
+                return ring.push(1, [&](void* p, std::size_t) noexcept {
+                    std::construct_at(static_cast<value_type*>(p), std::forward<U>(item));
+                }) != 0;
+            }
+            template<class U>
+            bool push_waiting(std::remove_reference_t<U>& item) {
+                bool open_now = true;
+                signal.wait_until([&] {
+                    if (!accepting()) {
+                        open_now = false;
+                        return true;
+                    }
+                    return ring.push(1, [&](void* p, std::size_t) noexcept {
+                        std::construct_at(static_cast<value_type*>(p), std::forward<U>(item));
+                    }) != 0;
+                });
+                if (open_now) {
+                    signal.wake();
+                }
+                return open_now;
+            }
+            bool pop_one(std::optional<value_type>& item) noexcept {
+                return ring.pop(1, [&](value_type* p, std::size_t) noexcept { item.emplace(std::move(*p)); }) != 0;
+            }
+            // Whether pop() should give up: the channel is closed and one more attempt, which sees everything pushed
+            // before the close, found nothing.
+            bool drained(std::optional<value_type>& item) noexcept {
+                return state.value.load(std::memory_order_acquire) == closed && (pop_one(item), true);
+            }
+
+            template<class Record>
+            bool close_with(Record&& record) {
+                std::uint8_t expected_state = open;
+                if (!state.value.compare_exchange_strong(expected_state, closing, std::memory_order_acquire)) {
+                    return false;
+                }
+                record();
+                state.value.store(failure ? failed : closed, std::memory_order_release);
+                signal.wake();
+                return true;
+            }
+
+            Ring<value_type> ring;
+            status state;
+            detail::channel_signal signal;
+            std::optional<E> failure;
+        };
+    }
+
+    // A channel between exactly one producer thread and one consumer thread.
+    template<class T, class E>
+    class spsc_channel : public detail::basic_channel<T, E, detail::spsc_ring> {
+    public:
+        using detail::basic_channel<T, E, detail::spsc_ring>::basic_channel;
+    };
+
+    // A channel between any number of producer and consumer threads.
+    template<class T, class E>
+    class mpmc_channel : public detail::basic_channel<T, E, detail::mpmc_ring> {
+    public:
+        using detail::basic_channel<T, E, detail::mpmc_ring>::basic_channel;
+    };
+}
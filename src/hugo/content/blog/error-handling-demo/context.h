@@ -0,0 +1,212 @@
+#pragma once
+
+#include "expected.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define MORI_HAS_BACKTRACE 1
+#else
+#define MORI_HAS_BACKTRACE 0
+#endif
+
+// Storage for the trace an Error collects as it is propagated (see Error::trace). Frames are written into a
+// per-thread bump arena and only turned into text when the error is described, so tracing an error costs a few stores
+// per frame and nothing at all until an error occurs.
+namespace mori {
+    // A static string plus the source location of whoever converted it, for functions that want both without making
+    // callers spell out std::source_location::current().
+    struct located_text {
+        located_text(const char* text, std::source_location where = std::source_location::current()) noexcept :
+            text(text), where(where) {}
+
+        const char* text;
+        std::source_location where;
+    };
+
+    namespace detail {
+        // One entry in an error's trace. Entries are immutable once written and form a singly linked list from the
+        // newest back to the oldest, so copies of an error can share a trace and extend it independently.
+        struct context_frame {
+            enum class kind : std::uint8_t { location, payload, backtrace };
+
+            const context_frame* previous;
+            std::source_location where;
+            const char* text;
+            // Formats text together with the arguments stored after the frame; null when there are none.
+            void (*format)(std::string& out, const char* text, const std::byte* args);
+            kind type;
+            // The payload size for payload frames, the number of return addresses for backtrace frames.
+            std::uint8_t size;
+
+            [[nodiscard]] const std::byte* extra() const noexcept { return reinterpret_cast<const std::byte*>(this + 1); }
+            [[nodiscard]] std::byte* extra() noexcept { return reinterpret_cast<std::byte*>(this + 1); }
+        };
+
+        // A fixed-size bump allocator owned by one thread. It is reference counted by the thread and by every error
+        // whose trace lives in it, and starts over from the beginning whenever the thread is the only one left holding
+        // it. When a new trace does not fit because errors the program keeps still hold the arena, the thread moves
+        // on to a fresh arena and leaves the old one to those errors, which free it with their last reference.
+        // Frames are only ever added by the owning thread; a trace that fills its arena drops its later frames.
+        class context_arena {
+        public:
+            static constexpr std::size_t capacity = 64 * 1024;
+            // The room a new trace needs beyond its first frames to start in an arena other traces still hold.
+            static constexpr std::size_t growth_reserve = capacity / 4;
+
+            context_arena(const context_arena&) = delete;
+            context_arena& operator=(const context_arena&) = delete;
+
+            // The calling thread's arena. The pointer is kept apart from the object that frees the arena at thread exit
+            // so that reading it is a plain thread-local load rather than a call through an initialization guard.
+            [[nodiscard]] static context_arena& local() {
+                if (current == nullptr) [[unlikely]] {
+                    current = create_local();
+                }
+                return *current;
+            }
+            // The arena a frame was allocated from. Arenas are aligned to their size to make this a mask.
+            [[nodiscard]] static context_arena& of(const context_frame* frame) noexcept {
+                return *reinterpret_cast<context_arena*>(reinterpret_cast<std::uintptr_t>(frame) & ~(capacity - 1));
+            }
+
+            // The calling thread's arena, ready for a new trace whose first frames take bytes: it starts over if no
+            // other trace is alive, and is replaced by a fresh one if the others leave too little room for the trace
+            // to grow into.
+            [[nodiscard]] static context_arena& for_new_trace(std::size_t bytes) {
+                context_arena& arena = local();
+                if (arena.references.load(std::memory_order_acquire) == 1) {
+                    arena.offset = start();
+                    return arena;
+                }
+                if (capacity - arena.offset >= bytes + growth_reserve) {
+                    return arena;
+                }
+                void* memory = ::operator new(capacity, std::align_val_t(capacity), std::nothrow);
+                if (memory == nullptr) {
+                    return arena;
+                }
+                current = ::new (memory) context_arena();
+                arena.release();
+                return *current;
+            }
+
+            // The size of a frame with extra bytes after it.
+            [[nodiscard]] static constexpr std::size_t frame_size(std::size_t extra) noexcept {
+                return (sizeof(context_frame) + extra + alignof(context_frame) - 1) & ~(alignof(context_frame) - 1);
+            }
+
+            // Whether the calling thread is the one that adds frames to this arena.
+            [[nodiscard]] bool owned_by_caller() const noexcept { return home == &current; }
+
+            // Allocates a frame with room for extra bytes after it, or returns nullptr when the arena is full.
+            [[nodiscard]] context_frame* allocate(std::size_t extra) noexcept {
+                const std::size_t bytes = frame_size(extra);
+                if (capacity - offset < bytes) {
+                    return nullptr;
+                }
+                auto* frame = reinterpret_cast<context_frame*>(reinterpret_cast<std::byte*>(this) + offset);
+                offset += bytes;
+                return frame;
+            }
+
+            void acquire() noexcept { references.fetch_add(1, std::memory_order_relaxed); }
+            void release() noexcept {
+                if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    this->~context_arena();
+                    ::operator delete(static_cast<void*>(this), std::align_val_t(capacity));
+                }
+            }
+
+        private:
+            static inline thread_local context_arena* current = nullptr;
+
+            MORI_COLD static context_arena* create_local() {
+                thread_local const owner releases_at_exit;
+                return ::new (::operator new(capacity, std::align_val_t(capacity))) context_arena();
+            }
+
+            // Drops the thread's reference to whichever arena it is using when it exits.
+            struct owner {
+                owner() = default;
+                owner(const owner&) = delete;
+                owner& operator=(const owner&) = delete;
+                ~owner() {
+                    if (context_arena* arena = std::exchange(current, nullptr)) {
+                        arena->release();
+                    }
+                }
+            };
+
+            // Frames start after the arena's own bookkeeping.
+            [[nodiscard]] static constexpr std::size_t start() noexcept {
+                return (sizeof(context_arena) + alignof(context_frame) - 1) & ~(alignof(context_frame) - 1);
+            }
+
+            context_arena() = default;
+            ~context_arena() = default;
+
+            std::atomic<std::size_t> references{1};
+            std::size_t offset = start();
+            // The address of the creating thread's current pointer, which identifies that thread.
+            context_arena* const* home = &current;
+        };
+
+        template<class T>
+        void append_argument(std::string& out, const T& arg) {
+            if constexpr (std::is_same_v<T, bool>) {
+                out += arg ? "true" : "false";
+            }
+            else if constexpr (std::is_same_v<T, char>) {
+                out += arg;
+            }
+            else if constexpr (std::is_arithmetic_v<T>) {
+                out += std::to_string(arg);
+            }
+            else if constexpr (std::is_enum_v<T>) {
+                out += std::to_string(static_cast<std::underlying_type_t<T>>(arg));
+            }
+            else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                out += std::string_view(arg);
+            }
+            else {
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%p", static_cast<const void*>(arg));
+                out += buffer;
+            }
+        }
+
+        // Substitutes the arguments for the {} placeholders in text, in order, and appends any left over.
+        template<class... Args>
+        void format_arguments(std::string& out, const char* text, const std::byte* args) {
+            const auto& values = *reinterpret_cast<const std::tuple<Args...>*>(args);
+            std::string_view rest(text);
+            const auto next = [&](const auto& arg) {
+                const std::size_t placeholder = rest.find("{}");
+                if (placeholder == std::string_view::npos) {
+                    out += rest;
+                    out += ' ';
+                    rest = {};
+                }
+                else {
+                    out += rest.substr(0, placeholder);
+                    rest.remove_prefix(placeholder + 2);
+                }
+                append_argument(out, arg);
+            };
+            std::apply([&](const auto&... arg) { (next(arg), ...); }, values);
+            out += rest;
+        }
+    }
+}
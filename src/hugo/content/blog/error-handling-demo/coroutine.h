@@ -0,0 +1,225 @@
+#pragma once
+
+#include "expected.h"
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Lets a function returning mori::expected be written as a coroutine, where co_await unwraps another expected's
+// value or returns its error straight to the caller:
+//
+//     mori::Result<Config> load(const path& p) {
+//         auto text = co_await read_file(p);
+//         auto table = co_await parse(text);
+//         co_return Config(std::move(table));
+//     }
+//
+// These coroutines never suspend except to bail out with an error, so the whole body runs before the call returns.
+// Compilers that elide the frame allocation can do so because the frame never outlives the call; when they do not,
+// frames are recycled through a small per-thread pool instead of going to the global allocator.
+//
+// The return object relies on the conversion to expected happening when the coroutine returns to its caller rather
+// than as soon as the return object is created, as GCC, MSVC and Clang 17+ do.
+namespace mori {
+    namespace detail {
+        // Per-thread free lists of coroutine frames, bucketed by size. Frames are created and destroyed on the same
+        // thread because the coroutine has finished by the time its call returns.
+        class frame_pool {
+        public:
+            static constexpr std::size_t granularity = 64;
+            static constexpr std::size_t buckets = 16;
+
+            frame_pool() = default;
+            frame_pool(const frame_pool&) = delete;
+            frame_pool& operator=(const frame_pool&) = delete;
+            ~frame_pool() {
+                for (node* head : free) {
+                    while (head != nullptr) {
+                        node* next = head->next;
+                        ::operator delete(head);
+                        head = next;
+                    }
+                }
+            }
+
+            [[nodiscard]] static void* allocate(std::size_t size) {
+                const std::size_t bucket = bucket_of(size);
+                if (bucket >= buckets) {
+                    return ::operator new(size);
+                }
+                frame_pool& pool = local();
+                if (node* head = pool.free[bucket]) {
+                    pool.free[bucket] = head->next;
+                    return head;
+                }
+                return ::operator new((bucket + 1) * granularity);
+            }
+
+            static void deallocate(void* p, std::size_t size) noexcept {
+                const std::size_t bucket = bucket_of(size);
+                if (bucket >= buckets) {
+                    ::operator delete(p);
+                    return;
+                }
+                frame_pool& pool = local();
+                pool.free[bucket] = ::new (p) node{pool.free[bucket]};
+            }
+
+        private:
+            struct node {
+                node* next;
+            };
+
+            [[nodiscard]] static constexpr std::size_t bucket_of(std::size_t size) noexcept {
+                return (size - 1) / granularity;
+            }
+            [[nodiscard]] static frame_pool& local() noexcept {
+                thread_local frame_pool pool;
+                return pool;
+            }
+
+            std::array<node*, buckets> free{};
+        };
+
+        template<class T, class E>
+        class expected_promise;
+
+        // What an expected coroutine hands back to its caller: it converts into the expected the coroutine produced
+        // and frees the frame.
+        template<class T, class E>
+        class expected_return_object {
+        public:
+            using handle_type = std::coroutine_handle<expected_promise<T, E>>;
+
+            explicit expected_return_object(handle_type handle) noexcept : handle(handle) {}
+            expected_return_object(const expected_return_object&) = delete;
+            expected_return_object& operator=(const expected_return_object&) = delete;
+            ~expected_return_object() {
+                if (handle) {
+                    handle.destroy();
+                }
+            }
+
+            operator expected<T, E>() && {
+                auto& promise = handle.promise();
+#if MORI_HAS_EXCEPTIONS
+                if (promise.exception) {
+                    std::exception_ptr exception = std::move(promise.exception);
+#if defined(__GNUC__) && !defined(__clang__)
+                    // GCC frees the frame itself when an exception leaves the initial call of a coroutine.
+                    handle = nullptr;
+#else
+                    std::exchange(handle, nullptr).destroy();
+#endif
+                    std::rethrow_exception(std::move(exception));
+                }
+#endif
+                return std::move(promise).take();
+            }
+
+        private:
+            handle_type handle;
+        };
+
+        template<class T, class E>
+        class expected_promise_base {
+        public:
+            expected_promise_base() noexcept {}
+            expected_promise_base(const expected_promise_base&) = delete;
+            expected_promise_base& operator=(const expected_promise_base&) = delete;
+            ~expected_promise_base() {
+                if (ready) {
+                    std::destroy_at(std::addressof(result));
+                }
+            }
+
+            [[nodiscard]] static void* operator new(std::size_t size) { return frame_pool::allocate(size); }
+            static void operator delete(void* p, std::size_t size) noexcept { frame_pool::deallocate(p, size); }
+
+            [[nodiscard]] expected_return_object<T, E> get_return_object() noexcept {
+                return expected_return_object<T, E>(
+                    std::coroutine_handle<expected_promise<T, E>>::from_promise(static_cast<expected_promise<T, E>&>(*this)));
+            }
+            [[nodiscard]] std::suspend_never initial_suspend() const noexcept { return {}; }
+            [[nodiscard]] std::suspend_always final_suspend() const noexcept { return {}; }
+#if !MORI_HAS_EXCEPTIONS
+            [[noreturn]] void unhandled_exception() const noexcept { std::terminate(); }
+#else
+            // Held until the return object is converted, so the exception always leaves from the same place and the
+            // frame is freed exactly once.
+            void unhandled_exception() noexcept { exception = std::current_exception(); }
+#endif
+
+            template<class Ex> requires (is_expected_v<std::remove_cvref_t<Ex>>)
+            [[nodiscard]] auto await_transform(Ex&& ex) noexcept {
+                return awaiter<Ex&&>{std::forward<Ex>(ex), this};
+            }
+
+            [[nodiscard]] expected<T, E> take() && { return std::move(result); }
+
+        protected:
+            template<class... Args>
+            void set(Args&&... args) {
+                std::construct_at(std::addressof(result), std::forward<Args>(args)...);
+                ready = true;
+            }
+
+        private:
+            friend class expected_return_object<T, E>;
+
+            // Resumes with the awaited expected's value, or stores its error as the coroutine's result and stays
+            // suspended so control goes straight back to the caller.
+            template<class Ex>
+            struct awaiter {
+                Ex ex;
+                expected_promise_base* promise;
+
+                [[nodiscard]] bool await_ready() const noexcept { return ex.has_value(); }
+                void await_suspend(std::coroutine_handle<>) {
+                    promise->set(unexpect, std::forward<Ex>(ex).error());
+                }
+                decltype(auto) await_resume() const noexcept {
+                    if constexpr (!std::is_void_v<typename std::remove_cvref_t<Ex>::value_type>) {
+                        return *std::forward<Ex>(ex);
+                    }
+                }
+            };
+
+            union {
+                expected<T, E> result;
+            };
+            bool ready = false;
+#if MORI_HAS_EXCEPTIONS
+            std::exception_ptr exception;
+#endif
+        };
+
+        template<class T, class E>
+        class expected_promise : public expected_promise_base<T, E> {
+        public:
+            template<class U = T>
+            requires (std::is_constructible_v<expected<T, E>, U>)
+            void return_value(U&& v) {
+                this->set(std::forward<U>(v));
+            }
+        };
+
+        template<class T, class E> requires (std::is_void_v<T>)
+        class expected_promise<T, E> : public expected_promise_base<T, E> {
+        public:
+            void return_void() {
+                this->set();
+            }
+        };
+    }
+}
+
+template<class T, class E, class... Args>
+struct std::coroutine_traits<mori::expected<T, E>, Args...> {
+    using promise_type = mori::detail::expected_promise<T, E>;
+};
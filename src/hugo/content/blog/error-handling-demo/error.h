@@ -0,0 +1,703 @@
+#pragma once
+
+#include "context.h"
+#include "expected.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mori {
+    class Error;
+    class message_id;
+
+    namespace detail {
+        inline constexpr std::uint8_t generic_category_id = 0;
+        inline constexpr std::uint8_t system_category_id = 1;
+        // Given to categories registered after the table is full; the Error keeps the category in its extension.
+        inline constexpr std::uint8_t extended_category_id = 255;
+
+        // Process-wide tables that let an Error refer to its category and message by a small index. Entries are
+        // added once and never removed, so an index stays valid for the life of the program. Adding takes a lock;
+        // looking an index up does not.
+        class error_registry {
+        public:
+            static constexpr std::size_t max_categories = extended_category_id;
+            static constexpr std::size_t max_messages = 65536;
+            // Messages interned at run time may only take this many entries, which leaves the rest for literals.
+            static constexpr std::size_t max_runtime_messages = max_messages / 4 * 3;
+
+            [[nodiscard]] static error_registry& get() {
+                static error_registry registry;
+                return registry;
+            }
+
+            // Returns extended_category_id once the table is full.
+            [[nodiscard]] std::uint8_t category_id(const std::error_category& category) {
+                const std::size_t count = category_count.load(std::memory_order_acquire);
+                for (std::size_t i = 0; i < count; ++i) {
+                    if (categories[i].load(std::memory_order_relaxed) == &category) {
+                        return static_cast<std::uint8_t>(i);
+                    }
+                }
+                return add_category(category);
+            }
+            [[nodiscard]] const std::error_category& category(std::uint8_t id) const noexcept {
+                return *categories[id].load(std::memory_order_relaxed);
+            }
+
+            // Returns the index of a copy of text, or nullopt once limit entries are taken.
+            [[nodiscard]] std::optional<std::uint16_t> intern(std::string_view text, std::size_t limit) {
+                if (text.empty()) {
+                    return 0;
+                }
+                std::lock_guard lock(mutex);
+                if (const auto it = message_ids.find(text); it != message_ids.end()) {
+                    return it->second;
+                }
+                if (message_count == limit) {
+                    return std::nullopt;
+                }
+                const std::size_t id = message_count;
+                if (id % chunk_size == 0) {
+                    chunks[id / chunk_size].store(owned_chunks.emplace_back(new std::string_view[chunk_size]).get(),
+                        std::memory_order_release);
+                }
+                const std::string_view stored = texts.emplace_back(text);
+                chunks[id / chunk_size].load(std::memory_order_relaxed)[id % chunk_size] = stored;
+                message_ids.emplace(stored, static_cast<std::uint16_t>(id));
+                ++message_count;
+                return static_cast<std::uint16_t>(id);
+            }
+            // An id is only handed out once its entry is written, and an entry never changes afterwards.
+            [[nodiscard]] std::string_view message(std::uint16_t id) const noexcept {
+                return chunks[id / chunk_size].load(std::memory_order_acquire)[id % chunk_size];
+            }
+
+        private:
+            static constexpr std::size_t chunk_size = 256;
+
+            error_registry() {
+                categories[generic_category_id].store(&std::generic_category(), std::memory_order_relaxed);
+                categories[system_category_id].store(&std::system_category(), std::memory_order_relaxed);
+                category_count.store(2, std::memory_order_release);
+                chunks[0].store(owned_chunks.emplace_back(new std::string_view[chunk_size]).get(),
+                    std::memory_order_release);
+                message_count = 1;
+            }
+
+            MORI_COLD std::uint8_t add_category(const std::error_category& category) {
+                std::lock_guard lock(mutex);
+                const std::size_t count = category_count.load(std::memory_order_relaxed);
+                for (std::size_t i = 0; i < count; ++i) {
+                    if (categories[i].load(std::memory_order_relaxed) == &category) {
+                        return static_cast<std::uint8_t>(i);
+                    }
+                }
+                if (count == max_categories) {
+                    return extended_category_id;
+                }
+                categories[count].store(&category, std::memory_order_relaxed);
+                category_count.store(count + 1, std::memory_order_release);
+                return static_cast<std::uint8_t>(count);
+            }
+
+            std::array<std::atomic<const std::error_category*>, max_categories> categories{};
+            std::atomic<std::size_t> category_count{0};
+            std::array<std::atomic<std::string_view*>, max_messages / chunk_size> chunks{};
+            std::mutex mutex;
+            std::size_t message_count = 0;
+            std::vector<std::unique_ptr<std::string_view[]>> owned_chunks;
+            std::deque<std::string> texts;
+            std::unordered_map<std::string_view, std::uint16_t> message_ids;
+        };
+
+        // Context attached to an Error with attach(), shared between copies and never modified once shared.
+        struct error_extension {
+            error_extension() = default;
+            error_extension(const error_extension& other) :
+                category(other.category), payload_size(other.payload_size), payload(other.payload),
+                context(other.context), trace(other.trace) {
+                if (trace != nullptr) {
+                    context_arena::of(trace).acquire();
+                }
+            }
+            error_extension& operator=(const error_extension&) = delete;
+            ~error_extension() {
+                if (trace != nullptr) {
+                    context_arena::of(trace).release();
+                }
+            }
+
+            std::atomic<std::uint32_t> references{1};
+            // Set when the category table was full; see extended_category_id.
+            const std::error_category* category = nullptr;
+            std::uint8_t payload_size = 0;
+            std::array<std::byte, 8> payload{};
+            std::string context;
+            const context_frame* trace = nullptr;
+        };
+
+        // A string literal usable as a template argument.
+        template<std::size_t N>
+        struct fixed_string {
+            constexpr fixed_string(const char (&text)[N]) noexcept {
+                std::copy_n(text, N, chars);
+            }
+            [[nodiscard]] constexpr std::string_view view() const noexcept { return {chars, N - 1}; }
+
+            char chars[N];
+        };
+
+        template<fixed_string Text>
+        struct literal_message;
+    }
+
+    // An interned message: text stored once for the life of the program and referred to by a 16-bit index.
+    class message_id {
+    public:
+        constexpr message_id() noexcept = default;
+
+        // Interns text at run time, or returns nullopt once the table has no room left for it. Meant for a bounded
+        // set of texts, such as ones loaded from configuration; text that differs from one error to the next belongs
+        // in Error::attach().
+        [[nodiscard]] static std::optional<message_id> intern(std::string_view text) {
+            return intern(text, detail::error_registry::max_runtime_messages);
+        }
+
+        [[nodiscard]] std::string_view text() const {
+            return id == 0 ? std::string_view() : detail::error_registry::get().message(id);
+        }
+        [[nodiscard]] friend constexpr bool operator==(message_id, message_id) noexcept = default;
+
+    private:
+        friend class Error;
+        template<detail::fixed_string>
+        friend struct detail::literal_message;
+
+        [[nodiscard]] static std::optional<message_id> intern(std::string_view text, std::size_t limit) {
+            const std::optional<std::uint16_t> id = detail::error_registry::get().intern(text, limit);
+            if (!id) {
+                return std::nullopt;
+            }
+            message_id m;
+            m.id = *id;
+            return m;
+        }
+
+        std::uint16_t id = 0;
+    };
+
+    namespace detail {
+        // Literals may use the whole table, including the part kept from run-time interning; there is only a
+        // fixed number of them in a program.
+        template<detail::fixed_string Text>
+        struct literal_message {
+            static inline const message_id value =
+                message_id::intern(Text.view(), error_registry::max_messages).value_or(message_id());
+        };
+    }
+
+    // A message interned once, during static initialization, so using it costs a load:
+    //     return mori::Error(std::errc::invalid_argument, mori::message<"field out of range">);
+    template<detail::fixed_string Text>
+    inline const message_id& message = detail::literal_message<Text>::value;
+
+    // A 16-byte error: an error code (value and category, as in std::error_code), an optional interned message and up
+    // to 8 bytes of trivially copyable payload, all stored inline, so creating, copying and destroying one never
+    // allocates. Larger context can be attached explicitly; it moves the payload to a shared heap block. The only
+    // other thing kept there is the category of an error whose category came after the first 255 the program used.
+    //
+    //     mori::Result<Row> parse(std::string_view line) {
+    //         if (line.size() > max_line) {
+    //             return mori::unexpected(mori::Error(std::errc::value_too_large, mori::message<"line too long">)
+    //                 .with_payload(line.size()));
+    //         }
+    //         ...
+    //     }
+    //
+    // Errors compare equal when their codes do, like std::error_code.
+    //
+    // An Error made from a std::errc can be created, copied, compared and destroyed in constant expressions, so a
+    // consteval parser can return a Result. Messages, payloads, context and traces live in process-wide tables and
+    // are only available at run time.
+    class Error {
+    public:
+        Error() noexcept = default;
+        constexpr Error(std::errc code, message_id text = {}) noexcept :
+            code_value(static_cast<std::int32_t>(code)), message_index(text.id), category_index(detail::generic_category_id) {}
+        Error(std::error_code code, message_id text = {}) :
+            code_value(code.value()), message_index(text.id), category_index(category_index_of(code.category())) {
+            if (category_index == detail::extended_category_id) {
+                unique_extension();
+                extension->category = &code.category();
+            }
+        }
+        template<class Enum> requires (std::is_error_code_enum_v<Enum>)
+        Error(Enum code, message_id text = {}) : Error(make_error_code(code), text) {}
+
+        constexpr Error(const Error& other) noexcept { copy_from(other); }
+        constexpr Error(Error&& other) noexcept {
+            copy_bits(other);
+            other.forget();
+        }
+        constexpr Error& operator=(const Error& other) noexcept {
+            if (this != &other) {
+                release();
+                copy_from(other);
+            }
+            return *this;
+        }
+        constexpr Error& operator=(Error&& other) noexcept {
+            if (this != &other) {
+                release();
+                copy_bits(other);
+                other.forget();
+            }
+            return *this;
+        }
+        constexpr ~Error() { release(); }
+
+        [[nodiscard]] constexpr int value() const noexcept { return code_value; }
+        [[nodiscard]] const std::error_category& category() const noexcept {
+            if (category_index == detail::extended_category_id) {
+                return *extension->category;
+            }
+            return detail::error_registry::get().category(category_index);
+        }
+        [[nodiscard]] std::error_code code() const noexcept { return std::error_code(code_value, category()); }
+        // The interned message, or an empty string when there is none.
+        [[nodiscard]] std::string_view message() const {
+            message_id id;
+            id.id = message_index;
+            return id.text();
+        }
+        // The context given to attach(), or an empty string when there is none.
+        [[nodiscard]] std::string_view context() const noexcept {
+            return extended() ? std::string_view(extension->context) : std::string_view();
+        }
+        // Everything known about the error, formatted for a log, with its trace from the oldest frame to the newest.
+        // Unlike the rest of Error, this allocates.
+        [[nodiscard]] std::string describe() const {
+            std::string text = category().name();
+            text += ':';
+            text += std::to_string(code_value);
+            text += " (";
+            text += code().message();
+            text += ')';
+            if (const std::string_view m = message(); !m.empty()) {
+                text += ": ";
+                text += m;
+            }
+            if (const std::string_view c = context(); !c.empty()) {
+                text += " [";
+                text += c;
+                text += ']';
+            }
+            const std::vector<const detail::context_frame*> frames = trace_frames();
+            for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+                describe_frame(text, **it);
+            }
+            return text;
+        }
+        // The locations recorded by trace(), from the oldest to the newest.
+        [[nodiscard]] std::vector<std::source_location> trace_locations() const {
+            std::vector<std::source_location> locations;
+            const std::vector<const detail::context_frame*> frames = trace_frames();
+            for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+                if ((*it)->type != detail::context_frame::kind::payload) {
+                    locations.push_back((*it)->where);
+                }
+            }
+            return locations;
+        }
+
+        // Stores a small trivially copyable value alongside the code, such as the offending size or index. It is read
+        // back with payload<P>(), which only checks that the size matches. This only allocates if context has been
+        // attached to a copy of this error.
+        template<class P> requires (std::is_trivially_copyable_v<P> && sizeof(P) <= 8)
+        Error& with_payload(const P& p) & {
+            if (traced()) {
+                const detail::context_frame* before = trace_head;
+                push_frame(sizeof(P), [&](detail::context_frame& frame) {
+                    frame.type = detail::context_frame::kind::payload;
+                    frame.size = sizeof(P);
+                    std::memcpy(frame.extra(), std::addressof(p), sizeof(P));
+                });
+                if (trace_head != before) {
+                    return *this;
+                }
+                unique_extension();
+            }
+            if (extended()) {
+                unique_extension();
+                std::memcpy(extension->payload.data(), std::addressof(p), sizeof(P));
+                extension->payload_size = sizeof(P);
+            }
+            else {
+                std::memcpy(inline_payload.data(), std::addressof(p), sizeof(P));
+                payload_state = sizeof(P);
+            }
+            return *this;
+        }
+        template<class P> requires (std::is_trivially_copyable_v<P> && sizeof(P) <= 8)
+        [[nodiscard]] Error&& with_payload(const P& p) && {
+            return std::move(with_payload(p));
+        }
+        template<class P> requires (std::is_trivially_copyable_v<P> && sizeof(P) <= 8)
+        [[nodiscard]] std::optional<P> payload() const noexcept {
+            const std::byte* bytes = nullptr;
+            std::size_t size = 0;
+            if (extended()) {
+                bytes = extension->payload.data();
+                size = extension->payload_size;
+            }
+            else if (traced()) {
+                if (const detail::context_frame* frame = newest_payload()) {
+                    bytes = frame->extra();
+                    size = frame->size;
+                }
+            }
+            else {
+                bytes = inline_payload.data();
+                size = payload_state;
+            }
+            if (size != sizeof(P)) {
+                return std::nullopt;
+            }
+            P p;
+            std::memcpy(std::addressof(p), bytes, sizeof(P));
+            return p;
+        }
+
+        // Attaches free-form context. Creating, copying and destroying an Error never allocates, except for this;
+        // copies made afterwards share the context rather than copying it.
+        Error& attach(std::string context) & {
+            unique_extension();
+            extension->context = std::move(context);
+            return *this;
+        }
+        [[nodiscard]] Error&& attach(std::string context) && {
+            return std::move(attach(std::move(context)));
+        }
+
+        // Records the caller's location in the error's trace, optionally with a message. The message is only
+        // formatted when the error is described: each {} in it is replaced by the next argument, which is copied
+        // bitwise into the trace, so arguments must be trivially copyable and anything they point to must outlive
+        // the error.
+        //
+        //     if (!row) {
+        //         return mori::unexpected(std::move(row).error().trace("reading row {} of {}", index, path_view));
+        //     }
+        //
+        // Frames go into a per-thread arena, so tracing costs a few stores and rarely allocates: only when errors the
+        // program keeps have filled the arena and the thread moves on to a new one. Frames are dropped when one trace
+        // fills its arena, and when the error is traced on a thread other than the one that started its trace.
+        Error& trace(std::source_location where = std::source_location::current()) & {
+            push_frame(0, [&](detail::context_frame& frame) { frame.where = where; });
+            return *this;
+        }
+        template<class... Args>
+        requires ((std::is_trivially_copyable_v<Args> && ...) && alignof(std::tuple<Args...>) <= alignof(detail::context_frame))
+        Error& trace(located_text text, const Args&... args) & {
+            push_frame(sizeof...(Args) == 0 ? 0 : sizeof(std::tuple<Args...>), [&](detail::context_frame& frame) {
+                frame.where = text.where;
+                frame.text = text.text;
+                if constexpr (sizeof...(Args) != 0) {
+                    ::new (static_cast<void*>(frame.extra())) std::tuple<Args...>(args...);
+                    frame.format = detail::format_arguments<Args...>;
+                }
+            });
+            return *this;
+        }
+        // Records the caller's location and the return addresses on the stack, which are symbolized when the error
+        // is described. Costs a stack walk, so it is meant for the point where an error is first created.
+        Error& trace_backtrace(std::source_location where = std::source_location::current()) & {
+#if MORI_HAS_BACKTRACE
+            constexpr int max_addresses = 32;
+            void* addresses[max_addresses];
+            const int count = ::backtrace(addresses, max_addresses);
+            push_frame(sizeof(void*) * static_cast<std::size_t>(count), [&](detail::context_frame& frame) {
+                frame.where = where;
+                frame.type = detail::context_frame::kind::backtrace;
+                frame.size = static_cast<std::uint8_t>(count);
+                std::memcpy(frame.extra(), addresses, sizeof(void*) * static_cast<std::size_t>(count));
+            });
+            return *this;
+#else
+            return trace(where);
+#endif
+        }
+        [[nodiscard]] Error&& trace(std::source_location where = std::source_location::current()) && {
+            return std::move(trace(where));
+        }
+        template<class... Args>
+        requires ((std::is_trivially_copyable_v<Args> && ...) && alignof(std::tuple<Args...>) <= alignof(detail::context_frame))
+        [[nodiscard]] Error&& trace(located_text text, const Args&... args) && {
+            return std::move(trace(text, args...));
+        }
+        [[nodiscard]] Error&& trace_backtrace(std::source_location where = std::source_location::current()) && {
+            return std::move(trace_backtrace(where));
+        }
+
+        [[nodiscard]] friend constexpr bool operator==(const Error& x, const Error& y) noexcept {
+            return x.code_value == y.code_value && x.category_index == y.category_index
+                && (x.category_index != detail::extended_category_id || x.extension->category == y.extension->category);
+        }
+
+    private:
+        friend struct spare_representation<Error>;
+
+        // payload_state is the size of the inline payload, or one of these. A traced error keeps its payload in its
+        // trace, and an extended one in its extension.
+        static constexpr std::uint8_t traced_state = 0x40;
+        static constexpr std::uint8_t extended_state = 0x80;
+        static constexpr std::uint8_t spare_state = 0xff;
+
+        [[nodiscard]] static std::uint8_t category_index_of(const std::error_category& category) {
+            return detail::error_registry::get().category_id(category);
+        }
+
+        [[nodiscard]] constexpr bool traced() const noexcept { return payload_state == traced_state; }
+        [[nodiscard]] constexpr bool extended() const noexcept { return payload_state == extended_state; }
+
+        [[nodiscard]] const detail::context_frame* head() const noexcept {
+            return traced() ? trace_head : extended() ? extension->trace : nullptr;
+        }
+        [[nodiscard]] const detail::context_frame* newest_payload() const noexcept {
+            for (const detail::context_frame* frame = head(); frame != nullptr; frame = frame->previous) {
+                if (frame->type == detail::context_frame::kind::payload) {
+                    return frame;
+                }
+            }
+            return nullptr;
+        }
+        [[nodiscard]] std::vector<const detail::context_frame*> trace_frames() const {
+            std::vector<const detail::context_frame*> frames;
+            for (const detail::context_frame* frame = head(); frame != nullptr; frame = frame->previous) {
+                frames.push_back(frame);
+            }
+            return frames;
+        }
+        static void describe_frame(std::string& text, const detail::context_frame& frame) {
+            if (frame.type == detail::context_frame::kind::payload) {
+                return;
+            }
+            text += "\n    at ";
+            text += frame.where.file_name();
+            text += ':';
+            text += std::to_string(frame.where.line());
+            text += " in ";
+            text += frame.where.function_name();
+            if (frame.text != nullptr) {
+                text += ": ";
+                if (frame.format != nullptr) {
+                    frame.format(text, frame.text, frame.extra());
+                }
+                else {
+                    text += frame.text;
+                }
+            }
+#if MORI_HAS_BACKTRACE
+            if (frame.type == detail::context_frame::kind::backtrace) {
+                void* addresses[32];
+                std::memcpy(addresses, frame.extra(), sizeof(void*) * frame.size);
+                if (char** symbols = ::backtrace_symbols(addresses, frame.size)) {
+                    for (std::size_t i = 0; i < frame.size; ++i) {
+                        text += "\n        #";
+                        text += std::to_string(i);
+                        text += ' ';
+                        text += symbols[i];
+                    }
+                    std::free(symbols);
+                }
+            }
+#endif
+        }
+
+        // Appends a frame to the trace, after moving an inline payload into the trace if this starts it. Does
+        // nothing when the frame cannot be stored.
+        template<class Fill>
+        void push_frame(std::size_t extra, Fill&& fill) {
+            if (extended() && extension->references.load(std::memory_order_acquire) != 1) {
+                unique_extension();
+            }
+            const detail::context_frame* previous = head();
+            const bool starts_trace = previous == nullptr;
+            const bool saves_payload = starts_trace && !extended() && payload_state != 0;
+            detail::context_arena* arena = nullptr;
+            if (starts_trace) {
+                arena = &detail::context_arena::for_new_trace(detail::context_arena::frame_size(extra)
+                    + (saves_payload ? detail::context_arena::frame_size(sizeof(inline_payload)) : 0));
+            }
+            else {
+                arena = &detail::context_arena::of(previous);
+                if (!arena->owned_by_caller()) {
+                    return;
+                }
+            }
+            if (saves_payload) {
+                detail::context_frame* saved = arena->allocate(sizeof(inline_payload));
+                if (saved == nullptr) {
+                    return;
+                }
+                ::new (static_cast<void*>(saved)) detail::context_frame{
+                    nullptr, {}, nullptr, nullptr, detail::context_frame::kind::payload, payload_state};
+                std::memcpy(saved->extra(), inline_payload.data(), sizeof(inline_payload));
+                previous = saved;
+            }
+            detail::context_frame* frame = arena->allocate(extra);
+            if (frame == nullptr) {
+                return;
+            }
+            ::new (static_cast<void*>(frame)) detail::context_frame{
+                previous, {}, nullptr, nullptr, detail::context_frame::kind::location, 0};
+            fill(*frame);
+            if (starts_trace) {
+                arena->acquire();
+            }
+            if (extended()) {
+                extension->trace = frame;
+            }
+            else {
+                trace_head = frame;
+                payload_state = traced_state;
+            }
+        }
+
+        // Makes sure this error has an extension of its own, creating one or copying a shared one.
+        void unique_extension() {
+            if (extended()) {
+                if (extension->references.load(std::memory_order_acquire) == 1) {
+                    return;
+                }
+                auto copy = std::make_unique<detail::error_extension>(*extension);
+                release();
+                extension = copy.release();
+            }
+            else if (traced()) {
+                auto ext = std::make_unique<detail::error_extension>();
+                if (const detail::context_frame* frame = newest_payload()) {
+                    ext->payload_size = frame->size;
+                    std::memcpy(ext->payload.data(), frame->extra(), frame->size);
+                }
+                // The extension takes over this error's reference to the arena.
+                ext->trace = trace_head;
+                extension = ext.release();
+            }
+            else {
+                auto ext = std::make_unique<detail::error_extension>();
+                ext->payload_size = payload_state;
+                ext->payload = inline_payload;
+                extension = ext.release();
+            }
+            payload_state = extended_state;
+        }
+
+        constexpr void copy_bits(const Error& other) noexcept {
+            code_value = other.code_value;
+            message_index = other.message_index;
+            category_index = other.category_index;
+            payload_state = other.payload_state;
+            if (other.extended()) {
+                extension = other.extension;
+            }
+            else if (other.traced()) {
+                trace_head = other.trace_head;
+            }
+            else {
+                inline_payload = other.inline_payload;
+            }
+        }
+        constexpr void copy_from(const Error& other) noexcept {
+            copy_bits(other);
+            if (extended()) {
+                extension->references.fetch_add(1, std::memory_order_relaxed);
+            }
+            else if (traced()) {
+                detail::context_arena::of(trace_head).acquire();
+            }
+        }
+        constexpr void release() noexcept {
+            if (extended() && extension->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete extension;
+            }
+            else if (traced()) {
+                detail::context_arena::of(trace_head).release();
+            }
+            payload_state = 0;
+        }
+        // Leaves a moved-from error without the extension it gave away. A category kept there is lost with it.
+        constexpr void forget() noexcept {
+            payload_state = 0;
+            if (category_index == detail::extended_category_id) {
+                category_index = detail::generic_category_id;
+            }
+        }
+
+        std::int32_t code_value = 0;
+        std::uint16_t message_index = 0;
+        std::uint8_t category_index = detail::generic_category_id;
+        std::uint8_t payload_state = 0;
+        union {
+            std::array<std::byte, 8> inline_payload{};
+            const detail::context_frame* trace_head;
+            detail::error_extension* extension;
+        };
+    };
+
+    static_assert(sizeof(Error) == 16);
+
+    // No Error has payload_state set to spare_state, so Result<void> needs no tag and is the size of an Error.
+    //
+    // The same byte marks a value held in the place of the payload, which a single pointer fits: Result<T*>,
+    // Result<std::unique_ptr<T>> and Result<T&> are the size of an Error too. Other values keep the tag, so that
+    // Result<int> and the like stay usable in constant expressions.
+    template<>
+    struct spare_representation<Error> {
+        static constexpr bool available = true;
+        static constexpr void write(Error* p) noexcept {
+            Error* e = std::construct_at(p);
+            e->payload_state = Error::spare_state;
+        }
+        [[nodiscard]] static constexpr bool holds(const Error* p) noexcept {
+            return p->payload_state == Error::spare_state;
+        }
+
+        static_assert(std::is_standard_layout_v<Error>);
+        static constexpr std::size_t free_offset = offsetof(Error, inline_payload);
+        static constexpr std::size_t state_offset = offsetof(Error, payload_state);
+        static_assert(state_offset < free_offset);
+
+        template<class U>
+        static constexpr bool fits_beside = detail::is_single_pointer_v<U> && sizeof(U) <= sizeof(Error) - free_offset
+            && alignof(U) <= alignof(Error);
+
+        static void mark(std::byte* p) noexcept { p[state_offset] = std::byte{Error::spare_state}; }
+        [[nodiscard]] static bool marked(const std::byte* p) noexcept {
+            return p[state_offset] == std::byte{Error::spare_state};
+        }
+    };
+
+    // An Error refers to its extension and trace by pointer and never to itself, so it can be moved by copying bytes.
+    template<>
+    struct trivially_relocatable<Error> : std::true_type {};
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <source_location>
+#include <vector>
+
+// With MORI_ERROR_COUNTERS set to 1, expected.h counts every error and every value an expected or unexpected is
+// constructed with against the source location that constructed it:
+//     - errors: unexpected(e), unexpected(std::in_place, ...), expected(unexpect, ...) and
+//       expected(unexpect_from, ...), which Err(...) and ErrWith(...) build, and so also assigning an unexpected to an
+//       expected;
+//     - values: expected(v), as in `return v;`, expected(std::in_place, ...) and expected(in_place_from, ...), which
+//       Ok(...) and OkWith(...) build.
+// Errors the library passes along itself (and_then, transform, ...) are counted at its own locations in expected.h,
+// which keeps propagation apart from the places errors originate.
+//
+//     for (const mori::error_site& site : mori::error_counts()) { ... }
+//     mori::dump_error_counts(stderr);
+//
+// Each thread counts into a table of its own, so counting is a few uncontended stores; error_counts() merges the
+// tables of all threads, live and exited, whenever it is called. The setting must be the same in every translation
+// unit of a program. With 0, the default, expected.h neither includes this header nor counts anything, and what is
+// left here reports no sites.
+#if !defined(MORI_ERROR_COUNTERS)
+#define MORI_ERROR_COUNTERS 0
+#endif
+
+namespace mori {
+    // What was counted at one source location.
+    struct error_site {
+        std::source_location where;
+        std::uint64_t errors = 0;
+        std::uint64_t values = 0;
+    };
+
+    // Everything counted in one function, summed over its sites.
+    struct error_function {
+        const char* function;
+        std::uint64_t errors = 0;
+        std::uint64_t values = 0;
+
+        // The share of constructions in this function that produced an error.
+        [[nodiscard]] double error_rate() const noexcept {
+            return errors + values == 0 ? 0.0 : static_cast<double>(errors) / static_cast<double>(errors + values);
+        }
+    };
+
+    namespace detail {
+        [[nodiscard]] inline bool same_site(const std::source_location& x, const std::source_location& y) noexcept {
+            return x.line() == y.line() && x.column() == y.column()
+                && (x.file_name() == y.file_name() || std::strcmp(x.file_name(), y.file_name()) == 0);
+        }
+
+        // One thread's counters: an open-addressed table keyed by source location. Only the owning thread writes
+        // it, with relaxed loads and stores instead of read-modify-writes, so that error_counts() can read it at any
+        // time. Tables are allocated on cache line boundaries and never share a line with another thread's.
+        class alignas(64) site_table {
+        public:
+            static constexpr std::size_t capacity = 1024;
+            // A site that is not found within this many slots is counted as dropped.
+            static constexpr std::size_t max_probes = 16;
+
+            site_table(const site_table&) = delete;
+            site_table& operator=(const site_table&) = delete;
+
+            // The calling thread's table. The pointer is kept apart from the object that retires the table at thread
+            // exit so that reading it is a plain thread-local load rather than a call through an initialization guard.
+            [[nodiscard]] static site_table& local() {
+                if (current == nullptr) [[unlikely]] {
+                    current = create_local();
+                }
+                return *current;
+            }
+
+            void count(const std::source_location& where, bool error) noexcept {
+                // Pointers to the same file name are usually identical, so they hash consistently within a table;
+                // a site seen through two different pointers just takes two slots until the counts are merged.
+                std::size_t h = (reinterpret_cast<std::uintptr_t>(where.file_name()) >> 3)
+                    ^ (std::size_t(where.line()) * 0x9e3779b1u) ^ where.column();
+                h ^= h >> 15;
+                for (std::size_t probe = 0; probe < max_probes; ++probe, ++h) {
+                    slot& s = slots[h & (capacity - 1)];
+                    if (!s.used.load(std::memory_order_relaxed)) {
+                        s.where = where;
+                        s.used.store(true, std::memory_order_release);
+                    }
+                    else if (!same_site(s.where, where)) {
+                        continue;
+                    }
+                    std::atomic<std::uint64_t>& counter = error ? s.errors : s.values;
+                    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    return;
+                }
+                dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
+            // Adds this table's counts to out.
+            void collect(std::vector<error_site>& out, std::uint64_t& lost) const {
+                for (const slot& s : slots) {
+                    if (s.used.load(std::memory_order_acquire)) {
+                        out.push_back({s.where, s.errors.load(std::memory_order_relaxed),
+                            s.values.load(std::memory_order_relaxed)});
+                    }
+                }
+                lost += dropped.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct slot {
+                std::source_location where;
+                std::atomic<bool> used{false};
+                std::atomic<std::uint64_t> errors{0};
+                std::atomic<std::uint64_t> values{0};
+            };
+
+            friend class site_registry;
+
+            static inline thread_local site_table* current = nullptr;
+
+            static site_table* create_local();
+
+            site_table() = default;
+
+            slot slots[capacity];
+            std::atomic<std::uint64_t> dropped{0};
+        };
+
+        // Every live table, plus what the tables of exited threads counted.
+        class site_registry {
+        public:
+            [[nodiscard]] static site_registry& get() {
+                static site_registry registry;
+                return registry;
+            }
+
+            void add(site_table* table) {
+                const std::lock_guard lock(mutex);
+                live.push_back(table);
+            }
+            void retire(site_table* table) {
+                const std::lock_guard lock(mutex);
+                table->collect(retired, retired_dropped);
+                merge(retired);
+                live.erase(std::find(live.begin(), live.end(), table));
+            }
+
+            // Merged counts, one entry per site, and the number of counts dropped because a table was full.
+            [[nodiscard]] std::vector<error_site> snapshot(std::uint64_t& lost) const {
+                std::vector<error_site> sites;
+                const std::lock_guard lock(mutex);
+                sites = retired;
+                lost = retired_dropped;
+                for (const site_table* table : live) {
+                    table->collect(sites, lost);
+                }
+                merge(sites);
+                return sites;
+            }
+
+        private:
+            site_registry() = default;
+
+            static void merge(std::vector<error_site>& sites) {
+                const auto before = [](const error_site& x, const error_site& y) {
+                    if (const int c = std::strcmp(x.where.file_name(), y.where.file_name()); c != 0) {
+                        return c < 0;
+                    }
+                    return x.where.line() != y.where.line() ? x.where.line() < y.where.line()
+                                                            : x.where.column() < y.where.column();
+                };
+                std::sort(sites.begin(), sites.end(), before);
+                std::size_t out = 0;
+                for (std::size_t i = 0; i < sites.size(); ++i) {
+                    if (out != 0 && same_site(sites[out - 1].where, sites[i].where)) {
+                        sites[out - 1].errors += sites[i].errors;
+                        sites[out - 1].values += sites[i].values;
+                    }
+                    else {
+                        sites[out++] = sites[i];
+                    }
+                }
+                sites.resize(out);
+            }
+
+            mutable std::mutex mutex;
+            std::vector<site_table*> live;
+            std::vector<error_site> retired;
+            std::uint64_t retired_dropped = 0;
+        };
+
+        inline site_table* site_table::create_local() {
+            struct owner {
+                owner() : table(::new (::operator new(sizeof(site_table), std::align_val_t(alignof(site_table))))
+                    site_table()) {
+                    site_registry::get().add(table);
+                }
+                owner(const owner&) = delete;
+                owner& operator=(const owner&) = delete;
+                ~owner() {
+                    current = nullptr;
+                    site_registry::get().retire(table);
+                    table->~site_table();
+                    ::operator delete(static_cast<void*>(table), std::align_val_t(alignof(site_table)));
+                }
+
+                site_table* table;
+            };
+            // Make sure the registry outlives every thread's owner, including the main thread's.
+            static_cast<void>(site_registry::get());
+            thread_local const owner local;
+            return local.table;
+        }
+
+        inline void count_error(const std::source_location& where) noexcept {
+            site_table::local().count(where, true);
+        }
+        inline void count_value(const std::source_location& where) noexcept {
+            site_table::local().count(where, false);
+        }
+    }
+
+    // Everything counted so far, one entry per source location, most errors first.
+    [[nodiscard]] inline std::vector<error_site> error_counts() {
+        std::uint64_t lost = 0;
+        std::vector<error_site> sites = detail::site_registry::get().snapshot(lost);
+        std::stable_sort(sites.begin(), sites.end(), [](const error_site& x, const error_site& y) {
+            return x.errors > y.errors;
+        });
+        return sites;
+    }
+
+    // The same counts summed per function, highest error rate first.
+    [[nodiscard]] inline std::vector<error_function> error_counts_by_function() {
+        std::vector<error_site> sites = error_counts();
+        std::stable_sort(sites.begin(), sites.end(), [](const error_site& x, const error_site& y) {
+            return std::strcmp(x.where.function_name(), y.where.function_name()) < 0;
+        });
+        std::vector<error_function> functions;
+        for (const error_site& site : sites) {
+            if (functions.empty() || std::strcmp(functions.back().function, site.where.function_name()) != 0) {
+                functions.push_back({site.where.function_name()});
+            }
+            functions.back().errors += site.errors;
+            functions.back().values += site.values;
+        }
+        std::stable_sort(functions.begin(), functions.end(), [](const error_function& x, const error_function& y) {
+            return x.error_rate() != y.error_rate() ? x.error_rate() > y.error_rate() : x.errors > y.errors;
+        });
+        return functions;
+    }
+
+    // Prints the functions that produced errors with their error rates, then the busiest error sites.
+    inline void dump_error_counts(std::FILE* out = stderr, std::size_t limit = 20) {
+        std::uint64_t lost = 0;
+        static_cast<void>(detail::site_registry::get().snapshot(lost));
+        std::fprintf(out, "errors by function (errors, values, error rate):\n");
+        std::size_t shown = 0;
+        for (const error_function& f : error_counts_by_function()) {
+            if (f.errors == 0 || shown++ == limit) {
+                continue;
+            }
+            std::fprintf(out, "  %12llu %12llu %6.2f%%  %s\n", static_cast<unsigned long long>(f.errors),
+                static_cast<unsigned long long>(f.values), 100 * f.error_rate(), f.function);
+        }
+        std::fprintf(out, "errors by site:\n");
+        shown = 0;
+        for (const error_site& site : error_counts()) {
+            if (site.errors == 0 || shown++ == limit) {
+                break;
+            }
+            std::fprintf(out, "  %12llu  %s:%u:%u\n", static_cast<unsigned long long>(site.errors),
+                site.where.file_name(), static_cast<unsigned>(site.where.line()),
+                static_cast<unsigned>(site.where.column()));
+        }
+        if (lost != 0) {
+            std::fprintf(out, "  %llu counts dropped: too many sites for one thread's table\n",
+                static_cast<unsigned long long>(lost));
+        }
+    }
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "expected.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <source_location>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// A closed set of error enumerations sharing one 32-bit code, for layers that each add a few errors of their own and
+// pass the rest up:
+//
+//     enum class ParseError { bad_digit = 1, overflow };
+//     enum class IoError { not_found = 1, denied };
+//     using LoadError = mori::error_set<ParseError, IoError>;
+//
+//     mori::expected<int, mori::error_set<ParseError>> parse(std::string_view text);
+//     mori::expected<int, LoadError> load(const char* path) {
+//         ...
+//         return parse(text);                              // widening: the code is copied as it is
+//     }
+//
+//     switch (error.code()) {
+//     case LoadError::code_of(IoError::not_found): ...
+//     }
+//     error.visit([](auto e) { return describe(e); });   // describe(ParseError), describe(IoError)
+//
+// Every enumeration owns the codes whose upper 16 bits are its domain; the lower 16 bits are the enumerator's value,
+// which must lie in 0..65535. Since the domain belongs to the type and not to the set, an error keeps its code in
+// every set it is part of, and converting a set to a larger one, or an enumerator to a set, changes no bits beyond
+// the domain being or-ed in. Code 0 is never used, which gives expected<void, error_set<...>> a spare representation.
+namespace mori {
+    namespace detail {
+        // FNV-1a over the type's name as it appears in this function's signature, folded to 16 bits. Zero is
+        // reserved for the spare code.
+        template<class E>
+        [[nodiscard]] consteval std::uint16_t name_domain() noexcept {
+            std::uint32_t hash = 2166136261u;
+            for (const char* c = std::source_location::current().function_name(); *c != '\0'; ++c) {
+                hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+            }
+            const auto folded = static_cast<std::uint16_t>(hash ^ (hash >> 16));
+            return folded == 0 ? 1 : folded;
+        }
+    }
+
+    // The upper 16 bits of an enumeration's codes. By default a hash of the type's name, which is the same in every
+    // translation unit but not across compilers; two members of one set whose hashes collide are a compile error.
+    // Specialize it with a nonzero value where codes must be stable, or to separate a collision:
+    //     template<> struct mori::error_domain<ParseError> : std::integral_constant<std::uint16_t, 7> {};
+    template<class E> requires (std::is_enum_v<E>)
+    struct error_domain : std::integral_constant<std::uint16_t, detail::name_domain<E>()> {};
+
+    template<class E>
+    inline constexpr std::uint16_t error_domain_v = error_domain<E>::value;
+
+    template<class... Es>
+    class error_set;
+
+    namespace detail {
+        template<class E, class... Es>
+        concept error_set_member = (std::is_same_v<E, Es> || ...);
+
+        template<class S, class... Es>
+        struct is_error_subset : std::false_type {};
+        template<class... Fs, class... Es>
+        struct is_error_subset<error_set<Fs...>, Es...> : std::bool_constant<(error_set_member<Fs, Es...> && ...)> {};
+
+        // A member enumeration, or a set whose members are all members.
+        template<class X, class... Es>
+        concept error_set_part = error_set_member<X, Es...> || is_error_subset<X, Es...>::value;
+
+        template<class... Es>
+        [[nodiscard]] consteval bool distinct_domains() noexcept {
+            constexpr std::uint16_t domains[] = {error_domain_v<Es>...};
+            for (std::size_t i = 0; i < sizeof...(Es); ++i) {
+                for (std::size_t j = i + 1; j < sizeof...(Es); ++j) {
+                    if (domains[i] == domains[j]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        inline constexpr char error_set_range_message[] = "error_set: enumerator value outside 0..65535";
+    }
+
+    template<class... Es>
+    class error_set {
+        static_assert(sizeof...(Es) > 0 && (std::is_enum_v<Es> && ...), "error_set members must be enumerations");
+        static_assert(((error_domain_v<Es> != 0) && ...), "error domain 0 is reserved");
+        static_assert(detail::distinct_domains<Es...>(),
+            "error_set members must have distinct domains; specialize mori::error_domain to separate them");
+
+        using first_type = std::tuple_element_t<0, std::tuple<Es...>>;
+
+    public:
+        template<class E> requires (detail::error_set_member<E, Es...>)
+        constexpr error_set(E e) noexcept : code_(code_of(e)) {}
+
+        // Widening from a set of some of the members; the code stays as it is.
+        template<class... Fs> requires (detail::is_error_subset<error_set<Fs...>, Es...>::value)
+        constexpr error_set(error_set<Fs...> other) noexcept : code_(other.code_) {}
+
+        // The code of an enumerator in any set; a constant expression, so it can label a case.
+        template<class E> requires (detail::error_set_member<E, Es...>)
+        [[nodiscard]] static constexpr std::uint32_t code_of(E e) noexcept {
+            const auto value = static_cast<std::underlying_type_t<E>>(e);
+            if (!std::in_range<std::uint16_t>(value)) {
+                detail::panic(detail::error_set_range_message);
+            }
+            return std::uint32_t{error_domain_v<E>} << 16 | static_cast<std::uint16_t>(value);
+        }
+
+        [[nodiscard]] constexpr std::uint32_t code() const noexcept { return code_; }
+
+        // Whether the error is an enumerator of E, or belongs to the subset E.
+        template<class X> requires (detail::error_set_part<X, Es...>)
+        [[nodiscard]] constexpr bool holds() const noexcept {
+            if constexpr (std::is_enum_v<X>) {
+                return domain() == error_domain_v<X>;
+            }
+            else {
+                return holds_any(std::type_identity<X>{});
+            }
+        }
+
+        // The error as an enumerator of E, or narrowed to the subset E. Requires holds<X>().
+        template<class X> requires (detail::error_set_part<X, Es...>)
+        [[nodiscard]] constexpr X get() const noexcept {
+            if constexpr (std::is_enum_v<X>) {
+                return static_cast<X>(static_cast<std::underlying_type_t<X>>(code_ & 0xffff));
+            }
+            else {
+                return X(code_);
+            }
+        }
+
+        // Calls f with the error as an enumerator of its own type. f must return the same type for every member.
+        // The tests on the domain are compared against constants, which the compiler turns into a switch.
+        template<class F>
+        constexpr decltype(auto) visit(F&& f) const {
+            using R = std::invoke_result_t<F&, first_type>;
+            static_assert((std::is_same_v<std::invoke_result_t<F&, Es>, R> && ...),
+                "error_set::visit needs the same result type for every member");
+            return dispatch<0>(f);
+        }
+
+        friend constexpr bool operator==(error_set, error_set) noexcept = default;
+
+        template<class E> requires (detail::error_set_member<E, Es...>)
+        friend constexpr bool operator==(error_set s, E e) noexcept {
+            return s.code_ == code_of(e);
+        }
+
+    private:
+        constexpr explicit error_set(std::uint32_t code) noexcept : code_(code) {}
+
+        [[nodiscard]] constexpr std::uint16_t domain() const noexcept { return static_cast<std::uint16_t>(code_ >> 16); }
+
+        template<class... Fs>
+        [[nodiscard]] constexpr bool holds_any(std::type_identity<error_set<Fs...>>) const noexcept {
+            return ((domain() == error_domain_v<Fs>) || ...);
+        }
+
+        // The last member needs no test: a set always holds one of its members.
+        template<std::size_t I, class F>
+        constexpr decltype(auto) dispatch(F& f) const {
+            using E = std::tuple_element_t<I, std::tuple<Es...>>;
+            if constexpr (I + 1 == sizeof...(Es)) {
+                return std::invoke(f, get<E>());
+            }
+            else {
+                if (domain() == error_domain_v<E>) {
+                    return std::invoke(f, get<E>());
+                }
+                return dispatch<I + 1>(f);
+            }
+        }
+
+        template<class...> friend class error_set;
+        friend struct spare_representation<error_set>;
+
+        std::uint32_t code_;
+    };
+
+    // No enumerator has code 0, so an expected<void, error_set<...>> is a single code with 0 meaning success.
+    template<class... Es>
+    struct spare_representation<error_set<Es...>> {
+        static constexpr bool available = true;
+        static constexpr void write(error_set<Es...>* p) noexcept { std::construct_at(p, error_set<Es...>(0u)); }
+        [[nodiscard]] static constexpr bool holds(const error_set<Es...>* p) noexcept { return p->code_ == 0; }
+    };
+}
@@ -1,11 +1,182 @@
 #pragma once
 
+#include "expected_fwd.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <optional>
+#include <system_error>
 #include <type_traits>
 #include <utility>
-#include <variant>
+#include <vector>
+
+// Whether the translation unit is compiled with exceptions. Only then can constructing a T or E throw, so only then
+// do the operations that replace contents go through the try blocks that keep the old contents on a throw.
+#if defined(__cpp_exceptions)
+#define MORI_HAS_EXCEPTIONS 1
+#else
+#define MORI_HAS_EXCEPTIONS 0
+#endif
+
+// With MORI_NO_EXCEPTIONS set to 1, accessing the value of an expected that holds an error calls the panic handler
+// instead of throwing bad_expected_access. It affects nothing else: exceptions thrown by T and E are still handled
+// wherever the translation unit has exceptions. It defaults to 1 when the translation unit is compiled without them,
+// and the header then contains no throw or try.
+#if !defined(MORI_NO_EXCEPTIONS)
+#if MORI_HAS_EXCEPTIONS
+#define MORI_NO_EXCEPTIONS 0
+#else
+#define MORI_NO_EXCEPTIONS 1
+#endif
+#endif
+
+// With MORI_ERROR_COUNTERS set to 1, constructing an error or a value is counted against the caller's source location
+// (see error_counters.h). With 0, the default, none of that code exists.
+#if !defined(MORI_ERROR_COUNTERS)
+#define MORI_ERROR_COUNTERS 0
+#endif
+#if MORI_ERROR_COUNTERS
+#include "error_counters.h"
+
+#include <source_location>
+
+// A trailing parameter for constructors that take no tag, and the counting calls their bodies make.
+#define MORI_CALLER_LOCATION , std::source_location caller = std::source_location::current()
+#define MORI_COUNT_ERROR(where) if (!std::is_constant_evaluated()) ::mori::detail::count_error(where)
+#define MORI_COUNT_VALUE(where) if (!std::is_constant_evaluated()) ::mori::detail::count_value(where)
+#else
+#define MORI_CALLER_LOCATION
+#define MORI_COUNT_ERROR(where)
+#define MORI_COUNT_VALUE(where)
+#endif
+
+// Whether the type trait builtins shared by GCC, Clang and MSVC can stand in for the std traits in constraints.
+#if !defined(MORI_TRAIT_BUILTINS)
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define MORI_TRAIT_BUILTINS 1
+#else
+#define MORI_TRAIT_BUILTINS 0
+#endif
+#endif
+
+// Keeps a failure path out of line and out of the hot code around its caller.
+#if defined(__GNUC__)
+#define MORI_COLD [[gnu::cold, gnu::noinline]]
+#elif defined(_MSC_VER)
+#define MORI_COLD __declspec(noinline)
+#else
+#define MORI_COLD
+#endif
 
 namespace mori {
+    // Constraints in this header are written with the concepts below rather than std::is_*_v. libstdc++ builds most of
+    // those traits from several layers of class templates, and instantiating them for every T and E was most of the
+    // cost of instantiating expected; the compiler builtins answer the same questions without instantiating anything.
+    namespace detail {
+#if MORI_TRAIT_BUILTINS
+        template<class T, class... Args>
+        concept constructible = __is_constructible(T, Args...);
+        template<class T, class... Args>
+        concept nothrow_constructible = __is_nothrow_constructible(T, Args...);
+        template<class T, class... Args>
+        concept trivially_constructible = __is_trivially_constructible(T, Args...);
+        template<class T, class U>
+        concept assignable = __is_assignable(T, U);
+        template<class T, class U>
+        concept nothrow_assignable = __is_nothrow_assignable(T, U);
+        template<class T, class U>
+        concept trivially_assignable = __is_trivially_assignable(T, U);
+#if defined(__clang__) || defined(_MSC_VER)
+        template<class T>
+        concept trivially_destructible = __is_trivially_destructible(T);
+#else
+        // Only ever asked about complete object types, for which this is exact.
+        template<class T>
+        concept trivially_destructible = __has_trivial_destructor(T);
+#endif
+#else
+        template<class T, class... Args>
+        concept constructible = std::is_constructible_v<T, Args...>;
+        template<class T, class... Args>
+        concept nothrow_constructible = std::is_nothrow_constructible_v<T, Args...>;
+        template<class T, class... Args>
+        concept trivially_constructible = std::is_trivially_constructible_v<T, Args...>;
+        template<class T, class U>
+        concept assignable = std::is_assignable_v<T, U>;
+        template<class T, class U>
+        concept nothrow_assignable = std::is_nothrow_assignable_v<T, U>;
+        template<class T, class U>
+        concept trivially_assignable = std::is_trivially_assignable_v<T, U>;
+        template<class T>
+        concept trivially_destructible = std::is_trivially_destructible_v<T>;
+#endif
+
+        template<class To>
+        void convert_implicitly(To) noexcept;
+        // libstdc++ answers is_convertible with an overload test wrapped in class templates; asking for the implicit
+        // conversion directly gives the same answer for the object types used here.
+        template<class From, class To>
+        concept convertible = requires { detail::convert_implicitly<To>(std::declval<From>()); };
+    }
+
+    // Called with a description of the failure when an exception-free build hits an error it cannot report any other
+    // way. A handler should not return; if it does, the program aborts.
+    using panic_handler = void (*)(const char* message) noexcept;
+
+    namespace detail {
+        inline void default_panic_handler(const char* message) noexcept {
+            std::fprintf(stderr, "mori: %s\n", message);
+            std::abort();
+        }
+
+        inline std::atomic<panic_handler> current_panic_handler{default_panic_handler};
+    }
+
+    // Installs a new panic handler, or restores the default one (print and abort) when given nullptr, and returns the
+    // previous handler.
+    inline panic_handler set_panic_handler(panic_handler handler) noexcept {
+        return detail::current_panic_handler.exchange(handler != nullptr ? handler : detail::default_panic_handler);
+    }
+    [[nodiscard]] inline panic_handler get_panic_handler() noexcept {
+        return detail::current_panic_handler.load();
+    }
+
+    namespace detail {
+        [[noreturn]] MORI_COLD inline void panic(const char* message) noexcept {
+            get_panic_handler()(message);
+            std::abort();
+        }
+
+        inline constexpr char bad_access_message[] =
+            "incorrectly accessing an expected object that contains an unexpected value";
+    }
+
+    namespace detail {
+#if MORI_ERROR_COUNTERS
+        // A tag argument together with the location of the expression that passed it: the tag converts implicitly,
+        // and the default argument is evaluated where that conversion happens, in the caller.
+        template<class Tag>
+        struct located_tag {
+            constexpr located_tag(Tag, std::source_location where = std::source_location::current()) noexcept :
+                where(where) {}
+
+            std::source_location where;
+        };
+        using in_place_arg = located_tag<std::in_place_t>;
+#else
+        using in_place_arg = std::in_place_t;
+#endif
+    }
+
     template<class E>
     class unexpected {
     public:
@@ -14,12 +185,19 @@ namespace mori {
         template<class Err = E>
         requires (!std::is_same_v<std::remove_cvref_t<Err>, unexpected>
             && !std::is_same_v<std::remove_cvref_t<Err>, std::in_place_t>
-            && std::is_constructible_v<E, Err>)
-        constexpr explicit unexpected(Err&& e) : unex(std::forward<Err>(e)) {}
-        template<class... Args> requires (std::is_constructible_v<E, Args...>)
-        constexpr explicit unexpected(std::in_place_t, Args&&... args) : unex(std::forward<Args>(args)...) {}
-        template<class U, class... Args> requires (std::is_constructible_v<E, std::initializer_list<U>&, Args...>)
-        constexpr explicit unexpected(std::in_place_t, std::initializer_list<U> il, Args&&... args) : unex(il, std::forward<Args>(args)...) {}
+            && detail::constructible<E, Err>)
+        constexpr explicit unexpected(Err&& e MORI_CALLER_LOCATION) : unex(std::forward<Err>(e)) {
+            MORI_COUNT_ERROR(caller);
+        }
+        template<class... Args> requires (detail::constructible<E, Args...>)
+        constexpr explicit unexpected([[maybe_unused]] detail::in_place_arg tag, Args&&... args) : unex(std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
+        template<class U, class... Args> requires (detail::constructible<E, std::initializer_list<U>&, Args...>)
+        constexpr explicit unexpected([[maybe_unused]] detail::in_place_arg tag, std::initializer_list<U> il, Args&&... args) :
+            unex(il, std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
 
         [[nodiscard]] constexpr const E& error() const & noexcept { return unex; }
         [[nodiscard]] constexpr E& error() & noexcept { return unex; }
@@ -44,6 +222,25 @@ namespace mori {
     template<class E>
     unexpected(E) -> unexpected<E>;
 
+    template<class E>
+    class bad_expected_access;
+
+    template<>
+    class bad_expected_access<void> : public std::exception {
+    public:
+        const char* what() const noexcept override {
+            return detail::bad_access_message;
+        }
+
+    protected:
+        bad_expected_access() noexcept = default;
+        bad_expected_access(const bad_expected_access&) = default;
+        bad_expected_access(bad_expected_access&&) noexcept = default;
+        bad_expected_access& operator=(const bad_expected_access& other) = default;
+        bad_expected_access& operator=(bad_expected_access&& other) noexcept = default;
+        virtual ~bad_expected_access() noexcept(std::is_nothrow_destructible_v<std::exception>) = default;
+    };
+
     template<class E>
     class bad_expected_access : public bad_expected_access<void> {
     public:
@@ -58,64 +255,1169 @@ namespace mori {
         E unex;
     };
 
+    namespace detail {
+        template<class E>
+        [[noreturn]] MORI_COLD void throw_bad_expected_access(E&& e) {
+#if MORI_NO_EXCEPTIONS
+            (void)e;
+            panic(bad_access_message);
+#else
+            throw bad_expected_access<std::decay_t<E>>(std::forward<E>(e));
+#endif
+        }
+    }
+
+    struct unexpect_t {
+        explicit unexpect_t() = default;
+    };
+    inline constexpr unexpect_t unexpect{};
+
+    // Tags for the constructors that initialize the value or error with the result of invoking a callable. A T or E
+    // the callable returns by value is constructed straight in the expected, with no move, so factories can return
+    // large or immovable types:
+    //     Result<Record> r(mori::in_place_from, parse_record, text);
+    struct in_place_from_t {
+        explicit in_place_from_t() = default;
+    };
+    inline constexpr in_place_from_t in_place_from{};
+    struct unexpect_from_t {
+        explicit unexpect_from_t() = default;
+    };
+    inline constexpr unexpect_from_t unexpect_from{};
+
+    namespace detail {
+#if MORI_ERROR_COUNTERS
+        using unexpect_arg = located_tag<unexpect_t>;
+        using in_place_from_arg = located_tag<in_place_from_t>;
+        using unexpect_from_arg = located_tag<unexpect_from_t>;
+#else
+        using unexpect_arg = unexpect_t;
+        using in_place_from_arg = in_place_from_t;
+        using unexpect_from_arg = unexpect_from_t;
+#endif
+
+        // Whether T can be initialized from the result of invoking F with Args. A prvalue T initializes it directly,
+        // so T needs no move constructor for that.
+        template<class T, class F, class... Args>
+        concept constructible_from_invoke = std::is_invocable_v<F, Args...>
+            && (std::is_same_v<std::remove_cv_t<std::invoke_result_t<F, Args...>>, T>
+                || constructible<T, std::invoke_result_t<F, Args...>>);
+        template<class T, class F, class... Args>
+        concept nothrow_constructible_from_invoke = constructible_from_invoke<T, F, Args...>
+            && std::is_nothrow_invocable_v<F, Args...>
+            && (std::is_same_v<std::remove_cv_t<std::invoke_result_t<F, Args...>>, T>
+                || nothrow_constructible<T, std::invoke_result_t<F, Args...>>);
+    }
+
+    // Opt-in trait for types with a bit pattern that no meaningful object of the type ever holds.
+    // When one side of an expected has a spare representation and the other side is empty (void, or an empty error
+    // class), expected stores only that side and uses the spare pattern as its discriminant, dropping the tag byte.
+    // Specializations provide:
+    //     static constexpr bool available = true;
+    //     static void write(T* p) noexcept;       // creates an object holding the spare pattern in the storage at p
+    //     static bool holds(const T* p) noexcept; // whether the object at p holds the spare pattern
+    // The object created by write() is never destroyed, only overwritten.
+    //
+    // An error type whose spare pattern leaves some of its bytes alone can also take a small value into those bytes,
+    // so expected<T, E> is the size of E even though both sides carry state. Such specializations also provide:
+    //     template<class U> static constexpr bool fits_beside; // whether a U fits in the bytes the pattern leaves free
+    //     static constexpr std::size_t free_offset;            // where those bytes start
+    //     static void mark(std::byte* p) noexcept;              // writes the pattern into raw storage holding no T
+    //     static bool marked(const std::byte* p) noexcept;      // whether raw storage holds the pattern
+    // Constant evaluation cannot tell which of two overlapping objects is alive, so such an expected cannot be used
+    // in a constant expression.
+    template<class T>
+    struct spare_representation {
+        static constexpr bool available = false;
+    };
+
+    namespace detail {
+        // A non-null address no object can live at, shared by the pointer-like specializations. Forming it is not a
+        // constant expression, so expected<T*, E> and the smart pointer niches cannot be used in one.
+        template<class T>
+        [[nodiscard]] inline T* spare_pointer() noexcept {
+            return reinterpret_cast<T*>(~std::uintptr_t{0});
+        }
+    }
+
+    template<class T> requires (std::is_object_v<T>)
+    struct spare_representation<T*> {
+        static constexpr bool available = true;
+        static void write(T** p) noexcept { std::construct_at(p, detail::spare_pointer<T>()); }
+        [[nodiscard]] static bool holds(T* const* p) noexcept { return *p == detail::spare_pointer<T>(); }
+    };
+
+    template<class T>
+    struct spare_representation<std::unique_ptr<T>> {
+        using element_type = typename std::unique_ptr<T>::element_type;
+
+        static constexpr bool available = true;
+        static void write(std::unique_ptr<T>* p) noexcept {
+            std::construct_at(p, detail::spare_pointer<element_type>());
+        }
+        [[nodiscard]] static bool holds(const std::unique_ptr<T>* p) noexcept {
+            return p->get() == detail::spare_pointer<element_type>();
+        }
+    };
+
+    template<class T>
+    struct spare_representation<std::shared_ptr<T>> {
+        using element_type = typename std::shared_ptr<T>::element_type;
+
+        static constexpr bool available = true;
+        static void write(std::shared_ptr<T>* p) noexcept {
+            // The aliasing constructor stores the pointer without allocating a control block.
+            std::construct_at(p, std::shared_ptr<T>(), detail::spare_pointer<element_type>());
+        }
+        [[nodiscard]] static bool holds(const std::shared_ptr<T>* p) noexcept {
+            return p->get() == detail::spare_pointer<element_type>();
+        }
+    };
+
+    // A zero error_code means "no error", so it can never be a meaningful error. Constructing an unexpected
+    // std::error_code{} in an expected<void, std::error_code> therefore reads back as success.
+    //
+    // An error_code always refers to a category, so a null category pointer marks an expected<T, std::error_code>
+    // holding a value, and a T up to the size of the int before it takes that int's place: expected<T*,
+    // std::error_code> is 16 bytes rather than 24. libstdc++, libc++ and Microsoft's library all store the int first
+    // and the category pointer last; elsewhere the tag stays.
     template<>
-    class bad_expected_access<void> : public std::exception {
-    public:
-        const char* what() const noexcept override {
-            return "incorrectly accessing an expected object that contains an unexpected value";
+    struct spare_representation<std::error_code> {
+        static constexpr bool available = true;
+        static void write(std::error_code* p) noexcept { std::construct_at(p); }
+        [[nodiscard]] static bool holds(const std::error_code* p) noexcept { return p->value() == 0; }
+
+#if defined(__GLIBCXX__) || defined(_LIBCPP_VERSION) || defined(_MSC_VER)
+        static constexpr std::size_t free_offset = 0;
+        static constexpr std::size_t category_offset = sizeof(std::error_code) - sizeof(const std::error_category*);
+        static_assert(category_offset >= sizeof(int));
+
+        template<class U>
+        static constexpr bool fits_beside = sizeof(U) <= category_offset && alignof(U) <= alignof(std::error_code);
+
+        static void mark(std::byte* p) noexcept {
+            const std::error_category* const none = nullptr;
+            std::memcpy(p + category_offset, &none, sizeof(none));
+        }
+        [[nodiscard]] static bool marked(const std::byte* p) noexcept {
+            const std::error_category* category;
+            std::memcpy(&category, p + category_offset, sizeof(category));
+            return category == nullptr;
         }
+#endif
+    };
 
-    protected:
-        bad_expected_access() noexcept = default;
-        bad_expected_access(const bad_expected_access&) = default;
-        bad_expected_access(bad_expected_access&&) noexcept = default;
-        bad_expected_access& operator=(const bad_expected_access& other) = default;
-        bad_expected_access& operator=(bad_expected_access&& other) noexcept = default;
-        virtual ~bad_expected_access() noexcept(std::is_nothrow_destructible_v<std::exception>) = default;
+    // Enumerations opt in by declaring an enumerator named mori_spare that is never used as a real value.
+    template<class T> requires (std::is_enum_v<T> && requires { T::mori_spare; })
+    struct spare_representation<T> {
+        static constexpr bool available = true;
+        static constexpr void write(T* p) noexcept { std::construct_at(p, T::mori_spare); }
+        [[nodiscard]] static constexpr bool holds(const T* p) noexcept { return *p == T::mori_spare; }
     };
 
-    struct unexpect_t {
-        explicit unexpect_t() = default;
-    };
-    inline constexpr unexpect_t unexpect{};
+    namespace detail {
+        // What expected<T&, E> stores for its value: the address of the referenced object, which is never null.
+        template<class T>
+        struct reference_slot {
+            T* pointer;
+        };
+
+        // Whether T is a single pointer and nothing else: a raw pointer, a unique_ptr with the default deleter, or
+        // the slot of expected<T&, E>.
+        template<class T>
+        inline constexpr bool is_single_pointer_v = std::is_pointer_v<T>;
+        template<class T>
+        inline constexpr bool is_single_pointer_v<std::unique_ptr<T>> = true;
+        template<class T>
+        inline constexpr bool is_single_pointer_v<reference_slot<T>> = true;
+    }
+
+    // Unlike the spare pointer above, null can be written and tested during constant evaluation.
+    template<class T>
+    struct spare_representation<detail::reference_slot<T>> {
+        static constexpr bool available = true;
+        static constexpr void write(detail::reference_slot<T>* p) noexcept { std::construct_at(p, nullptr); }
+        [[nodiscard]] static constexpr bool holds(const detail::reference_slot<T>* p) noexcept {
+            return p->pointer == nullptr;
+        }
+    };
+
+    // Opt-in trait for types whose objects can be moved to another address by copying their bytes, after which the old
+    // bytes are forgotten instead of destroyed. expected uses it to switch between value and error, and to swap, without
+    // moving anything through a temporary. Trivially copyable types qualify automatically, unless they cannot be moved
+    // at all: a type with every copy and move deleted counts as trivially copyable, but std::mutex and the like are
+    // pinned to their address.
+    // libstdc++'s std::string points into its own small buffer, so it only qualifies with libc++.
+    template<class T>
+    struct trivially_relocatable
+        : std::bool_constant<std::is_trivially_copyable_v<T> && std::is_move_constructible_v<T>> {};
+
+    template<class T>
+    inline constexpr bool is_trivially_relocatable_v = trivially_relocatable<std::remove_cv_t<T>>::value;
+
+    template<class T, class D>
+    struct trivially_relocatable<std::unique_ptr<T, D>> : trivially_relocatable<D> {};
+    template<class T>
+    struct trivially_relocatable<std::shared_ptr<T>> : std::true_type {};
+    template<class T>
+    struct trivially_relocatable<std::weak_ptr<T>> : std::true_type {};
+    // libstdc++, libc++ and MSVC's STL all keep a vector as three pointers into its heap block, with std::allocator
+    // stored as an empty base or member. Another allocator may hold state tied to the vector's address, or fancy
+    // pointers that are not plain addresses, so only the default one qualifies.
+    template<class T>
+    struct trivially_relocatable<std::vector<T, std::allocator<T>>> : std::true_type {};
+    template<class T>
+    struct trivially_relocatable<std::optional<T>> : trivially_relocatable<T> {};
+    template<>
+    struct trivially_relocatable<std::exception_ptr> : std::true_type {};
+#if defined(_LIBCPP_VERSION)
+    template<class C, class Traits>
+    struct trivially_relocatable<std::basic_string<C, Traits>> : std::true_type {};
+#endif
+
+    namespace detail {
+        // Whether X can be built from some expected<U, G>, which makes the converting constructors of expected
+        // ambiguous with X's own. Named so that every converting constructor shares one cached answer.
+        template<class X, class U, class G>
+        concept constructible_from_expected = constructible<X, expected<U, G>&>
+            || constructible<X, expected<U, G>>
+            || constructible<X, const expected<U, G>&>
+            || constructible<X, const expected<U, G>>;
+        template<class X, class U, class G>
+        concept converts_from_expected = constructible_from_expected<X, U, G>
+            || detail::convertible<expected<U, G>&, X>
+            || detail::convertible<expected<U, G>, X>
+            || detail::convertible<const expected<U, G>&, X>
+            || detail::convertible<const expected<U, G>, X>;
+
+        // Whether a T& initialized from a U refers to an object the caller already has: an lvalue of T or of a class
+        // derived from it, or whatever a conversion returns when T is not const, since only an lvalue binds to that.
+        // Anything else would bind the reference to a temporary that is gone by the end of the full-expression.
+        template<class T, class U>
+        concept binds_lvalue = constructible<T&, U>
+            && (std::is_convertible_v<std::remove_reference_t<U>*, T*>
+                ? std::is_lvalue_reference_v<U>
+                : !std::is_const_v<T>);
+        template<class T, class U>
+        concept binds_temporary = constructible<T&, U> && !binds_lvalue<T, U>;
+
+        // The value type transform on an expected<T&, E> gives a function returning R: an lvalue reference carries
+        // through as expected<U&, E>, anything else is held by value. On an expected that holds its value, transform
+        // decays the result as std::expected does, so the new expected never refers into the old one.
+        template<class R>
+        using transform_value_t = std::conditional_t<std::is_lvalue_reference_v<R>, R, std::remove_cvref_t<R>>;
+    }
+
+    template<class Source, class... Stages>
+    class pipeline;
+
+    namespace detail {
+        template<class T>
+        constexpr bool is_unexpected_v = false;
+        template<class E>
+        constexpr bool is_unexpected_v<unexpected<E>> = true;
+
+        template<class T>
+        constexpr bool is_expected_v = false;
+        template<class T, class E>
+        constexpr bool is_expected_v<expected<T, E>> = true;
+
+        // Stands in for the value of expected<void, E> so both specializations share one storage layout.
+        struct void_value {};
+
+        // Tags for the private constructors that initialize the value or error straight from the result of invoking a
+        // callable, so monadic operations never move a freshly computed T or E into the new expected.
+        struct invoke_value_t {
+            explicit invoke_value_t() = default;
+        };
+        inline constexpr invoke_value_t invoke_value{};
+        struct invoke_error_t {
+            explicit invoke_error_t() = default;
+        };
+        inline constexpr invoke_error_t invoke_error{};
+
+#if MORI_HAS_EXCEPTIONS
+        // Puts the object that was moved aside back after constructing its replacement threw, and rethrows.
+        template<class T>
+        [[noreturn]] MORI_COLD void restore_and_rethrow(T& old_val, T&& saved) {
+            std::construct_at(std::addressof(old_val), std::move(saved));
+            throw;
+        }
+#endif
+
+        // Raw storage for one object that is being relocated.
+        template<class T>
+        struct relocation_buffer {
+            [[nodiscard]] T* get() noexcept { return reinterpret_cast<T*>(bytes); }
+
+            alignas(T) std::byte bytes[sizeof(T)];
+        };
+
+        // Moves the object at from to the storage at to by copying its bytes. The object at from is gone afterwards.
+        template<class T>
+        void relocate(T* to, T* from) noexcept {
+            std::memcpy(static_cast<void*>(to), static_cast<const void*>(from), sizeof(T));
+        }
+
+#if MORI_HAS_EXCEPTIONS
+        template<class T>
+        [[noreturn]] MORI_COLD void relocate_back_and_rethrow(T* to, T* from) {
+            relocate(to, from);
+            throw;
+        }
+#endif
+
+        // The throwing cases of reinit_expected for when either side can be relocated: nothing is moved through a
+        // temporary and a throw just puts the old bytes back. Returns false when neither can, or during constant
+        // evaluation.
+        template<class NewType, class OldType, class... Args>
+        constexpr bool relocate_into(NewType& new_val, OldType& old_val, Args&&... args) {
+            if (std::is_constant_evaluated()) {
+                return false;
+            }
+            if constexpr (is_trivially_relocatable_v<OldType>) {
+                relocation_buffer<OldType> saved;
+                relocate(saved.get(), std::addressof(old_val));
+#if !MORI_HAS_EXCEPTIONS
+                std::construct_at(std::addressof(new_val), std::forward<Args>(args)...);
+#else
+                try {
+                    std::construct_at(std::addressof(new_val), std::forward<Args>(args)...);
+                }
+                catch (...) {
+                    relocate_back_and_rethrow(std::addressof(old_val), saved.get());
+                }
+#endif
+                std::destroy_at(saved.get());
+                return true;
+            }
+            else if constexpr (is_trivially_relocatable_v<NewType>) {
+                relocation_buffer<NewType> temp;
+                std::construct_at(temp.get(), std::forward<Args>(args)...);
+                std::destroy_at(std::addressof(old_val));
+                relocate(std::addressof(new_val), temp.get());
+                return true;
+            }
+            else {
+                return false;
+            }
+        }
+
+        // Replaces the value or error in old_val with one constructed from args, leaving old_val intact if that throws.
+        // The caller is responsible for updating the discriminant afterwards.
+        template<class NewType, class OldType, class... Args>
+        constexpr void reinit_expected(NewType& new_val, OldType& old_val, Args&&... args)
+            noexcept(detail::nothrow_constructible<NewType, Args...>) {
+            if constexpr (detail::nothrow_constructible<NewType, Args...>) {
+                std::destroy_at(std::addressof(old_val));
+                std::construct_at(std::addressof(new_val), std::forward<Args>(args)...);
+            }
+            else if (relocate_into(new_val, old_val, std::forward<Args>(args)...)) {
+                return;
+            }
+            else if constexpr (detail::nothrow_constructible<NewType, NewType>) {
+                NewType temp(std::forward<Args>(args)...);
+                std::destroy_at(std::addressof(old_val));
+                std::construct_at(std::addressof(new_val), std::move(temp));
+            }
+            else {
+#if !MORI_HAS_EXCEPTIONS
+                std::destroy_at(std::addressof(old_val));
+                std::construct_at(std::addressof(new_val), std::forward<Args>(args)...);
+#else
+                OldType temp(std::move(old_val));
+                std::destroy_at(std::addressof(old_val));
+                try {
+                    std::construct_at(std::addressof(new_val), std::forward<Args>(args)...);
+                }
+                catch (...) {
+                    restore_and_rethrow(old_val, std::move(temp));
+                }
+#endif
+            }
+        }
+
+        // Whether the contents of an expected<T, E> can be replaced with the strong exception guarantee when
+        // constructing the new ones may throw, by relocating or moving the old ones aside.
+        template<class T, class E>
+        constexpr bool reconstructible = !MORI_HAS_EXCEPTIONS || is_trivially_relocatable_v<expected<T, E>>
+            || (constructible<T, T> && constructible<E, E>);
+
+        template<class T, class E>
+        constexpr bool trivially_copy_constructible_v =
+            detail::trivially_constructible<T, const T&> && detail::trivially_constructible<E, const E&>;
+        template<class T, class E>
+        constexpr bool trivially_move_constructible_v =
+            detail::trivially_constructible<T, T> && detail::trivially_constructible<E, E>;
+        template<class T, class E>
+        constexpr bool trivially_destructible_v =
+            detail::trivially_destructible<T> && detail::trivially_destructible<E>;
+        template<class T, class E>
+        constexpr bool trivially_copy_assignable_v = trivially_copy_constructible_v<T, E>
+            && detail::trivially_assignable<T&, const T&> && detail::trivially_assignable<E&, const E&>
+            && trivially_destructible_v<T, E>;
+        template<class T, class E>
+        constexpr bool trivially_move_assignable_v = trivially_move_constructible_v<T, E>
+            && detail::trivially_assignable<T&, T> && detail::trivially_assignable<E&, E>
+            && trivially_destructible_v<T, E>;
+
+        // Storage shared by every expected: the value and error overlap in a union and a one-byte tag says which is
+        // alive. Each special member is trivial whenever it is trivial for both T and E, so expected<int, int> and
+        // friends stay trivially copyable and are passed around in registers.
+        template<class T, class E>
+        class expected_storage {
+        public:
+            template<class... Args>
+            constexpr explicit expected_storage(std::in_place_t, Args&&... args) :
+                val(std::forward<Args>(args)...), has_val(true) {}
+            template<class... Args>
+            constexpr explicit expected_storage(unexpect_t, Args&&... args) :
+                unex(std::forward<Args>(args)...), has_val(false) {}
+            template<class F, class... Args>
+            constexpr explicit expected_storage(invoke_value_t, F&& f, Args&&... args) :
+                val(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)), has_val(true) {}
+            template<class F, class... Args>
+            constexpr explicit expected_storage(invoke_error_t, F&& f, Args&&... args) :
+                unex(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)), has_val(false) {}
+
+            constexpr expected_storage(const expected_storage&) = delete;
+            constexpr expected_storage(const expected_storage&)
+                requires (trivially_copy_constructible_v<T, E>) = default;
+            constexpr expected_storage(const expected_storage& other)
+                requires (detail::constructible<T, const T&> && detail::constructible<E, const E&>
+                    && !trivially_copy_constructible_v<T, E>) : has_val(other.has_val) {
+                if (has_val) {
+                    std::construct_at(std::addressof(val), other.val);
+                }
+                else {
+                    std::construct_at(std::addressof(unex), other.unex);
+                }
+            }
+            constexpr expected_storage(expected_storage&&)
+                requires (trivially_move_constructible_v<T, E>) = default;
+            constexpr expected_storage(expected_storage&& other)
+                noexcept(detail::nothrow_constructible<T, T> && detail::nothrow_constructible<E, E>)
+                requires (detail::constructible<T, T> && detail::constructible<E, E>
+                    && !trivially_move_constructible_v<T, E>) : has_val(other.has_val) {
+                if (has_val) {
+                    std::construct_at(std::addressof(val), std::move(other.val));
+                }
+                else {
+                    std::construct_at(std::addressof(unex), std::move(other.unex));
+                }
+            }
+
+            constexpr expected_storage& operator=(const expected_storage&) = delete;
+            constexpr expected_storage& operator=(const expected_storage&)
+                requires (trivially_copy_assignable_v<T, E>) = default;
+            constexpr expected_storage& operator=(const expected_storage& other)
+                requires (detail::assignable<T&, const T&>
+                    && detail::constructible<T, const T&>
+                    && detail::assignable<E&, const E&>
+                    && detail::constructible<E, const E&>
+                    && (detail::nothrow_constructible<T, T>
+                        || detail::nothrow_constructible<E, E>)
+                    && !trivially_copy_assignable_v<T, E>) {
+                if (has_val && other.has_val) {
+                    val = other.val;
+                }
+                else if (has_val) {
+                    reinit_expected(unex, val, other.unex);
+                }
+                else if (other.has_val) {
+                    reinit_expected(val, unex, other.val);
+                }
+                else {
+                    unex = other.unex;
+                }
+                has_val = other.has_val;
+                return *this;
+            }
+            constexpr expected_storage& operator=(expected_storage&&)
+                requires (trivially_move_assignable_v<T, E>) = default;
+            constexpr expected_storage& operator=(expected_storage&& other)
+                noexcept(detail::nothrow_constructible<T, T>
+                    && detail::nothrow_assignable<T&, T>
+                    && detail::nothrow_constructible<E, E>
+                    && detail::nothrow_assignable<E&, E>)
+                requires (detail::assignable<T&, T>
+                    && detail::constructible<T, T>
+                    && detail::assignable<E&, E>
+                    && detail::constructible<E, E>
+                    && (detail::nothrow_constructible<T, T>
+                        || detail::nothrow_constructible<E, E>)
+                    && !trivially_move_assignable_v<T, E>) {
+                if (has_val && other.has_val) {
+                    val = std::move(other.val);
+                }
+                else if (has_val) {
+                    reinit_expected(unex, val, std::move(other.unex));
+                }
+                else if (other.has_val) {
+                    reinit_expected(val, unex, std::move(other.val));
+                }
+                else {
+                    unex = std::move(other.unex);
+                }
+                has_val = other.has_val;
+                return *this;
+            }
+
+            constexpr ~expected_storage() requires (trivially_destructible_v<T, E>) = default;
+            constexpr ~expected_storage() {
+                destroy();
+            }
+
+            [[nodiscard]] constexpr bool has_value() const noexcept { return has_val; }
+            [[nodiscard]] constexpr T& value() noexcept { return val; }
+            [[nodiscard]] constexpr const T& value() const noexcept { return val; }
+            [[nodiscard]] constexpr E& error() noexcept { return unex; }
+            [[nodiscard]] constexpr const E& error() const noexcept { return unex; }
+
+            // Destroys whatever is held and constructs a value in its place; only valid when that cannot throw.
+            template<class... Args>
+            constexpr void emplace_value(Args&&... args) noexcept {
+                destroy();
+                std::construct_at(std::addressof(val), std::forward<Args>(args)...);
+                has_val = true;
+            }
+
+            constexpr void swap(expected_storage& other)
+                noexcept(detail::nothrow_constructible<T, T> && std::is_nothrow_swappable_v<T>
+                    && detail::nothrow_constructible<E, E> && std::is_nothrow_swappable_v<E>) {
+                if constexpr (is_trivially_relocatable_v<T> && is_trivially_relocatable_v<E>) {
+                    if (!std::is_constant_evaluated()) {
+                        relocation_buffer<expected_storage> temp;
+                        relocate(temp.get(), this);
+                        relocate(this, std::addressof(other));
+                        relocate(std::addressof(other), temp.get());
+                        return;
+                    }
+                }
+                using std::swap;
+                if (has_val && other.has_val) {
+                    swap(val, other.val);
+                }
+                else if (!has_val && !other.has_val) {
+                    swap(unex, other.unex);
+                }
+                else if (has_val) {
+                    swap_mixed(*this, other);
+                }
+                else {
+                    swap_mixed(other, *this);
+                }
+            }
+
+            // Assigns over a held value, or switches from the error with the strong exception guarantee.
+            template<class U>
+            constexpr void assign_value(U&& v) {
+                if (has_val) {
+                    val = std::forward<U>(v);
+                }
+                else {
+                    reinit_expected(val, unex, std::forward<U>(v));
+                    has_val = true;
+                }
+            }
+            template<class G>
+            constexpr void assign_error(G&& e) {
+                if (has_val) {
+                    reinit_expected(unex, val, std::forward<G>(e));
+                    has_val = false;
+                }
+                else {
+                    unex = std::forward<G>(e);
+                }
+            }
+
+        private:
+            // Exchanges the value of with_value and the error of with_error, keeping both intact if a move throws.
+            static constexpr void swap_mixed(expected_storage& with_value, expected_storage& with_error) {
+                if (relocate_mixed(with_value, with_error)) {
+                    return;
+                }
+                if constexpr (detail::nothrow_constructible<E, E>) {
+                    E temp(std::move(with_error.unex));
+                    std::destroy_at(std::addressof(with_error.unex));
+                    if constexpr (detail::nothrow_constructible<T, T>) {
+                        std::construct_at(std::addressof(with_error.val), std::move(with_value.val));
+                    }
+                    else {
+#if !MORI_HAS_EXCEPTIONS
+                        std::construct_at(std::addressof(with_error.val), std::move(with_value.val));
+#else
+                        try {
+                            std::construct_at(std::addressof(with_error.val), std::move(with_value.val));
+                        }
+                        catch (...) {
+                            restore_and_rethrow(with_error.unex, std::move(temp));
+                        }
+#endif
+                    }
+                    std::destroy_at(std::addressof(with_value.val));
+                    std::construct_at(std::addressof(with_value.unex), std::move(temp));
+                }
+                else {
+                    T temp(std::move(with_value.val));
+                    std::destroy_at(std::addressof(with_value.val));
+#if !MORI_HAS_EXCEPTIONS
+                    std::construct_at(std::addressof(with_value.unex), std::move(with_error.unex));
+#else
+                    try {
+                        std::construct_at(std::addressof(with_value.unex), std::move(with_error.unex));
+                    }
+                    catch (...) {
+                        restore_and_rethrow(with_value.val, std::move(temp));
+                    }
+#endif
+                    std::destroy_at(std::addressof(with_error.unex));
+                    std::construct_at(std::addressof(with_error.val), std::move(temp));
+                }
+                with_value.has_val = false;
+                with_error.has_val = true;
+            }
+
+            // swap_mixed for when one side can be relocated: it is parked in a buffer while the other side is moved
+            // across, then copied into place. Returns false when neither can, or during constant evaluation.
+            static constexpr bool relocate_mixed(expected_storage& with_value, expected_storage& with_error) {
+                if (std::is_constant_evaluated()) {
+                    return false;
+                }
+                if constexpr (is_trivially_relocatable_v<T>) {
+                    relocation_buffer<T> parked;
+                    relocate(parked.get(), std::addressof(with_value.val));
+#if !MORI_HAS_EXCEPTIONS
+                    std::construct_at(std::addressof(with_value.unex), std::move(with_error.unex));
+#else
+                    try {
+                        std::construct_at(std::addressof(with_value.unex), std::move(with_error.unex));
+                    }
+                    catch (...) {
+                        relocate_back_and_rethrow(std::addressof(with_value.val), parked.get());
+                    }
+#endif
+                    std::destroy_at(std::addressof(with_error.unex));
+                    relocate(std::addressof(with_error.val), parked.get());
+                }
+                else if constexpr (is_trivially_relocatable_v<E>) {
+                    relocation_buffer<E> parked;
+                    relocate(parked.get(), std::addressof(with_error.unex));
+#if !MORI_HAS_EXCEPTIONS
+                    std::construct_at(std::addressof(with_error.val), std::move(with_value.val));
+#else
+                    try {
+                        std::construct_at(std::addressof(with_error.val), std::move(with_value.val));
+                    }
+                    catch (...) {
+                        relocate_back_and_rethrow(std::addressof(with_error.unex), parked.get());
+                    }
+#endif
+                    std::destroy_at(std::addressof(with_value.val));
+                    relocate(std::addressof(with_value.unex), parked.get());
+                }
+                else {
+                    return false;
+                }
+                with_value.has_val = false;
+                with_error.has_val = true;
+                return true;
+            }
+
+            constexpr void destroy() noexcept {
+                if constexpr (!trivially_destructible_v<T, E>) {
+                    if (has_val) {
+                        std::destroy_at(std::addressof(val));
+                    }
+                    else {
+                        std::destroy_at(std::addressof(unex));
+                    }
+                }
+            }
+
+            union {
+                T val;
+                E unex;
+            };
+            bool has_val;
+        };
+
+        template<class T>
+        concept spare_representable = spare_representation<T>::available;
+
+        // The side that has nothing to store: void or an empty class that is free to create and copy.
+        template<class T>
+        concept stateless = std::is_empty_v<T>
+            && detail::trivially_constructible<T>
+            && std::is_trivially_copyable_v<T>;
+
+        template<class T, class E>
+        concept value_niche = spare_representable<T> && !stateless<T> && stateless<E>;
+        template<class T, class E>
+        concept error_niche = spare_representable<E> && !stateless<E> && stateless<T> && !value_niche<T, E>;
+
+        // Tagless storage for an expected where one side (Full) has a spare representation and the other (Empty)
+        // carries no state. Full holds its spare pattern whenever the expected is in the Empty state, so
+        // expected<T*, Empty> is pointer-sized and expected<void, std::error_code> is the size of an error_code.
+        // Empty is always alive; it is recreated in place whenever the expected enters its state.
+        template<class Full, class Empty, bool FullIsValue>
+        class niche_storage {
+            using spare = spare_representation<Full>;
+            using value_type = std::conditional_t<FullIsValue, Full, Empty>;
+            using error_type = std::conditional_t<FullIsValue, Empty, Full>;
+
+        public:
+            template<class... Args>
+            constexpr explicit niche_storage(std::in_place_t, Args&&... args) {
+                if constexpr (FullIsValue) {
+                    std::construct_at(std::addressof(full), std::forward<Args>(args)...);
+                }
+                else {
+                    spare::write(std::addressof(full));
+                    std::construct_at(std::addressof(empty), std::forward<Args>(args)...);
+                }
+            }
+            template<class... Args>
+            constexpr explicit niche_storage(unexpect_t, Args&&... args) {
+                if constexpr (FullIsValue) {
+                    spare::write(std::addressof(full));
+                    std::construct_at(std::addressof(empty), std::forward<Args>(args)...);
+                }
+                else {
+                    std::construct_at(std::addressof(full), std::forward<Args>(args)...);
+                }
+            }
+            template<class F, class... Args> requires (FullIsValue)
+            constexpr explicit niche_storage(invoke_value_t, F&& f, Args&&... args) :
+                full(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)) {}
+            template<class F, class... Args> requires (!FullIsValue)
+            constexpr explicit niche_storage(invoke_value_t, F&& f, Args&&... args) :
+                empty(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)) {
+                spare::write(std::addressof(full));
+            }
+            template<class F, class... Args> requires (FullIsValue)
+            constexpr explicit niche_storage(invoke_error_t, F&& f, Args&&... args) :
+                empty(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)) {
+                spare::write(std::addressof(full));
+            }
+            template<class F, class... Args> requires (!FullIsValue)
+            constexpr explicit niche_storage(invoke_error_t, F&& f, Args&&... args) :
+                full(std::invoke(std::forward<F>(f), std::forward<Args>(args)...)) {}
+
+            constexpr niche_storage(const niche_storage&) = delete;
+            constexpr niche_storage(const niche_storage&)
+                requires (detail::trivially_constructible<Full, const Full&>) = default;
+            constexpr niche_storage(const niche_storage& other)
+                requires (detail::constructible<Full, const Full&> && !detail::trivially_constructible<Full, const Full&>) :
+                empty(other.empty) {
+                if (other.full_alive()) {
+                    std::construct_at(std::addressof(full), other.full);
+                }
+                else {
+                    spare::write(std::addressof(full));
+                }
+            }
+            constexpr niche_storage(niche_storage&&)
+                requires (detail::trivially_constructible<Full, Full>) = default;
+            constexpr niche_storage(niche_storage&& other)
+                noexcept(detail::nothrow_constructible<Full, Full>)
+                requires (detail::constructible<Full, Full> && !detail::trivially_constructible<Full, Full>) :
+                empty(other.empty) {
+                if (other.full_alive()) {
+                    std::construct_at(std::addressof(full), std::move(other.full));
+                }
+                else {
+                    spare::write(std::addressof(full));
+                }
+            }
+
+            constexpr niche_storage& operator=(const niche_storage&) = delete;
+            constexpr niche_storage& operator=(const niche_storage&)
+                requires (detail::trivially_constructible<Full, const Full&>
+                    && detail::trivially_assignable<Full&, const Full&>
+                    && detail::trivially_destructible<Full>) = default;
+            constexpr niche_storage& operator=(const niche_storage& other)
+                requires (detail::constructible<Full, const Full&>
+                    && detail::assignable<Full&, const Full&>
+                    && !(detail::trivially_constructible<Full, const Full&>
+                        && detail::trivially_assignable<Full&, const Full&>
+                        && detail::trivially_destructible<Full>)) {
+                if (other.full_alive()) {
+                    assign_full(other.full);
+                }
+                else {
+                    clear_full();
+                }
+                empty = other.empty;
+                return *this;
+            }
+            constexpr niche_storage& operator=(niche_storage&&)
+                requires (detail::trivially_constructible<Full, Full>
+                    && detail::trivially_assignable<Full&, Full>
+                    && detail::trivially_destructible<Full>) = default;
+            constexpr niche_storage& operator=(niche_storage&& other)
+                noexcept(detail::nothrow_constructible<Full, Full> && detail::nothrow_assignable<Full&, Full>)
+                requires (detail::constructible<Full, Full>
+                    && detail::assignable<Full&, Full>
+                    && !(detail::trivially_constructible<Full, Full>
+                        && detail::trivially_assignable<Full&, Full>
+                        && detail::trivially_destructible<Full>)) {
+                if (other.full_alive()) {
+                    assign_full(std::move(other.full));
+                }
+                else {
+                    clear_full();
+                }
+                empty = other.empty;
+                return *this;
+            }
+
+            constexpr ~niche_storage() requires (detail::trivially_destructible<Full>) = default;
+            constexpr ~niche_storage() {
+                if (full_alive()) {
+                    std::destroy_at(std::addressof(full));
+                }
+            }
+
+            [[nodiscard]] constexpr bool has_value() const noexcept { return full_alive() == FullIsValue; }
+            [[nodiscard]] constexpr value_type& value() noexcept {
+                if constexpr (FullIsValue) {
+                    return full;
+                }
+                else {
+                    return empty;
+                }
+            }
+            [[nodiscard]] constexpr const value_type& value() const noexcept {
+                if constexpr (FullIsValue) {
+                    return full;
+                }
+                else {
+                    return empty;
+                }
+            }
+            [[nodiscard]] constexpr error_type& error() noexcept {
+                if constexpr (FullIsValue) {
+                    return empty;
+                }
+                else {
+                    return full;
+                }
+            }
+            [[nodiscard]] constexpr const error_type& error() const noexcept {
+                if constexpr (FullIsValue) {
+                    return empty;
+                }
+                else {
+                    return full;
+                }
+            }
+
+            template<class... Args>
+            constexpr void emplace_value(Args&&... args) noexcept {
+                if constexpr (FullIsValue) {
+                    if (full_alive()) {
+                        std::destroy_at(std::addressof(full));
+                    }
+                    std::construct_at(std::addressof(full), std::forward<Args>(args)...);
+                }
+                else {
+                    clear_full();
+                    std::construct_at(std::addressof(empty), std::forward<Args>(args)...);
+                }
+            }
+
+            template<class U>
+            constexpr void assign_value(U&& v) {
+                if constexpr (FullIsValue) {
+                    assign_full(std::forward<U>(v));
+                }
+                else {
+                    clear_full();
+                    std::construct_at(std::addressof(empty), std::forward<U>(v));
+                }
+            }
+            template<class G>
+            constexpr void assign_error(G&& e) {
+                if constexpr (FullIsValue) {
+                    clear_full();
+                    std::construct_at(std::addressof(empty), std::forward<G>(e));
+                }
+                else {
+                    assign_full(std::forward<G>(e));
+                }
+            }
+
+            constexpr void swap(niche_storage& other)
+                noexcept(detail::nothrow_constructible<Full, Full> && std::is_nothrow_swappable_v<Full>) {
+                if constexpr (is_trivially_relocatable_v<Full>) {
+                    if (!std::is_constant_evaluated()) {
+                        relocation_buffer<niche_storage> temp;
+                        relocate(temp.get(), this);
+                        relocate(this, std::addressof(other));
+                        relocate(std::addressof(other), temp.get());
+                        return;
+                    }
+                }
+                // Empty carries no state, so only Full needs to change hands.
+                const bool mine = full_alive();
+                const bool theirs = other.full_alive();
+                if (mine && theirs) {
+                    using std::swap;
+                    swap(full, other.full);
+                }
+                else if (mine) {
+                    other.assign_full(std::move(full));
+                    clear_full();
+                }
+                else if (theirs) {
+                    assign_full(std::move(other.full));
+                    other.clear_full();
+                }
+            }
+
+        private:
+            [[nodiscard]] constexpr bool full_alive() const noexcept { return !spare::holds(std::addressof(full)); }
+
+            // Switching out of the Empty state cannot lose anything, so the strong exception guarantee only needs
+            // the spare pattern restored if constructing Full throws partway through.
+            template<class U>
+            constexpr void assign_full(U&& v) {
+                if (full_alive()) {
+                    full = std::forward<U>(v);
+                }
+                else if constexpr (detail::nothrow_constructible<Full, U>) {
+                    std::construct_at(std::addressof(full), std::forward<U>(v));
+                }
+                else {
+#if !MORI_HAS_EXCEPTIONS
+                    std::construct_at(std::addressof(full), std::forward<U>(v));
+#else
+                    try {
+                        std::construct_at(std::addressof(full), std::forward<U>(v));
+                    }
+                    catch (...) {
+                        write_spare_and_rethrow();
+                    }
+#endif
+                }
+            }
+#if MORI_HAS_EXCEPTIONS
+            [[noreturn]] MORI_COLD void write_spare_and_rethrow() {
+                spare::write(std::addressof(full));
+                throw;
+            }
+#endif
+            constexpr void clear_full() noexcept {
+                if (full_alive()) {
+                    std::destroy_at(std::addressof(full));
+                    spare::write(std::addressof(full));
+                }
+            }
+
+            union {
+                Full full;
+            };
+            [[no_unique_address]] Empty empty{};
+        };
+
+        // A value that fits in the bytes E's spare pattern leaves free, with both sides carrying state.
+        template<class T, class E>
+        concept value_overlay = requires { spare_representation<E>::free_offset; }
+            && spare_representation<E>::template fits_beside<T>
+            && std::is_object_v<T> && !stateless<T> && !stateless<E>
+            && nothrow_constructible<T, T> && nothrow_constructible<E, E>;
+
+        // Tagless storage for an expected whose value lives inside the bytes of E that E's spare pattern does not
+        // use. With the value alive the pattern is written next to it; with the error alive, E never holds the
+        // pattern. Moves of both sides cannot throw, so switching sides only needs the new contents built aside
+        // first when building them can throw.
+        template<class T, class E>
+        class overlay_storage {
+            using spare = spare_representation<E>;
+
+        public:
+            template<class... Args>
+            explicit overlay_storage(std::in_place_t, Args&&... args) {
+                ::new (static_cast<void*>(bytes + spare::free_offset)) T(std::forward<Args>(args)...);
+                spare::mark(bytes);
+            }
+            template<class... Args>
+            explicit overlay_storage(unexpect_t, Args&&... args) {
+                ::new (static_cast<void*>(bytes)) E(std::forward<Args>(args)...);
+            }
+            template<class F, class... Args>
+            explicit overlay_storage(invoke_value_t, F&& f, Args&&... args) {
+                ::new (static_cast<void*>(bytes + spare::free_offset))
+                    T(std::invoke(std::forward<F>(f), std::forward<Args>(args)...));
+                spare::mark(bytes);
+            }
+            template<class F, class... Args>
+            explicit overlay_storage(invoke_error_t, F&& f, Args&&... args) {
+                ::new (static_cast<void*>(bytes)) E(std::invoke(std::forward<F>(f), std::forward<Args>(args)...));
+            }
+
+            // Copying the bytes copies whichever side is alive, along with the pattern.
+            overlay_storage(const overlay_storage&) = delete;
+            overlay_storage(const overlay_storage&) requires (trivially_copy_constructible_v<T, E>) = default;
+            overlay_storage(const overlay_storage& other)
+                requires (constructible<T, const T&> && constructible<E, const E&>
+                    && !trivially_copy_constructible_v<T, E>) {
+                if (other.has_value()) {
+                    std::construct_at(value_address(), other.value());
+                    spare::mark(bytes);
+                }
+                else {
+                    std::construct_at(error_address(), other.error());
+                }
+            }
+            overlay_storage(overlay_storage&&) requires (trivially_move_constructible_v<T, E>) = default;
+            overlay_storage(overlay_storage&& other) noexcept requires (!trivially_move_constructible_v<T, E>) {
+                if (other.has_value()) {
+                    std::construct_at(value_address(), std::move(other.value()));
+                    spare::mark(bytes);
+                }
+                else {
+                    std::construct_at(error_address(), std::move(other.error()));
+                }
+            }
+
+            overlay_storage& operator=(const overlay_storage&) = delete;
+            overlay_storage& operator=(const overlay_storage&) requires (trivially_copy_assignable_v<T, E>) = default;
+            overlay_storage& operator=(const overlay_storage& other)
+                requires (constructible<T, const T&> && assignable<T&, const T&>
+                    && constructible<E, const E&> && assignable<E&, const E&>
+                    && !trivially_copy_assignable_v<T, E>) {
+                if (other.has_value()) {
+                    assign_value(other.value());
+                }
+                else {
+                    assign_error(other.error());
+                }
+                return *this;
+            }
+            overlay_storage& operator=(overlay_storage&&) requires (trivially_move_assignable_v<T, E>) = default;
+            overlay_storage& operator=(overlay_storage&& other)
+                noexcept(nothrow_assignable<T&, T> && nothrow_assignable<E&, E>)
+                requires (assignable<T&, T> && assignable<E&, E> && !trivially_move_assignable_v<T, E>) {
+                if (other.has_value()) {
+                    assign_value(std::move(other.value()));
+                }
+                else {
+                    assign_error(std::move(other.error()));
+                }
+                return *this;
+            }
+
+            ~overlay_storage() requires (trivially_destructible_v<T, E>) = default;
+            ~overlay_storage() { destroy(); }
+
+            [[nodiscard]] bool has_value() const noexcept { return spare::marked(bytes); }
+            [[nodiscard]] T& value() noexcept { return *value_address(); }
+            [[nodiscard]] const T& value() const noexcept {
+                return *std::launder(reinterpret_cast<const T*>(bytes + spare::free_offset));
+            }
+            [[nodiscard]] E& error() noexcept { return *error_address(); }
+            [[nodiscard]] const E& error() const noexcept { return *std::launder(reinterpret_cast<const E*>(bytes)); }
+
+            template<class... Args>
+            void emplace_value(Args&&... args) noexcept {
+                destroy();
+                ::new (static_cast<void*>(bytes + spare::free_offset)) T(std::forward<Args>(args)...);
+                spare::mark(bytes);
+            }
+
+            template<class U>
+            void assign_value(U&& v) {
+                if (has_value()) {
+                    value() = std::forward<U>(v);
+                }
+                else if constexpr (nothrow_constructible<T, U>) {
+                    emplace_value(std::forward<U>(v));
+                }
+                else {
+                    T temp(std::forward<U>(v));
+                    emplace_value(std::move(temp));
+                }
+            }
+            template<class G>
+            void assign_error(G&& e) {
+                if (!has_value()) {
+                    error() = std::forward<G>(e);
+                }
+                else if constexpr (nothrow_constructible<E, G>) {
+                    emplace_error(std::forward<G>(e));
+                }
+                else {
+                    E temp(std::forward<G>(e));
+                    emplace_error(std::move(temp));
+                }
+            }
+
+            void swap(overlay_storage& other)
+                noexcept(std::is_nothrow_swappable_v<T> && std::is_nothrow_swappable_v<E>) {
+                if constexpr (is_trivially_relocatable_v<T> && is_trivially_relocatable_v<E>) {
+                    std::swap(bytes, other.bytes);
+                }
+                else if (has_value() && other.has_value()) {
+                    using std::swap;
+                    swap(value(), other.value());
+                }
+                else if (!has_value() && !other.has_value()) {
+                    using std::swap;
+                    swap(error(), other.error());
+                }
+                else {
+                    overlay_storage& with_value = has_value() ? *this : other;
+                    overlay_storage& with_error = has_value() ? other : *this;
+                    T parked(std::move(with_value.value()));
+                    with_value.emplace_error(std::move(with_error.error()));
+                    with_error.emplace_value(std::move(parked));
+                }
+            }
 
-    namespace detail {
-        template<class T>
-        constexpr bool is_unexpected_v = false;
-        template<class E>
-        constexpr bool is_unexpected_v<unexpected<E>> = true;
+        private:
+            [[nodiscard]] T* value_address() noexcept {
+                return std::launder(reinterpret_cast<T*>(bytes + spare::free_offset));
+            }
+            [[nodiscard]] E* error_address() noexcept { return std::launder(reinterpret_cast<E*>(bytes)); }
 
-        template<std::size_t Index, class T, class E, class... Args>
-        constexpr void reinit_expected(std::variant<T, E>& variant, Args&&... args)
-            noexcept(std::is_nothrow_constructible_v<std::variant_alternative_t<Index, std::variant<T, E>>, Args...>) {
-            using NewType = std::variant_alternative_t<Index, std::variant<T, E>>;
-            constexpr auto OldIndex = (Index == 0) ? std::size_t{1} : std::size_t{0};
-            using OldType = std::variant_alternative_t<OldIndex, std::variant<T, E>>;
-            if constexpr (std::is_nothrow_constructible_v<NewType, Args...>) {
-                //std::destroy_at(std::addressof(old_val));
-                //std::construct_at(std::addressof(new_val), std::forward<Args>(args)...);
-                variant.template emplace<Index>(std::forward<Args>(args)...);
-            }
-            else if constexpr (std::is_nothrow_move_constructible_v<NewType>) {
-                NewType temp(std::forward<Args>(args)...);
-                //std::destroy_at(std::addressof(old_val));
-                //std::construct_at(std::addressof(new_val), std::move(temp));
-                variant.template emplace<Index>(std::move(temp));
+            template<class... Args>
+            void emplace_error(Args&&... args) noexcept {
+                destroy();
+                ::new (static_cast<void*>(bytes)) E(std::forward<Args>(args)...);
             }
-            else {
-                OldType temp(std::move(variant.get<OldIndex));
-                //std::destroy_at(std::addressof(old_val));
-                try {
-                    //std::construct_at(std::addressof(new_val), std::forward<Args>(args)...);
-                    variant.template emplace<Index>(std::forward<Args>(args)...);
-                }
-                catch (...) {
-                    //std::construct_at(std::addressof(old_val), std::move(temp));
-                    variant.template emplace<OldIndex>(std::move(temp));
-                    throw;
+            void destroy() noexcept {
+                if constexpr (!trivially_destructible_v<T, E>) {
+                    if (has_value()) {
+                        std::destroy_at(value_address());
+                    }
+                    else {
+                        std::destroy_at(error_address());
+                    }
                 }
             }
-        }
+
+            alignas(E) std::byte bytes[sizeof(E)];
+        };
+
+        template<class T, class E> requires (value_niche<T, E>)
+        class expected_storage<T, E> : public niche_storage<T, E, true> {
+        public:
+            using niche_storage<T, E, true>::niche_storage;
+        };
+
+        template<class T, class E> requires (error_niche<T, E>)
+        class expected_storage<T, E> : public niche_storage<E, T, false> {
+        public:
+            using niche_storage<E, T, false>::niche_storage;
+        };
+
+        template<class T, class E> requires (value_overlay<T, E>)
+        class expected_storage<T, E> : public overlay_storage<T, E> {
+        public:
+            using overlay_storage<T, E>::overlay_storage;
+        };
     }
 
     template<class T, class E>
@@ -128,252 +1430,381 @@ namespace mori {
         template<class U>
         using rebind = expected<U, error_type>;
 
-        constexpr expected() requires (std::is_default_constructible_v<T>) = default;
-        constexpr expected(const expected&) = delete;
-        constexpr expected(const expected&)
-            requires (std::is_copy_constructible_v<T> && std::is_copy_constructible_v<E>) = default;
-        constexpr expected(expected&&)
-            noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_constructible_v<E>)
-            requires (std::is_move_constructible_v<T> && std::is_move_constructible_v<E>) = default;
+        constexpr expected() requires (detail::constructible<T>) : impl(std::in_place) {}
+        constexpr expected(const expected&) = default;
+        constexpr expected(expected&&) = default;
         template<class U, class G>
-        requires (std::is_constructible_v<T, std::add_lvalue_reference_t<const U>
-            && std::is_constructible_v<E, const G&>
-            && (std::is_same_v<std:remove_cv_t<T>, bool>
-                || (!std::is_constructible_v<T, expected<U, G>&>
-                    && !std::is_constructible_v<T, expected<U, G>>
-                    && !std::is_constructible_v<T, const expected<U, G>&>
-                    && !std::is_constructible_v<T, const expected<U, G>
-                    && !std::is_convertible_v<expected<U, G>&, T>
-                    && !std::is_convertible_v<expected<U, G>, T>
-                    && !std::is_convertible_v<const expected<U, G>&, T>
-                    && !std::is_convertible_v<const expected<U, G>, T>))
-            && !std::is_constructible_v<unexpected<E>, expected<U, G>&>
-            && !std::is_constructible_v<unexpected<E>, expected<U, G>
-            && !std::is_constructible_v<unexpected<E>, const expected<U, G>&
-            && !std::is_constructible_v<unexpected<E>, const expected<U, G>)
-        constexpr explicit(!std::is_convertible_v<std::add_lvalue_reference_t<const U>, T> || !std::is_convertible_v<const G&, E>)
+        requires (detail::constructible<T, std::add_lvalue_reference_t<const U>>
+            && detail::constructible<E, const G&>
+            && (std::is_same_v<std::remove_cv_t<T>, bool>
+                || !detail::converts_from_expected<T, U, G>)
+            && !detail::constructible_from_expected<unexpected<E>, U, G>)
+        constexpr explicit(!detail::convertible<std::add_lvalue_reference_t<const U>, T> || !detail::convertible<const G&, E>)
             expected(const expected<U, G>& other) : impl(other.has_value()
-                ? std::variant<T, E>(std::in_place_index<0>, std::forward<std::add_lvalue_reference_t<const U>>(*other))
-                : std::variant<T, E>(std::in_place_index<1>, std::forward<const G&>(other.error()))) {}
+                ? impl_type(std::in_place, std::forward<std::add_lvalue_reference_t<const U>>(*other))
+                : impl_type(unexpect, std::forward<const G&>(other.error()))) {}
         template<class U, class G>
-        requires (std::is_constructible_v<T, U>
-            && std::is_constructible_v<E, G>
-            && (std::is_same_v<std:remove_cv_t<T>, bool>
-                || (!std::is_constructible_v<T, expected<U, G>&>
-                    && !std::is_constructible_v<T, expected<U, G>>
-                    && !std::is_constructible_v<T, const expected<U, G>&>
-                    && !std::is_constructible_v<T, const expected<U, G>
-                    && !std::is_convertible_v<expected<U, G>&, T>
-                    && !std::is_convertible_v<expected<U, G>, T>
-                    && !std::is_convertible_v<const expected<U, G>&, T>
-                    && !std::is_convertible_v<const expected<U, G>, T>))
-            && !std::is_constructible_v<unexpected<E>, expected<U, G>&>
-            && !std::is_constructible_v<unexpected<E>, expected<U, G>
-            && !std::is_constructible_v<unexpected<E>, const expected<U, G>&
-            && !std::is_constructible_v<unexpected<E>, const expected<U, G>)
-        constexpr explicit(!std::is_convertible_v<U, T> || !std::is_convertible_v<G, E>)
+        requires (detail::constructible<T, U>
+            && detail::constructible<E, G>
+            && (std::is_same_v<std::remove_cv_t<T>, bool>
+                || !detail::converts_from_expected<T, U, G>)
+            && !detail::constructible_from_expected<unexpected<E>, U, G>)
+        constexpr explicit(!detail::convertible<U, T> || !detail::convertible<G, E>)
             expected(expected<U, G>&& other) : impl(other.has_value()
-                ? std::variant<T, E>(std::in_place_index<0>, std::forward<U>(*other))
-                : std::variant<T, E>(std::in_place_index<1>, std::forward<G>(other.error()))) {}
+                ? impl_type(std::in_place, std::forward<U>(*other))
+                : impl_type(unexpect, std::forward<G>(other.error()))) {}
         template<class U = T>
         requires (!std::is_same_v<std::remove_cvref_t<U>, std::in_place_t>
             && !std::is_same_v<expected, std::remove_cvref_t<U>>
-            && std::is_constructible_v<T, U>
+            && detail::constructible<T, U>
             && !detail::is_unexpected_v<std::remove_cvref_t<U>>
-            && (!std::is_same_v<std::remove_cv_t<T>, bool> || !detail::is_unexpected_v<std::remove_cvref_t<U>>))
-        constexpr explicit(!std::is_convertible_v<U, T>) expected(U&& v) : impl(std::in_place_index<0>, std::forward<U>(v)) {}
+            && (!std::is_same_v<std::remove_cv_t<T>, bool> || !detail::is_expected_v<std::remove_cvref_t<U>>))
+        constexpr explicit(!detail::convertible<U, T>) expected(U&& v MORI_CALLER_LOCATION) : impl(std::in_place, std::forward<U>(v)) {
+            MORI_COUNT_VALUE(caller);
+        }
         template<class G>
-        requires (std::is_constructible_v<E, const G&>)
-        constexpr explicit(!std::is_convertible_v<const G&, E>) expected(const unexpected<G>& e) : impl(std::in_place_index<1>, std::forward<const G&>(e.error())) {}
+        requires (detail::constructible<E, const G&>)
+        constexpr explicit(!detail::convertible<const G&, E>) expected(const unexpected<G>& e) : impl(unexpect, std::forward<const G&>(e.error())) {}
         template<class G>
-        requires (std::is_constructible_v<E, G>)
-        constexpr explicit(!std::is_convertible_v<G, E>) expected(unexpected<G>&& e) : impl(std::in_place_index<1>, std::forward<G>(e.error())) {}
+        requires (detail::constructible<E, G>)
+        constexpr explicit(!detail::convertible<G, E>) expected(unexpected<G>&& e) : impl(unexpect, std::forward<G>(e.error())) {}
         template<class... Args>
-        requires (std::is_constructible_v<T, Args...)
-        constexpr explicit expected(std::in_place_t, Args&&... args) : impl(std::in_place_index<0>, std::forward<Args>(args)...) {}
+        requires (detail::constructible<T, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::in_place_arg tag, Args&&... args) :
+            impl(std::in_place, std::forward<Args>(args)...) {
+            MORI_COUNT_VALUE(tag.where);
+        }
         template<class U, class... Args>
-        requires (std::is_constructible_v<T, std::initializer_list<U>&, Args...)
-        constexpr explicit expected(std::in_place_t, std::initializer_list<U> il, Args&&... args) : impl(std::in_place_index<0>, il, std::forward<Args>(args)...) {}
+        requires (detail::constructible<T, std::initializer_list<U>&, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::in_place_arg tag, std::initializer_list<U> il, Args&&... args) :
+            impl(std::in_place, il, std::forward<Args>(args)...) {
+            MORI_COUNT_VALUE(tag.where);
+        }
         template<class... Args>
-        requires (std::is_constructible_v<E, Args...)
-        constexpr explicit expected(unexpect_t, Args&&... args) : impl(std::in_place_index<1>, std::forward<Args>(args)...) {}
+        requires (detail::constructible<E, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_arg tag, Args&&... args) :
+            impl(unexpect, std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
         template<class U, class... Args>
-        requires (std::is_constructible_v<E, std::initializer_list<U>&, Args...)
-        constexpr explicit expected(unexpect_t, std::initializer_list<U> il, Args&&... args) : impl(std::in_place_index<1>, il, std::forward<Args>(args)...) {}
-        constexpr expected& operator=(const expected& other) = delete;
-        constexpr expected& operator=(const expected& other)
-            requires (std::is_copy_assignable_v<T>
-                && std::is_copy_constructible_v<T>
-                && std::is_copy_assignable_v<E>
-                && std::is_copy_constructible_v<E>
-                && (std::is_nothrow_move_constructible_v<T>
-                    || std::is_nothrow_move_constructible_v<E>)) {
-            if (this != &other) {
-                if (has_value() == other.has_value()) {
-                    impl = other.impl;
-                }
-                else if (other.has_value()) {
-                    detail::reinit_expected<0>(impl, *other);
-                }
-                else {
-                    detail::reinit_expected<1>(impl, other.error());
-                }
-            }
-            return *this;
+        requires (detail::constructible<E, std::initializer_list<U>&, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_arg tag, std::initializer_list<U> il, Args&&... args) :
+            impl(unexpect, il, std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
         }
-        constexpr expected& operator=(expected&& other)
-            requires (std::is_move_assignable_v<T>
-                && std::is_move_constructible_v<T>
-                && std::is_move_assignable_v<E>
-                && std::is_move_constructible_v<E>
-                && (std::is_nothrow_move_constructible_v<T>
-                    || std::is_nothrow_move_constructible_v<E>))
-            noexcept(std::is_nothrow_move_constructible_v<T>
-                && std::is_nothrow_move_assignable_v<T>
-                && std::is_nothrow_move_constructible_v<E>
-                && std::is_nothrow_move_assignable_v<E>) {
-            if (this != &other) {
-                if (has_value() == other.has_value()) {
-                    impl = std::move(other.impl);
-                }
-                else if (other.has_value()) {
-                    detail::reinit_expected<0>(impl, std::move(*other));
-                }
-                else {
-                    detail::reinit_expected<1>(impl, std::move(other.error()));
-                }
-            }
-            return *this;
+        template<class F, class... Args>
+        requires (detail::constructible_from_invoke<T, F, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::in_place_from_arg tag, F&& f, Args&&... args) :
+            impl(detail::invoke_value, std::forward<F>(f), std::forward<Args>(args)...) {
+            MORI_COUNT_VALUE(tag.where);
         }
+        template<class F, class... Args>
+        requires (detail::constructible_from_invoke<E, F, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_from_arg tag, F&& f, Args&&... args) :
+            impl(detail::invoke_error, std::forward<F>(f), std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
+        constexpr expected& operator=(const expected& other) = default;
+        constexpr expected& operator=(expected&& other) = default;
         template<class U = T>
         requires (!std::is_same_v<expected, std::remove_cvref_t<U>>
             && !detail::is_unexpected_v<std::remove_cvref_t<U>>
-            && std::is_constructible_v<T, U>
-            && std::is_assignable_v<T&, U>
-            && (std::is_nothrow_constructible_v<T, U>
-                || std::is_nothrow_move_constructible_v<T>
-                || std::is_nothrow_move_constructible_v<E>))
+            && detail::constructible<T, U>
+            && detail::assignable<T&, U>
+            && (detail::nothrow_constructible<T, U>
+                || detail::nothrow_constructible<T, T>
+                || detail::nothrow_constructible<E, E>))
         constexpr expected& operator=(U&& v) {
-            if (has_value()) {
-                **this = std::forward<U>(v);
-            }
-            else {
-                detail::reinit_expected<0>(impl, std::forward<U>(v));
-            }
+            impl.assign_value(std::forward<U>(v));
+            return *this;
         }
         template<class G>
-        requires (std::is_constructible_v<E, const G&>
-            && std::is_assignable_v<E&, const G&>
-            && (std::is_nothrow_constructible_v<E, const G&>
-                || std::is_nothrow_move_constructible_v<T> 
-                || std::is_nothrow_move_constructible_v<E>))
+        requires (detail::constructible<E, const G&>
+            && detail::assignable<E&, const G&>
+            && (detail::nothrow_constructible<E, const G&>
+                || detail::nothrow_constructible<T, T>
+                || detail::nothrow_constructible<E, E>))
         constexpr expected& operator=(const unexpected<G>& e) {
-            if (has_value()) {
-                detail::reinit_expected<1>(impl, std::forward<const G&>(e.error()));
-            }
-            else {
-                error() = std::forward<const G&>(e.error());
-            }
+            impl.assign_error(std::forward<const G&>(e.error()));
+            return *this;
         }
         template<class G>
-        requires (std::is_constructible_v<E, G>
-            && std::is_assignable_v<E&, G>
-            && (std::is_nothrow_constructible_v<E, G>
-                || std::is_nothrow_move_constructible_v<T> 
-                || std::is_nothrow_move_constructible_v<E>))
+        requires (detail::constructible<E, G>
+            && detail::assignable<E&, G>
+            && (detail::nothrow_constructible<E, G>
+                || detail::nothrow_constructible<T, T>
+                || detail::nothrow_constructible<E, E>))
         constexpr expected& operator=(unexpected<G>&& e) {
-            if (has_value()) {
-                detail::reinit_expected<1>(impl, std::forward<G>(e.error()));
-            }
-            else {
-                error() = std::forward<G>(e.error());
-            }
+            impl.assign_error(std::forward<G>(e.error()));
+            return *this;
         }
         constexpr ~expected() = default;
 
         template<class... Args>
-        requires (std::is_nothrow_constructible_v<T, Args...>)
+        requires (detail::nothrow_constructible<T, Args...>)
         constexpr T& emplace(Args&&... args) noexcept {
-            impl.template emplace<0>(std::forward<Args>(args)...);
+            impl.emplace_value(std::forward<Args>(args)...);
             return **this;
         }
         template<class U, class... Args>
-        requires (std::is_nothrow_constructible_v<T, std::initializer_list<U>&, Args...>)
+        requires (detail::nothrow_constructible<T, std::initializer_list<U>&, Args...>)
         constexpr T& emplace(std::initializer_list<U> il, Args&&... args) noexcept {
-            impl.template emplace<0>(il, std::forward<Args>(args)...);
+            impl.emplace_value(il, std::forward<Args>(args)...);
+            return **this;
+        }
+        // Beyond std::expected: constructors that can throw are allowed too, and a throw leaves the expected as it
+        // was (see reconstruct).
+        template<class... Args>
+        requires (detail::constructible<T, Args...> && !detail::nothrow_constructible<T, Args...>
+            && detail::reconstructible<T, E>)
+        constexpr T& emplace(Args&&... args) {
+            reconstruct<false>(std::in_place, std::forward<Args>(args)...);
             return **this;
         }
+        template<class U, class... Args>
+        requires (detail::constructible<T, std::initializer_list<U>&, Args...>
+            && !detail::nothrow_constructible<T, std::initializer_list<U>&, Args...>
+            && detail::reconstructible<T, E>)
+        constexpr T& emplace(std::initializer_list<U> il, Args&&... args) {
+            reconstruct<false>(std::in_place, il, std::forward<Args>(args)...);
+            return **this;
+        }
+        // Replaces whatever is held with a value initialized from the result of invoking f with args. A T returned by
+        // value is constructed in place, with no move; if f throws, the expected keeps what it held.
+        template<class F, class... Args>
+        requires (detail::constructible_from_invoke<T, F, Args...>
+            && (detail::nothrow_constructible_from_invoke<T, F, Args...> || detail::reconstructible<T, E>))
+        constexpr T& emplace_with(F&& f, Args&&... args)
+            noexcept(detail::nothrow_constructible_from_invoke<T, F, Args...>) {
+            reconstruct<detail::nothrow_constructible_from_invoke<T, F, Args...>>(detail::invoke_value,
+                std::forward<F>(f), std::forward<Args>(args)...);
+            return **this;
+        }
+
+        constexpr void swap(expected& other) noexcept(detail::nothrow_constructible<T, T>
+            && std::is_nothrow_swappable_v<T>
+            && detail::nothrow_constructible<E, E>
+            && std::is_nothrow_swappable_v<E>) {
+            impl.swap(other.impl);
+        }
+        friend constexpr void swap(expected& x, expected& y) noexcept(noexcept(x.swap(y))) { x.swap(y); }
 
-        constexpr void swap(expected& other) noexcept();
-        friend constexpr void swap(expected& x, expected& y) noexcept();
-
-        [[nodiscard]] constexpr const T* operator->() const noexcept;
-        [[nodiscard]] constexpr T* operator->() noexcept;
-        [[nodiscard]] constexpr const T& operator*() const & noexcept;
-        [[nodiscard]] constexpr T& operator*() & noexcept;
-        [[nodiscard]] constexpr const T&& operator*() const && noexcept;
-        [[nodiscard]] constexpr T&& operator*() && noexcept;
-        [[nodiscard]] constexpr explicit operator bool() const noexcept;
-        [[nodiscard]] constexpr bool has_value() const noexcept;
-        [[nodiscard]] constexpr const T& value() const &;
-        [[nodiscard]] constexpr T& value() &;
-        [[nodiscard]] constexpr const T&& value() const &&;
-        [[nodiscard]] constexpr T&& value() &&;
-        [[nodiscard]] constexpr const E& error() const &;
-        [[nodiscard]] constexpr E& error() &;
-        [[nodiscard]] constexpr const E&& error() const &&;
-        [[nodiscard]] constexpr E&& error() &&;
+        [[nodiscard]] constexpr const T* operator->() const noexcept { return std::addressof(impl.value()); }
+        [[nodiscard]] constexpr T* operator->() noexcept { return std::addressof(impl.value()); }
+        [[nodiscard]] constexpr const T& operator*() const & noexcept { return impl.value(); }
+        [[nodiscard]] constexpr T& operator*() & noexcept { return impl.value(); }
+        [[nodiscard]] constexpr const T&& operator*() const && noexcept { return std::move(impl.value()); }
+        [[nodiscard]] constexpr T&& operator*() && noexcept { return std::move(impl.value()); }
+        [[nodiscard]] constexpr explicit operator bool() const noexcept { return impl.has_value(); }
+        [[nodiscard]] constexpr bool has_value() const noexcept { return impl.has_value(); }
+        [[nodiscard]] constexpr const T& value() const & {
+            if (!has_value()) {
+                detail::throw_bad_expected_access(std::as_const(error()));
+            }
+            return impl.value();
+        }
+        [[nodiscard]] constexpr T& value() & {
+            if (!has_value()) {
+                detail::throw_bad_expected_access(std::as_const(error()));
+            }
+            return impl.value();
+        }
+        [[nodiscard]] constexpr const T&& value() const && {
+            if (!has_value()) {
+                detail::throw_bad_expected_access(std::move(error()));
+            }
+            return std::move(impl.value());
+        }
+        [[nodiscard]] constexpr T&& value() && {
+            if (!has_value()) {
+                detail::throw_bad_expected_access(std::move(error()));
+            }
+            return std::move(impl.value());
+        }
+        [[nodiscard]] constexpr const E& error() const & noexcept { return impl.error(); }
+        [[nodiscard]] constexpr E& error() & noexcept { return impl.error(); }
+        [[nodiscard]] constexpr const E&& error() const && noexcept { return std::move(impl.error()); }
+        [[nodiscard]] constexpr E&& error() && noexcept { return std::move(impl.error()); }
         template<class U>
-        [[nodiscard]] constexpr T value_or(U&& v) const &;
+        [[nodiscard]] constexpr T value_or(U&& v) const & {
+            return has_value() ? **this : static_cast<T>(std::forward<U>(v));
+        }
         template<class U>
-        [[nodiscard]] constexpr T value_or(U&& v) &&;
+        [[nodiscard]] constexpr T value_or(U&& v) && {
+            return has_value() ? std::move(**this) : static_cast<T>(std::forward<U>(v));
+        }
         template<class G = E>
-        [[nodiscard]] constexpr E error_or(G&& e) const &;
+        [[nodiscard]] constexpr E error_or(G&& e) const & {
+            return has_value() ? std::forward<G>(e) : error();
+        }
         template<class G = E>
-        [[nodiscard]] constexpr E error_or(G&& e) &&;
+        [[nodiscard]] constexpr E error_or(G&& e) && {
+            return has_value() ? std::forward<G>(e) : std::move(error());
+        }
 
         template<class F>
-        [[nodiscard]] constexpr auto and_then(F&& f) &;
+        requires (detail::constructible<E, E&>)
+        [[nodiscard]] constexpr auto and_then(F&& f) & { return and_then_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto and_then(F&& f) &&;
+        requires (detail::constructible<E, E>)
+        [[nodiscard]] constexpr auto and_then(F&& f) && { return and_then_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto and_then(F&& f) const &;
+        requires (detail::constructible<E, const E&>)
+        [[nodiscard]] constexpr auto and_then(F&& f) const & { return and_then_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto and_then(F&& f) const &&;
+        requires (detail::constructible<E, const E>)
+        [[nodiscard]] constexpr auto and_then(F&& f) const && { return and_then_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto or_else(F&& f) &;
+        requires (detail::constructible<T, T&>)
+        [[nodiscard]] constexpr auto or_else(F&& f) & { return or_else_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto or_else(F&& f) &&;
+        requires (detail::constructible<T, T>)
+        [[nodiscard]] constexpr auto or_else(F&& f) && { return or_else_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto or_else(F&& f) const &;
+        requires (detail::constructible<T, const T&>)
+        [[nodiscard]] constexpr auto or_else(F&& f) const & { return or_else_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto or_else(F&& f) const &&;
+        requires (detail::constructible<T, const T>)
+        [[nodiscard]] constexpr auto or_else(F&& f) const && { return or_else_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform(F&& f) &;
+        requires (detail::constructible<E, E&>)
+        [[nodiscard]] constexpr auto transform(F&& f) & { return transform_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform(F&& f) &&;
+        requires (detail::constructible<E, E>)
+        [[nodiscard]] constexpr auto transform(F&& f) && { return transform_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform(F&& f) const &;
+        requires (detail::constructible<E, const E&>)
+        [[nodiscard]] constexpr auto transform(F&& f) const & { return transform_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform(F&& f) const &&;
+        requires (detail::constructible<E, const E>)
+        [[nodiscard]] constexpr auto transform(F&& f) const && { return transform_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform_error(F&& f) &;
+        requires (detail::constructible<T, T&>)
+        [[nodiscard]] constexpr auto transform_error(F&& f) & { return transform_error_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform_error(F&& f) &&;
+        requires (detail::constructible<T, T>)
+        [[nodiscard]] constexpr auto transform_error(F&& f) && { return transform_error_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform_error(F&& f) const &;
+        requires (detail::constructible<T, const T&>)
+        [[nodiscard]] constexpr auto transform_error(F&& f) const & { return transform_error_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform_error(F&& f) const &&;
+        requires (detail::constructible<T, const T>)
+        [[nodiscard]] constexpr auto transform_error(F&& f) const && { return transform_error_impl(std::move(*this), std::forward<F>(f)); }
 
         template<class T2, class E2> requires (!std::is_void_v<T2>)
-        [[nodiscard]] friend constexpr bool operator==(const expected& x, const expected<T2, E2>& y);
-        template<class T2>
-        [[nodiscard]] friend constexpr bool operator==(const expected& x, const T2& y);
+        [[nodiscard]] friend constexpr bool operator==(const expected& x, const expected<T2, E2>& y) {
+            if (x.has_value() != y.has_value()) {
+                return false;
+            }
+            return x.has_value() ? *x == *y : x.error() == y.error();
+        }
+        template<class T2> requires (!detail::is_expected_v<T2>)
+        [[nodiscard]] friend constexpr bool operator==(const expected& x, const T2& y) {
+            return x.has_value() && static_cast<bool>(*x == y);
+        }
         template<class E2>
-        [[nodiscard]] friend constexpr bool operator==(const expected& x, const unexpected<E2>& y);
+        [[nodiscard]] friend constexpr bool operator==(const expected& x, const unexpected<E2>& y) {
+            return !x.has_value() && static_cast<bool>(x.error() == y.error());
+        }
 
     private:
-        std::variant<T, E> impl;
+        using impl_type = detail::expected_storage<T, E>;
+
+        template<class, class>
+        friend class expected;
+        template<class, class...>
+        friend class pipeline;
+
+        template<class F, class... Args>
+        constexpr explicit expected(detail::invoke_value_t tag, F&& f, Args&&... args) :
+            impl(tag, std::forward<F>(f), std::forward<Args>(args)...) {}
+        template<class F, class... Args>
+        constexpr explicit expected(detail::invoke_error_t tag, F&& f, Args&&... args) :
+            impl(tag, std::forward<F>(f), std::forward<Args>(args)...) {}
+
+        // Destroys the storage and constructs it again from args, which is how a prvalue result ends up in place.
+        // When that can throw, the old contents are relocated (or, failing that, moved) aside first and put back if
+        // it does, so a failed replacement leaves the expected unchanged.
+        template<bool Nothrow, class... Args>
+        constexpr void reconstruct(Args&&... args) noexcept(Nothrow) {
+#if MORI_HAS_EXCEPTIONS
+            if constexpr (!Nothrow) {
+                if (!std::is_constant_evaluated()) {
+                    if constexpr (is_trivially_relocatable_v<expected>) {
+                        detail::relocation_buffer<impl_type> saved;
+                        detail::relocate(saved.get(), std::addressof(impl));
+                        try {
+                            std::construct_at(std::addressof(impl), std::forward<Args>(args)...);
+                        }
+                        catch (...) {
+                            detail::relocate_back_and_rethrow(std::addressof(impl), saved.get());
+                        }
+                        std::destroy_at(saved.get());
+                    }
+                    else {
+                        impl_type saved(std::move(impl));
+                        std::destroy_at(std::addressof(impl));
+                        try {
+                            std::construct_at(std::addressof(impl), std::forward<Args>(args)...);
+                        }
+                        catch (...) {
+                            detail::restore_and_rethrow(impl, std::move(saved));
+                        }
+                    }
+                    return;
+                }
+            }
+#endif
+            std::destroy_at(std::addressof(impl));
+            std::construct_at(std::addressof(impl), std::forward<Args>(args)...);
+        }
+
+        template<class Self, class F>
+        static constexpr auto and_then_impl(Self&& self, F&& f) {
+            using U = std::remove_cvref_t<std::invoke_result_t<F, decltype(*std::forward<Self>(self))>>;
+            static_assert(detail::is_expected_v<U>, "and_then requires a function returning an expected");
+            static_assert(std::is_same_v<typename U::error_type, E>, "and_then cannot change the error_type");
+            if (self.has_value()) {
+                return std::invoke(std::forward<F>(f), *std::forward<Self>(self));
+            }
+            return U(unexpect, std::forward<Self>(self).error());
+        }
+        template<class Self, class F>
+        static constexpr auto or_else_impl(Self&& self, F&& f) {
+            using G = std::remove_cvref_t<std::invoke_result_t<F, decltype(std::forward<Self>(self).error())>>;
+            static_assert(detail::is_expected_v<G>, "or_else requires a function returning an expected");
+            static_assert(std::is_same_v<typename G::value_type, T>, "or_else cannot change the value_type");
+            if (self.has_value()) {
+                return G(std::in_place, *std::forward<Self>(self));
+            }
+            return std::invoke(std::forward<F>(f), std::forward<Self>(self).error());
+        }
+        template<class Self, class F>
+        static constexpr auto transform_impl(Self&& self, F&& f) {
+            using U = std::remove_cvref_t<std::invoke_result_t<F, decltype(*std::forward<Self>(self))>>;
+            using Result = expected<U, E>;
+            if (!self.has_value()) {
+                return Result(unexpect, std::forward<Self>(self).error());
+            }
+            if constexpr (std::is_void_v<U>) {
+                std::invoke(std::forward<F>(f), *std::forward<Self>(self));
+                return Result();
+            }
+            else {
+                return Result(detail::invoke_value, std::forward<F>(f), *std::forward<Self>(self));
+            }
+        }
+        template<class Self, class F>
+        static constexpr auto transform_error_impl(Self&& self, F&& f) {
+            using G = std::remove_cv_t<std::invoke_result_t<F, decltype(std::forward<Self>(self).error())>>;
+            using Result = expected<T, G>;
+            if (self.has_value()) {
+                return Result(std::in_place, *std::forward<Self>(self));
+            }
+            return Result(detail::invoke_error, std::forward<F>(f), std::forward<Self>(self).error());
+        }
+
+        impl_type impl;
     };
 
     template<class T, class E> requires (std::is_void_v<T>)
@@ -386,88 +1817,522 @@ namespace mori {
         template<class U>
         using rebind = expected<U, error_type>;
 
-        constexpr expected() noexcept;
-        constexpr explicit() expected(const expected&);
-        constexpr explicit() expected(expected&&) noexcept();
+        constexpr expected() noexcept : impl(std::in_place) {}
+        constexpr expected(const expected&) = default;
+        constexpr expected(expected&&) = default;
         template<class U, class G>
-        constexpr explicit() expected(const expected<U, G>&);
+        requires (std::is_void_v<U>
+            && detail::constructible<E, const G&>
+            && !detail::constructible_from_expected<unexpected<E>, U, G>)
+        constexpr explicit(!detail::convertible<const G&, E>) expected(const expected<U, G>& other) :
+            impl(other.has_value() ? impl_type(std::in_place) : impl_type(unexpect, std::forward<const G&>(other.error()))) {}
         template<class U, class G>
-        constexpr explicit() expected(expected<U, G>&&) noexcept();
+        requires (std::is_void_v<U>
+            && detail::constructible<E, G>
+            && !detail::constructible_from_expected<unexpected<E>, U, G>)
+        constexpr explicit(!detail::convertible<G, E>) expected(expected<U, G>&& other) :
+            impl(other.has_value() ? impl_type(std::in_place) : impl_type(unexpect, std::forward<G>(other.error()))) {}
         template<class G>
-        constexpr expected(const unexpected<G>&);
+        requires (detail::constructible<E, const G&>)
+        constexpr explicit(!detail::convertible<const G&, E>) expected(const unexpected<G>& e) : impl(unexpect, std::forward<const G&>(e.error())) {}
         template<class G>
-        constexpr expected(unexpected<G>&&) noexcept();
-        constexpr explicit expected(std::in_place_t) noexcept;
+        requires (detail::constructible<E, G>)
+        constexpr explicit(!detail::convertible<G, E>) expected(unexpected<G>&& e) : impl(unexpect, std::forward<G>(e.error())) {}
+        constexpr explicit expected([[maybe_unused]] detail::in_place_arg tag) noexcept : impl(std::in_place) {
+            MORI_COUNT_VALUE(tag.where);
+        }
         template<class... Args>
-        constexpr explicit expected(unexpect_t, Args&&... args);
+        requires (detail::constructible<E, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_arg tag, Args&&... args) :
+            impl(unexpect, std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
         template<class U, class... Args>
-        constexpr explicit expected(unexpect_t, std::initializer_list<U> il, Args&&... args);
-        constexpr expected& operator=(const expected& other);
-        constexpr expected& operator=(expected&& other) noexcept();
+        requires (detail::constructible<E, std::initializer_list<U>&, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_arg tag, std::initializer_list<U> il, Args&&... args) :
+            impl(unexpect, il, std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
+        template<class F, class... Args>
+        requires (detail::constructible_from_invoke<E, F, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_from_arg tag, F&& f, Args&&... args) :
+            impl(detail::invoke_error, std::forward<F>(f), std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
+        constexpr expected& operator=(const expected& other) = default;
+        constexpr expected& operator=(expected&& other) = default;
         template<class G>
-        constexpr expected& operator=(const unexpected<G>& other);
+        requires (detail::constructible<E, const G&> && detail::assignable<E&, const G&>)
+        constexpr expected& operator=(const unexpected<G>& e) {
+            impl.assign_error(std::forward<const G&>(e.error()));
+            return *this;
+        }
         template<class G>
-        constexpr expected& operator=(unexpected<G>&& other) noexcept();
-        constexpr ~expected() noexcept() = default;
-
-        constexpr void emplace() noexcept;
-
-        constexpr void swap(expected& other) noexcept();
-        friend constexpr void swap(expected& x, expected& y) noexcept();
-
-        [[nodiscard]] constexpr explicit operator bool() const noexcept;
-        [[nodiscard]] constexpr bool has_value() const noexcept;
-        [[nodiscard]] constexpr void operator*() const noexcept;
-        [[nodiscard]] constexpr void value() const &;
-        [[nodiscard]] constexpr void value() &&;
-        [[nodiscard]] constexpr const E& error() const &;
-        [[nodiscard]] constexpr E& error() &;
-        [[nodiscard]] constexpr const E&& error() const &&;
-        [[nodiscard]] constexpr E&& error() &&;
+        requires (detail::constructible<E, G> && detail::assignable<E&, G>)
+        constexpr expected& operator=(unexpected<G>&& e) {
+            impl.assign_error(std::forward<G>(e.error()));
+            return *this;
+        }
+        constexpr ~expected() = default;
+
+        constexpr void emplace() noexcept {
+            impl.emplace_value();
+        }
+
+        constexpr void swap(expected& other) noexcept(detail::nothrow_constructible<E, E>
+            && std::is_nothrow_swappable_v<E>) {
+            impl.swap(other.impl);
+        }
+        friend constexpr void swap(expected& x, expected& y) noexcept(noexcept(x.swap(y))) { x.swap(y); }
+
+        [[nodiscard]] constexpr explicit operator bool() const noexcept { return impl.has_value(); }
+        [[nodiscard]] constexpr bool has_value() const noexcept { return impl.has_value(); }
+        constexpr void operator*() const noexcept {}
+        constexpr void value() const & {
+            if (!has_value()) {
+                detail::throw_bad_expected_access(std::as_const(error()));
+            }
+        }
+        constexpr void value() && {
+            if (!has_value()) {
+                detail::throw_bad_expected_access(std::move(error()));
+            }
+        }
+        [[nodiscard]] constexpr const E& error() const & noexcept { return impl.error(); }
+        [[nodiscard]] constexpr E& error() & noexcept { return impl.error(); }
+        [[nodiscard]] constexpr const E&& error() const && noexcept { return std::move(impl.error()); }
+        [[nodiscard]] constexpr E&& error() && noexcept { return std::move(impl.error()); }
         template<class G = E>
-        [[nodiscard]] constexpr E error_or(G&& e) const &;
+        [[nodiscard]] constexpr E error_or(G&& e) const & {
+            return has_value() ? std::forward<G>(e) : error();
+        }
         template<class G = E>
-        [[nodiscard]] constexpr E error_or(G&& e) &&;
+        [[nodiscard]] constexpr E error_or(G&& e) && {
+            return has_value() ? std::forward<G>(e) : std::move(error());
+        }
 
         template<class F>
-        [[nodiscard]] constexpr auto and_then(F&& f) &;
+        requires (detail::constructible<E, E&>)
+        [[nodiscard]] constexpr auto and_then(F&& f) & { return and_then_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto and_then(F&& f) &&;
+        requires (detail::constructible<E, E>)
+        [[nodiscard]] constexpr auto and_then(F&& f) && { return and_then_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto and_then(F&& f) const &;
+        requires (detail::constructible<E, const E&>)
+        [[nodiscard]] constexpr auto and_then(F&& f) const & { return and_then_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto and_then(F&& f) const &&;
+        requires (detail::constructible<E, const E>)
+        [[nodiscard]] constexpr auto and_then(F&& f) const && { return and_then_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto or_else(F&& f) &;
+        [[nodiscard]] constexpr auto or_else(F&& f) & { return or_else_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto or_else(F&& f) &&;
+        [[nodiscard]] constexpr auto or_else(F&& f) && { return or_else_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto or_else(F&& f) const &;
+        [[nodiscard]] constexpr auto or_else(F&& f) const & { return or_else_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto or_else(F&& f) const &&;
+        [[nodiscard]] constexpr auto or_else(F&& f) const && { return or_else_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform(F&& f) &;
+        requires (detail::constructible<E, E&>)
+        [[nodiscard]] constexpr auto transform(F&& f) & { return transform_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform(F&& f) &&;
+        requires (detail::constructible<E, E>)
+        [[nodiscard]] constexpr auto transform(F&& f) && { return transform_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform(F&& f) const &;
+        requires (detail::constructible<E, const E&>)
+        [[nodiscard]] constexpr auto transform(F&& f) const & { return transform_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform(F&& f) const &&;
+        requires (detail::constructible<E, const E>)
+        [[nodiscard]] constexpr auto transform(F&& f) const && { return transform_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform_error(F&& f) &;
+        [[nodiscard]] constexpr auto transform_error(F&& f) & { return transform_error_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform_error(F&& f) &&;
+        [[nodiscard]] constexpr auto transform_error(F&& f) && { return transform_error_impl(std::move(*this), std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform_error(F&& f) const &;
+        [[nodiscard]] constexpr auto transform_error(F&& f) const & { return transform_error_impl(*this, std::forward<F>(f)); }
         template<class F>
-        [[nodiscard]] constexpr auto transform_error(F&& f) const &&;
+        [[nodiscard]] constexpr auto transform_error(F&& f) const && { return transform_error_impl(std::move(*this), std::forward<F>(f)); }
 
         template<class T2, class E2> requires (std::is_void_v<T2>)
-        [[nodiscard]] friend constexpr bool operator==(const expected& x, const expected<T2, E2>& y);
+        [[nodiscard]] friend constexpr bool operator==(const expected& x, const expected<T2, E2>& y) {
+            if (x.has_value() != y.has_value()) {
+                return false;
+            }
+            return x.has_value() || static_cast<bool>(x.error() == y.error());
+        }
+        template<class E2>
+        [[nodiscard]] friend constexpr bool operator==(const expected& x, const unexpected<E2>& y) {
+            return !x.has_value() && static_cast<bool>(x.error() == y.error());
+        }
+
+    private:
+        using impl_type = detail::expected_storage<detail::void_value, E>;
+
+        template<class, class>
+        friend class expected;
+        template<class, class...>
+        friend class pipeline;
+
+        template<class F, class... Args>
+        constexpr explicit expected(detail::invoke_error_t tag, F&& f, Args&&... args) :
+            impl(tag, std::forward<F>(f), std::forward<Args>(args)...) {}
+
+        template<class Self, class F>
+        static constexpr auto and_then_impl(Self&& self, F&& f) {
+            using U = std::remove_cvref_t<std::invoke_result_t<F>>;
+            static_assert(detail::is_expected_v<U>, "and_then requires a function returning an expected");
+            static_assert(std::is_same_v<typename U::error_type, E>, "and_then cannot change the error_type");
+            if (self.has_value()) {
+                return std::invoke(std::forward<F>(f));
+            }
+            return U(unexpect, std::forward<Self>(self).error());
+        }
+        template<class Self, class F>
+        static constexpr auto or_else_impl(Self&& self, F&& f) {
+            using G = std::remove_cvref_t<std::invoke_result_t<F, decltype(std::forward<Self>(self).error())>>;
+            static_assert(detail::is_expected_v<G>, "or_else requires a function returning an expected");
+            static_assert(std::is_void_v<typename G::value_type>, "or_else cannot change the value_type");
+            if (self.has_value()) {
+                return G();
+            }
+            return std::invoke(std::forward<F>(f), std::forward<Self>(self).error());
+        }
+        template<class Self, class F>
+        static constexpr auto transform_impl(Self&& self, F&& f) {
+            using U = std::remove_cvref_t<std::invoke_result_t<F>>;
+            using Result = expected<U, E>;
+            if (!self.has_value()) {
+                return Result(unexpect, std::forward<Self>(self).error());
+            }
+            if constexpr (std::is_void_v<U>) {
+                std::invoke(std::forward<F>(f));
+                return Result();
+            }
+            else {
+                return Result(detail::invoke_value, std::forward<F>(f));
+            }
+        }
+        template<class Self, class F>
+        static constexpr auto transform_error_impl(Self&& self, F&& f) {
+            using G = std::remove_cv_t<std::invoke_result_t<F, decltype(std::forward<Self>(self).error())>>;
+            using Result = expected<T, G>;
+            if (self.has_value()) {
+                return Result();
+            }
+            return Result(detail::invoke_error, std::forward<F>(f), std::forward<Self>(self).error());
+        }
+
+        impl_type impl;
+    };
+
+    // An expected that refers to a value it does not own, for lookups that would otherwise return a copy. It stores a
+    // pointer in place of the value, so with an empty error type it is pointer-sized. Assigning a new referent rebinds
+    // it rather than assigning through, and it cannot be initialized from a temporary, which would leave it dangling.
+    template<class T, class E>
+    class [[nodiscard]] expected<T&, E> {
+    public:
+        using value_type = T&;
+        using error_type = E;
+        using unexpected_type = unexpected<E>;
+
+        template<class U>
+        using rebind = expected<U, error_type>;
+
+        constexpr expected(const expected&) = default;
+        constexpr expected(expected&&) = default;
+        template<class U, class G>
+        requires (detail::binds_lvalue<T, U&>
+            && detail::constructible<E, const G&>
+            && !std::is_same_v<expected, expected<U&, G>>)
+        constexpr explicit(!detail::convertible<U&, T&> || !detail::convertible<const G&, E>)
+            expected(const expected<U&, G>& other) : impl(other.has_value()
+                ? impl_type(std::in_place, slot(*other))
+                : impl_type(unexpect, std::forward<const G&>(other.error()))) {}
+        template<class U, class G>
+        requires (detail::binds_lvalue<T, U&>
+            && detail::constructible<E, G>
+            && !std::is_same_v<expected, expected<U&, G>>)
+        constexpr explicit(!detail::convertible<U&, T&> || !detail::convertible<G, E>)
+            expected(expected<U&, G>&& other) : impl(other.has_value()
+                ? impl_type(std::in_place, slot(*other))
+                : impl_type(unexpect, std::forward<G>(other.error()))) {}
+        template<class U>
+        requires (!std::is_same_v<std::remove_cvref_t<U>, std::in_place_t>
+            && !std::is_same_v<expected, std::remove_cvref_t<U>>
+            && !detail::is_unexpected_v<std::remove_cvref_t<U>>
+            && detail::binds_lvalue<T, U>)
+        constexpr explicit(!detail::convertible<U, T&>) expected(U&& v MORI_CALLER_LOCATION) noexcept :
+            impl(std::in_place, slot(std::forward<U>(v))) {
+            MORI_COUNT_VALUE(caller);
+        }
+        template<class U>
+        requires (!std::is_same_v<expected, std::remove_cvref_t<U>>
+            && !detail::is_unexpected_v<std::remove_cvref_t<U>>
+            && detail::binds_temporary<T, U>)
+        expected(U&& v) = delete;
+        template<class G>
+        requires (detail::constructible<E, const G&>)
+        constexpr explicit(!detail::convertible<const G&, E>) expected(const unexpected<G>& e) : impl(unexpect, std::forward<const G&>(e.error())) {}
+        template<class G>
+        requires (detail::constructible<E, G>)
+        constexpr explicit(!detail::convertible<G, E>) expected(unexpected<G>&& e) : impl(unexpect, std::forward<G>(e.error())) {}
+        template<class U>
+        requires (detail::binds_lvalue<T, U>)
+        constexpr explicit expected([[maybe_unused]] detail::in_place_arg tag, U&& v) noexcept :
+            impl(std::in_place, slot(std::forward<U>(v))) {
+            MORI_COUNT_VALUE(tag.where);
+        }
+        template<class U>
+        requires (detail::binds_temporary<T, U>)
+        expected(detail::in_place_arg tag, U&& v) = delete;
+        template<class... Args>
+        requires (detail::constructible<E, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_arg tag, Args&&... args) :
+            impl(unexpect, std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
+        template<class U, class... Args>
+        requires (detail::constructible<E, std::initializer_list<U>&, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_arg tag, std::initializer_list<U> il, Args&&... args) :
+            impl(unexpect, il, std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
+        template<class F, class... Args>
+        requires (detail::constructible_from_invoke<E, F, Args...>)
+        constexpr explicit expected([[maybe_unused]] detail::unexpect_from_arg tag, F&& f, Args&&... args) :
+            impl(detail::invoke_error, std::forward<F>(f), std::forward<Args>(args)...) {
+            MORI_COUNT_ERROR(tag.where);
+        }
+        // Copying an expected, or assigning an lvalue to it, rebinds the reference; the referenced objects are left
+        // alone.
+        constexpr expected& operator=(const expected& other) = default;
+        constexpr expected& operator=(expected&& other) = default;
+        template<class U>
+        requires (!std::is_same_v<expected, std::remove_cvref_t<U>>
+            && !detail::is_unexpected_v<std::remove_cvref_t<U>>
+            && detail::binds_lvalue<T, U>)
+        constexpr expected& operator=(U&& v) {
+            impl.assign_value(slot(std::forward<U>(v)));
+            return *this;
+        }
+        template<class U>
+        requires (!std::is_same_v<expected, std::remove_cvref_t<U>>
+            && !detail::is_unexpected_v<std::remove_cvref_t<U>>
+            && detail::binds_temporary<T, U>)
+        expected& operator=(U&& v) = delete;
+        template<class G>
+        requires (detail::constructible<E, const G&> && detail::assignable<E&, const G&>)
+        constexpr expected& operator=(const unexpected<G>& e) {
+            impl.assign_error(std::forward<const G&>(e.error()));
+            return *this;
+        }
+        template<class G>
+        requires (detail::constructible<E, G> && detail::assignable<E&, G>)
+        constexpr expected& operator=(unexpected<G>&& e) {
+            impl.assign_error(std::forward<G>(e.error()));
+            return *this;
+        }
+        constexpr ~expected() = default;
+
+        template<class U>
+        requires (detail::binds_lvalue<T, U>)
+        constexpr T& emplace(U&& v) noexcept {
+            impl.emplace_value(slot(std::forward<U>(v)));
+            return **this;
+        }
+        template<class U>
+        requires (detail::binds_temporary<T, U>)
+        T& emplace(U&& v) = delete;
+
+        constexpr void swap(expected& other) noexcept(detail::nothrow_constructible<E, E>
+            && std::is_nothrow_swappable_v<E>) {
+            impl.swap(other.impl);
+        }
+        friend constexpr void swap(expected& x, expected& y) noexcept(noexcept(x.swap(y))) { x.swap(y); }
+
+        // A const expected<T&, E> still refers to a mutable T, as a const pointer would.
+        [[nodiscard]] constexpr T* operator->() const noexcept { return impl.value().pointer; }
+        [[nodiscard]] constexpr T& operator*() const noexcept { return *impl.value().pointer; }
+        [[nodiscard]] constexpr explicit operator bool() const noexcept { return impl.has_value(); }
+        [[nodiscard]] constexpr bool has_value() const noexcept { return impl.has_value(); }
+        [[nodiscard]] constexpr T& value() const & {
+            if (!has_value()) {
+                detail::throw_bad_expected_access(std::as_const(error()));
+            }
+            return **this;
+        }
+        [[nodiscard]] constexpr T& value() && {
+            if (!has_value()) {
+                detail::throw_bad_expected_access(std::move(error()));
+            }
+            return **this;
+        }
+        [[nodiscard]] constexpr const E& error() const & noexcept { return impl.error(); }
+        [[nodiscard]] constexpr E& error() & noexcept { return impl.error(); }
+        [[nodiscard]] constexpr const E&& error() const && noexcept { return std::move(impl.error()); }
+        [[nodiscard]] constexpr E&& error() && noexcept { return std::move(impl.error()); }
+        // The fallback may be a temporary, so this returns a copy either way.
+        template<class U>
+        [[nodiscard]] constexpr std::remove_cv_t<T> value_or(U&& v) const {
+            return has_value() ? **this : static_cast<std::remove_cv_t<T>>(std::forward<U>(v));
+        }
+        template<class G = E>
+        [[nodiscard]] constexpr E error_or(G&& e) const & {
+            return has_value() ? std::forward<G>(e) : error();
+        }
+        template<class G = E>
+        [[nodiscard]] constexpr E error_or(G&& e) && {
+            return has_value() ? std::forward<G>(e) : std::move(error());
+        }
+
+        // The value is passed on as T& whatever the expected's own value category; a function that returns an lvalue
+        // reference from transform keeps the chain in references.
+        template<class F>
+        requires (detail::constructible<E, E&>)
+        [[nodiscard]] constexpr auto and_then(F&& f) & { return and_then_impl(*this, std::forward<F>(f)); }
+        template<class F>
+        requires (detail::constructible<E, E>)
+        [[nodiscard]] constexpr auto and_then(F&& f) && { return and_then_impl(std::move(*this), std::forward<F>(f)); }
+        template<class F>
+        requires (detail::constructible<E, const E&>)
+        [[nodiscard]] constexpr auto and_then(F&& f) const & { return and_then_impl(*this, std::forward<F>(f)); }
+        template<class F>
+        requires (detail::constructible<E, const E>)
+        [[nodiscard]] constexpr auto and_then(F&& f) const && { return and_then_impl(std::move(*this), std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto or_else(F&& f) & { return or_else_impl(*this, std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto or_else(F&& f) && { return or_else_impl(std::move(*this), std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto or_else(F&& f) const & { return or_else_impl(*this, std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto or_else(F&& f) const && { return or_else_impl(std::move(*this), std::forward<F>(f)); }
+        template<class F>
+        requires (detail::constructible<E, E&>)
+        [[nodiscard]] constexpr auto transform(F&& f) & { return transform_impl(*this, std::forward<F>(f)); }
+        template<class F>
+        requires (detail::constructible<E, E>)
+        [[nodiscard]] constexpr auto transform(F&& f) && { return transform_impl(std::move(*this), std::forward<F>(f)); }
+        template<class F>
+        requires (detail::constructible<E, const E&>)
+        [[nodiscard]] constexpr auto transform(F&& f) const & { return transform_impl(*this, std::forward<F>(f)); }
+        template<class F>
+        requires (detail::constructible<E, const E>)
+        [[nodiscard]] constexpr auto transform(F&& f) const && { return transform_impl(std::move(*this), std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto transform_error(F&& f) & { return transform_error_impl(*this, std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto transform_error(F&& f) && { return transform_error_impl(std::move(*this), std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto transform_error(F&& f) const & { return transform_error_impl(*this, std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto transform_error(F&& f) const && { return transform_error_impl(std::move(*this), std::forward<F>(f)); }
+
+        // Compares the referenced values, like the other expected, not the addresses.
+        template<class T2, class E2> requires (!std::is_void_v<T2>)
+        [[nodiscard]] friend constexpr bool operator==(const expected& x, const expected<T2, E2>& y) {
+            if (x.has_value() != y.has_value()) {
+                return false;
+            }
+            return x.has_value() ? *x == *y : x.error() == y.error();
+        }
+        template<class T2> requires (!detail::is_expected_v<T2>)
+        [[nodiscard]] friend constexpr bool operator==(const expected& x, const T2& y) {
+            return x.has_value() && static_cast<bool>(*x == y);
+        }
         template<class E2>
-        [[nodiscard]] friend constexpr bool operator==(const expected& x, const unexpected<E2>& y);
+        [[nodiscard]] friend constexpr bool operator==(const expected& x, const unexpected<E2>& y) {
+            return !x.has_value() && static_cast<bool>(x.error() == y.error());
+        }
 
     private:
-        std::variant<std::monostate, E> impl;
+        using impl_type = detail::expected_storage<detail::reference_slot<T>, E>;
+
+        template<class, class>
+        friend class expected;
+        template<class, class...>
+        friend class pipeline;
+
+        template<class F, class... Args>
+        constexpr explicit expected(detail::invoke_error_t tag, F&& f, Args&&... args) :
+            impl(tag, std::forward<F>(f), std::forward<Args>(args)...) {}
+
+        template<class U>
+        [[nodiscard]] static constexpr detail::reference_slot<T> slot(U&& v) noexcept {
+            return {std::addressof(static_cast<T&>(std::forward<U>(v)))};
+        }
+
+        template<class Self, class F>
+        static constexpr auto and_then_impl(Self&& self, F&& f) {
+            using U = std::remove_cvref_t<std::invoke_result_t<F, T&>>;
+            static_assert(detail::is_expected_v<U>, "and_then requires a function returning an expected");
+            static_assert(std::is_same_v<typename U::error_type, E>, "and_then cannot change the error_type");
+            if (self.has_value()) {
+                return std::invoke(std::forward<F>(f), *self);
+            }
+            return U(unexpect, std::forward<Self>(self).error());
+        }
+        template<class Self, class F>
+        static constexpr auto or_else_impl(Self&& self, F&& f) {
+            using G = std::remove_cvref_t<std::invoke_result_t<F, decltype(std::forward<Self>(self).error())>>;
+            static_assert(detail::is_expected_v<G>, "or_else requires a function returning an expected");
+            static_assert(std::is_same_v<typename G::value_type, T&>, "or_else cannot change the value_type");
+            if (self.has_value()) {
+                return G(std::in_place, *self);
+            }
+            return std::invoke(std::forward<F>(f), std::forward<Self>(self).error());
+        }
+        template<class Self, class F>
+        static constexpr auto transform_impl(Self&& self, F&& f) {
+            using U = detail::transform_value_t<std::invoke_result_t<F, T&>>;
+            using Result = expected<U, E>;
+            if (!self.has_value()) {
+                return Result(unexpect, std::forward<Self>(self).error());
+            }
+            if constexpr (std::is_void_v<U>) {
+                std::invoke(std::forward<F>(f), *self);
+                return Result();
+            }
+            else if constexpr (std::is_reference_v<U>) {
+                return Result(std::in_place, std::invoke(std::forward<F>(f), *self));
+            }
+            else {
+                return Result(detail::invoke_value, std::forward<F>(f), *self);
+            }
+        }
+        template<class Self, class F>
+        static constexpr auto transform_error_impl(Self&& self, F&& f) {
+            using G = std::remove_cv_t<std::invoke_result_t<F, decltype(std::forward<Self>(self).error())>>;
+            using Result = expected<T&, G>;
+            if (self.has_value()) {
+                return Result(std::in_place, *self);
+            }
+            return Result(detail::invoke_error, std::forward<F>(f), std::forward<Self>(self).error());
+        }
+
+        impl_type impl;
     };
+
+    template<class E>
+    struct trivially_relocatable<unexpected<E>> : trivially_relocatable<E> {};
+
+    template<class T, class E>
+    struct trivially_relocatable<expected<T, E>>
+        : std::bool_constant<(std::is_void_v<T> || std::is_lvalue_reference_v<T> || is_trivially_relocatable_v<T>)
+            && is_trivially_relocatable_v<E>> {};
 }
+
+// libstdc++ grows a std::vector by memmove when its element type specializes std::__is_bitwise_relocatable. The hook is
+// internal and undocumented, and specializing it is outside what the standard allows in namespace std, so it is only
+// used when MORI_LIBSTDCXX_RELOCATION is defined to 1, and then only on the libstdc++ releases it was checked against:
+// the hook has had this form since GCC 9, and this was tested with GCC 12. MORI_HAS_LIBSTDCXX_RELOCATION says whether
+// it is in effect.
+#if !defined(MORI_LIBSTDCXX_RELOCATION)
+#define MORI_LIBSTDCXX_RELOCATION 0
+#endif
+#if MORI_LIBSTDCXX_RELOCATION && defined(_GLIBCXX_RELEASE) && _GLIBCXX_RELEASE >= 9 && _GLIBCXX_RELEASE <= 12
+#define MORI_HAS_LIBSTDCXX_RELOCATION 1
+template<class T, class E> requires (mori::is_trivially_relocatable_v<mori::expected<T, E>>)
+struct std::__is_bitwise_relocatable<mori::expected<T, E>, void> : std::true_type {};
+#else
+#define MORI_HAS_LIBSTDCXX_RELOCATION 0
+#endif
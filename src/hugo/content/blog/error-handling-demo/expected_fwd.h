@@ -0,0 +1,16 @@
+#pragma once
+
+// Declarations only, for headers that pass expected or Result around by reference or name them in function
+// signatures. Including this instead of result.h keeps the templates out of translation units that never instantiate
+// them; anything that constructs, inspects or returns one by value still needs expected.h or result.h.
+namespace mori {
+    template<class E>
+    class unexpected;
+    template<class T, class E>
+    class expected;
+
+    class Error;
+
+    template<class T>
+    using Result = expected<T, Error>;
+}
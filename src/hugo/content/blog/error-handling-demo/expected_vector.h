@@ -0,0 +1,564 @@
+#pragma once
+
+#include "expected.h"
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Structure-of-arrays storage for a batch of expected<T, E>: a bitmask saying which elements hold values, a dense array
+// of values indexed like the batch, and a side table holding only the errors. Bulk operations walk the bitmask a word
+// at a time, so runs of values are processed by straight loops the compiler can vectorize and errors cost nothing
+// until they are looked at.
+//
+//     mori::expected_vector<Record, Fault> parsed = parse_all(lines);
+//     auto scaled = parsed.transform(scale).and_then(validate);
+//     std::printf("%zu rejected\n", scaled.count_errors());
+//     mori::expected<std::vector<Record>, Fault> all = std::move(scaled).collect();
+//
+// Slots for elements that hold errors contain value-initialized T, so T must be default constructible. Values are kept
+// in a std::vector<T>, except for bool: a batch of checks keeps one bool per byte, so value() and transform work on real
+// bools rather than on std::vector<bool>'s bit proxies.
+namespace mori {
+    template<class T, class E>
+    class expected_vector;
+    template<class T, class E>
+    class expected_span;
+
+    namespace detail {
+        template<class E>
+        struct indexed_error {
+            std::size_t index;
+            E error;
+        };
+
+        inline constexpr std::size_t word_bits = 64;
+
+        [[nodiscard]] constexpr std::size_t word_count(std::size_t bits) noexcept {
+            return (bits + word_bits - 1) / word_bits;
+        }
+
+        // Calls f(i) for every i in [first, last) whose bit is set, a word at a time. Full words take a plain loop.
+        template<class F>
+        constexpr void for_each_set(const std::uint64_t* words, std::size_t first, std::size_t last, F&& f) {
+            std::size_t i = first;
+            while (i < last) {
+                const std::size_t word = i / word_bits;
+                const std::size_t bit = i % word_bits;
+                const std::size_t end = std::min(last, (word + 1) * word_bits);
+                std::uint64_t bits = words[word] >> bit;
+                const std::size_t span = end - i;
+                if (span < word_bits) {
+                    bits &= (std::uint64_t{1} << span) - 1;
+                }
+                if (span == word_bits && bits == ~std::uint64_t{0}) {
+                    for (std::size_t k = i; k < end; ++k) {
+                        f(k);
+                    }
+                }
+                else {
+                    while (bits != 0) {
+                        f(i + static_cast<std::size_t>(std::countr_zero(bits)));
+                        bits &= bits - 1;
+                    }
+                }
+                i = end;
+            }
+        }
+
+        [[nodiscard]] constexpr std::size_t count_set(const std::uint64_t* words, std::size_t first, std::size_t last) noexcept {
+            std::size_t count = 0;
+            std::size_t i = first;
+            while (i < last) {
+                const std::size_t word = i / word_bits;
+                const std::size_t bit = i % word_bits;
+                const std::size_t end = std::min(last, (word + 1) * word_bits);
+                std::uint64_t bits = words[word] >> bit;
+                if (end - i < word_bits) {
+                    bits &= (std::uint64_t{1} << (end - i)) - 1;
+                }
+                count += static_cast<std::size_t>(std::popcount(bits));
+                i = end;
+            }
+            return count;
+        }
+
+        // The part of std::vector's interface expected_vector uses, over a plain array of bool.
+        class bool_array {
+        public:
+            constexpr bool_array() noexcept = default;
+            constexpr bool_array(const bool_array& other) {
+                reserve(other.count);
+                for (std::size_t i = 0; i < other.count; ++i) {
+                    std::construct_at(first + i, other.first[i]);
+                }
+                count = other.count;
+            }
+            constexpr bool_array(bool_array&& other) noexcept :
+                first(std::exchange(other.first, nullptr)), count(std::exchange(other.count, 0)),
+                room(std::exchange(other.room, 0)) {}
+            constexpr bool_array& operator=(bool_array other) noexcept {
+                std::swap(first, other.first);
+                std::swap(count, other.count);
+                std::swap(room, other.room);
+                return *this;
+            }
+            constexpr ~bool_array() {
+                if (first != nullptr) {
+                    std::allocator<bool>().deallocate(first, room);
+                }
+            }
+
+            [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+            [[nodiscard]] constexpr bool empty() const noexcept { return count == 0; }
+            [[nodiscard]] constexpr bool* data() noexcept { return first; }
+            [[nodiscard]] constexpr const bool* data() const noexcept { return first; }
+            [[nodiscard]] constexpr bool& operator[](std::size_t i) noexcept { return first[i]; }
+            [[nodiscard]] constexpr const bool& operator[](std::size_t i) const noexcept { return first[i]; }
+
+            constexpr void reserve(std::size_t n) {
+                if (n <= room) {
+                    return;
+                }
+                bool* grown = std::allocator<bool>().allocate(n);
+                for (std::size_t i = 0; i < count; ++i) {
+                    std::construct_at(grown + i, first[i]);
+                }
+                if (first != nullptr) {
+                    std::allocator<bool>().deallocate(first, room);
+                }
+                first = grown;
+                room = n;
+            }
+            constexpr void resize(std::size_t n) {
+                reserve(n);
+                for (std::size_t i = count; i < n; ++i) {
+                    std::construct_at(first + i, false);
+                }
+                count = n;
+            }
+            constexpr void clear() noexcept { count = 0; }
+            template<class... Args>
+            constexpr bool& emplace_back(Args&&... args) {
+                if (count == room) {
+                    reserve(std::max<std::size_t>(room * 2, 16));
+                }
+                return *std::construct_at(first + count++, std::forward<Args>(args)...);
+            }
+
+        private:
+            bool* first = nullptr;
+            std::size_t count = 0;
+            std::size_t room = 0;
+        };
+
+        template<class T>
+        using value_array = std::conditional_t<std::is_same_v<T, bool>, bool_array, std::vector<T>>;
+    }
+
+    // A read-only view of a contiguous range of an expected_vector, with the same bulk operations.
+    template<class T, class E>
+    class expected_span {
+    public:
+        using value_type = expected<T, E>;
+
+        constexpr expected_span() noexcept = default;
+
+        [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+        [[nodiscard]] constexpr bool empty() const noexcept { return count == 0; }
+
+        [[nodiscard]] constexpr bool has_value(std::size_t i) const noexcept {
+            const std::size_t at = offset + i;
+            return (words[at / detail::word_bits] >> (at % detail::word_bits)) & 1;
+        }
+        // The value at i, which must hold one.
+        [[nodiscard]] constexpr const T& value(std::size_t i) const noexcept { return values[offset + i]; }
+        // The error at i, which must hold one.
+        [[nodiscard]] constexpr const E& error(std::size_t i) const noexcept {
+            const auto it = std::lower_bound(errors.begin(), errors.end(), offset + i,
+                [](const detail::indexed_error<E>& e, std::size_t index) { return e.index < index; });
+            return it->error;
+        }
+        [[nodiscard]] constexpr value_type operator[](std::size_t i) const {
+            if (has_value(i)) {
+                return value_type(std::in_place, value(i));
+            }
+            return value_type(unexpect, error(i));
+        }
+
+        [[nodiscard]] constexpr expected_span subspan(std::size_t pos, std::size_t n) const {
+            n = std::min(n, count - pos);
+            expected_span s = *this;
+            s.offset = offset + pos;
+            s.count = n;
+            s.errors = errors_between(s.offset, s.offset + n);
+            return s;
+        }
+
+        // Calls f(i, value) for every element that holds a value, in order.
+        template<class F>
+        constexpr void for_each_value(F&& f) const {
+            detail::for_each_set(words, offset, offset + count, [&](std::size_t at) { f(at - offset, values[at]); });
+        }
+        // Calls f(i, error) for every element that holds an error, in order.
+        template<class F>
+        constexpr void for_each_error(F&& f) const {
+            for (const auto& e : errors) {
+                f(e.index - offset, e.error);
+            }
+        }
+
+        [[nodiscard]] constexpr std::size_t count_values() const noexcept {
+            return detail::count_set(words, offset, offset + count);
+        }
+        [[nodiscard]] constexpr std::size_t count_errors() const noexcept { return errors.size(); }
+
+        // Applies f to every value; errors are carried over unchanged.
+        template<class F>
+        [[nodiscard]] constexpr auto transform(F&& f) const {
+            using U = std::remove_cv_t<std::invoke_result_t<F&, const T&>>;
+            expected_vector<U, E> out = shaped<U>();
+            U* dest = out.values.data();
+            detail::for_each_set(words, offset, offset + count,
+                [&](std::size_t at) { dest[at - offset] = std::invoke(f, values[at]); });
+            return out;
+        }
+        // Applies f, which returns an expected<U, E>, to every value; its errors join the ones already present.
+        template<class F>
+        [[nodiscard]] constexpr auto and_then(F&& f) const {
+            using R = std::remove_cvref_t<std::invoke_result_t<F&, const T&>>;
+            static_assert(detail::is_expected_v<R>, "and_then must return an expected");
+            static_assert(std::is_same_v<typename R::error_type, E>, "and_then must return the same error type");
+            using U = typename R::value_type;
+            expected_vector<U, E> out = shaped<U>();
+            std::vector<detail::indexed_error<E>> failed;
+            detail::for_each_set(words, offset, offset + count, [&](std::size_t at) {
+                R r = std::invoke(f, values[at]);
+                if (r.has_value()) {
+                    out.values[at - offset] = *std::move(r);
+                }
+                else {
+                    out.clear_bit(at - offset);
+                    failed.push_back({at - offset, std::move(r).error()});
+                }
+            });
+            out.merge_errors(std::move(failed));
+            return out;
+        }
+
+        // All the values, or the error of the first element that holds one.
+        [[nodiscard]] constexpr expected<std::vector<T>, E> collect() const {
+            if (!errors.empty()) {
+                return expected<std::vector<T>, E>(unexpect, errors.front().error);
+            }
+            return expected<std::vector<T>, E>(std::in_place, values + offset, values + offset + count);
+        }
+
+        struct partitioned {
+            std::vector<T> values;
+            std::vector<E> errors;
+        };
+        // Splits the elements into their values and their errors, each in order.
+        [[nodiscard]] constexpr partitioned partition() const {
+            partitioned out;
+            out.values.reserve(count - errors.size());
+            detail::for_each_set(words, offset, offset + count, [&](std::size_t at) { out.values.push_back(values[at]); });
+            out.errors.reserve(errors.size());
+            for (const auto& e : errors) {
+                out.errors.push_back(e.error);
+            }
+            return out;
+        }
+
+    private:
+        friend class expected_vector<T, E>;
+
+        constexpr expected_span(const std::uint64_t* words, const T* values, std::span<const detail::indexed_error<E>> errors,
+            std::size_t count) noexcept :
+            words(words), values(values), errors(errors), count(count) {}
+
+        [[nodiscard]] constexpr std::span<const detail::indexed_error<E>> errors_between(std::size_t first, std::size_t last) const {
+            const auto by_index = [](const detail::indexed_error<E>& e, std::size_t index) { return e.index < index; };
+            const auto begin = std::lower_bound(errors.begin(), errors.end(), first, by_index);
+            const auto end = std::lower_bound(begin, errors.end(), last, by_index);
+            return {begin, end};
+        }
+
+        // A vector of the same length with the same elements valid, holding these errors and value-initialized values.
+        template<class U>
+        [[nodiscard]] constexpr expected_vector<U, E> shaped() const {
+            expected_vector<U, E> out;
+            out.values.resize(count);
+            out.valid.resize(detail::word_count(count));
+            for (std::size_t w = 0; w < out.valid.size(); ++w) {
+                const std::size_t at = offset + w * detail::word_bits;
+                std::uint64_t bits = words[at / detail::word_bits] >> (at % detail::word_bits);
+                if (at % detail::word_bits != 0 && at / detail::word_bits + 1 < detail::word_count(offset + count)) {
+                    bits |= words[at / detail::word_bits + 1] << (detail::word_bits - at % detail::word_bits);
+                }
+                out.valid[w] = bits;
+            }
+            out.trim();
+            out.errors.reserve(errors.size());
+            for (const auto& e : errors) {
+                out.errors.push_back({e.index - offset, e.error});
+            }
+            return out;
+        }
+
+        const std::uint64_t* words = nullptr;
+        const T* values = nullptr;
+        std::span<const detail::indexed_error<E>> errors;
+        std::size_t offset = 0;
+        std::size_t count = 0;
+    };
+
+    template<class T, class E>
+    class expected_vector {
+        static_assert(std::is_object_v<T> && std::default_initializable<T>,
+            "expected_vector needs a default constructible value type to fill the slots of errors");
+
+    public:
+        using value_type = expected<T, E>;
+        using span_type = expected_span<T, E>;
+
+        constexpr expected_vector() = default;
+        template<std::input_iterator It, std::sentinel_for<It> S>
+        requires (std::is_constructible_v<value_type, std::iter_reference_t<It>>)
+        constexpr expected_vector(It first, S last) {
+            if constexpr (std::sized_sentinel_for<S, It>) {
+                reserve(static_cast<std::size_t>(last - first));
+            }
+            for (; first != last; ++first) {
+                push_back(*first);
+            }
+        }
+        constexpr expected_vector(std::initializer_list<value_type> il) : expected_vector(il.begin(), il.end()) {}
+
+        [[nodiscard]] constexpr std::size_t size() const noexcept { return values.size(); }
+        [[nodiscard]] constexpr bool empty() const noexcept { return values.empty(); }
+        constexpr void reserve(std::size_t n) {
+            values.reserve(n);
+            valid.reserve(detail::word_count(n));
+        }
+        constexpr void clear() noexcept {
+            values.clear();
+            valid.clear();
+            errors.clear();
+        }
+
+        constexpr void push_back(const T& v) { emplace_back(v); }
+        constexpr void push_back(T&& v) { emplace_back(std::move(v)); }
+        template<class... Args>
+        constexpr T& emplace_back(Args&&... args) {
+            grow();
+            T& v = values.emplace_back(std::forward<Args>(args)...);
+            set_bit(values.size() - 1);
+            return v;
+        }
+        template<class G>
+        constexpr void push_back(const unexpected<G>& e) { push_error(e.error()); }
+        template<class G>
+        constexpr void push_back(unexpected<G>&& e) { push_error(std::move(e).error()); }
+        template<class U, class G>
+        constexpr void push_back(const expected<U, G>& e) {
+            if (e.has_value()) {
+                emplace_back(*e);
+            }
+            else {
+                push_error(e.error());
+            }
+        }
+        template<class U, class G>
+        constexpr void push_back(expected<U, G>&& e) {
+            if (e.has_value()) {
+                emplace_back(*std::move(e));
+            }
+            else {
+                push_error(std::move(e).error());
+            }
+        }
+
+        // Replaces element i, which must already exist.
+        constexpr void set(std::size_t i, const value_type& e) { assign(i, e); }
+        constexpr void set(std::size_t i, value_type&& e) { assign(i, std::move(e)); }
+
+        [[nodiscard]] constexpr span_type view() const noexcept {
+            return span_type(valid.data(), values.data(), errors, values.size());
+        }
+        [[nodiscard]] constexpr operator span_type() const noexcept { return view(); }
+        [[nodiscard]] constexpr span_type subspan(std::size_t pos, std::size_t n) const { return view().subspan(pos, n); }
+
+        [[nodiscard]] constexpr bool has_value(std::size_t i) const noexcept { return view().has_value(i); }
+        [[nodiscard]] constexpr const T& value(std::size_t i) const noexcept { return values[i]; }
+        [[nodiscard]] constexpr T& value(std::size_t i) noexcept { return values[i]; }
+        [[nodiscard]] constexpr const E& error(std::size_t i) const noexcept { return view().error(i); }
+        [[nodiscard]] constexpr value_type operator[](std::size_t i) const { return view()[i]; }
+
+        template<class F>
+        constexpr void for_each_value(F&& f) const { view().for_each_value(std::forward<F>(f)); }
+        template<class F>
+        constexpr void for_each_error(F&& f) const { view().for_each_error(std::forward<F>(f)); }
+        [[nodiscard]] constexpr std::size_t count_values() const noexcept { return size() - errors.size(); }
+        [[nodiscard]] constexpr std::size_t count_errors() const noexcept { return errors.size(); }
+
+        template<class F>
+        [[nodiscard]] constexpr auto transform(F&& f) const { return view().transform(std::forward<F>(f)); }
+        template<class F>
+        [[nodiscard]] constexpr auto and_then(F&& f) const { return view().and_then(std::forward<F>(f)); }
+        [[nodiscard]] constexpr expected<std::vector<T>, E> collect() const & { return view().collect(); }
+        // Moves the values out rather than copying them.
+        [[nodiscard]] constexpr expected<std::vector<T>, E> collect() && {
+            if (!errors.empty()) {
+                return expected<std::vector<T>, E>(unexpect, std::move(errors.front().error));
+            }
+            if constexpr (std::is_same_v<T, bool>) {
+                return expected<std::vector<T>, E>(std::in_place, values.data(), values.data() + values.size());
+            }
+            else {
+                return expected<std::vector<T>, E>(std::in_place, std::move(values));
+            }
+        }
+        [[nodiscard]] constexpr auto partition() const { return view().partition(); }
+
+        // Iterates the elements as expected<T, E>, by value.
+        class const_iterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = expected<T, E>;
+            using difference_type = std::ptrdiff_t;
+            using reference = value_type;
+
+            constexpr const_iterator() noexcept = default;
+
+            [[nodiscard]] constexpr value_type operator*() const { return (*owner)[index]; }
+            constexpr const_iterator& operator++() noexcept {
+                ++index;
+                return *this;
+            }
+            constexpr const_iterator operator++(int) noexcept {
+                const_iterator old = *this;
+                ++index;
+                return old;
+            }
+            [[nodiscard]] friend constexpr bool operator==(const const_iterator& x, const const_iterator& y) noexcept {
+                return x.index == y.index;
+            }
+
+        private:
+            friend class expected_vector;
+
+            constexpr const_iterator(const expected_vector* owner, std::size_t index) noexcept : owner(owner), index(index) {}
+
+            const expected_vector* owner = nullptr;
+            std::size_t index = 0;
+        };
+
+        [[nodiscard]] constexpr const_iterator begin() const noexcept { return const_iterator(this, 0); }
+        [[nodiscard]] constexpr const_iterator end() const noexcept { return const_iterator(this, size()); }
+
+    private:
+        template<class, class>
+        friend class expected_span;
+        template<class, class>
+        friend class expected_vector;
+
+        // Adds the word for the next element's bit unless an earlier push that threw already did.
+        constexpr void grow() {
+            if (valid.size() * detail::word_bits == values.size()) {
+                valid.push_back(0);
+            }
+        }
+        constexpr void set_bit(std::size_t i) noexcept {
+            valid[i / detail::word_bits] |= std::uint64_t{1} << (i % detail::word_bits);
+        }
+        constexpr void clear_bit(std::size_t i) noexcept {
+            valid[i / detail::word_bits] &= ~(std::uint64_t{1} << (i % detail::word_bits));
+        }
+        // Clears the bits past the end, which the bulk operations may have copied in from a wider view.
+        constexpr void trim() noexcept {
+            if (const std::size_t tail = values.size() % detail::word_bits; tail != 0 && !valid.empty()) {
+                valid.back() &= (std::uint64_t{1} << tail) - 1;
+            }
+        }
+
+        template<class G>
+        constexpr void push_error(G&& e) {
+            grow();
+            errors.push_back({values.size(), E(std::forward<G>(e))});
+#if MORI_HAS_EXCEPTIONS
+            // An error without its slot would be reported for the next element pushed.
+            try {
+                values.emplace_back();
+            }
+            catch (...) {
+                errors.pop_back();
+                throw;
+            }
+#else
+            values.emplace_back();
+#endif
+        }
+
+        [[nodiscard]] constexpr auto find_error(std::size_t i) {
+            return std::lower_bound(errors.begin(), errors.end(), i,
+                [](const detail::indexed_error<E>& e, std::size_t index) { return e.index < index; });
+        }
+
+        template<class Ex>
+        constexpr void assign(std::size_t i, Ex&& e) {
+            const auto it = find_error(i);
+            const bool had_error = it != errors.end() && it->index == i;
+            if (e.has_value()) {
+                values[i] = *std::forward<Ex>(e);
+                set_bit(i);
+                if (had_error) {
+                    errors.erase(it);
+                }
+            }
+            else {
+                values[i] = T();
+                clear_bit(i);
+                if (had_error) {
+                    it->error = std::forward<Ex>(e).error();
+                }
+                else {
+                    errors.insert(it, {i, std::forward<Ex>(e).error()});
+                }
+            }
+        }
+
+        // Adds errors for elements whose bits are already clear, keeping the table in index order.
+        constexpr void merge_errors(std::vector<detail::indexed_error<E>>&& more) {
+            if (more.empty()) {
+                return;
+            }
+            if (errors.empty()) {
+                errors = std::move(more);
+                return;
+            }
+            std::vector<detail::indexed_error<E>> merged;
+            merged.reserve(errors.size() + more.size());
+            const auto by_index = [](const detail::indexed_error<E>& x, const detail::indexed_error<E>& y) {
+                return x.index < y.index;
+            };
+            std::merge(std::make_move_iterator(errors.begin()), std::make_move_iterator(errors.end()),
+                std::make_move_iterator(more.begin()), std::make_move_iterator(more.end()), std::back_inserter(merged),
+                by_index);
+            errors = std::move(merged);
+        }
+
+        std::vector<std::uint64_t> valid;
+        detail::value_array<T> values;
+        std::vector<detail::indexed_error<E>> errors;
+    };
+}
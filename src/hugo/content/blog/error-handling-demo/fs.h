@@ -0,0 +1,881 @@
+#pragma once
+
+#include "parallel.h"
+#include "result.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// The operations are built on the POSIX calls; there is no fallback for other systems.
+#if !__has_include(<unistd.h>)
+#error "fs.h needs a POSIX system"
+#endif
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define MORI_HAS_IO_URING 1
+#else
+#define MORI_HAS_IO_URING 0
+#endif
+
+// Filesystem operations that never throw: failures come back as a Result whose Error holds the errno in the system
+// category, as std::filesystem reports it. Each operation can be called on its own or queued on a batch, which runs
+// many of them at once:
+//
+//     mori::fs::batch spool;
+//     std::vector<mori::fs::ticket<void>> moved;
+//     for (const Entry& e : entries) {
+//         moved.push_back(spool.rename(e.incoming, e.done));
+//     }
+//     spool.wait();
+//     for (const auto t : moved) {
+//         if (!spool[t]) {
+//             log(spool[t].error());
+//         }
+//     }
+//
+// On Linux a batch submits its operations through io_uring, so the kernel works on many at once and thousands of them
+// cost a handful of system calls. When io_uring is unavailable, or lacks one of the operations used here (it needs
+// Linux 5.15), a batch runs them on a thread pool instead. Both run every operation as the same sequence of system
+// calls (see detail::fs_operation), so the results do not depend on which one was used.
+namespace mori::fs {
+    using path = std::filesystem::path;
+
+    // What stat reports about a file, after following symbolic links.
+    struct status {
+        std::filesystem::file_type type = std::filesystem::file_type::none;
+        std::filesystem::perms permissions = std::filesystem::perms::unknown;
+        std::uint64_t size = 0;
+        std::chrono::sys_time<std::chrono::nanoseconds> modified{};
+    };
+
+    // The largest file read_file accepts unless told otherwise.
+    inline constexpr std::size_t default_read_limit = std::size_t(1) << 20;
+
+    namespace detail {
+        enum class fs_kind : std::uint8_t { rename, stat, remove, create_directories, read_file };
+        // The system call an operation is waiting for.
+        enum class fs_call : std::uint8_t { none, rename, stat, unlink, mkdir, open, read, close };
+
+        [[nodiscard]] inline std::filesystem::file_type file_type_of(unsigned mode) noexcept {
+            using std::filesystem::file_type;
+            switch (mode & S_IFMT) {
+            case S_IFREG:
+                return file_type::regular;
+            case S_IFDIR:
+                return file_type::directory;
+            case S_IFLNK:
+                return file_type::symlink;
+            case S_IFBLK:
+                return file_type::block;
+            case S_IFCHR:
+                return file_type::character;
+            case S_IFIFO:
+                return file_type::fifo;
+            case S_IFSOCK:
+                return file_type::socket;
+            default:
+                return file_type::unknown;
+            }
+        }
+
+        [[nodiscard]] inline status make_status(unsigned mode, std::uint64_t size, std::int64_t seconds,
+            std::int64_t nanoseconds) noexcept {
+            return {file_type_of(mode), static_cast<std::filesystem::perms>(mode & 07777), size,
+                std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::seconds(seconds)
+                    + std::chrono::nanoseconds(nanoseconds))};
+        }
+
+        // The end of the path component that starts at or after from, skipping separators.
+        [[nodiscard]] inline std::size_t component_end(const char* p, std::size_t from) noexcept {
+            while (p[from] == '/') {
+                ++from;
+            }
+            while (p[from] != '\0' && p[from] != '/') {
+                ++from;
+            }
+            return from;
+        }
+
+        // One operation as a sequence of system calls. call is the next one to make; whoever runs the operation
+        // makes it and hands its result (a value, or -errno) to advance(), which picks the following call or sets
+        // call to none once the operation is complete. Paths are borrowed and must outlive the operation.
+        struct fs_operation {
+            fs_operation(fs_kind kind, const char* source, const char* target = nullptr,
+                std::size_t limit = default_read_limit) noexcept : kind(kind), source(source), target(target), limit(limit) {
+                switch (kind) {
+                case fs_kind::rename:
+                    call = fs_call::rename;
+                    break;
+                case fs_kind::stat:
+                    call = fs_call::stat;
+                    break;
+                case fs_kind::remove:
+                    call = fs_call::unlink;
+                    break;
+                case fs_kind::create_directories:
+                    call = fs_call::mkdir;
+                    break;
+                case fs_kind::read_file:
+                    call = fs_call::open;
+                    break;
+                }
+            }
+
+            // The directory a mkdir call creates: the whole path, or one of its parents once those turn out to be
+            // missing.
+            [[nodiscard]] const char* directory() const noexcept { return prefix == npos ? source : parent.c_str(); }
+
+            void advance(long result) noexcept {
+                const fs_call done = call;
+                call = fs_call::none;
+                switch (kind) {
+                case fs_kind::rename:
+                case fs_kind::stat:
+                    fail_if(result);
+                    break;
+                case fs_kind::remove:
+                    // Linux refuses to unlink a directory with EISDIR, POSIX with EPERM; either way, try rmdir.
+                    if (result == 0 || result == -ENOENT) {
+                        flag = result == 0;
+                    }
+                    else if ((result == -EISDIR || result == -EPERM) && flags == 0) {
+                        flags = AT_REMOVEDIR;
+                        call = fs_call::unlink;
+                    }
+                    else {
+                        error = flags == AT_REMOVEDIR && result == -ENOTDIR ? EPERM : static_cast<int>(-result);
+                    }
+                    break;
+                case fs_kind::create_directories:
+                    advance_create(done, result);
+                    break;
+                case fs_kind::read_file:
+                    advance_read(done, result);
+                    break;
+                }
+            }
+
+            // Makes each call in turn on this thread until the operation is complete.
+            void run() noexcept {
+                while (call != fs_call::none) {
+                    advance(perform());
+                }
+            }
+
+            template<class T>
+            [[nodiscard]] Result<T> outcome() {
+                if (error != 0) [[unlikely]] {
+                    return unexpected(Error(std::error_code(error, std::system_category()), message_of()));
+                }
+                if constexpr (std::is_void_v<T>) {
+                    return {};
+                }
+                else if constexpr (std::is_same_v<T, status>) {
+                    return info;
+                }
+                else if constexpr (std::is_same_v<T, bool>) {
+                    return flag;
+                }
+                else {
+                    return std::move(data);
+                }
+            }
+
+            static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+            fs_kind kind;
+            fs_call call = fs_call::none;
+            // Whether remove removed something and create_directories created something.
+            bool flag = false;
+            int flags = 0;
+            int fd = -1;
+            // The errno to report, or 0 on success.
+            int error = 0;
+            // Where a batch stores the result, among the results of the same type.
+            std::size_t index = 0;
+            const char* source;
+            const char* target;
+            std::size_t limit;
+            std::size_t filled = 0;
+            // create_directories: the end of the parent in parent, or npos while working on the whole path.
+            std::size_t prefix = npos;
+            std::string parent;
+            std::string data;
+            status info;
+
+        private:
+            void fail_if(long result) noexcept {
+                if (result < 0) {
+                    error = static_cast<int>(-result);
+                }
+            }
+
+            // mkdir the whole path; when that fails with ENOENT, mkdir each parent from the root down and then the
+            // path itself. An existing path only counts as success when it is a directory.
+            void advance_create(fs_call done, long result) noexcept {
+                if (done == fs_call::stat) {
+                    fail_if(result);
+                    if (error == 0 && info.type != std::filesystem::file_type::directory) {
+                        error = ENOTDIR;
+                    }
+                    return;
+                }
+                std::size_t end = std::strlen(source);
+                while (end > 1 && source[end - 1] == '/') {
+                    --end;
+                }
+                if (prefix == npos && result == -ENOENT) {
+                    const std::size_t first = component_end(source, 0);
+                    if (first >= end) {
+                        error = ENOENT;
+                        return;
+                    }
+                    set_parent(first);
+                    return;
+                }
+                if (result != 0 && result != -EEXIST) {
+                    error = static_cast<int>(-result);
+                }
+                else if (prefix != npos && prefix < end) {
+                    set_parent(component_end(source, prefix));
+                }
+                else if (result == 0) {
+                    flag = true;
+                }
+                else {
+                    call = fs_call::stat;
+                }
+            }
+
+            void set_parent(std::size_t end) noexcept {
+                try {
+                    parent.assign(source, end);
+                }
+                catch (const std::bad_alloc&) {
+                    error = ENOMEM;
+                    return;
+                }
+                prefix = end;
+                call = fs_call::mkdir;
+            }
+
+            // open, read until end of file into a buffer that doubles up to limit + 1 bytes, then close.
+            void advance_read(fs_call done, long result) noexcept {
+                switch (done) {
+                case fs_call::open:
+                    if (result < 0) {
+                        error = static_cast<int>(-result);
+                        return;
+                    }
+                    fd = static_cast<int>(result);
+                    call = grow() ? fs_call::read : fs_call::close;
+                    return;
+                case fs_call::read:
+                    if (result == -EINTR) {
+                        call = fs_call::read;
+                        return;
+                    }
+                    if (result <= 0) {
+                        fail_if(result);
+                        data.resize(filled);
+                        call = fs_call::close;
+                        return;
+                    }
+                    filled += static_cast<std::size_t>(result);
+                    if (filled > limit) {
+                        error = EFBIG;
+                        call = fs_call::close;
+                    }
+                    else {
+                        call = filled < data.size() || grow() ? fs_call::read : fs_call::close;
+                    }
+                    return;
+                default:
+                    // There is nothing useful to do about a failed close of a file that was only read.
+                    fd = -1;
+                    return;
+                }
+            }
+
+            [[nodiscard]] bool grow() noexcept {
+                const std::size_t most = limit == std::numeric_limits<std::size_t>::max() ? limit : limit + 1;
+                try {
+                    data.resize(std::min(std::max<std::size_t>(data.size() * 2, 4096), most));
+                }
+                catch (const std::bad_alloc&) {
+                    error = ENOMEM;
+                    return false;
+                }
+                return true;
+            }
+
+            [[nodiscard]] long perform() noexcept {
+                long result = 0;
+                switch (call) {
+                case fs_call::rename:
+                    result = ::rename(source, target);
+                    break;
+                case fs_call::stat: {
+                    struct ::stat st;
+                    result = ::stat(source, &st);
+                    if (result == 0) {
+                        info = make_status(st.st_mode, static_cast<std::uint64_t>(st.st_size), st.st_mtim.tv_sec,
+                            st.st_mtim.tv_nsec);
+                    }
+                    break;
+                }
+                case fs_call::unlink:
+                    result = ::unlinkat(AT_FDCWD, source, flags);
+                    break;
+                case fs_call::mkdir:
+                    result = ::mkdir(directory(), 0777);
+                    break;
+                case fs_call::open:
+                    result = ::open(source, O_RDONLY | O_CLOEXEC);
+                    break;
+                case fs_call::read:
+                    result = ::pread(fd, data.data() + filled, data.size() - filled, static_cast<off_t>(filled));
+                    break;
+                case fs_call::close:
+                    result = ::close(fd);
+                    break;
+                case fs_call::none:
+                    break;
+                }
+                return result < 0 ? -errno : result;
+            }
+
+            [[nodiscard]] message_id message_of() const noexcept {
+                switch (kind) {
+                case fs_kind::rename:
+                    return message<"rename failed">;
+                case fs_kind::stat:
+                    return message<"stat failed">;
+                case fs_kind::remove:
+                    return message<"remove failed">;
+                case fs_kind::create_directories:
+                    return message<"create_directories failed">;
+                default:
+                    return message<"read_file failed">;
+                }
+            }
+        };
+
+#if MORI_HAS_IO_URING
+        // A minimal io_uring instance driven through the raw system calls: submission and completion rings mapped
+        // into the process, one submission entry per operation in flight.
+        class uring {
+        public:
+            // Returns nullptr when io_uring cannot be set up here or lacks one of the operations fs_operation makes.
+            [[nodiscard]] static std::unique_ptr<uring> create(unsigned entries) noexcept {
+                if (unsupported.load(std::memory_order_relaxed)) {
+                    return nullptr;
+                }
+                io_uring_params params{};
+                params.flags = IORING_SETUP_CLAMP;
+                const int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+                if (fd < 0) {
+                    unsupported.store(true, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                std::unique_ptr<uring> ring(new (std::nothrow) uring(fd));
+                if (ring == nullptr) {
+                    ::close(fd);
+                    return nullptr;
+                }
+                if (!ring->map(params) || !ring->supports_operations()) {
+                    unsupported.store(true, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                return ring;
+            }
+
+            uring(const uring&) = delete;
+            uring& operator=(const uring&) = delete;
+            ~uring() {
+                if (sqes != nullptr) {
+                    ::munmap(sqes, sqe_bytes);
+                }
+                if (cq_ring != nullptr && cq_ring != sq_ring) {
+                    ::munmap(cq_ring, cq_bytes);
+                }
+                if (sq_ring != nullptr) {
+                    ::munmap(sq_ring, sq_bytes);
+                }
+                ::close(fd);
+            }
+
+            [[nodiscard]] unsigned capacity() const noexcept { return entries; }
+
+            // Queues op's next call, to be submitted by the next enter(). stx receives the result of a stat call.
+            void push(const fs_operation& op, struct ::statx& stx, std::uint64_t user_data) noexcept {
+                io_uring_sqe& sqe = sqes[tail & sq_mask];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.user_data = user_data;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<std::uintptr_t>(op.source);
+                switch (op.call) {
+                case fs_call::rename:
+                    sqe.opcode = IORING_OP_RENAMEAT;
+                    sqe.len = static_cast<std::uint32_t>(AT_FDCWD);
+                    sqe.addr2 = reinterpret_cast<std::uintptr_t>(op.target);
+                    break;
+                case fs_call::stat:
+                    sqe.opcode = IORING_OP_STATX;
+                    sqe.len = STATX_BASIC_STATS;
+                    sqe.addr2 = reinterpret_cast<std::uintptr_t>(&stx);
+                    break;
+                case fs_call::unlink:
+                    sqe.opcode = IORING_OP_UNLINKAT;
+                    sqe.unlink_flags = static_cast<std::uint32_t>(op.flags);
+                    break;
+                case fs_call::mkdir:
+                    sqe.opcode = IORING_OP_MKDIRAT;
+                    sqe.addr = reinterpret_cast<std::uintptr_t>(op.directory());
+                    sqe.len = 0777;
+                    break;
+                case fs_call::open:
+                    sqe.opcode = IORING_OP_OPENAT;
+                    sqe.open_flags = O_RDONLY | O_CLOEXEC;
+                    break;
+                case fs_call::read:
+                    sqe.opcode = IORING_OP_READ;
+                    sqe.fd = op.fd;
+                    sqe.addr = reinterpret_cast<std::uintptr_t>(op.data.data() + op.filled);
+                    sqe.len = static_cast<std::uint32_t>(
+                        std::min<std::size_t>(op.data.size() - op.filled, std::numeric_limits<std::uint32_t>::max()));
+                    sqe.off = op.filled;
+                    break;
+                case fs_call::close:
+                case fs_call::none:
+                    sqe.opcode = IORING_OP_CLOSE;
+                    sqe.fd = op.fd;
+                    sqe.addr = 0;
+                    break;
+                }
+                ++tail;
+            }
+
+            // Submits everything pushed so far and waits until at least wait_for completions are available.
+            void enter(unsigned wait_for) noexcept {
+                std::atomic_ref(*sq_tail).store(tail, std::memory_order_release);
+                for (;;) {
+                    const unsigned pending = tail - std::atomic_ref(*sq_head).load(std::memory_order_acquire);
+                    if (pending == 0 && wait_for == 0) {
+                        return;
+                    }
+                    const long result = ::syscall(__NR_io_uring_enter, fd, pending, wait_for,
+                        wait_for != 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+                    if (result >= 0) {
+                        return;
+                    }
+                    // EAGAIN and EBUSY ask for completions to be reaped first, which the caller does next.
+                    if (errno == EAGAIN || errno == EBUSY) {
+                        return;
+                    }
+                    if (errno != EINTR) {
+                        mori::detail::panic("io_uring_enter failed");
+                    }
+                }
+            }
+
+            // Calls f(user_data, result) for every completion available.
+            template<class F>
+            void reap(F&& f) noexcept {
+                unsigned head = *cq_head;
+                const unsigned end = std::atomic_ref(*cq_tail).load(std::memory_order_acquire);
+                for (; head != end; ++head) {
+                    const io_uring_cqe& cqe = cqes[head & cq_mask];
+                    f(cqe.user_data, cqe.res);
+                }
+                std::atomic_ref(*cq_head).store(head, std::memory_order_release);
+            }
+
+        private:
+            explicit uring(int fd) noexcept : fd(fd) {}
+
+            [[nodiscard]] bool map(const io_uring_params& params) noexcept {
+                entries = params.sq_entries;
+                sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (single) {
+                    sq_bytes = cq_bytes = std::max(sq_bytes, cq_bytes);
+                }
+                sq_ring = map_region(sq_bytes, IORING_OFF_SQ_RING);
+                cq_ring = single ? sq_ring : map_region(cq_bytes, IORING_OFF_CQ_RING);
+                sqe_bytes = params.sq_entries * sizeof(io_uring_sqe);
+                sqes = static_cast<io_uring_sqe*>(map_region(sqe_bytes, IORING_OFF_SQES));
+                if (sq_ring == nullptr || cq_ring == nullptr || sqes == nullptr) {
+                    return false;
+                }
+                auto* sq = static_cast<std::byte*>(sq_ring);
+                auto* cq = static_cast<std::byte*>(cq_ring);
+                sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+                sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+                sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+                cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+                cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+                cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+                cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+                tail = *sq_tail;
+                // Submission entry i always goes in slot i, so the indirection array is filled in once.
+                auto* array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+                for (unsigned i = 0; i < params.sq_entries; ++i) {
+                    array[i] = i;
+                }
+                return true;
+            }
+
+            [[nodiscard]] void* map_region(std::size_t bytes, std::uint64_t offset) const noexcept {
+                void* region = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    static_cast<off_t>(offset));
+                return region == MAP_FAILED ? nullptr : region;
+            }
+
+            [[nodiscard]] bool supports_operations() const noexcept {
+                constexpr unsigned max_ops = 256;
+                alignas(io_uring_probe) std::byte buffer[sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op)]{};
+                auto* probe = reinterpret_cast<io_uring_probe*>(buffer);
+                if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, max_ops) < 0) {
+                    return false;
+                }
+                for (const unsigned op : {IORING_OP_RENAMEAT, IORING_OP_STATX, IORING_OP_UNLINKAT, IORING_OP_MKDIRAT,
+                         IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE}) {
+                    if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Set once io_uring turns out to be missing, so later batches go straight to the thread pool.
+            static inline std::atomic<bool> unsupported{false};
+
+            int fd;
+            unsigned entries = 0;
+            void* sq_ring = nullptr;
+            void* cq_ring = nullptr;
+            std::size_t sq_bytes = 0;
+            std::size_t cq_bytes = 0;
+            std::size_t sqe_bytes = 0;
+            io_uring_sqe* sqes = nullptr;
+            io_uring_cqe* cqes = nullptr;
+            unsigned* sq_head = nullptr;
+            unsigned* sq_tail = nullptr;
+            unsigned* cq_head = nullptr;
+            unsigned* cq_tail = nullptr;
+            unsigned sq_mask = 0;
+            unsigned cq_mask = 0;
+            // The submission tail as this process sees it; published to the kernel by enter().
+            unsigned tail = 0;
+        };
+#endif
+    }
+
+    [[nodiscard]] inline Result<void> rename(const path& from, const path& to) noexcept {
+        detail::fs_operation op(detail::fs_kind::rename, from.c_str(), to.c_str());
+        op.run();
+        return op.outcome<void>();
+    }
+
+    [[nodiscard]] inline Result<status> stat(const path& p) noexcept {
+        detail::fs_operation op(detail::fs_kind::stat, p.c_str());
+        op.run();
+        return op.outcome<status>();
+    }
+
+    // Removes a file or an empty directory. Like std::filesystem::remove, returns false when there was nothing to
+    // remove.
+    [[nodiscard]] inline Result<bool> remove(const path& p) noexcept {
+        detail::fs_operation op(detail::fs_kind::remove, p.c_str());
+        op.run();
+        return op.outcome<bool>();
+    }
+
+    // Creates p and any missing parents. Returns false when p already was a directory.
+    [[nodiscard]] inline Result<bool> create_directories(const path& p) noexcept {
+        detail::fs_operation op(detail::fs_kind::create_directories, p.c_str());
+        op.run();
+        return op.outcome<bool>();
+    }
+
+    // Reads a whole file, failing with file_too_large when it holds more than limit bytes.
+    [[nodiscard]] inline Result<std::string> read_file(const path& p, std::size_t limit = default_read_limit) noexcept {
+        detail::fs_operation op(detail::fs_kind::read_file, p.c_str(), nullptr, limit);
+        op.run();
+        return op.outcome<std::string>();
+    }
+
+    enum class backend { automatic, threads };
+
+    // Names the result of an operation queued on a batch.
+    template<class T>
+    struct ticket {
+        std::size_t index;
+    };
+
+    // Operations queued together and run concurrently. Queuing only records an operation; submit() starts what has
+    // been queued so far and wait() runs everything to completion, after which batch[ticket] holds each result.
+    // Operations run in no particular order, so ones that depend on each other belong in separate batches. Queuing
+    // and waiting are for one thread at a time.
+    class batch {
+    public:
+        // The number of operations a batch keeps in flight on its io_uring.
+        static constexpr unsigned ring_entries = 256;
+
+        // backend::threads skips io_uring even where it is available.
+        explicit batch(backend preferred = backend::automatic, thread_pool& pool = thread_pool::shared()) : pool(&pool) {
+#if MORI_HAS_IO_URING
+            if (preferred == backend::automatic) {
+                ring = detail::uring::create(ring_entries);
+            }
+            if (ring != nullptr) {
+                slots = std::make_unique<slot[]>(ring->capacity());
+                free_slots.reserve(ring->capacity());
+                for (unsigned i = ring->capacity(); i > 0; --i) {
+                    free_slots.push_back(i - 1);
+                }
+            }
+#else
+            static_cast<void>(preferred);
+#endif
+        }
+        batch(const batch&) = delete;
+        batch& operator=(const batch&) = delete;
+        // Waits for whatever was submitted, since the kernel may still be using the paths and buffers.
+        ~batch() {
+            submitted = started;
+            drain();
+        }
+
+        [[nodiscard]] bool uses_io_uring() const noexcept {
+#if MORI_HAS_IO_URING
+            return ring != nullptr;
+#else
+            return false;
+#endif
+        }
+
+        ticket<void> rename(const path& from, const path& to) {
+            return {queue(detail::fs_kind::rename, from, to, default_read_limit, renamed)};
+        }
+        ticket<status> stat(const path& p) {
+            return {queue(detail::fs_kind::stat, p, {}, default_read_limit, stats)};
+        }
+        ticket<bool> remove(const path& p) {
+            return {queue(detail::fs_kind::remove, p, {}, default_read_limit, flags)};
+        }
+        ticket<bool> create_directories(const path& p) {
+            return {queue(detail::fs_kind::create_directories, p, {}, default_read_limit, flags)};
+        }
+        ticket<std::string> read_file(const path& p, std::size_t limit = default_read_limit) {
+            return {queue(detail::fs_kind::read_file, p, {}, limit, contents)};
+        }
+
+        // Starts the operations queued since the last submit() without waiting for them. Without io_uring they are
+        // left for wait(), which runs them on the thread pool.
+        void submit() noexcept {
+            submitted = entries.size();
+#if MORI_HAS_IO_URING
+            if (ring != nullptr) {
+                fill();
+                ring->enter(0);
+            }
+#endif
+        }
+
+        // Runs every queued operation to completion.
+        void wait() noexcept {
+            submitted = entries.size();
+            drain();
+        }
+
+        template<class T>
+        [[nodiscard]] Result<T>& operator[](ticket<T> t) noexcept {
+            return results<T>()[t.index];
+        }
+        template<class T>
+        [[nodiscard]] const Result<T>& operator[](ticket<T> t) const noexcept {
+            return const_cast<batch&>(*this).results<T>()[t.index];
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept { return entries.size(); }
+
+        // Forgets every operation and result, after waiting for them, so the batch can be reused.
+        void clear() noexcept {
+            wait();
+            entries.clear();
+            renamed.clear();
+            stats.clear();
+            flags.clear();
+            contents.clear();
+            submitted = 0;
+            started = 0;
+        }
+
+    private:
+        // An operation with the paths it borrows. Entries live in a deque, so they never move once queued.
+        struct entry {
+            entry(detail::fs_kind kind, std::string first, std::string second, std::size_t limit) :
+                first(std::move(first)), second(std::move(second)),
+                op(kind, this->first.c_str(), this->second.c_str(), limit) {}
+            entry(const entry&) = delete;
+            entry& operator=(const entry&) = delete;
+
+            std::string first;
+            std::string second;
+            detail::fs_operation op;
+        };
+
+        template<class T>
+        std::size_t queue(detail::fs_kind kind, const path& first, const path& second, std::size_t limit,
+            std::deque<Result<T>>& out) {
+            const std::size_t index = out.size();
+            entries.emplace_back(kind, first.native(), second.native(), limit);
+            entries.back().op.index = index;
+            out.emplace_back();
+            return index;
+        }
+
+        template<class T>
+        [[nodiscard]] std::deque<Result<T>>& results() noexcept {
+            if constexpr (std::is_void_v<T>) {
+                return renamed;
+            }
+            else if constexpr (std::is_same_v<T, status>) {
+                return stats;
+            }
+            else if constexpr (std::is_same_v<T, bool>) {
+                return flags;
+            }
+            else {
+                return contents;
+            }
+        }
+
+        void complete(detail::fs_operation& op) noexcept {
+            switch (op.kind) {
+            case detail::fs_kind::rename:
+                renamed[op.index] = op.outcome<void>();
+                break;
+            case detail::fs_kind::stat:
+                stats[op.index] = op.outcome<status>();
+                break;
+            case detail::fs_kind::remove:
+            case detail::fs_kind::create_directories:
+                flags[op.index] = op.outcome<bool>();
+                break;
+            case detail::fs_kind::read_file:
+                contents[op.index] = op.outcome<std::string>();
+                break;
+            }
+        }
+
+        // Runs operations [started, submitted) to completion.
+        void drain() noexcept {
+#if MORI_HAS_IO_URING
+            if (ring != nullptr) {
+                while (started < submitted || in_flight > 0) {
+                    fill();
+                    ring->enter(in_flight > 0 ? 1 : 0);
+                    ring->reap([&](std::uint64_t index, int result) { completed(static_cast<unsigned>(index), result); });
+                }
+                return;
+            }
+#endif
+            struct job {
+                batch* self;
+                std::size_t begin;
+                std::size_t count;
+                std::size_t chunks;
+            };
+            const std::size_t count = submitted - started;
+            if (count == 0) {
+                return;
+            }
+            job j{this, started, count, std::min<std::size_t>(count, std::size_t(pool->concurrency()) * 4)};
+            pool->run_chunks(j.chunks, &j, [](void* p, std::size_t chunk) noexcept {
+                const job& j = *static_cast<const job*>(p);
+                const std::size_t end = j.begin + (chunk + 1) * j.count / j.chunks;
+                for (std::size_t i = j.begin + chunk * j.count / j.chunks; i < end; ++i) {
+                    detail::fs_operation& op = j.self->entries[i].op;
+                    op.run();
+                    j.self->complete(op);
+                }
+            });
+            started = submitted;
+        }
+
+#if MORI_HAS_IO_URING
+        struct slot {
+            std::size_t entry;
+            struct ::statx stx;
+        };
+
+        // Puts the first call of as many submitted operations as there are free slots on the ring.
+        void fill() noexcept {
+            while (started < submitted && !free_slots.empty()) {
+                const unsigned s = free_slots.back();
+                free_slots.pop_back();
+                slots[s].entry = started;
+                ring->push(entries[started].op, slots[s].stx, s);
+                ++started;
+                ++in_flight;
+            }
+        }
+
+        void completed(unsigned s, int result) noexcept {
+            detail::fs_operation& op = entries[slots[s].entry].op;
+            if (op.call == detail::fs_call::stat && result >= 0) {
+                const struct ::statx& stx = slots[s].stx;
+                op.info = detail::make_status(stx.stx_mode, stx.stx_size, stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec);
+            }
+            op.advance(result);
+            if (op.call != detail::fs_call::none) {
+                ring->push(op, slots[s].stx, s);
+                return;
+            }
+            complete(op);
+            free_slots.push_back(s);
+            --in_flight;
+        }
+
+        std::unique_ptr<detail::uring> ring;
+        std::unique_ptr<slot[]> slots;
+        std::vector<unsigned> free_slots;
+        unsigned in_flight = 0;
+#endif
+        thread_pool* pool;
+        std::deque<entry> entries;
+        // Entries handed to the backend, and entries it has started on.
+        std::size_t submitted = 0;
+        std::size_t started = 0;
+        std::deque<Result<void>> renamed;
+        std::deque<Result<status>> stats;
+        std::deque<Result<bool>> flags;
+        std::deque<Result<std::string>> contents;
+    };
+}
@@ -0,0 +1,404 @@
+#pragma once
+
+#include "expected.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Runs a fallible callable across a random-access range on a work-stealing thread pool and stops early on failure.
+//
+//     mori::expected<std::vector<Row>, Fault> rows = mori::parallel_transform(lines, parse_row);
+//     mori::expected<void, std::vector<Fault>> checked = mori::parallel_for_each(rows, validate, mori::all_errors);
+//
+// With first_error (the default) the result is the error of the lowest-index element that failed, exactly what a
+// sequential loop would report: elements after the lowest failure seen so far are skipped, while every element before
+// it still runs. With all_errors nothing is skipped and the errors come back in index order. Either way the values are
+// in index order and the outcome does not depend on how the threads were scheduled.
+namespace mori {
+    struct first_error_t {
+        explicit first_error_t() = default;
+    };
+    inline constexpr first_error_t first_error{};
+
+    struct all_errors_t {
+        explicit all_errors_t() = default;
+    };
+    inline constexpr all_errors_t all_errors{};
+
+    // A fixed set of worker threads, each with its own deque of tasks. Workers take their own tasks from the front and,
+    // when they run out, steal from the back of the others'. The thread that starts a job helps run it, so a pool of
+    // concurrency n has n - 1 workers and a pool of concurrency 1 runs everything on the caller.
+    class thread_pool {
+    public:
+        explicit thread_pool(unsigned concurrency = std::max(std::thread::hardware_concurrency(), 1u)) :
+            count(std::max(concurrency, 1u) - 1), queues(std::make_unique<queue[]>(count)) {
+            workers.reserve(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                workers.emplace_back([this, i] { work(i); });
+            }
+        }
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+        ~thread_pool() {
+            {
+                std::lock_guard lock(sleep_mutex);
+                stopping = true;
+            }
+            signal.notify_all();
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+
+        [[nodiscard]] unsigned concurrency() const noexcept { return static_cast<unsigned>(count) + 1; }
+
+        // The pool the algorithms use when none is given, sized to the machine.
+        [[nodiscard]] static thread_pool& shared() {
+            static thread_pool pool;
+            return pool;
+        }
+
+        // Calls run(job, chunk) for every chunk in [0, chunks) and returns once all have finished. Each worker is
+        // handed a contiguous block of chunks. run must not throw.
+        void run_chunks(std::size_t chunks, void* job, void (*run)(void*, std::size_t) noexcept) {
+            if (count == 0 || chunks <= 1) {
+                for (std::size_t c = 0; c < chunks; ++c) {
+                    run(job, c);
+                }
+                return;
+            }
+            std::atomic<std::size_t> remaining{chunks};
+            pending.fetch_add(static_cast<std::ptrdiff_t>(chunks), std::memory_order_release);
+            for (std::size_t w = 0; w < count; ++w) {
+                std::lock_guard lock(queues[w].mutex);
+                for (std::size_t c = w * chunks / count; c < (w + 1) * chunks / count; ++c) {
+                    queues[w].tasks.push_back({run, job, c, &remaining});
+                }
+            }
+            {
+                std::lock_guard lock(sleep_mutex);
+            }
+            signal.notify_all();
+
+            while (remaining.load(std::memory_order_acquire) != 0) {
+                if (try_run_one(0, false)) {
+                    continue;
+                }
+                std::unique_lock lock(sleep_mutex);
+                signal.wait(lock, [&] {
+                    return remaining.load(std::memory_order_acquire) == 0 || pending.load(std::memory_order_acquire) > 0;
+                });
+            }
+        }
+
+    private:
+        struct task {
+            void (*run)(void*, std::size_t) noexcept;
+            void* job;
+            std::size_t chunk;
+            std::atomic<std::size_t>* remaining;
+        };
+
+        struct alignas(64) queue {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        // Runs one task, looking in queue home first. Returns false when every queue is empty.
+        bool try_run_one(std::size_t home, bool owner) {
+            for (std::size_t k = 0; k < count; ++k) {
+                queue& q = queues[(home + k) % count];
+                std::unique_lock lock(q.mutex);
+                if (q.tasks.empty()) {
+                    continue;
+                }
+                task t;
+                if (owner && k == 0) {
+                    t = q.tasks.front();
+                    q.tasks.pop_front();
+                }
+                else {
+                    t = q.tasks.back();
+                    q.tasks.pop_back();
+                }
+                lock.unlock();
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                t.run(t.job, t.chunk);
+                // The waiting thread may return as soon as it sees zero, so the counter is not touched after this.
+                if (t.remaining->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    {
+                        std::lock_guard sleep(sleep_mutex);
+                    }
+                    signal.notify_all();
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void work(std::size_t index) {
+            for (;;) {
+                if (try_run_one(index, true)) {
+                    continue;
+                }
+                std::unique_lock lock(sleep_mutex);
+                signal.wait(lock, [&] { return stopping || pending.load(std::memory_order_acquire) > 0; });
+                if (stopping && pending.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+            }
+        }
+
+        // The number of workers, fixed before any of them starts.
+        const std::size_t count;
+        std::unique_ptr<queue[]> queues;
+        std::vector<std::thread> workers;
+        // Tasks pushed but not yet taken, across all queues.
+        std::atomic<std::ptrdiff_t> pending{0};
+        std::mutex sleep_mutex;
+        std::condition_variable signal;
+        bool stopping = false;
+    };
+
+    template<class R>
+    concept parallel_range = std::ranges::random_access_range<R> && std::ranges::sized_range<R>;
+
+    namespace detail {
+        template<class F, class R>
+        using parallel_result_t = std::remove_cvref_t<std::invoke_result_t<F&, std::ranges::range_reference_t<R>>>;
+
+        template<class F, class R>
+        concept parallel_callable = std::invocable<F&, std::ranges::range_reference_t<R>>
+            && is_expected_v<parallel_result_t<F, R>>;
+
+        template<class Policy, class E>
+        using parallel_errors_t = std::conditional_t<std::is_same_v<Policy, all_errors_t>, std::vector<E>, E>;
+
+        // The shared engine of the parallel algorithms: splits the range into chunks, calls f on each element, hands
+        // values to accept(state, value) for the chunk's own state and records errors. The callers combine the chunks
+        // in order afterwards.
+        template<class Policy, class R, class F, class State, class Accept>
+        class parallel_job {
+        public:
+            using result_type = parallel_result_t<F, R>;
+            using error_type = typename result_type::error_type;
+            static constexpr bool all = std::is_same_v<Policy, all_errors_t>;
+
+            struct alignas(64) chunk {
+                State state{};
+                std::conditional_t<all, std::vector<error_type>, std::optional<error_type>> errors;
+            };
+
+            parallel_job(R& range, F& f, Accept& accept, unsigned concurrency) :
+                first(std::ranges::begin(range)), size(static_cast<std::size_t>(std::ranges::size(range))), f(f),
+                accept(accept),
+                // Several chunks per thread lets stealing even out elements that take unequal time.
+                chunks(concurrency == 1 ? std::min<std::size_t>(size, 1) : std::min<std::size_t>(size, concurrency * 16u)) {}
+
+            std::vector<chunk>& run(thread_pool& pool) {
+                pool.run_chunks(chunks.size(), this,
+                    [](void* job, std::size_t c) noexcept { static_cast<parallel_job*>(job)->run_chunk(c); });
+#if MORI_HAS_EXCEPTIONS
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+#endif
+                return chunks;
+            }
+
+        private:
+            void run_chunk(std::size_t c) noexcept {
+                const std::size_t begin = c * size / chunks.size();
+                const std::size_t end = (c + 1) * size / chunks.size();
+                chunk& out = chunks[c];
+#if MORI_HAS_EXCEPTIONS
+                try {
+#endif
+                    if constexpr (requires { out.state.reserve(end - begin); }) {
+                        if (begin <= cutoff.load(std::memory_order_relaxed)) {
+                            out.state.reserve(end - begin);
+                        }
+                    }
+                    for (std::size_t i = begin; i < end; ++i) {
+                        if (i > cutoff.load(std::memory_order_relaxed)) {
+                            return;
+                        }
+                        result_type r = std::invoke(f, first[static_cast<std::iter_difference_t<iterator>>(i)]);
+                        if (r.has_value()) [[likely]] {
+                            if constexpr (std::is_void_v<typename result_type::value_type>) {
+                                accept(out.state);
+                            }
+                            else {
+                                accept(out.state, *std::move(r));
+                            }
+                        }
+                        else if constexpr (all) {
+                            out.errors.push_back(std::move(r).error());
+                        }
+                        else {
+                            out.errors.emplace(std::move(r).error());
+                            lower_cutoff(i);
+                            return;
+                        }
+                    }
+#if MORI_HAS_EXCEPTIONS
+                }
+                catch (...) {
+                    std::lock_guard lock(exception_mutex);
+                    if (!exception) {
+                        exception = std::current_exception();
+                    }
+                    lower_cutoff(0);
+                }
+#endif
+            }
+
+            // Elements past the cutoff are skipped; it only ever moves down.
+            void lower_cutoff(std::size_t i) noexcept {
+                std::size_t seen = cutoff.load(std::memory_order_relaxed);
+                while (i < seen && !cutoff.compare_exchange_weak(seen, i, std::memory_order_relaxed)) {
+                }
+            }
+
+            using iterator = std::ranges::iterator_t<R>;
+
+            iterator first;
+            std::size_t size;
+            F& f;
+            Accept& accept;
+            std::vector<chunk> chunks;
+            std::atomic<std::size_t> cutoff{std::numeric_limits<std::size_t>::max()};
+#if MORI_HAS_EXCEPTIONS
+            std::mutex exception_mutex;
+            std::exception_ptr exception;
+#endif
+        };
+
+        // Returns the first recorded error, or all of them in order, or nothing.
+        template<class Policy, class Chunks>
+        [[nodiscard]] auto take_errors(Chunks& chunks) {
+            using error_type = typename std::remove_cvref_t<decltype(chunks.front().errors)>::value_type;
+            std::optional<parallel_errors_t<Policy, error_type>> out;
+            for (auto& c : chunks) {
+                if constexpr (std::is_same_v<Policy, all_errors_t>) {
+                    if (!c.errors.empty()) {
+                        if (!out) {
+                            out.emplace();
+                        }
+                        out->insert(out->end(), std::make_move_iterator(c.errors.begin()),
+                            std::make_move_iterator(c.errors.end()));
+                    }
+                }
+                else if (c.errors) {
+                    out.emplace(std::move(*c.errors));
+                    break;
+                }
+            }
+            return out;
+        }
+    }
+
+    // Calls f on every element and collects the values in order, or reports the failures as described above.
+    template<class Policy = first_error_t, parallel_range R, detail::parallel_callable<R> F>
+    requires (!std::is_void_v<typename detail::parallel_result_t<F, R>::value_type>)
+    [[nodiscard]] auto parallel_transform(thread_pool& pool, R&& range, F f, Policy = Policy()) {
+        using result_type = detail::parallel_result_t<F, R>;
+        using T = typename result_type::value_type;
+        using E = typename result_type::error_type;
+        using out_type = expected<std::vector<T>, detail::parallel_errors_t<Policy, E>>;
+
+        auto accept = [](std::vector<T>& values, T&& value) { values.push_back(std::move(value)); };
+        detail::parallel_job<Policy, std::remove_reference_t<R>, F, std::vector<T>, decltype(accept)> job(range, f, accept,
+            pool.concurrency());
+        auto& chunks = job.run(pool);
+        if (auto errors = detail::take_errors<Policy>(chunks)) {
+            return out_type(unexpect, std::move(*errors));
+        }
+        std::vector<T> values;
+        values.reserve(static_cast<std::size_t>(std::ranges::size(range)));
+        for (auto& c : chunks) {
+            values.insert(values.end(), std::make_move_iterator(c.state.begin()), std::make_move_iterator(c.state.end()));
+        }
+        return out_type(std::in_place, std::move(values));
+    }
+
+    template<class Policy = first_error_t, parallel_range R, detail::parallel_callable<R> F>
+    [[nodiscard]] auto parallel_transform(R&& range, F f, Policy policy = Policy()) {
+        return parallel_transform(thread_pool::shared(), std::forward<R>(range), std::move(f), policy);
+    }
+
+    // Calls f on every element for its effects, discarding the values.
+    template<class Policy = first_error_t, parallel_range R, detail::parallel_callable<R> F>
+    [[nodiscard]] auto parallel_for_each(thread_pool& pool, R&& range, F f, Policy = Policy()) {
+        using E = typename detail::parallel_result_t<F, R>::error_type;
+        using out_type = expected<void, detail::parallel_errors_t<Policy, E>>;
+
+        struct nothing {};
+        auto accept = [](nothing&, auto&&...) {};
+        detail::parallel_job<Policy, std::remove_reference_t<R>, F, nothing, decltype(accept)> job(range, f, accept,
+            pool.concurrency());
+        if (auto errors = detail::take_errors<Policy>(job.run(pool))) {
+            return out_type(unexpect, std::move(*errors));
+        }
+        return out_type();
+    }
+
+    template<class Policy = first_error_t, parallel_range R, detail::parallel_callable<R> F>
+    [[nodiscard]] auto parallel_for_each(R&& range, F f, Policy policy = Policy()) {
+        return parallel_for_each(thread_pool::shared(), std::forward<R>(range), std::move(f), policy);
+    }
+
+    // Folds the values of f over the range into init with reduce. Each chunk is folded on its own and the chunks are
+    // then folded in order, so reduce must be associative; the result is deterministic for a given pool size.
+    template<class Policy = first_error_t, parallel_range R, class T, class Reduce, detail::parallel_callable<R> F>
+    requires (!std::is_void_v<typename detail::parallel_result_t<F, R>::value_type>)
+    [[nodiscard]] auto parallel_transform_reduce(thread_pool& pool, R&& range, T init, Reduce reduce, F f,
+        Policy = Policy()) {
+        using result_type = detail::parallel_result_t<F, R>;
+        using U = typename result_type::value_type;
+        using E = typename result_type::error_type;
+        using out_type = expected<T, detail::parallel_errors_t<Policy, E>>;
+
+        auto accept = [&reduce](std::optional<T>& folded, U&& value) {
+            if (folded) {
+                *folded = std::invoke(reduce, std::move(*folded), std::move(value));
+            }
+            else {
+                folded.emplace(std::move(value));
+            }
+        };
+        detail::parallel_job<Policy, std::remove_reference_t<R>, F, std::optional<T>, decltype(accept)> job(range, f,
+            accept, pool.concurrency());
+        auto& chunks = job.run(pool);
+        if (auto errors = detail::take_errors<Policy>(chunks)) {
+            return out_type(unexpect, std::move(*errors));
+        }
+        for (auto& c : chunks) {
+            if (c.state) {
+                init = std::invoke(reduce, std::move(init), std::move(*c.state));
+            }
+        }
+        return out_type(std::in_place, std::move(init));
+    }
+
+    template<class Policy = first_error_t, parallel_range R, class T, class Reduce, detail::parallel_callable<R> F>
+    [[nodiscard]] auto parallel_transform_reduce(R&& range, T init, Reduce reduce, F f, Policy policy = Policy()) {
+        return parallel_transform_reduce(thread_pool::shared(), std::forward<R>(range), std::move(init),
+            std::move(reduce), std::move(f), policy);
+    }
+}
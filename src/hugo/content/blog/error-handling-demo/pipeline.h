@@ -0,0 +1,217 @@
+#pragma once
+
+#include "expected.h"
+
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace mori {
+    namespace detail {
+        enum class stage_kind { and_then, or_else, transform, transform_error };
+
+        template<stage_kind Kind, class F>
+        struct stage {
+            static constexpr stage_kind kind = Kind;
+
+            F f;
+        };
+
+        // The expected the eager member function would return, used only to work out a pipeline's result type.
+        template<class Ex, class S>
+        struct after_stage;
+        template<class Ex, class F>
+        struct after_stage<Ex, stage<stage_kind::and_then, F>> {
+            using type = decltype(std::declval<Ex>().and_then(std::declval<F>()));
+        };
+        template<class Ex, class F>
+        struct after_stage<Ex, stage<stage_kind::or_else, F>> {
+            using type = decltype(std::declval<Ex>().or_else(std::declval<F>()));
+        };
+        template<class Ex, class F>
+        struct after_stage<Ex, stage<stage_kind::transform, F>> {
+            using type = decltype(std::declval<Ex>().transform(std::declval<F>()));
+        };
+        template<class Ex, class F>
+        struct after_stage<Ex, stage<stage_kind::transform_error, F>> {
+            using type = decltype(std::declval<Ex>().transform_error(std::declval<F>()));
+        };
+
+        template<class Ex, class... Stages>
+        struct chain_result {
+            using type = std::remove_cvref_t<Ex>;
+        };
+        template<class Ex, class S, class... Rest>
+        struct chain_result<Ex, S, Rest...> : chain_result<typename after_stage<Ex, S>::type, Rest...> {};
+
+        // Invokes f with v, or with nothing when v stands in for the value of an expected<void, E>.
+        template<class F, class V>
+        constexpr decltype(auto) invoke_stage(F&& f, V&& v) {
+            if constexpr (std::is_same_v<std::remove_cvref_t<V>, void_value>) {
+                return std::invoke(std::forward<F>(f));
+            }
+            else {
+                return std::invoke(std::forward<F>(f), std::forward<V>(v));
+            }
+        }
+    }
+
+    // A chain of monadic operations over an expected, evaluated in a single pass when it is converted back into an
+    // expected. The value or error is handed from stage to stage by reference rather than being moved into a new
+    // expected after every step, and a trailing transform or transform_error constructs its result directly in the
+    // returned expected:
+    //
+    //     Result<Record> r = mori::pipe(parse(text)).and_then(validate).transform(normalize).or_else(recover);
+    //
+    // The result is the same as calling the member functions one after another. A pipeline refers to its source and
+    // must be consumed within the full-expression that creates it; every operation is &&-qualified to enforce that.
+    template<class Source, class... Stages>
+    class [[nodiscard]] pipeline {
+    public:
+        using result_type = typename detail::chain_result<Source, Stages...>::type;
+
+        pipeline(const pipeline&) = delete;
+        pipeline& operator=(const pipeline&) = delete;
+
+        template<class F>
+        [[nodiscard]] constexpr auto and_then(F&& f) && {
+            return std::move(*this).template then<detail::stage_kind::and_then>(std::forward<F>(f));
+        }
+        template<class F>
+        [[nodiscard]] constexpr auto or_else(F&& f) && {
+            return std::move(*this).template then<detail::stage_kind::or_else>(std::forward<F>(f));
+        }
+        template<class F>
+        [[nodiscard]] constexpr auto transform(F&& f) && {
+            return std::move(*this).template then<detail::stage_kind::transform>(std::forward<F>(f));
+        }
+        template<class F>
+        [[nodiscard]] constexpr auto transform_error(F&& f) && {
+            return std::move(*this).template then<detail::stage_kind::transform_error>(std::forward<F>(f));
+        }
+
+        [[nodiscard]] constexpr result_type run() && {
+            if (source.has_value()) {
+                if constexpr (std::is_void_v<typename std::remove_cvref_t<Source>::value_type>) {
+                    return on_value<0>(detail::void_value{});
+                }
+                else {
+                    return on_value<0>(*std::forward<Source>(source));
+                }
+            }
+            return on_error<0>(std::forward<Source>(source).error());
+        }
+        constexpr operator result_type() && { return std::move(*this).run(); }
+
+    private:
+        template<class, class...>
+        friend class pipeline;
+        template<class Ex> requires (detail::is_expected_v<std::remove_cvref_t<Ex>>)
+        friend constexpr pipeline<Ex&&> pipe(Ex&& source) noexcept;
+
+        static constexpr std::size_t size = sizeof...(Stages);
+
+        constexpr pipeline(Source source, std::tuple<Stages...>&& stages) :
+            source(std::forward<Source>(source)), stages(std::move(stages)) {}
+
+        template<detail::stage_kind Kind, class F>
+        constexpr auto then(F&& f) && {
+            using S = detail::stage<Kind, std::decay_t<F>>;
+            return pipeline<Source, Stages..., S>(
+                std::forward<Source>(source),
+                std::tuple_cat(std::move(stages), std::tuple<S>(S{std::forward<F>(f)})));
+        }
+
+        template<class V>
+        [[nodiscard]] static constexpr result_type value_of(V&& v) {
+            (void)v;
+            if constexpr (std::is_void_v<typename result_type::value_type>) {
+                return result_type();
+            }
+            else {
+                return result_type(std::in_place, std::forward<V>(v));
+            }
+        }
+
+        // Continues with the value held by an expected that a stage returned.
+        template<std::size_t I, class Ex>
+        [[nodiscard]] constexpr result_type resume(Ex&& next) {
+            if (next.has_value()) {
+                if constexpr (std::is_void_v<typename std::remove_cvref_t<Ex>::value_type>) {
+                    return on_value<I>(detail::void_value{});
+                }
+                else {
+                    return on_value<I>(*std::move(next));
+                }
+            }
+            return on_error<I>(std::move(next).error());
+        }
+
+        template<std::size_t I, class V>
+        [[nodiscard]] constexpr result_type on_value(V&& v) {
+            if constexpr (I == size) {
+                return value_of(std::forward<V>(v));
+            }
+            else {
+                using S = std::tuple_element_t<I, std::tuple<Stages...>>;
+                auto&& f = std::move(std::get<I>(stages).f);
+                if constexpr (S::kind == detail::stage_kind::and_then) {
+                    return resume<I + 1>(detail::invoke_stage(std::move(f), std::forward<V>(v)));
+                }
+                else if constexpr (S::kind == detail::stage_kind::transform) {
+                    using U = decltype(detail::invoke_stage(std::move(f), std::forward<V>(v)));
+                    if constexpr (std::is_void_v<U>) {
+                        detail::invoke_stage(std::move(f), std::forward<V>(v));
+                        return on_value<I + 1>(detail::void_value{});
+                    }
+                    else if constexpr (I + 1 == size) {
+                        return result_type(detail::invoke_value, [&]() -> U {
+                            return detail::invoke_stage(std::move(f), std::forward<V>(v));
+                        });
+                    }
+                    else {
+                        return on_value<I + 1>(detail::invoke_stage(std::move(f), std::forward<V>(v)));
+                    }
+                }
+                else {
+                    return on_value<I + 1>(std::forward<V>(v));
+                }
+            }
+        }
+
+        template<std::size_t I, class G>
+        [[nodiscard]] constexpr result_type on_error(G&& e) {
+            if constexpr (I == size) {
+                return result_type(unexpect, std::forward<G>(e));
+            }
+            else {
+                using S = std::tuple_element_t<I, std::tuple<Stages...>>;
+                auto&& f = std::move(std::get<I>(stages).f);
+                if constexpr (S::kind == detail::stage_kind::or_else) {
+                    return resume<I + 1>(std::invoke(std::move(f), std::forward<G>(e)));
+                }
+                else if constexpr (S::kind == detail::stage_kind::transform_error) {
+                    if constexpr (I + 1 == size) {
+                        return result_type(detail::invoke_error, std::move(f), std::forward<G>(e));
+                    }
+                    else {
+                        return on_error<I + 1>(std::invoke(std::move(f), std::forward<G>(e)));
+                    }
+                }
+                else {
+                    return on_error<I + 1>(std::forward<G>(e));
+                }
+            }
+        }
+
+        Source source;
+        std::tuple<Stages...> stages;
+    };
+
+    template<class Ex> requires (detail::is_expected_v<std::remove_cvref_t<Ex>>)
+    [[nodiscard]] constexpr pipeline<Ex&&> pipe(Ex&& source) noexcept {
+        return pipeline<Ex&&>(std::forward<Ex>(source), std::tuple<>());
+    }
+}
@@ -1,13 +1,66 @@
 #pragma once
 
+#include "error.h"
 #include "expected.h"
+#include "expected_fwd.h"
 
-namespace mori {
-    class Error {};
+#include <source_location>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
+namespace mori {
+    // Records the caller's location in r's error, if it holds one, for propagating a result unchanged:
+    //     return mori::trace(load(path));
     template<class T>
-    using Result = expected<T, Error>;
+    [[nodiscard]] Result<T> trace(Result<T>&& r, std::source_location where = std::source_location::current()) {
+        if (!r.has_value()) {
+            r.error().trace(where);
+        }
+        return std::move(r);
+    }
+
+    namespace detail {
+        // What Ok(...) and friends evaluate to: a tag and the arguments, converting to whichever expected the return
+        // statement or parameter needs. The conversion returns that expected constructed from the tag and arguments,
+        // so the value or error is built straight in the destination object. Lvalue arguments are held by reference and
+        // rvalues are moved in, so a builder kept in a variable past the end of its full-expression still owns the
+        // temporaries it was given instead of referring to destroyed ones.
+        template<class Tag, class... Args>
+        class [[nodiscard]] result_builder {
+        public:
+            constexpr explicit result_builder(Tag tag, Args&&... args)
+                noexcept((std::is_nothrow_constructible_v<Args, Args&&> && ...)) :
+                tag(tag), args(std::forward<Args>(args)...) {}
+            result_builder(const result_builder&) = delete;
+            result_builder& operator=(const result_builder&) = delete;
+
+            template<class T, class E> requires (detail::constructible<expected<T, E>, Tag, Args...>)
+            constexpr operator expected<T, E>() && {
+                return std::apply([this](Args&&... a) { return expected<T, E>(tag, std::forward<Args>(a)...); },
+                    std::move(args));
+            }
+
+        private:
+            Tag tag;
+            std::tuple<Args...> args;
+        };
+
+        template<class Tag, class... Args>
+        [[nodiscard]] constexpr result_builder<Tag, Args...> build_result(Tag tag, Args&&... args)
+            noexcept((std::is_nothrow_constructible_v<Args, Args&&> && ...)) {
+            return result_builder<Tag, Args...>(tag, std::forward<Args>(args)...);
+        }
+    }
 }
 
-#define Ok(...) {std::in_place __VA_OPT__(, ) __VA_ARGS__}
-#define Err(...) {unexpect __VA_OPT__(, ) __VA_ARGS__}
+// Return a value or an error constructed in place in the function's expected:
+//     return Ok(std::move(name), 42);            // expected(std::in_place, std::move(name), 42)
+//     return Err(std::errc::invalid_argument);   // expected(unexpect, std::errc::invalid_argument)
+// An rvalue argument costs one move on the way, into the Ok(...) expression itself. OkWith and ErrWith construct the
+// value from what a callable returns instead, with no move even for large or immovable types:
+//     return OkWith(parse_record, text);         // expected(in_place_from, parse_record, text)
+#define Ok(...) ::mori::detail::build_result(::mori::detail::in_place_arg(std::in_place) __VA_OPT__(, ) __VA_ARGS__)
+#define Err(...) ::mori::detail::build_result(::mori::detail::unexpect_arg(::mori::unexpect) __VA_OPT__(, ) __VA_ARGS__)
+#define OkWith(...) ::mori::detail::build_result(::mori::detail::in_place_from_arg(::mori::in_place_from), __VA_ARGS__)
+#define ErrWith(...) ::mori::detail::build_result(::mori::detail::unexpect_from_arg(::mori::unexpect_from), __VA_ARGS__)
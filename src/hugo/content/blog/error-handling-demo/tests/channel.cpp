@@ -0,0 +1,229 @@
+#include "channel.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    enum class Fault { bad_row, shutdown };
+
+    using Item = mori::expected<int, Fault>;
+
+    void test_order_and_close() {
+        // Channel operations run outside assert(), which NDEBUG compiles out.
+        mori::spsc_channel<int, Fault> ch(3);
+        const mori::channel_status pushed[] = {ch.try_push(1), ch.try_push(mori::unexpected(Fault::bad_row)),
+            ch.try_push(3), ch.try_push(4), ch.try_push(5)};
+        assert(pushed[0] == mori::channel_status::ok && pushed[1] == mori::channel_status::ok);
+        assert(pushed[2] == mori::channel_status::ok && pushed[3] == mori::channel_status::ok);
+        // Capacity is rounded up to a power of two.
+        assert(pushed[4] == mori::channel_status::full);
+
+        const std::optional<Item> first = ch.pop();
+        const std::optional<Item> second = ch.pop();
+        assert(**first == 1);
+        assert(second->error() == Fault::bad_row);
+        const bool closed = ch.close();
+        const bool closed_again = ch.close();
+        assert(closed && !closed_again && ch.is_closed());
+        const bool pushed_closed = ch.push(6);
+        const mori::channel_status tried_closed = ch.try_push(6);
+        assert(!pushed_closed && tried_closed == mori::channel_status::closed);
+        // What was pushed before close() is still delivered.
+        const std::optional<Item> third = ch.pop();
+        const std::optional<Item> fourth = ch.try_pop();
+        assert(**third == 3 && **fourth == 4);
+        const std::optional<Item> drained = ch.pop();
+        const std::optional<Item> tried_drained = ch.try_pop();
+        assert(!drained && !tried_drained && ch.error() == nullptr);
+    }
+
+    void test_poison() {
+        const auto payload = std::make_shared<int>(7);
+        {
+            mori::mpmc_channel<std::shared_ptr<int>, Fault> ch(8);
+            const bool pushed = ch.push(payload);
+            const bool pushed_again = ch.push(payload);
+            assert(pushed && pushed_again);
+            assert(payload.use_count() == 3);
+            const bool closed = ch.close(Fault::shutdown);
+            const bool closed_again = ch.close(Fault::bad_row);
+            assert(closed && !closed_again);
+            // Consumers stop at once; the items left behind go with the channel.
+            const bool popped = ch.pop().has_value();
+            const bool tried = ch.try_pop().has_value();
+            assert(!popped && !tried);
+            std::vector<mori::expected<std::shared_ptr<int>, Fault>> batch;
+            const std::size_t taken = ch.pop_some(batch, 4);
+            assert(taken == 0 && batch.empty());
+            assert(ch.error() != nullptr && *ch.error() == Fault::shutdown);
+        }
+        assert(payload.use_count() == 1);
+    }
+
+    // A push that fails leaves the item with the caller.
+    void test_failed_push_keeps_item() {
+        mori::spsc_channel<std::string, Fault> ch(2);
+        const bool pushed = ch.push(std::string(100, 'a'));
+        const bool pushed_again = ch.push(std::string(100, 'b'));
+        assert(pushed && pushed_again);
+        mori::expected<std::string, Fault> item = std::string(100, 'c');
+        const mori::channel_status tried = ch.try_push(std::move(item));
+        assert(tried == mori::channel_status::full && item->size() == 100);
+        const bool closed = ch.close();
+        assert(closed);
+        const bool pushed_closed = ch.push(std::move(item));
+        assert(!pushed_closed && item->size() == 100);
+    }
+
+    // One producer and one consumer in batches; order is preserved.
+    void test_spsc_batches() {
+        constexpr int count = 100'000;
+        mori::spsc_channel<int, Fault> ch(64);
+        std::thread producer([&] {
+            std::vector<Item> batch;
+            for (int i = 0; i < count; i += 10) {
+                batch.clear();
+                for (int j = i; j < i + 10; ++j) {
+                    batch.push_back(j % 1000 == 0 ? Item(mori::unexpect, Fault::bad_row) : Item(j));
+                }
+                const bool pushed = ch.push_all(batch);
+                assert(pushed);
+            }
+            ch.close();
+        });
+        int next = 0;
+        int errors = 0;
+        std::vector<Item> batch;
+        while (ch.pop_some(batch, 32) != 0) {
+            for (const Item& item : batch) {
+                if (item) {
+                    assert(*item == next);
+                }
+                else {
+                    assert(next % 1000 == 0);
+                    ++errors;
+                }
+                ++next;
+            }
+            batch.clear();
+        }
+        producer.join();
+        assert(next == count && errors == count / 1000);
+    }
+
+    // Several producers and consumers, mixing single items and batches; nothing is lost or duplicated.
+    void test_mpmc() {
+        constexpr int producers = 4;
+        constexpr int consumers = 3;
+        constexpr int per_producer = 50'000;
+        mori::mpmc_channel<int, Fault> ch(128);
+        std::atomic<int> producing{producers};
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                std::vector<Item> batch;
+                for (int i = 0; i < per_producer; ++i) {
+                    const int v = p * per_producer + i;
+                    if (p % 2 == 0) {
+                        const bool pushed = ch.push(v);
+                        assert(pushed);
+                        continue;
+                    }
+                    batch.emplace_back(v);
+                    if (batch.size() == 16 || i + 1 == per_producer) {
+                        const bool pushed = ch.push_all(batch);
+                        assert(pushed);
+                        batch.clear();
+                    }
+                }
+                if (producing.fetch_sub(1) == 1) {
+                    ch.close();
+                }
+            });
+        }
+        std::vector<std::vector<int>> seen(consumers);
+        for (int c = 0; c < consumers; ++c) {
+            threads.emplace_back([&, c] {
+                std::vector<Item> batch;
+                for (;;) {
+                    if (c == 0) {
+                        const std::optional<Item> item = ch.pop();
+                        if (!item) {
+                            return;
+                        }
+                        seen[c].push_back(**item);
+                    }
+                    else {
+                        if (ch.pop_some(batch, 8) == 0) {
+                            return;
+                        }
+                        for (const Item& item : batch) {
+                            seen[c].push_back(*item);
+                        }
+                        batch.clear();
+                    }
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        std::vector<bool> received(producers * per_producer);
+        for (const std::vector<int>& values : seen) {
+            for (const int v : values) {
+                assert(!received[v]);
+                received[v] = true;
+            }
+        }
+        for (const bool r : received) {
+            assert(r);
+        }
+    }
+
+    // Closing with an error wakes consumers waiting on an empty channel and producers waiting on a full one.
+    void test_poison_wakes_waiters() {
+        mori::mpmc_channel<int, Fault> empty(4);
+        mori::mpmc_channel<int, Fault> full(2);
+        const bool pushed = full.push(1);
+        const bool pushed_again = full.push(2);
+        assert(pushed && pushed_again);
+        std::vector<std::thread> threads;
+        std::atomic<int> woken{0};
+        for (int i = 0; i < 3; ++i) {
+            threads.emplace_back([&] {
+                if (!empty.pop()) {
+                    ++woken;
+                }
+            });
+            threads.emplace_back([&] {
+                if (!full.push(3)) {
+                    ++woken;
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        const bool closed_empty = empty.close(Fault::shutdown);
+        const bool closed_full = full.close(Fault::shutdown);
+        assert(closed_empty && closed_full);
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        assert(woken == 6);
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_order_and_close();
+    test_poison();
+    test_failed_push_keeps_item();
+    test_spsc_batches();
+    test_mpmc();
+    test_poison_wakes_waiters();
+    return 0;
+}
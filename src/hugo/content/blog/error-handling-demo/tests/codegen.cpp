@@ -0,0 +1,399 @@
+// Disassembles the probes in tests/codegen/probes.cpp and checks them against the baseline checked in for this
+// toolchain: no probe may grow by an instruction, the happy path of a probe may not call into exception or unwind
+// machinery, small results must come back in registers, and the object's code may not grow in total. A failure prints
+// the difference between the baseline's assembly and the current one.
+//
+//     codegen-test <probes object> <baseline> [--update]
+//
+// --update rewrites the baseline from the current object; the codegen-baseline target runs it. Without a baseline or
+// a readable object the check exits with 77, which CTest reports as skipped rather than passed.
+//
+// Only GCC 12 on x86-64 has a baseline (tests/codegen/gnu-12-x86_64.txt), so that is the only toolchain the check
+// covers; Clang, other GCC releases and other architectures are skipped until someone with that toolchain runs the
+// codegen-baseline target and checks in the file it writes.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    // The exit code CTest is told means "skipped" (SKIP_RETURN_CODE).
+    constexpr int exit_skipped = 77;
+
+    // Probes that return an expected small and trivially copyable enough for the ABI to return in registers.
+    constexpr std::string_view register_returns[] = {
+        "codegen_return_value",
+        "codegen_return_either",
+        "codegen_return_pointer",
+        "codegen_return_reference",
+        "codegen_return_error_code",
+        "codegen_return_pointer_or_code",
+        "codegen_propagate",
+        "codegen_and_then",
+        "codegen_or_else",
+        "codegen_error_set_widen",
+        "codegen_error_set_widen_status",
+    };
+
+    struct function {
+        // One instruction per line, without addresses, encodings or padding.
+        std::vector<std::string> lines;
+        // What the function refers to through relocations: calls, jumps to other sections, data.
+        std::vector<std::string> symbols;
+        int instructions = 0;
+    };
+
+    struct listing {
+        std::map<std::string, function> functions;
+        std::size_t text_size = 0;
+    };
+
+    [[nodiscard]] std::optional<std::string> run(const std::string& command) {
+        FILE* out = popen(command.c_str(), "r");
+        if (out == nullptr) {
+            return std::nullopt;
+        }
+        std::string text;
+        char buffer[4096];
+        while (const std::size_t n = std::fread(buffer, 1, sizeof(buffer), out)) {
+            text.append(buffer, n);
+        }
+        return pclose(out) == 0 ? std::optional(std::move(text)) : std::nullopt;
+    }
+
+    [[nodiscard]] std::string_view trim(std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\n')) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    [[nodiscard]] bool is_probe(std::string_view name) {
+        return name.starts_with("codegen_");
+    }
+
+    // Alignment padding between and after functions.
+    [[nodiscard]] bool is_padding(std::string_view instruction) {
+        return instruction.starts_with("nop") || instruction.starts_with("data16") || instruction == "xchg %ax,%ax";
+    }
+
+    // "js     68 <codegen_return_either+0x18>  # comment" becomes "js <+0x18>": the mnemonic and its operands, one
+    // space apart, with branch targets relative to the function. Sets has_target when the operand was a branch target.
+    [[nodiscard]] std::string normalize(std::string_view text, std::string_view function_name, bool& has_target) {
+        if (const std::size_t comment = text.find(" #"); comment != std::string_view::npos) {
+            text = text.substr(0, comment);
+        }
+        text = trim(text);
+        const std::size_t space = text.find(' ');
+        if (space == std::string_view::npos) {
+            has_target = false;
+            return std::string(text);
+        }
+        const std::string_view mnemonic = text.substr(0, space);
+        std::string_view operands = trim(text.substr(space));
+        has_target = false;
+        if (const std::size_t open = operands.find(" <"); open != std::string_view::npos && operands.ends_with('>')
+            && operands.substr(0, open).find_first_not_of("0123456789abcdef") == std::string_view::npos) {
+            has_target = true;
+            std::string_view target = operands.substr(open + 2, operands.size() - open - 3);
+            if (target.starts_with(function_name) && target.substr(function_name.size()).starts_with('+')) {
+                target.remove_prefix(function_name.size());
+            }
+            return std::string(mnemonic) + " <" + std::string(target) + ">";
+        }
+        return std::string(mnemonic) + " " + std::string(operands);
+    }
+
+    // Parses objdump -d -r output into the functions it lists.
+    [[nodiscard]] std::map<std::string, function> parse_disassembly(const std::string& text) {
+        std::map<std::string, function> functions;
+        function* current = nullptr;
+        std::string current_name;
+        bool last_has_target = false;
+        std::istringstream in(text);
+        for (std::string line; std::getline(in, line);) {
+            const std::string_view l(line);
+            if (l.empty() || l.starts_with("Disassembly of section")) {
+                continue;
+            }
+            if (l.ends_with(">:") && l.find(" <") != std::string_view::npos && l.front() != ' ') {
+                const std::size_t open = l.find(" <");
+                current_name = std::string(l.substr(open + 2, l.size() - open - 4));
+                current = &functions[current_name];
+                continue;
+            }
+            if (current == nullptr) {
+                continue;
+            }
+            if (l.starts_with("\t\t\t")) {
+                // A relocation against the previous instruction: "f5: R_X86_64_PLT32\tcodegen_source-0x4".
+                const std::size_t tab = l.rfind('\t');
+                std::string symbol(trim(l.substr(tab + 1)));
+                if (symbol.ends_with("-0x4")) {
+                    symbol.resize(symbol.size() - 4);
+                }
+                current->symbols.push_back(symbol);
+                if (!current->lines.empty()) {
+                    std::string& previous = current->lines.back();
+                    if (last_has_target) {
+                        previous = previous.substr(0, previous.find(' ')) + " " + symbol;
+                    }
+                    else {
+                        previous += "  # " + symbol;
+                    }
+                }
+                continue;
+            }
+            const std::size_t colon = l.find(":\t");
+            if (colon == std::string_view::npos) {
+                continue;
+            }
+            const std::string_view instruction = trim(l.substr(colon + 2));
+            if (is_padding(instruction)) {
+                last_has_target = false;
+                continue;
+            }
+            const std::string& normalized =
+                current->lines.emplace_back(normalize(instruction, current_name, last_has_target));
+            ++current->instructions;
+            // A call or jump to another function in the same section needs no relocation.
+            if (const std::size_t open = normalized.find(" <"); last_has_target && normalized[open + 2] != '+') {
+                const std::string_view target(normalized.data() + open + 2, normalized.size() - open - 3);
+                current->symbols.emplace_back(target.substr(0, target.find('+')));
+            }
+        }
+        return functions;
+    }
+
+    // Sums the sections holding code in objdump -h output.
+    [[nodiscard]] std::size_t parse_text_size(const std::string& text) {
+        std::size_t total = 0;
+        std::istringstream in(text);
+        for (std::string line; std::getline(in, line);) {
+            std::istringstream fields(line);
+            std::string index;
+            std::string name;
+            std::string size;
+            if (fields >> index >> name >> size && name.starts_with(".text")) {
+                total += std::strtoull(size.c_str(), nullptr, 16);
+            }
+        }
+        return total;
+    }
+
+    [[nodiscard]] std::optional<listing> disassemble(const std::string& object) {
+        const std::optional<std::string> code = run(std::string(MORI_OBJDUMP) + " -d -r --no-show-raw-insn '" + object + "'");
+        const std::optional<std::string> headers = run(std::string(MORI_OBJDUMP) + " -h '" + object + "'");
+        if (!code || !headers) {
+            return std::nullopt;
+        }
+        listing result;
+        for (auto& [name, f] : parse_disassembly(*code)) {
+            // Only probes are compared one by one; the library code they pull in counts toward the total size.
+            if (is_probe(name)) {
+                result.functions.emplace(name, std::move(f));
+            }
+        }
+        result.text_size = parse_text_size(*headers);
+        return result;
+    }
+
+    // The baseline file: "text <bytes>", then for each probe "function <name> <instructions>" followed by its
+    // instructions, each on a line starting with a tab.
+    [[nodiscard]] std::optional<listing> read_baseline(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            return std::nullopt;
+        }
+        listing result;
+        function* current = nullptr;
+        for (std::string line; std::getline(in, line);) {
+            if (line.starts_with('\t') && current != nullptr) {
+                current->lines.push_back(line.substr(1));
+                continue;
+            }
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "text") {
+                fields >> result.text_size;
+            }
+            else if (kind == "function") {
+                std::string name;
+                fields >> name;
+                current = &result.functions[name];
+                fields >> current->instructions;
+            }
+        }
+        return result;
+    }
+
+    [[nodiscard]] bool write_baseline(const std::string& path, const listing& current) {
+        std::ofstream out(path);
+        out << "# Generated by codegen-test --update (the codegen-baseline target) for " << MORI_CODEGEN_TOOLCHAIN
+            << ".\n";
+        out << "text " << current.text_size << "\n";
+        for (const auto& [name, f] : current.functions) {
+            out << "function " << name << " " << f.instructions << "\n";
+            for (const std::string& line : f.lines) {
+                out << "\t" << line << "\n";
+            }
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Prints a line diff of two listings, from the longest common subsequence.
+    void print_diff(const std::vector<std::string>& before, const std::vector<std::string>& after) {
+        const std::size_t n = before.size();
+        const std::size_t m = after.size();
+        std::vector<std::vector<std::size_t>> common(n + 1, std::vector<std::size_t>(m + 1));
+        for (std::size_t i = n; i-- > 0;) {
+            for (std::size_t j = m; j-- > 0;) {
+                common[i][j] = before[i] == after[j] ? common[i + 1][j + 1] + 1
+                                                     : std::max(common[i + 1][j], common[i][j + 1]);
+            }
+        }
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while (i < n || j < m) {
+            if (i < n && j < m && before[i] == after[j]) {
+                std::printf("      %s\n", before[i].c_str());
+                ++i;
+                ++j;
+            }
+            else if (j < m && (i == n || common[i][j + 1] >= common[i + 1][j])) {
+                std::printf("    + %s\n", after[j++].c_str());
+            }
+            else {
+                std::printf("    - %s\n", before[i++].c_str());
+            }
+        }
+    }
+
+    [[nodiscard]] bool is_exception_machinery(std::string_view symbol) {
+        return symbol.starts_with("__cxa_")
+            || symbol.starts_with("_Unwind_")
+            || symbol.starts_with("__gxx_personality")
+            || symbol.starts_with("_ZSt9terminate")
+            || symbol.find("__throw_") != std::string_view::npos
+            || symbol.find("throw_bad_expected_access") != std::string_view::npos;
+    }
+
+    // The System V ABI passes the address of a result returned in memory in %rdi.
+    [[nodiscard]] bool stores_through_rdi(const function& f) {
+        for (const std::string& line : f.lines) {
+            if (line.starts_with("mov") && line.ends_with("(%rdi)")) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Compares the current code with the baseline and returns the number of failed checks.
+    [[nodiscard]] int check(const listing& baseline, const listing& current) {
+        int failures = 0;
+        int improved = 0;
+        for (const auto& [name, f] : current.functions) {
+            const auto it = baseline.functions.find(name);
+            if (it == baseline.functions.end()) {
+                std::printf("FAIL %s: not in the baseline; run the codegen-baseline target\n", name.c_str());
+                ++failures;
+                continue;
+            }
+            const function& before = it->second;
+            if (f.instructions > before.instructions) {
+                std::printf("FAIL %s: %d instructions, baseline %d\n", name.c_str(), f.instructions,
+                    before.instructions);
+                print_diff(before.lines, f.lines);
+                ++failures;
+            }
+            else if (f.lines != before.lines) {
+                std::printf("note %s: %d instructions, baseline %d\n", name.c_str(), f.instructions,
+                    before.instructions);
+                print_diff(before.lines, f.lines);
+                improved += f.instructions < before.instructions;
+            }
+            // GCC moves the unlikely paths of a function into <name>.cold, which is where a throw belongs.
+            if (!name.ends_with(".cold")) {
+                for (const std::string& symbol : f.symbols) {
+                    if (is_exception_machinery(symbol)) {
+                        std::printf("FAIL %s: calls %s outside its cold path\n", name.c_str(), symbol.c_str());
+                        print_diff(before.lines, f.lines);
+                        ++failures;
+                        break;
+                    }
+                }
+            }
+        }
+        for (const auto& [name, f] : baseline.functions) {
+            if (!current.functions.contains(name)) {
+                std::printf("FAIL %s: in the baseline but not in the object\n", name.c_str());
+                ++failures;
+            }
+        }
+#if defined(__x86_64__)
+        for (const std::string_view name : register_returns) {
+            const auto it = current.functions.find(std::string(name));
+            if (it != current.functions.end() && stores_through_rdi(it->second)) {
+                std::printf("FAIL %s: returns its result through memory\n", it->first.c_str());
+                print_diff(baseline.functions.contains(it->first) ? baseline.functions.at(it->first).lines
+                                                                  : std::vector<std::string>(),
+                    it->second.lines);
+                ++failures;
+            }
+        }
+#endif
+        if (current.text_size > baseline.text_size) {
+            std::printf("FAIL .text: %zu bytes, baseline %zu\n", current.text_size, baseline.text_size);
+            ++failures;
+        }
+        std::printf("%zu probes, .text %zu bytes (baseline %zu)\n", current.functions.size(), current.text_size,
+            baseline.text_size);
+        if (failures == 0 && (improved > 0 || current.text_size < baseline.text_size)) {
+            std::printf("The code got smaller; run the codegen-baseline target to lock that in.\n");
+        }
+        return failures;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <probes object> <baseline> [--update]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const std::string object = argv[1];
+    const std::string baseline_path = argv[2];
+    const bool update = argc > 3 && std::string_view(argv[3]) == "--update";
+
+    const std::optional<listing> current = disassemble(object);
+    if (!current || current->functions.empty()) {
+        std::printf("codegen-test: %s, cannot disassemble %s\n", update ? "failed" : "skipped", object.c_str());
+        return update ? EXIT_FAILURE : exit_skipped;
+    }
+    if (update) {
+        if (!write_baseline(baseline_path, *current)) {
+            std::fprintf(stderr, "cannot write %s\n", baseline_path.c_str());
+            return EXIT_FAILURE;
+        }
+        std::printf("wrote %s: %zu probes, .text %zu bytes\n", baseline_path.c_str(), current->functions.size(),
+            current->text_size);
+        return EXIT_SUCCESS;
+    }
+    const std::optional<listing> baseline = read_baseline(baseline_path);
+    if (!baseline) {
+        std::printf("codegen-test: skipped, no baseline for %s; run the codegen-baseline target to create %s\n",
+            MORI_CODEGEN_TOOLCHAIN, baseline_path.c_str());
+        return exit_skipped;
+    }
+    return check(*baseline, *current) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
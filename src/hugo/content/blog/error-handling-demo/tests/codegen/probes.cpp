@@ -0,0 +1,126 @@
+// Probe functions for codegen-test, compiled at -O2 into an object file that is disassembled rather than run. Each one
+// is a common way of using expected in a hot path, with C linkage so it is easy to find. The functions they call are
+// only declared, as they would be across translation units, so nothing is inlined or folded away.
+
+#include "error_set.h"
+#include "result.h"
+
+#include <system_error>
+#include <type_traits>
+
+namespace {
+    enum class Errc { bad_input = 1, overflow };
+    struct Empty {};
+
+    enum class Stage { refused = 1 };
+
+    using Small = mori::expected<int, Errc>;
+    using Narrow = mori::expected<int, mori::error_set<Errc>>;
+    using Wide = mori::expected<int, mori::error_set<Stage, Errc>>;
+
+    // What the System V ABI needs to return a result in registers; codegen-test checks that it happens.
+    template<class T>
+    constexpr bool fits_registers = std::is_trivially_copyable_v<T> && sizeof(T) <= 16;
+    static_assert(fits_registers<Small>);
+    static_assert(fits_registers<mori::expected<int*, Empty>>);
+    static_assert(fits_registers<mori::expected<const int&, Empty>>);
+    static_assert(fits_registers<mori::expected<void, std::error_code>>);
+    static_assert(fits_registers<mori::expected<int*, std::error_code>>);
+    static_assert(fits_registers<Wide>);
+}
+
+extern "C" {
+    Small codegen_source(int x) noexcept;
+    mori::Result<int> codegen_result_source(int x) noexcept;
+    Small codegen_half(int x) noexcept;
+    Narrow codegen_narrow_source(int x) noexcept;
+    mori::expected<void, mori::error_set<Errc>> codegen_narrow_status(int x) noexcept;
+
+    // Returning by value: small expected types come back in registers.
+    Small codegen_return_value(int x) {
+        return x;
+    }
+    Small codegen_return_either(int x) {
+        if (x < 0) {
+            return mori::unexpected(Errc::bad_input);
+        }
+        return x * 2;
+    }
+    mori::expected<int*, Empty> codegen_return_pointer(int* p) {
+        if (p == nullptr) {
+            return mori::unexpected(Empty{});
+        }
+        return p;
+    }
+    mori::expected<const int&, Empty> codegen_return_reference(const int* p) {
+        if (p == nullptr) {
+            return mori::unexpected(Empty{});
+        }
+        return *p;
+    }
+    mori::expected<void, std::error_code> codegen_return_error_code(int x) {
+        if (x < 0) {
+            return mori::unexpected(std::make_error_code(std::errc::invalid_argument));
+        }
+        return {};
+    }
+    mori::expected<int*, std::error_code> codegen_return_pointer_or_code(int* p) {
+        if (p == nullptr) {
+            return mori::unexpected(std::make_error_code(std::errc::invalid_argument));
+        }
+        return p;
+    }
+
+    // Passing an error up unchanged.
+    Small codegen_propagate(int x) {
+        const Small r = codegen_source(x);
+        if (!r) {
+            return mori::unexpected(r.error());
+        }
+        return *r + 1;
+    }
+    mori::Result<int> codegen_result_propagate(int x) {
+        mori::Result<int> r = codegen_result_source(x);
+        if (!r) {
+            return mori::unexpected(std::move(r).error());
+        }
+        return *r + 1;
+    }
+
+    int codegen_value_or(Small r) {
+        return r.value_or(-1);
+    }
+    int codegen_result_value_or(const mori::Result<int>& r) {
+        return r.value_or(-1);
+    }
+    // value() throws on an error, but the throw is outlined, so the path to the return has no calls.
+    int codegen_value(const Small& r) {
+        return r.value();
+    }
+
+    Small codegen_and_then(Small r) {
+        return r.and_then(codegen_half).and_then(codegen_half).transform([](int x) { return x + 1; });
+    }
+    Small codegen_or_else(Small r) {
+        return r.or_else([](Errc e) { return e == Errc::overflow ? Small(0) : Small(mori::unexpect, e); });
+    }
+
+    bool codegen_equals_unexpected(Small r) {
+        return r == mori::unexpected(Errc::overflow);
+    }
+    bool codegen_result_equals_value(const mori::Result<int>& r) {
+        return r == 42;
+    }
+
+    // Widening an error_set leaves the code as it is; at most the padding beside the tag is cleared.
+    Wide codegen_error_set_widen(int x) {
+        return codegen_narrow_source(x);
+    }
+    mori::expected<void, mori::error_set<Stage, Errc>> codegen_error_set_widen_status(int x) {
+        return codegen_narrow_status(x);
+    }
+    // visit compares the domain with constants, with no table or indirect call.
+    int codegen_error_set_visit(mori::error_set<Stage, Errc> e) {
+        return e.visit([](auto v) { return static_cast<int>(v) + (std::is_same_v<decltype(v), Stage> ? 10 : 20); });
+    }
+}
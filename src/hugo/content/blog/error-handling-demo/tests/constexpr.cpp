@@ -0,0 +1,280 @@
+// Every operation of expected, checked in static_asserts. The niches for pointers and std::error_code are left out:
+// their spare representations are not constant expressions (see spare_pointer).
+
+#include "result.h"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace {
+    enum class Fault { bad_row = 1, overflow, mori_spare };
+    struct Empty {};
+
+    using Number = mori::expected<int, Fault>;
+
+    // Copies can throw and moves cannot, which takes assignment and swap through a temporary.
+    struct Fragile {
+        constexpr explicit Fragile(int v) : v(v) {}
+        constexpr Fragile(const Fragile& other) : v(other.v) {}
+        constexpr Fragile(Fragile&& other) noexcept : v(other.v) {}
+        constexpr Fragile& operator=(const Fragile& other) {
+            v = other.v;
+            return *this;
+        }
+        constexpr Fragile& operator=(Fragile&& other) noexcept {
+            v = other.v;
+            return *this;
+        }
+        constexpr ~Fragile() {}
+
+        friend constexpr bool operator==(const Fragile&, const Fragile&) = default;
+
+        int v;
+    };
+
+    // Moves can throw too, which takes them through the try blocks that restore the old contents.
+    struct Sticky {
+        constexpr explicit Sticky(int v) : v(v) {}
+        constexpr Sticky(const Sticky& other) : v(other.v) {}
+        constexpr Sticky& operator=(const Sticky& other) {
+            v = other.v;
+            return *this;
+        }
+        constexpr ~Sticky() {}
+
+        friend constexpr bool operator==(const Sticky&, const Sticky&) = default;
+
+        int v;
+    };
+
+    // Construction and observers.
+    static_assert(Number(1).has_value() && *Number(1) == 1 && Number(1).value() == 1);
+    static_assert(!Number(mori::unexpect, Fault::bad_row) && Number(mori::unexpect, Fault::bad_row).error() == Fault::bad_row);
+    static_assert(Number().value() == 0);
+    static_assert(*Number(std::in_place, 2) == 2);
+    static_assert(Number(mori::unexpected(Fault::overflow)).error() == Fault::overflow);
+    static_assert(*Number(mori::in_place_from, [](int x) { return x * 3; }, 3) == 9);
+    static_assert(Number(mori::unexpect_from, [] { return Fault::bad_row; }).error() == Fault::bad_row);
+    static_assert(Number(2).value_or(5) == 2 && Number(mori::unexpected(Fault::bad_row)).value_or(5) == 5);
+    static_assert(Number(2).error_or(Fault::overflow) == Fault::overflow);
+    static_assert(mori::expected<long, Fault>(Number(4)).value() == 4);
+    static_assert(mori::expected<std::string, Fault>(std::in_place, 3, 'x')->size() == 3);
+    static_assert(mori::expected<std::string, Fault>(std::in_place, {'a', 'b'}).value() == "ab");
+    constexpr bool emplaces() {
+        mori::expected<std::string, Fault> s = mori::unexpected(Fault::bad_row);
+        // std::string's constructors can throw, which takes emplace through reconstruct.
+        const bool replaced = s.emplace("abc") == "abc";
+        Number n = mori::unexpected(Fault::bad_row);
+        return replaced && n.emplace_with([](int x) { return x + 1; }, 1) == 2 && *n == 2;
+    }
+    static_assert(emplaces());
+    constexpr mori::Result<int> ok_or_err(int x) {
+        if (x < 0) {
+            return Err(std::errc::invalid_argument);
+        }
+        return Ok(x);
+    }
+    static_assert(ok_or_err(1).value() == 1 && ok_or_err(-1).error() == std::errc::invalid_argument);
+
+    // Assignment in every combination of states, with trivial, allocating and throwing contents.
+    template<class T, class E>
+    constexpr bool assigns(T a, T b, E e) {
+        mori::expected<T, E> x = a;
+        mori::expected<T, E> y(mori::unexpect, e);
+        x = y;
+        bool ok = !x && x.error() == e;
+        x = b;
+        ok = ok && *x == b;
+        y = std::move(x);
+        ok = ok && *y == b;
+        y = mori::unexpected(e);
+        ok = ok && y.error() == e;
+        y = mori::expected<T, E>(a);
+        ok = ok && *y == a;
+        x = mori::expected<T, E>(mori::unexpect, e);
+        x = y;
+        ok = ok && *x == a;
+        x.emplace(b);
+        return ok && *x == b;
+    }
+    static_assert(assigns(1, 2, Fault::bad_row));
+    static_assert(assigns(std::string(40, 'a'), std::string(50, 'b'), std::string(60, 'e')));
+    static_assert(assigns(Fragile(1), Fragile(2), Fragile(3)));
+    static_assert(assigns(Sticky(1), Sticky(2), Fault::overflow));
+    static_assert(assigns(Fault::bad_row, Fault::overflow, Sticky(3)));
+
+    template<class T, class E>
+    constexpr bool swaps(T a, T b, E e, E f) {
+        mori::expected<T, E> v1 = a;
+        mori::expected<T, E> v2 = b;
+        mori::expected<T, E> e1(mori::unexpect, e);
+        mori::expected<T, E> e2(mori::unexpect, f);
+        swap(v1, v2);
+        bool ok = *v1 == b && *v2 == a;
+        swap(e1, e2);
+        ok = ok && e1.error() == f && e2.error() == e;
+        v1.swap(e1);
+        ok = ok && v1.error() == f && *e1 == b;
+        swap(e2, v2);
+        return ok && *e2 == a && v2.error() == e;
+    }
+    static_assert(swaps(1, 2, Fault::bad_row, Fault::overflow));
+    static_assert(swaps(std::string(40, 'a'), std::string(50, 'b'), std::string(60, 'e'), std::string(70, 'f')));
+    static_assert(swaps(Fragile(1), Fragile(2), Fragile(3), Fragile(4)));
+    static_assert(swaps(Sticky(1), Sticky(2), Fault::bad_row, Fault::overflow));
+
+    // Comparisons.
+    static_assert(Number(1) == Number(1) && Number(1) != Number(2));
+    static_assert(Number(1) != Number(mori::unexpect, Fault::bad_row));
+    static_assert(Number(1) == mori::expected<long, Fault>(1));
+    static_assert(Number(1) == 1 && Number(1) != 2);
+    static_assert(Number(mori::unexpect, Fault::bad_row) == mori::unexpected(Fault::bad_row));
+    static_assert(mori::unexpected(1) == mori::unexpected(1L));
+
+    // Monadic operations, on lvalues and rvalues.
+    constexpr Number half(int x) {
+        return x % 2 == 0 ? Number(x / 2) : Number(mori::unexpect, Fault::bad_row);
+    }
+    static_assert(*Number(8).and_then(half).and_then(half) == 2);
+    static_assert(Number(6).and_then(half).and_then(half).error() == Fault::bad_row);
+    static_assert(*Number(mori::unexpect, Fault::overflow).or_else([](Fault) { return Number(0); }) == 0);
+    static_assert(Number(4).transform([](int x) { return x + 1; }).value() == 5);
+    static_assert(Number(4).transform([](int) {}).has_value());
+    static_assert(Number(mori::unexpect, Fault::overflow).transform_error([](Fault f) { return static_cast<int>(f); })
+        .error() == 2);
+    constexpr bool lvalue_chains() {
+        const Number n = 8;
+        Number m = 3;
+        return n.and_then(half).value() == 4
+            && m.transform([](int& x) -> int& { return ++x; }).value() == 4 && *m == 4
+            && n.or_else([](Fault) { return Number(0); }).value() == 8
+            && n.transform_error([](Fault) { return 0; }).value() == 8;
+    }
+    static_assert(lvalue_chains());
+    static_assert(mori::expected<std::string, Fault>("abc").transform([](std::string s) { return s.size(); }).value() == 3);
+
+    // The void specialization.
+    using Status = mori::expected<void, Fault>;
+    constexpr bool void_status() {
+        Status s;
+        Status t = mori::unexpected(Fault::bad_row);
+        bool ok = s && !t;
+        swap(s, t);
+        ok = ok && !s && t;
+        s = t;
+        ok = ok && s == t;
+        s = mori::unexpected(Fault::overflow);
+        s.emplace();
+        s.value();
+        return ok && s.and_then([] { return Number(1); }).value() == 1
+            && Status(mori::unexpect, Fault::bad_row).transform([] { return 2; }).error() == Fault::bad_row
+            && Status(mori::unexpect, Fault::bad_row).or_else([](Fault) { return Status(); }).has_value()
+            && Status(mori::unexpect, Fault::bad_row).transform_error([](Fault) { return 3; }).error() == 3
+            && Status(mori::unexpect, Fault::bad_row) == mori::unexpected(Fault::bad_row);
+    }
+    static_assert(void_status());
+
+    // Niches whose spare representation is a constant: an enumerator, null for references, and Error's spare state.
+    constexpr bool niches() {
+        mori::expected<Empty, Fault> e = mori::unexpected(Fault::overflow);
+        bool ok = !e && e.error() == Fault::overflow;
+        e = Empty{};
+        ok = ok && e.has_value();
+        int a = 1;
+        int b = 2;
+        mori::expected<int&, Empty> r = a;
+        mori::expected<int&, Empty> s = mori::unexpected(Empty{});
+        swap(r, s);
+        ok = ok && !r && &*s == &a;
+        r = b;
+        ok = ok && *r == 2 && r.transform([](int& x) -> int& { return x; }).value() == 2;
+        mori::Result<void> v;
+        mori::Result<void> w = mori::unexpected(mori::Error(std::errc::invalid_argument));
+        swap(v, w);
+        return ok && !v && w && v.error() == std::errc::invalid_argument;
+    }
+    static_assert(niches());
+
+    // mori::Error itself: codes, copies and comparisons work at compile time; messages, payloads, context and traces
+    // need the process-wide registries and arenas, so they do not.
+    constexpr bool errors() {
+        const mori::Error a(std::errc::invalid_argument);
+        mori::Error b = a;
+        mori::Error c;
+        c = std::move(b);
+        return c == a && c.value() == static_cast<int>(std::errc::invalid_argument) && !(c == mori::Error());
+    }
+    static_assert(errors());
+
+    // A configuration table parsed at compile time: "port=80;port=443;limit=100". A bad table is a compile error
+    // where it is used through value(), since throwing is not a constant expression.
+    struct Limits {
+        std::array<int, 8> ports{};
+        std::size_t port_count = 0;
+        int limit = 0;
+    };
+
+    constexpr mori::Result<int> parse_number(std::string_view text) {
+        if (text.empty()) {
+            return mori::unexpected(mori::Error(std::errc::invalid_argument));
+        }
+        int n = 0;
+        for (const char c : text) {
+            if (c < '0' || c > '9') {
+                return mori::unexpected(mori::Error(std::errc::invalid_argument));
+            }
+            n = n * 10 + (c - '0');
+            if (n > 65535) {
+                return mori::unexpected(mori::Error(std::errc::result_out_of_range));
+            }
+        }
+        return n;
+    }
+
+    consteval mori::Result<Limits> parse_limits(std::string_view text) {
+        Limits limits;
+        while (!text.empty()) {
+            const std::size_t end = std::min(text.find(';'), text.size());
+            const std::string_view entry = text.substr(0, end);
+            text.remove_prefix(std::min(end + 1, text.size()));
+            const std::size_t eq = entry.find('=');
+            if (eq == std::string_view::npos) {
+                return mori::unexpected(mori::Error(std::errc::invalid_argument));
+            }
+            const std::string_view key = entry.substr(0, eq);
+            const mori::Result<int> value = parse_number(entry.substr(eq + 1));
+            if (!value) {
+                return mori::unexpected(value.error());
+            }
+            if (key == "port") {
+                if (limits.port_count == limits.ports.size()) {
+                    return mori::unexpected(mori::Error(std::errc::value_too_large));
+                }
+                limits.ports[limits.port_count++] = *value;
+            }
+            else if (key == "limit") {
+                limits.limit = *value;
+            }
+            else {
+                return mori::unexpected(mori::Error(std::errc::invalid_argument));
+            }
+        }
+        return limits;
+    }
+
+    constexpr Limits limits = parse_limits("port=80;port=443;limit=100").value();
+    static_assert(limits.port_count == 2 && limits.ports[1] == 443 && limits.limit == 100);
+    static_assert(parse_limits("port=80;speed=3").error() == std::errc::invalid_argument);
+    static_assert(parse_limits("port=99999").error() == std::errc::result_out_of_range);
+    static_assert(parse_limits("port=1;port=x").transform([](const Limits& l) { return l.limit; })
+        .error() == std::errc::invalid_argument);
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    // The table is embedded as constant data; nothing is parsed at run time.
+    return limits.ports[0] == 80 ? 0 : 1;
+}
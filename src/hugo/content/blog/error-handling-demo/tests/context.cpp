@@ -0,0 +1,169 @@
+#include "result.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace {
+    // Global allocations made since the last reset.
+    long allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    mori::Result<int> leaf(int row) {
+        if (row < 0) {
+            return mori::unexpected(mori::Error(std::errc::invalid_argument).with_payload(row));
+        }
+        return row;
+    }
+
+    template<int Depth>
+    mori::Result<int> chain(int row) {
+        if constexpr (Depth == 0) {
+            return leaf(row);
+        }
+        else {
+            return mori::trace(chain<Depth - 1>(row));
+        }
+    }
+
+    void test_locations() {
+        const mori::Result<int> r = chain<10>(-1);
+        assert(!r.has_value());
+        const auto locations = r.error().trace_locations();
+        assert(locations.size() == 10);
+        for (const auto& where : locations) {
+            assert(std::string_view(where.file_name()).ends_with("context.cpp"));
+            assert(std::string_view(where.function_name()).find("chain") != std::string_view::npos);
+        }
+        assert(r.error().payload<int>() == -1);
+        assert(chain<10>(3) == 3);
+    }
+
+    void test_messages() {
+        const std::string_view file = "data.csv";
+        mori::Error e(std::errc::invalid_argument);
+        e.trace("reading row {} of {}", 17, file);
+        e.trace("retrying", 2);
+        e.trace("giving up");
+        const std::string text = e.describe();
+        assert(text.find("reading row 17 of data.csv") != std::string::npos);
+        assert(text.find("retrying 2") != std::string::npos);
+        assert(text.find("giving up") != std::string::npos);
+        assert(text.find("reading row") < text.find("giving up"));
+        assert(e.trace_locations().size() == 3);
+    }
+
+    void test_no_allocations() {
+        (void)chain<10>(-1);
+        allocations = 0;
+        for (int i = 0; i < 1000; ++i) {
+            const mori::Result<int> r = chain<10>(-i - 1);
+            assert(r.error().payload<int>() == -i - 1);
+        }
+        assert(allocations == 0);
+    }
+
+    void test_copies() {
+        mori::Error e = mori::Error(std::errc::io_error).with_payload(std::uint16_t{1}).trace();
+        mori::Error copy = e;
+        copy.trace().with_payload(std::uint16_t{2});
+        e.trace().trace();
+        assert(e.trace_locations().size() == 3 && copy.trace_locations().size() == 2);
+        assert(e.payload<std::uint16_t>() == 1 && copy.payload<std::uint16_t>() == 2);
+
+        copy.attach("while syncing");
+        copy.trace();
+        assert(copy.trace_locations().size() == 3 && copy.payload<std::uint16_t>() == 2);
+        assert(copy.describe().find("[while syncing]") != std::string::npos);
+        mori::Error shared = copy;
+        shared.trace();
+        assert(shared.trace_locations().size() == 4 && copy.trace_locations().size() == 3);
+    }
+
+    // Once every traced error is gone the arena starts over, so a long run never runs out of space.
+    void test_arena_reuse() {
+        for (int i = 0; i < 100'000; ++i) {
+            const mori::Result<int> r = chain<10>(-1);
+            assert(r.error().trace_locations().size() == 10);
+        }
+    }
+
+    void test_arena_full() {
+        mori::Error e(std::errc::io_error);
+        for (int i = 0; i < 10'000; ++i) {
+            e.trace();
+        }
+        const std::size_t kept = e.trace_locations().size();
+        assert(kept > 100 && kept < 10'000);
+        // A trace that fills its arena drops its later frames, but new traces move on to a fresh arena.
+        const mori::Result<int> r = chain<4>(-1);
+        assert(r.error().payload<int>() == -1 && r.error().trace_locations().size() == 4);
+    }
+
+    // An error the program keeps holds its arena, which then never starts over; traces made after it must not be
+    // left without room once the frames they add up to pass the arena's size.
+    void test_arena_kept() {
+        const mori::Error kept = chain<3>(-1).error();
+        std::size_t traced = 0;
+        for (int i = 0; i < 10'000; ++i) {
+            const mori::Result<int> r = chain<10>(-1);
+            assert(r.error().trace_locations().size() == 10);
+            traced += 10 * sizeof(mori::detail::context_frame);
+        }
+        assert(traced > 4 * mori::detail::context_arena::capacity);
+        mori::Error extended = kept;
+        extended.trace();
+        assert(kept.trace_locations().size() == 3 && extended.trace_locations().size() == 4);
+    }
+
+    void test_threads() {
+        mori::Error e;
+        std::thread([&] { e = mori::Error(std::errc::timed_out).trace(); }).join();
+        // The arena outlives the thread that made it, and other threads cannot add to it.
+        e.trace();
+        assert(e.trace_locations().size() == 1);
+        assert(e.describe().find("test_threads") != std::string::npos);
+    }
+
+    void test_backtrace() {
+        const mori::Error e = mori::Error(std::errc::bad_address).trace_backtrace();
+        assert(e.trace_locations().size() == 1);
+#if MORI_HAS_BACKTRACE
+        assert(e.describe().find("#0 ") != std::string::npos);
+#endif
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_locations();
+    test_messages();
+    test_no_allocations();
+    test_copies();
+    test_arena_reuse();
+    test_arena_full();
+    test_arena_kept();
+    test_threads();
+    test_backtrace();
+    return 0;
+}
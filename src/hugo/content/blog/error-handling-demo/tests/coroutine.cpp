@@ -0,0 +1,139 @@
+#include "coroutine.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace {
+    // Global allocations made since the last reset, to check that coroutine frames come from the pool.
+    long allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    using Ex = mori::expected<int, std::string>;
+
+    Ex parse(int v) {
+        if (v < 0) {
+            return mori::unexpected(std::string("negative"));
+        }
+        return v;
+    }
+
+    Ex twice(int v) {
+        const int parsed = co_await parse(v);
+        co_return parsed * 2;
+    }
+
+    Ex sum(int a, int b) {
+        const int x = co_await twice(a);
+        const int y = co_await twice(b);
+        co_return x + y;
+    }
+
+    mori::expected<void, std::string> check(int v) {
+        co_await parse(v);
+    }
+
+    mori::expected<long, std::error_code> widen(mori::expected<int, std::errc> e) {
+        const int v = co_await e.transform_error([](std::errc c) { return std::make_error_code(c); });
+        co_return v;
+    }
+
+    int destroyed = 0;
+    struct Guard {
+        ~Guard() { ++destroyed; }
+    };
+
+    Ex guarded(int v) {
+        Guard g;
+        const int parsed = co_await parse(v);
+        co_return parsed;
+    }
+
+#if MORI_HAS_EXCEPTIONS
+    Ex throws(int v) {
+        co_await parse(v);
+        throw std::runtime_error("thrown");
+    }
+#endif
+
+    void test_values() {
+        assert(twice(4) == 8);
+        assert(sum(1, 2) == 6);
+        assert(check(1).has_value());
+        assert(widen(3) == 3L);
+    }
+
+    void test_errors() {
+        assert(twice(-1) == mori::unexpected(std::string("negative")));
+        assert(sum(1, -2) == mori::unexpected(std::string("negative")));
+        assert(check(-1).error() == "negative");
+        assert(widen(mori::unexpected(std::errc::invalid_argument)).error() == std::errc::invalid_argument);
+    }
+
+    void test_lvalues() {
+        const auto read = [](const Ex& source) -> Ex {
+            const int& v = co_await source;
+            co_return v + 1;
+        };
+        const Ex source = 1;
+        assert(read(source) == 2);
+        assert(source == 1);
+    }
+
+    void test_cleanup() {
+        destroyed = 0;
+        assert(guarded(1) == 1);
+        assert(guarded(-1).error() == "negative");
+        assert(destroyed == 2);
+
+#if MORI_HAS_EXCEPTIONS
+        bool caught = false;
+        try {
+            (void)throws(1);
+        }
+        catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+        assert(throws(-1).error() == "negative");
+#endif
+    }
+
+    // Once the pool has a frame of the right size, further calls do not touch the global allocator.
+    void test_frames_are_recycled() {
+        (void)sum(1, 2);
+        allocations = 0;
+        for (int i = 0; i < 100; ++i) {
+            assert(sum(i, 1) == 2 * i + 2);
+            assert(!sum(-1, i).has_value());
+        }
+        assert(allocations == 0);
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_values();
+    test_errors();
+    test_lvalues();
+    test_cleanup();
+    test_frames_are_recycled();
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include "result.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <new>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+    // Global allocations made since the last reset.
+    long allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    enum class Ingest { rejected = 1, truncated };
+
+    class ingest_category : public std::error_category {
+    public:
+        const char* name() const noexcept override { return "ingest"; }
+        std::string message(int code) const override { return code == 1 ? "rejected" : "truncated"; }
+    };
+
+    const std::error_category& ingest() {
+        static const ingest_category category;
+        return category;
+    }
+
+    std::error_code make_error_code(Ingest e) {
+        return {static_cast<int>(e), ingest()};
+    }
+}
+
+template<>
+struct std::is_error_code_enum<Ingest> : std::true_type {};
+
+namespace {
+    void test_codes() {
+        const mori::Error none;
+        assert(none.value() == 0 && none.category() == std::generic_category());
+
+        const mori::Error generic = std::errc::invalid_argument;
+        assert(generic.code() == std::errc::invalid_argument);
+        assert(generic == mori::Error(std::make_error_code(std::errc::invalid_argument)));
+
+        const mori::Error system = std::error_code(5, std::system_category());
+        assert(system.category() == std::system_category() && system.value() == 5);
+        assert(system != mori::Error(std::error_code(5, std::generic_category())));
+
+        const mori::Error custom = Ingest::truncated;
+        assert(custom.category() == ingest() && custom.code() == Ingest::truncated);
+        assert(mori::Error(std::future_errc::no_state).category() == std::future_category());
+    }
+
+    void test_messages() {
+        const mori::Error a(std::errc::invalid_argument, mori::message<"field out of range">);
+        const mori::Error b(Ingest::rejected, mori::message_id::intern("field out of range").value());
+        assert(a.message() == "field out of range");
+        assert(mori::message<"field out of range"> == mori::message_id::intern("field out of range"));
+        assert(mori::message_id::intern("") == mori::message_id());
+        assert(b.message() == a.message() && b.message().data() == a.message().data());
+        assert(mori::Error(std::errc::invalid_argument).message().empty());
+        assert(a.describe().find("field out of range") != std::string::npos);
+    }
+
+    void test_payload() {
+        mori::Error e = mori::Error(Ingest::truncated).with_payload(std::uint32_t{42});
+        assert(e.payload<std::uint32_t>() == 42u);
+        assert(!e.payload<std::uint64_t>().has_value());
+        e.with_payload(-1.5);
+        assert(e.payload<double>() == -1.5);
+        assert(!mori::Error().payload<int>().has_value());
+    }
+
+    void test_no_allocations() {
+        const mori::Error warm(Ingest::rejected, mori::message<"warm">);
+        // Per-thread state, such as the table MORI_ERROR_COUNTERS counts into, is set up on first use.
+        const mori::Result<int> warm_result = mori::unexpected(warm);
+        allocations = 0;
+        mori::Result<int> r = mori::unexpected(mori::Error(Ingest::rejected, mori::message<"bad row">).with_payload(7));
+        mori::Result<int> copy = r;
+        mori::Result<int> moved = std::move(r);
+        moved = copy;
+        assert(copy.error().payload<int>() == 7 && moved.error() == Ingest::rejected);
+        assert(allocations == 0);
+    }
+
+    void test_context() {
+        mori::Error e = mori::Error(std::errc::io_error).with_payload(std::uint16_t{3});
+        allocations = 0;
+        e.attach("while reading /var/spool/ingest/batch-0001.json");
+        assert(allocations > 0);
+        assert(e.context() == "while reading /var/spool/ingest/batch-0001.json");
+        assert(e.payload<std::uint16_t>() == 3);
+
+        // Copies share the context; changing it afterwards leaves the other copies alone.
+        allocations = 0;
+        mori::Error copy = e;
+        assert(allocations == 0 && copy.context() == e.context());
+        copy.attach("retried");
+        assert(copy.context() == "retried" && e.context() != "retried");
+        assert(copy.payload<std::uint16_t>() == 3);
+        e.with_payload(std::uint16_t{4});
+        assert(e.payload<std::uint16_t>() == 4 && copy.payload<std::uint16_t>() == 3);
+
+        mori::Error moved = std::move(copy);
+        assert(moved.context() == "retried");
+        assert(moved.describe().find("[retried]") != std::string::npos);
+    }
+
+    void test_result_void() {
+        mori::Result<void> ok;
+        assert(ok.has_value());
+        ok = mori::unexpected(mori::Error(std::errc::timed_out));
+        assert(!ok.has_value() && ok.error() == std::errc::timed_out);
+        ok.emplace();
+        assert(ok.has_value());
+    }
+}
+
+namespace {
+    class numbered_category : public std::error_category {
+    public:
+        const char* name() const noexcept override { return "numbered"; }
+        std::string message(int code) const override { return std::to_string(code); }
+    };
+
+    // Past the size of the category table, errors keep their category in an extension instead.
+    void test_many_categories() {
+        static const numbered_category categories[300];
+        std::vector<mori::Error> errors;
+        for (const numbered_category& category : categories) {
+            errors.emplace_back(std::error_code(7, category));
+        }
+        for (std::size_t i = 0; i < std::size(categories); ++i) {
+            const mori::Error copy = errors[i];
+            assert(copy.category() == categories[i] && copy.code() == std::error_code(7, categories[i]));
+            assert(copy == errors[i] && (i == 0 || copy != errors[i - 1]));
+            assert(copy.describe().starts_with("numbered:7"));
+        }
+        mori::Error last = errors.back();
+        last.with_payload(5).trace();
+        assert(last.category() == categories[299] && last.payload<int>() == 5 && last == errors.back());
+        const mori::Error moved = std::move(last);
+        assert(moved.category() == categories[299]);
+    }
+
+    // Run last: it uses up the part of the message table that is open to run-time text.
+    void test_interning_limit() {
+        std::size_t interned = 0;
+        while (mori::message_id::intern("message " + std::to_string(interned))) {
+            ++interned;
+        }
+        assert(interned > 40'000 && interned < 65'536);
+        // Text that is already interned is still found.
+        assert(mori::message_id::intern("message 0").has_value());
+        assert(!mori::message_id::intern("one more").has_value());
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_codes();
+    test_messages();
+    test_payload();
+    test_no_allocations();
+    test_context();
+    test_result_void();
+    test_many_categories();
+    test_interning_limit();
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Built twice: with MORI_ERROR_COUNTERS=1, checking what is counted where, and with 0, checking that nothing is.
+
+#include "error_counters.h"
+#include "result.h"
+
+#include <cassert>
+#include <cstring>
+#include <source_location>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+    enum class Fault { empty, too_long };
+
+    mori::expected<int, Fault> parse(const std::string& text) {
+        if (text.empty()) {
+            return mori::unexpected(Fault::empty);
+        }
+        if (text.size() > 3) {
+            return mori::expected<int, Fault>(mori::unexpect, Fault::too_long);
+        }
+        return static_cast<int>(text.size());
+    }
+
+#if MORI_ERROR_COUNTERS
+    // The counts for sites in this file in the given function, errors and values summed.
+    mori::error_site counted(const char* function) {
+        mori::error_site total;
+        for (const mori::error_site& site : mori::error_counts()) {
+            if (std::strstr(site.where.file_name(), "error_counters.cpp") != nullptr
+                && std::strstr(site.where.function_name(), function) != nullptr) {
+                total.errors += site.errors;
+                total.values += site.values;
+            }
+        }
+        return total;
+    }
+
+    void test_counts() {
+        for (int i = 0; i < 10; ++i) {
+            static_cast<void>(parse(""));
+            static_cast<void>(parse("abcd"));
+            static_cast<void>(parse("ab"));
+            static_cast<void>(parse("abc"));
+        }
+        const mori::error_site total = counted("parse");
+        assert(total.errors == 20 && total.values == 20);
+
+        // The two error sites are told apart by line.
+        std::size_t error_sites = 0;
+        for (const mori::error_site& site : mori::error_counts()) {
+            if (std::strstr(site.where.function_name(), "parse") != nullptr && site.errors != 0) {
+                assert(site.errors == 10 && site.values == 0);
+                ++error_sites;
+            }
+        }
+        assert(error_sites == 2);
+
+        const std::vector<mori::error_function> functions = mori::error_counts_by_function();
+        bool found = false;
+        for (const mori::error_function& f : functions) {
+            if (std::strstr(f.function, "parse") != nullptr) {
+                assert(f.errors == 20 && f.values == 20 && f.error_rate() == 0.5);
+                found = true;
+            }
+        }
+        assert(found);
+    }
+
+    void test_assignment_and_in_place() {
+        mori::expected<int, Fault> r = 1;
+        r = mori::unexpected(Fault::empty);
+        const mori::expected<std::string, Fault> s(std::in_place, 3, 'x');
+        const mori::expected<void, Fault> v(std::in_place);
+        const mori::unexpected<Fault> u(std::in_place, Fault::too_long);
+        assert(!r && *s == "xxx" && v && u.error() == Fault::too_long);
+        const mori::error_site total = counted("test_assignment_and_in_place");
+        assert(total.errors == 2 && total.values == 3);
+    }
+
+    // Threads count into tables of their own, merged into the totals while they run and when they exit.
+    void test_threads() {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([] {
+                for (int i = 0; i < 1000; ++i) {
+                    static_cast<void>(parse(i % 4 == 0 ? "" : "a"));
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        const mori::error_site total = counted("parse");
+        assert(total.errors == 20 + 4 * 250 && total.values == 20 + 4 * 750);
+    }
+
+    // Constant evaluation counts nothing.
+    constexpr int constant = [] {
+        const mori::expected<int, Fault> r = mori::unexpected(Fault::empty);
+        return r.has_value() ? 1 : 2;
+    }();
+    static_assert(constant == 2);
+#else
+    // Without counters, the tag constructors take the standard tags and no constructor has an extra parameter.
+    static_assert(std::is_same_v<mori::detail::in_place_arg, std::in_place_t>);
+    static_assert(std::is_same_v<mori::detail::unexpect_arg, mori::unexpect_t>);
+    static_assert(!std::is_constructible_v<mori::unexpected<int>, int, std::source_location>);
+    static_assert(!std::is_constructible_v<mori::expected<int, int>, int, std::source_location>);
+
+    void test_nothing_counted() {
+        static_cast<void>(parse(""));
+        static_cast<void>(parse("a"));
+        assert(mori::error_counts().empty());
+        assert(mori::error_counts_by_function().empty());
+    }
+#endif
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+#if MORI_ERROR_COUNTERS
+    test_counts();
+    test_assignment_and_in_place();
+    test_threads();
+#else
+    test_nothing_counted();
+#endif
+    mori::dump_error_counts(stdout, 5);
+    return 0;
+}
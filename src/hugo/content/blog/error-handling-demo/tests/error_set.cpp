@@ -0,0 +1,155 @@
+#include "error_set.h"
+
+#include <cassert>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace {
+    enum class ParseError { bad_digit = 1, overflow };
+    enum class IoError : std::uint8_t { not_found = 1, denied };
+    enum class ConfigError { missing_key = 1 };
+    enum class Pinned { first = 0, last = 0xffff };
+
+    using ParseErrors = mori::error_set<ParseError>;
+    using LoadErrors = mori::error_set<ParseError, IoError>;
+    using ConfigErrors = mori::error_set<ConfigError, IoError, ParseError>;
+}
+
+template<>
+struct mori::error_domain<Pinned> : std::integral_constant<std::uint16_t, 7> {};
+
+namespace {
+    // One code whatever the members, and the spare code replaces the tag of expected<void, ...>.
+    static_assert(sizeof(ConfigErrors) == sizeof(std::uint32_t));
+    static_assert(std::is_trivially_copyable_v<ConfigErrors>);
+    static_assert(sizeof(mori::expected<int, ConfigErrors>) == 2 * sizeof(std::uint32_t));
+    static_assert(sizeof(mori::expected<void, ConfigErrors>) == sizeof(std::uint32_t));
+
+    // Widening goes one way only, and only to sets with every member.
+    static_assert(std::is_convertible_v<ParseErrors, ConfigErrors>);
+    static_assert(std::is_convertible_v<LoadErrors, ConfigErrors>);
+    static_assert(!std::is_convertible_v<ConfigErrors, LoadErrors>);
+    static_assert(!std::is_constructible_v<ParseErrors, IoError>);
+    static_assert(std::is_convertible_v<mori::expected<int, LoadErrors>, mori::expected<int, ConfigErrors>>);
+    static_assert(!std::is_convertible_v<mori::expected<int, ConfigErrors>, mori::expected<int, LoadErrors>>);
+
+    // A code is the same in every set, so it can label a case.
+    static_assert(LoadErrors::code_of(IoError::denied) == ConfigErrors::code_of(IoError::denied));
+    static_assert(ConfigErrors(LoadErrors(IoError::denied)).code() == LoadErrors(IoError::denied).code());
+    static_assert(mori::error_set<Pinned>::code_of(Pinned::last) == 0x0007ffff);
+    static_assert(mori::error_domain_v<ParseError> != mori::error_domain_v<IoError>);
+
+    [[nodiscard]] mori::expected<int, ParseErrors> parse(std::string_view text) {
+        if (text.empty()) {
+            return mori::unexpected(ParseError::bad_digit);
+        }
+        int n = 0;
+        for (const char c : text) {
+            if (c < '0' || c > '9') {
+                return mori::unexpected(ParseError::bad_digit);
+            }
+            n = n * 10 + (c - '0');
+            if (n > 65535) {
+                return mori::unexpected(ParseError::overflow);
+            }
+        }
+        return n;
+    }
+
+    // Each layer returns what the layer below it returned, widened, and adds errors of its own.
+    [[nodiscard]] mori::expected<int, LoadErrors> load(std::string_view path) {
+        if (path == "denied") {
+            return mori::unexpected(IoError::denied);
+        }
+        return parse(path);
+    }
+
+    [[nodiscard]] mori::expected<int, ConfigErrors> port(std::string_view path) {
+        if (path == "unset") {
+            return mori::unexpected(ConfigError::missing_key);
+        }
+        return load(path);
+    }
+
+    [[nodiscard]] int describe(ParseError e) { return 10 + static_cast<int>(e); }
+    [[nodiscard]] int describe(IoError e) { return 20 + static_cast<int>(e); }
+    [[nodiscard]] int describe(ConfigError e) { return 30 + static_cast<int>(e); }
+
+    void test_propagation() {
+        assert(*port("8080") == 8080);
+        assert(port("80x").error() == ParseError::bad_digit);
+        assert(port("99999").error() == ParseError::overflow);
+        assert(port("denied").error() == IoError::denied);
+        assert(port("unset").error() == ConfigError::missing_key);
+        assert(port("denied").error() != IoError::not_found);
+        assert(port("80x").error() != port("99999").error());
+
+        // Members with equal values stay apart.
+        assert(ConfigErrors(ParseError::bad_digit) != ConfigErrors(IoError::not_found));
+        assert(ConfigErrors(ParseError::bad_digit) != ConfigErrors(ConfigError::missing_key));
+    }
+
+    void test_matching() {
+        const ConfigErrors e = port("denied").error();
+        assert(e.holds<IoError>() && !e.holds<ParseError>());
+        assert(e.get<IoError>() == IoError::denied);
+        assert(e.holds<LoadErrors>() && !e.holds<ParseErrors>());
+        const LoadErrors narrowed = e.get<LoadErrors>();
+        assert(narrowed == IoError::denied && ConfigErrors(narrowed) == e);
+
+        assert(e.visit([](auto v) { return describe(v); }) == 22);
+        assert(port("80x").error().visit([](auto v) { return describe(v); }) == 11);
+        assert(port("unset").error().visit([](auto v) { return describe(v); }) == 31);
+        int seen = 0;
+        port("99999").error().visit([&](auto v) { seen = describe(v); });
+        assert(seen == 12);
+
+        int matched = 0;
+        switch (port("unset").error().code()) {
+        case ConfigErrors::code_of(ConfigError::missing_key):
+            matched = 1;
+            break;
+        case ConfigErrors::code_of(IoError::denied):
+        case ConfigErrors::code_of(IoError::not_found):
+            matched = 2;
+            break;
+        default:
+            break;
+        }
+        assert(matched == 1);
+    }
+
+    void test_void() {
+        const auto check = [](std::string_view path) -> mori::expected<void, ConfigErrors> {
+            if (const auto p = port(path); !p) {
+                return mori::unexpected(p.error());
+            }
+            return {};
+        };
+        assert(check("80"));
+        const mori::expected<void, ConfigErrors> failed = check("denied");
+        assert(!failed && failed.error() == IoError::denied);
+        mori::expected<void, LoadErrors> narrow = mori::unexpected(ParseError::overflow);
+        const mori::expected<void, ConfigErrors> wide = narrow;
+        assert(wide.error() == ParseError::overflow);
+        narrow.emplace();
+        const mori::expected<void, ConfigErrors> widened = narrow;
+        assert(widened.has_value());
+    }
+
+    constexpr bool constant() {
+        const mori::expected<int, ConfigErrors> e = mori::expected<int, LoadErrors>(mori::unexpect, IoError::not_found);
+        return e.error().holds<IoError>() && e.error().get<IoError>() == IoError::not_found
+            && e.error().visit([](auto v) { return std::is_same_v<decltype(v), IoError>; });
+    }
+    static_assert(constant());
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_propagation();
+    test_matching();
+    test_void();
+    return 0;
+}
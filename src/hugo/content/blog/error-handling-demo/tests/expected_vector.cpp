@@ -0,0 +1,227 @@
+#include "expected_vector.h"
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+    enum class Fault { negative, odd, too_big };
+
+    using Parsed = mori::expected_vector<int, Fault>;
+
+    // Every third element is an error, which puts both full and mixed words into a vector longer than 64.
+    Parsed make(int count) {
+        Parsed v;
+        for (int i = 0; i < count; ++i) {
+            if (i % 3 == 2) {
+                v.push_back(mori::unexpected(Fault::negative));
+            }
+            else {
+                v.push_back(i);
+            }
+        }
+        return v;
+    }
+
+    void test_element_access() {
+        const Parsed v = make(200);
+        assert(v.size() == 200);
+        assert(v.count_errors() == 66 && v.count_values() == 134);
+        for (int i = 0; i < 200; ++i) {
+            const mori::expected<int, Fault> e = v[static_cast<std::size_t>(i)];
+            if (i % 3 == 2) {
+                assert(!e.has_value() && e.error() == Fault::negative);
+            }
+            else {
+                assert(e == i);
+            }
+        }
+        int seen = 0;
+        for (const mori::expected<int, Fault> e : v) {
+            seen += e.has_value();
+        }
+        assert(seen == 134);
+    }
+
+    bool fail_default = false;
+
+    // Throws from its default constructor while fail_default is set, and when built from a negative number.
+    struct Picky {
+        Picky() {
+            if (fail_default) {
+                throw std::runtime_error("default");
+            }
+        }
+        explicit Picky(int v) : v(v) {
+            if (v < 0) {
+                throw std::runtime_error("negative");
+            }
+        }
+
+        int v = 0;
+    };
+
+    template<class F>
+    void expect_throw(F&& f) {
+        bool thrown = false;
+        try {
+            f();
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    // A push that throws leaves the vector as it was, including at the start of a new word of the bitmask.
+    void test_throwing_push() {
+        mori::expected_vector<Picky, Fault> v;
+        for (int i = 0; i < 64; ++i) {
+            v.emplace_back(i);
+        }
+        expect_throw([&] { v.emplace_back(-1); });
+        assert(v.size() == 64 && v.count_errors() == 0);
+        v.push_back(mori::unexpected(Fault::odd));
+        assert(!v.has_value(64) && v.error(64) == Fault::odd && v.count_errors() == 1);
+
+        fail_default = true;
+        expect_throw([&] { v.push_back(mori::unexpected(Fault::too_big)); });
+        fail_default = false;
+        assert(v.size() == 65 && v.count_errors() == 1);
+        v.emplace_back(65);
+        assert(v.has_value(65) && v.value(65).v == 65 && v.count_values() == 65 && v.count_errors() == 1);
+        int errors = 0;
+        v.for_each_error([&](std::size_t i, Fault f) {
+            assert(i == 64 && f == Fault::odd);
+            ++errors;
+        });
+        assert(errors == 1);
+    }
+
+    void test_set() {
+        Parsed v = make(10);
+        v.set(2, 2);
+        v.set(4, mori::unexpected(Fault::odd));
+        v.set(5, mori::unexpected(Fault::too_big));
+        assert(v[2] == 2);
+        assert(v.error(4) == Fault::odd && v.error(5) == Fault::too_big);
+        assert(v.count_errors() == 3);
+        int last = -1;
+        v.for_each_error([&](std::size_t i, Fault) {
+            assert(static_cast<int>(i) > last);
+            last = static_cast<int>(i);
+        });
+    }
+
+    void test_transform() {
+        const Parsed v = make(1000);
+        const auto doubled = v.transform([](int x) { return x * 2.0; });
+        static_assert(std::is_same_v<decltype(doubled), const mori::expected_vector<double, Fault>>);
+        assert(doubled.size() == 1000 && doubled.count_errors() == v.count_errors());
+        assert(doubled[10] == 20.0 && !doubled[11].has_value());
+    }
+
+    // A check per element gives a vector of bools, which are stored one per byte rather than as std::vector<bool>.
+    void test_bool() {
+        const auto even = make(1000).transform([](int x) { return x % 2 == 0; });
+        static_assert(std::is_same_v<decltype(even), const mori::expected_vector<bool, Fault>>);
+        static_assert(std::is_same_v<decltype(even.value(0)), const bool&>);
+        assert(even.size() == 1000 && even.count_errors() == 333);
+        assert(even[0] == true && even[1] == false && !even[2].has_value());
+        assert(&even.value(1) == &even.value(0) + 1);
+
+        mori::expected_vector<bool, Fault> flags = even;
+        flags.value(0) = false;
+        flags.set(2, true);
+        flags.push_back(mori::unexpected(Fault::too_big));
+        assert(flags[0] == false && even[0] == true && flags[2] == true && flags.size() == 1001);
+        const auto counted = flags.transform([](bool b) { return b ? 1 : 0; });
+        assert(counted[4] == 1 && counted[3] == 0 && !counted[5].has_value());
+        assert(flags.partition().values.size() == flags.count_values());
+
+        mori::expected_vector<bool, Fault> clean;
+        for (int i = 0; i < 100; ++i) {
+            clean.push_back(i % 3 == 0);
+        }
+        const mori::expected<std::vector<bool>, Fault> all = std::move(clean).collect();
+        assert(all.has_value() && all->size() == 100 && (*all)[99] && !(*all)[98]);
+    }
+
+    void test_and_then() {
+        const auto checked = make(1000).and_then([](int x) -> mori::expected<std::string, Fault> {
+            if (x % 2 != 0) {
+                return mori::unexpected(Fault::odd);
+            }
+            return std::to_string(x);
+        });
+        assert(checked.size() == 1000);
+        assert(checked[0] == std::string("0") && checked[1].error() == Fault::odd && checked[2].error() == Fault::negative);
+        std::size_t errors = 0;
+        std::size_t previous = 0;
+        checked.for_each_error([&](std::size_t i, Fault) {
+            assert(errors == 0 || i > previous);
+            previous = i;
+            ++errors;
+        });
+        assert(errors == checked.count_errors());
+        assert(checked.count_values() + checked.count_errors() == 1000);
+    }
+
+    void test_collect() {
+        const auto first = make(100).collect();
+        assert(!first.has_value() && first.error() == Fault::negative);
+
+        Parsed clean;
+        for (int i = 0; i < 100; ++i) {
+            clean.push_back(i);
+        }
+        const auto all = std::move(clean).collect();
+        assert(all.has_value() && all->size() == 100 && (*all)[99] == 99);
+    }
+
+    void test_partition() {
+        const auto [values, errors] = make(300).partition();
+        assert(values.size() == 200 && errors.size() == 100);
+        assert(values[0] == 0 && values[1] == 1 && values[2] == 3);
+    }
+
+    // Views may start in the middle of a word; their bulk operations must give the same answers as the element-wise
+    // ones.
+    void test_span() {
+        const Parsed v = make(500);
+        for (const std::size_t pos : {0u, 1u, 63u, 64u, 70u, 130u}) {
+            for (const std::size_t n : {0u, 1u, 63u, 64u, 65u, 200u}) {
+                const mori::expected_span<int, Fault> s = v.subspan(pos, n);
+                std::size_t errors = 0;
+                for (std::size_t i = 0; i < s.size(); ++i) {
+                    assert(s[i] == v[pos + i]);
+                    errors += !s.has_value(i);
+                }
+                assert(s.count_errors() == errors && s.count_values() == n - errors);
+                const auto doubled = s.transform([](int x) { return x * 2; });
+                assert(doubled.count_values() == n - errors);
+                for (std::size_t i = 0; i < n; ++i) {
+                    assert(doubled[i] == v[pos + i].transform([](int x) { return x * 2; }));
+                }
+                assert(s.collect().has_value() == (errors == 0));
+                assert(s.partition().values.size() == n - errors);
+            }
+        }
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_element_access();
+    test_throwing_push();
+    test_set();
+    test_transform();
+    test_bool();
+    test_and_then();
+    test_collect();
+    test_partition();
+    test_span();
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "fs.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+    namespace stdfs = std::filesystem;
+
+    stdfs::path make_temp_directory() {
+        std::string pattern = (stdfs::temp_directory_path() / "mori-fs-test-XXXXXX").string();
+        const char* made = ::mkdtemp(pattern.data());
+        assert(made != nullptr);
+        return made;
+    }
+
+    void write(const stdfs::path& p, const std::string& text) {
+        std::ofstream(p, std::ios::binary) << text;
+    }
+
+    bool failed_with(const auto& r, std::errc code) {
+        return !r.has_value() && r.error().code() == code;
+    }
+
+    void test_single(const stdfs::path& root) {
+        const stdfs::path nested = root / "single" / "a" / "b";
+        // Every operation runs outside assert(), which NDEBUG compiles out.
+        const auto made = mori::fs::create_directories(nested);
+        assert(made == true);
+        const auto made_again = mori::fs::create_directories(nested);
+        assert(made_again == false);
+        const auto made_slash = mori::fs::create_directories(root / "single" / "a" / "c/");
+        assert(made_slash == true);
+        assert(stdfs::is_directory(root / "single" / "a" / "c"));
+
+        write(nested / "file", "hello");
+        const auto over_file = mori::fs::create_directories(nested / "file");
+        assert(failed_with(over_file, std::errc::not_a_directory));
+        const auto below_file = mori::fs::create_directories(nested / "file" / "below");
+        assert(failed_with(below_file, std::errc::not_a_directory));
+
+        const auto info = mori::fs::stat(nested / "file");
+        assert(info.has_value());
+        assert(info->type == stdfs::file_type::regular);
+        assert(info->size == 5);
+        const auto dir_info = mori::fs::stat(nested);
+        assert(dir_info->type == stdfs::file_type::directory);
+        const auto missing = mori::fs::stat(nested / "missing");
+        assert(failed_with(missing, std::errc::no_such_file_or_directory));
+        assert(missing.error().category() == std::system_category());
+        assert(missing.error().message() == "stat failed");
+
+        const auto renamed = mori::fs::rename(nested / "file", nested / "renamed");
+        assert(renamed.has_value());
+        const auto renamed_again = mori::fs::rename(nested / "file", nested / "again");
+        assert(failed_with(renamed_again, std::errc::no_such_file_or_directory));
+        const auto text = mori::fs::read_file(nested / "renamed");
+        assert(text == "hello");
+        const auto too_large = mori::fs::read_file(nested / "renamed", 4);
+        assert(failed_with(too_large, std::errc::file_too_large));
+        const auto at_limit = mori::fs::read_file(nested / "renamed", 5);
+        assert(at_limit == "hello");
+        const auto gone = mori::fs::read_file(nested / "file");
+        assert(failed_with(gone, std::errc::no_such_file_or_directory));
+
+        // Larger than the first read buffer, so the buffer has to grow.
+        std::string big(100'000, 'x');
+        big[99'999] = 'y';
+        write(nested / "big", big);
+        const auto big_text = mori::fs::read_file(nested / "big");
+        assert(big_text == big);
+        write(nested / "empty", "");
+        const auto empty_text = mori::fs::read_file(nested / "empty");
+        assert(empty_text == "");
+
+        const auto removed = mori::fs::remove(nested / "renamed");
+        assert(removed == true);
+        const auto removed_again = mori::fs::remove(nested / "renamed");
+        assert(removed_again == false);
+        const auto not_empty = mori::fs::remove(root / "single" / "a");
+        assert(failed_with(not_empty, std::errc::directory_not_empty));
+        const auto removed_dir = mori::fs::remove(root / "single" / "a" / "c");
+        assert(removed_dir == true);
+        assert(!stdfs::exists(root / "single" / "a" / "c"));
+    }
+
+    void test_batch(const stdfs::path& root, mori::fs::backend backend, mori::thread_pool& pool) {
+        const stdfs::path dir = root / (backend == mori::fs::backend::threads ? "threads" : "automatic");
+        // More operations than the ring holds at once, so slots are reused.
+        constexpr int count = 600;
+        {
+            mori::fs::batch b(backend, pool);
+            std::vector<mori::fs::ticket<bool>> made;
+            for (int i = 0; i < count; ++i) {
+                made.push_back(b.create_directories(dir / std::to_string(i % 10) / std::to_string(i)));
+            }
+            b.wait();
+            assert(b.size() == count);
+            for (const auto t : made) {
+                assert(b[t] == true);
+            }
+        }
+        for (int i = 0; i < count; ++i) {
+            write(dir / std::to_string(i % 10) / std::to_string(i) / "data", std::to_string(i));
+        }
+
+        mori::fs::batch b(backend, pool);
+        std::vector<mori::fs::ticket<mori::fs::status>> stats;
+        std::vector<mori::fs::ticket<std::string>> reads;
+        std::vector<mori::fs::ticket<void>> renames;
+        for (int i = 0; i < count; ++i) {
+            const stdfs::path d = dir / std::to_string(i % 10) / std::to_string(i);
+            stats.push_back(b.stat(d / (i % 7 == 0 ? "missing" : "data")));
+            reads.push_back(b.read_file(d / "data", i % 5 == 0 ? 1 : mori::fs::default_read_limit));
+        }
+        b.submit();
+        // Operations in flight together run in any order, so the renames wait for the reads.
+        b.wait();
+        for (int i = 0; i < count; ++i) {
+            const stdfs::path d = dir / std::to_string(i % 10) / std::to_string(i);
+            renames.push_back(b.rename(d / "data", d / "moved"));
+        }
+        b.wait();
+        for (int i = 0; i < count; ++i) {
+            const std::string text = std::to_string(i);
+            if (i % 7 == 0) {
+                assert(failed_with(b[stats[i]], std::errc::no_such_file_or_directory));
+            }
+            else {
+                assert(b[stats[i]].has_value() && b[stats[i]]->size == text.size());
+            }
+            if (i % 5 == 0 && text.size() > 1) {
+                assert(failed_with(b[reads[i]], std::errc::file_too_large));
+            }
+            else {
+                assert(b[reads[i]] == text);
+            }
+            assert(b[renames[i]].has_value());
+        }
+
+        b.clear();
+        assert(b.size() == 0);
+        std::vector<mori::fs::ticket<bool>> removed;
+        for (int i = 0; i < count; ++i) {
+            const stdfs::path d = dir / std::to_string(i % 10) / std::to_string(i);
+            removed.push_back(b.remove(d / "moved"));
+            removed.push_back(b.remove(d / "data"));
+        }
+        b.wait();
+        for (std::size_t i = 0; i < removed.size(); ++i) {
+            assert(b[removed[i]] == (i % 2 == 0));
+        }
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    const stdfs::path root = make_temp_directory();
+    test_single(root);
+    // A pool of its own, so the fallback runs operations concurrently even on a single core.
+    mori::thread_pool pool(4);
+    test_batch(root, mori::fs::backend::automatic, pool);
+    test_batch(root, mori::fs::backend::threads, pool);
+    std::printf("io_uring %s\n", mori::fs::batch().uses_io_uring() ? "available" : "unavailable, used threads");
+    stdfs::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include "result.h"
+
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+    int copies = 0;
+    int moves = 0;
+
+    // The 4 KB record a parser returns; every copy and move of it is counted.
+    struct Record {
+        explicit Record(int id) noexcept : id(id) {}
+        Record(const Record& other) noexcept : id(other.id) { ++copies; }
+        Record(Record&& other) noexcept : id(other.id) { ++moves; }
+        Record& operator=(const Record&) = delete;
+        Record& operator=(Record&&) = delete;
+
+        int id;
+        char bytes[4096 - sizeof(int)] = {};
+    };
+    static_assert(sizeof(Record) == 4096);
+
+    // Cannot be copied or moved at all.
+    struct Pinned {
+        explicit Pinned(int id) noexcept : id(id) {}
+        Pinned(const Pinned&) = delete;
+        Pinned& operator=(const Pinned&) = delete;
+
+        std::mutex mutex;
+        int id;
+        char bytes[4096] = {};
+    };
+
+    [[nodiscard]] Record parse_record(int id) noexcept {
+        return Record(id);
+    }
+    [[nodiscard]] Pinned make_pinned(int id) noexcept {
+        return Pinned(id);
+    }
+    [[nodiscard]] Pinned pin_or_throw(int id) {
+        if (id < 0) {
+            throw std::invalid_argument("negative id");
+        }
+        return Pinned(id);
+    }
+    [[nodiscard]] Record parse_or_throw(int id) {
+        if (id < 0) {
+            throw std::invalid_argument("negative id");
+        }
+        return Record(id);
+    }
+
+    template<class X, class F>
+    concept can_emplace_with = requires(X& x, F& f) { x.emplace_with(f, 1); };
+
+    void reset() {
+        copies = 0;
+        moves = 0;
+    }
+
+    mori::Result<Record> load(int id) {
+        if (id < 0) {
+            return Err(std::errc::invalid_argument);
+        }
+        if (id == 0) {
+            return Ok(0);
+        }
+        return OkWith(parse_record, id);
+    }
+
+    mori::expected<Record, Record> load_either(int id) {
+        if (id < 0) {
+            return ErrWith(parse_record, -id);
+        }
+        return OkWith(parse_record, id);
+    }
+
+    void test_constructors() {
+        reset();
+        const mori::expected<Record, int> r(mori::in_place_from, parse_record, 7);
+        const mori::expected<int, Record> e(mori::unexpect_from, parse_record, 8);
+        const mori::expected<void, Record> v(mori::unexpect_from, [] { return parse_record(9); });
+        assert(r->id == 7 && e.error().id == 8 && v.error().id == 9);
+        assert(copies == 0 && moves == 0);
+
+        const mori::expected<Pinned, int> p(mori::in_place_from, make_pinned, 10);
+        assert(p->id == 10);
+    }
+
+    void test_ok_err() {
+        reset();
+        const mori::Result<Record> a = load(3);
+        const mori::Result<Record> b = load(0);
+        const mori::Result<Record> c = load(-1);
+        assert(a->id == 3 && b->id == 0 && c.error() == std::errc::invalid_argument);
+        const mori::expected<Record, Record> d = load_either(4);
+        const mori::expected<Record, Record> f = load_either(-5);
+        assert(d->id == 4 && f.error().id == 5);
+        assert(copies == 0 && moves == 0);
+
+        // The same expressions convert to whatever expected they initialize.
+        const mori::expected<std::string, int> s = Ok(3, 'x');
+        const mori::expected<void, int> ok = Ok();
+        const mori::expected<void, int> err = Err(4);
+        assert(*s == "xxx" && ok && err.error() == 4);
+
+        // A builder kept in a variable owns the temporaries it was given, which are gone by the time it converts.
+        auto stored = Ok(std::string(100, 'y'));
+        auto stored_record = Err(Record(6));
+        const mori::expected<std::string, int> t = std::move(stored);
+        reset();
+        const mori::expected<int, Record> g = std::move(stored_record);
+        assert(*t == std::string(100, 'y') && g.error().id == 6);
+        assert(copies == 0 && moves == 1);
+    }
+
+    void test_emplace_with() {
+        mori::expected<Record, int> r = mori::unexpected(1);
+        reset();
+        assert(r.emplace_with(parse_record, 2).id == 2);
+        assert(r.emplace_with(parse_record, 3).id == 3 && r->id == 3);
+        assert(copies == 0 && moves == 0);
+        static_assert(noexcept(r.emplace_with(parse_record, 4)));
+
+        mori::expected<Pinned, int> p = mori::unexpected(1);
+        assert(p.emplace_with(make_pinned, 5).id == 5);
+        assert(p.emplace_with([]() noexcept { return make_pinned(6); }).id == 6);
+    }
+
+    // A factory that can throw leaves the expected as it was.
+    void test_emplace_with_throwing() {
+        mori::expected<Record, int> r = mori::unexpected(1);
+        static_assert(!noexcept(r.emplace_with(parse_or_throw, 1)));
+        reset();
+        assert(r.emplace_with(parse_or_throw, 2).id == 2);
+        assert(copies == 0 && moves == 0);
+        try {
+            static_cast<void>(r.emplace_with(parse_or_throw, -1));
+            assert(false);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        assert(r && r->id == 2);
+
+        // Relocatable contents are set aside by copying bytes rather than by moves.
+        mori::expected<std::vector<int>, int> v = std::vector<int>{1, 2, 3};
+        const int* data = v->data();
+        try {
+            static_cast<void>(v.emplace_with([]() -> std::vector<int> { throw std::runtime_error("full"); }));
+            assert(false);
+        }
+        catch (const std::runtime_error&) {
+        }
+        assert(v->size() == 3 && v->data() == data);
+        assert(v.emplace_with([] { return std::vector<int>(5); }).size() == 5);
+
+        // With nothing to set aside by, and a factory that can throw, there is no way to keep the old contents.
+        static_assert(!can_emplace_with<mori::expected<Pinned, int>, decltype(pin_or_throw)>);
+        static_assert(can_emplace_with<mori::expected<Pinned, int>, decltype(make_pinned)>);
+    }
+
+    // emplace also takes constructors that can throw, with the same guarantee.
+    void test_emplace_throwing() {
+        mori::expected<std::string, int> s = mori::unexpected(1);
+        assert(s.emplace("text") == "text");
+        assert(s.emplace({'a', 'b'}) == "ab");
+        try {
+            static_cast<void>(s.emplace(std::string("abc"), 5));
+            assert(false);
+        }
+        catch (const std::out_of_range&) {
+        }
+        assert(*s == "ab");
+    }
+
+    void test_transform() {
+        const mori::expected<int, int> id = 11;
+        const mori::expected<int, int> failed = mori::unexpected(12);
+        reset();
+        const mori::expected<Record, int> r = id.transform(parse_record);
+        const mori::expected<int, Record> e = failed.transform_error(parse_record);
+        assert(r->id == 11 && e.error().id == 12);
+        assert(copies == 0 && moves == 0);
+    }
+
+    constexpr int constant = [] {
+        mori::expected<int, int> r(mori::in_place_from, [](int x) { return x + 1; }, 1);
+        r.emplace_with([](int x) { return x * 10; }, *r);
+        const mori::expected<int, int> e(mori::unexpect_from, [] { return 5; });
+        return *r + e.error();
+    }();
+    static_assert(constant == 25);
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_constructors();
+    test_ok_err();
+    test_emplace_with();
+    test_emplace_with_throwing();
+    test_emplace_throwing();
+    test_transform();
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include "result.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+    // The size an expected should have with a union and a one-byte tag appended to it.
+    template<class T, class E>
+    constexpr std::size_t tagged_union_size() {
+        using Value = std::conditional_t<std::is_void_v<T>, char, T>;
+        constexpr std::size_t align = std::max(alignof(Value), alignof(E));
+        constexpr std::size_t size = std::max(sizeof(Value), sizeof(E)) + 1;
+        return (size + align - 1) / align * align;
+    }
+
+    template<class T, class E>
+    constexpr bool has_tagged_union_layout() {
+        return sizeof(mori::expected<T, E>) == tagged_union_size<T, E>()
+            && alignof(mori::expected<T, E>) == std::max(alignof(std::conditional_t<std::is_void_v<T>, char, T>), alignof(E));
+    }
+
+    // expected must be exactly as trivial as its members are.
+    template<class T, class E>
+    constexpr bool is_as_trivial_as_members() {
+        using Ex = mori::expected<T, E>;
+        using Value = std::conditional_t<std::is_void_v<T>, char, T>;
+        return std::is_trivially_copy_constructible_v<Ex>
+                == (std::is_trivially_copy_constructible_v<Value> && std::is_trivially_copy_constructible_v<E>)
+            && std::is_trivially_move_constructible_v<Ex>
+                == (std::is_trivially_move_constructible_v<Value> && std::is_trivially_move_constructible_v<E>)
+            && std::is_trivially_destructible_v<Ex>
+                == (std::is_trivially_destructible_v<Value> && std::is_trivially_destructible_v<E>)
+            && std::is_trivially_copyable_v<Ex> == (std::is_trivially_copyable_v<Value> && std::is_trivially_copyable_v<E>);
+    }
+
+    template<class T, class E>
+    constexpr bool check() {
+        static_assert(has_tagged_union_layout<T, E>());
+        static_assert(is_as_trivial_as_members<T, E>());
+        return true;
+    }
+
+    enum class Code : std::uint8_t { a, b };
+    struct Big {
+        std::int64_t data[8];
+    };
+    struct Odd {
+        std::int32_t a;
+        std::int8_t b;
+    };
+
+    static_assert(check<int, int>());
+    static_assert(check<char, char>());
+    static_assert(check<bool, Code>());
+    static_assert(check<double, int>());
+    static_assert(check<std::int64_t, std::errc>());
+    static_assert(check<int*, int>());
+    static_assert(check<Odd, Code>());
+    static_assert(check<Big, std::error_code>());
+    static_assert(check<void, int>());
+    static_assert(check<std::string, int>());
+    static_assert(check<int, std::string>());
+    static_assert(check<std::vector<int>, std::error_code>());
+    static_assert(check<std::unique_ptr<int>, int>());
+    static_assert(check<void, std::string>());
+
+    // Types with a spare representation paired with a stateless side drop the tag entirely.
+    template<class T, class E>
+    constexpr bool check_niche() {
+        using Full = std::conditional_t<std::is_empty_v<E>, T, E>;
+        static_assert(sizeof(mori::expected<T, E>) == sizeof(Full));
+        static_assert(alignof(mori::expected<T, E>) == alignof(Full));
+        static_assert(std::is_trivially_copyable_v<mori::expected<T, E>> == std::is_trivially_copyable_v<Full>);
+        return true;
+    }
+
+    enum class Reserved : std::uint8_t { a, b, mori_spare };
+    struct Empty {};
+
+    static_assert(check_niche<int*, Empty>());
+    static_assert(check_niche<const Big*, Empty>());
+    static_assert(check_niche<std::unique_ptr<Big>, Empty>());
+    static_assert(check_niche<std::unique_ptr<int[]>, Empty>());
+    static_assert(check_niche<std::shared_ptr<int>, Empty>());
+    static_assert(check_niche<Reserved, Empty>());
+    static_assert(check_niche<void, std::error_code>());
+    static_assert(check_niche<void, Reserved>());
+    static_assert(check_niche<Empty, std::error_code>());
+
+    // Without a stateless side there is nowhere for the spare pattern to live alongside the other member, unless the
+    // error leaves room for the value beside it.
+    static_assert(check<int*, int>());
+    static_assert(check<Reserved, int>());
+    static_assert(check<std::error_code, std::error_code>());
+    static_assert(check<Big, std::error_code>());
+
+    // A value that fits in the bytes the error's spare pattern leaves free shares the error's storage.
+    template<class T, class E>
+    constexpr bool check_overlay() {
+        static_assert(sizeof(mori::expected<T, E>) == sizeof(E));
+        static_assert(alignof(mori::expected<T, E>) == alignof(E));
+        static_assert(is_as_trivial_as_members<T, E>());
+        return true;
+    }
+
+#if defined(__GLIBCXX__) || defined(_LIBCPP_VERSION) || defined(_MSC_VER)
+    static_assert(check_overlay<double, std::error_code>());
+    static_assert(check_overlay<int*, std::error_code>());
+    static_assert(check_overlay<Code, std::error_code>());
+    static_assert(check_overlay<Odd, std::error_code>());
+    static_assert(check_overlay<std::unique_ptr<int>, std::error_code>());
+#endif
+    static_assert(check_overlay<int*, mori::Error>());
+    static_assert(check_overlay<const Big*, mori::Error>());
+    static_assert(check_overlay<std::unique_ptr<Big>, mori::Error>());
+    static_assert(check_overlay<std::unique_ptr<int[]>, mori::Error>());
+    // Only single pointers go into an Error, so values usable in constant expressions keep their tag.
+    static_assert(check<int, mori::Error>());
+    static_assert(check<Code, mori::Error>());
+    static_assert(check<std::shared_ptr<int>, mori::Error>());
+
+    static_assert(sizeof(mori::expected<int*, Empty>) == sizeof(int*));
+    static_assert(sizeof(mori::Error) == 16);
+    static_assert(sizeof(mori::Result<void>) == sizeof(mori::Error));
+    static_assert(sizeof(mori::Result<int>) == 24);
+    static_assert(sizeof(mori::Result<int*>) == sizeof(mori::Error));
+    static_assert(sizeof(mori::Result<std::unique_ptr<int>>) == sizeof(mori::Error));
+    static_assert(sizeof(mori::Result<const int&>) == sizeof(mori::Error));
+    static_assert(sizeof(mori::expected<void, std::error_code>) == sizeof(std::error_code));
+    static_assert(sizeof(mori::expected<int, int>) == 8);
+    static_assert(sizeof(mori::expected<char, char>) == 2);
+#if defined(__GLIBCXX__) || defined(_LIBCPP_VERSION) || defined(_MSC_VER)
+    static_assert(sizeof(mori::expected<double, std::error_code>) == 16);
+    static_assert(sizeof(mori::expected<int*, std::error_code>) == 16);
+#endif
+    static_assert(std::is_trivially_copyable_v<mori::expected<int, int>>);
+    static_assert(std::is_trivially_copyable_v<mori::expected<double, std::error_code>>);
+    static_assert(std::is_trivially_copyable_v<mori::expected<void, int>>);
+    static_assert(!std::is_copy_constructible_v<mori::expected<std::unique_ptr<int>, int>>);
+    static_assert(std::is_nothrow_move_constructible_v<mori::expected<std::unique_ptr<int>, int>>);
+
+    int live = 0;
+    struct Counted {
+        explicit Counted(int v) : v(v) { ++live; }
+        Counted(const Counted& other) : v(other.v) { ++live; }
+        Counted(Counted&& other) noexcept : v(other.v) { ++live; }
+        Counted& operator=(const Counted&) = default;
+        Counted& operator=(Counted&&) = default;
+        ~Counted() { --live; }
+        int v;
+    };
+
+    // Switches an overlaid expected between its states, checking that each side is built and destroyed once.
+    void test_overlay() {
+#if defined(__GLIBCXX__) || defined(_LIBCPP_VERSION) || defined(_MSC_VER)
+        // The layout the error_code overlay relies on: the category pointer comes last.
+        const std::error_code code = std::make_error_code(std::errc::io_error);
+        const std::error_category* category = nullptr;
+        std::memcpy(&category, reinterpret_cast<const std::byte*>(&code) + sizeof(code) - sizeof(category),
+            sizeof(category));
+        assert(category == &code.category());
+
+        {
+            using Ex = mori::expected<Counted, std::error_code>;
+            Ex a(std::in_place, 1);
+            Ex b = mori::unexpected(code);
+            assert(a && a->v == 1 && !b && b.error() == code && live == 1);
+            Ex c = a;
+            b = a;
+            assert(b && b->v == 1 && live == 3);
+            a = mori::unexpected(code);
+            assert(!a && a.error() == code && live == 2);
+            swap(a, c);
+            assert(a && a->v == 1 && !c && c.error() == code && live == 2);
+            c = Counted(4);
+            a = std::move(c);
+            assert(a->v == 4 && live == 3);
+        }
+        assert(live == 0);
+#endif
+
+        int x = 1;
+        mori::Result<int*> p = &x;
+        assert(p && *p == &x);
+        p = mori::unexpected(mori::Error(std::errc::timed_out));
+        assert(!p && p.error() == std::errc::timed_out);
+        mori::Result<std::unique_ptr<int>> owned = std::make_unique<int>(2);
+        mori::Result<std::unique_ptr<int>> failed = mori::unexpected(mori::Error(std::errc::io_error));
+        swap(owned, failed);
+        assert(!owned && owned.error() == std::errc::io_error && **failed == 2);
+        owned = std::move(failed);
+        assert(owned && **owned == 2);
+        const mori::Result<const int&> ref = x;
+        assert(&*ref == &x);
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    {
+        mori::expected<Counted, std::string> ex(std::in_place, 1);
+        assert(live == 1);
+        ex = mori::unexpected(std::string("failed"));
+        assert(live == 0);
+        assert(!ex && ex.error() == "failed");
+        auto copy = ex;
+        ex = Counted(2);
+        assert(live == 1 && ex->v == 2);
+        copy = ex;
+        assert(live == 2 && copy->v == 2);
+        copy = std::move(ex);
+        assert(live == 2);
+    }
+    assert(live == 0);
+    test_overlay();
+
+    mori::expected<void, int> v;
+    assert(v);
+    v = mori::unexpected(4);
+    assert(v.error() == 4);
+    v.emplace();
+    assert((v == mori::expected<void, long>()));
+
+    return 0;
+}
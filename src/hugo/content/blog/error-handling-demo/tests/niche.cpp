@@ -0,0 +1,92 @@
+#include "expected.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+
+namespace {
+    // An error with nothing to store, so every expected below keeps only its value side.
+    struct Missing {};
+
+    template<class T>
+    using Found = mori::expected<T, Missing>;
+
+    enum class Status : std::uint8_t { busy, closed, mori_spare };
+
+    int deleted = 0;
+    struct Tracked {
+        ~Tracked() { ++deleted; }
+    };
+
+    Found<int*> find(int* p) {
+        if (p == nullptr) {
+            return mori::unexpected(Missing());
+        }
+        return p;
+    }
+
+    mori::expected<void, std::error_code> check(int code) {
+        if (code != 0) {
+            return mori::unexpected(std::error_code(code, std::generic_category()));
+        }
+        return {};
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    int x = 3;
+    auto found = find(&x);
+    assert(found && *found == &x);
+    assert(!find(nullptr));
+
+    // A null pointer is still a perfectly good value.
+    Found<int*> null = nullptr;
+    assert(null && *null == nullptr);
+    null = mori::unexpected(Missing());
+    assert(!null);
+    null = &x;
+    assert(null && **null == 3);
+
+    assert(check(0));
+    auto failed = check(static_cast<int>(std::errc::no_such_file_or_directory));
+    assert(!failed && failed.error() == std::errc::no_such_file_or_directory);
+    failed.emplace();
+    assert(failed && !failed.error());
+
+    {
+        Found<std::unique_ptr<Tracked>> owned = std::make_unique<Tracked>();
+        assert(owned && *owned != nullptr);
+        auto moved = std::move(owned);
+        assert(moved && owned && *owned == nullptr);
+        moved = mori::unexpected(Missing());
+        assert(!moved && deleted == 1);
+        moved = std::make_unique<Tracked>();
+    }
+    assert(deleted == 2);
+
+    {
+        auto shared = std::make_shared<Tracked>();
+        Found<std::shared_ptr<Tracked>> a = shared;
+        Found<std::shared_ptr<Tracked>> b = mori::unexpected(Missing());
+        assert(shared.use_count() == 2 && !b);
+        b = a;
+        assert(shared.use_count() == 3 && b);
+        a = mori::unexpected(Missing());
+        b = mori::unexpected(Missing());
+        assert(shared.use_count() == 1);
+    }
+    assert(deleted == 3);
+
+    Found<Status> status = Status::closed;
+    assert(status && *status == Status::closed);
+    status = mori::unexpected(Missing());
+    assert(!status);
+    mori::expected<void, Status> done;
+    assert(done);
+    done = mori::unexpected(Status::busy);
+    assert(!done && done.error() == Status::busy);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Built with -fno-exceptions. Checks that a bad access reaches the panic handler, and that the success path of
+// value() is no longer than a hand-written check that calls out to a cold function on failure.
+
+#include "expected.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(MORI_OBJDUMP)
+#include <unistd.h>
+#endif
+
+static_assert(MORI_NO_EXCEPTIONS, "this test must be compiled with -fno-exceptions");
+
+namespace {
+    [[noreturn]] MORI_COLD void hand_written_failure() {
+        std::abort();
+    }
+}
+
+// The functions whose code is compared, with C linkage so they are easy to find in the disassembly.
+extern "C" {
+    [[gnu::noinline]] int probe_value(const mori::expected<int, int>& r) {
+        return r.value();
+    }
+    [[gnu::noinline]] int probe_hand_written(const mori::expected<int, int>& r) {
+        if (!r.has_value()) {
+            hand_written_failure();
+        }
+        return *r;
+    }
+    [[gnu::noinline]] std::size_t probe_string_value(const mori::expected<std::string, std::string>& r) {
+        return r.value().size();
+    }
+    [[gnu::noinline]] std::size_t probe_string_hand_written(const mori::expected<std::string, std::string>& r) {
+        if (!r.has_value()) {
+            hand_written_failure();
+        }
+        return r->size();
+    }
+}
+
+namespace {
+    // Counts the instructions in a function of this executable, or returns -1 when it cannot be disassembled.
+    int instruction_count(const char* function) {
+#if defined(MORI_OBJDUMP)
+        // Resolved here: inside the objdump process /proc/self/exe would be objdump.
+        char self[256] = {};
+        if (readlink("/proc/self/exe", self, sizeof(self) - 1) < 0) {
+            return -1;
+        }
+        char command[512];
+        std::snprintf(command, sizeof(command), "%s -d --no-show-raw-insn '%s'", MORI_OBJDUMP, self);
+        FILE* out = popen(command, "r");
+        if (out == nullptr) {
+            return -1;
+        }
+        char header[256];
+        std::snprintf(header, sizeof(header), "<%s>:", function);
+        char line[512];
+        int count = -1;
+        while (std::fgets(line, sizeof(line), out) != nullptr) {
+            if (count < 0) {
+                if (std::strstr(line, header) != nullptr) {
+                    count = 0;
+                }
+            }
+            else if (line[0] == '\n') {
+                break;
+            }
+            else if (std::string_view(line).find(":\t") != std::string_view::npos) {
+                ++count;
+            }
+        }
+        pclose(out);
+        return count;
+#else
+        (void)function;
+        return -1;
+#endif
+    }
+
+    void check_hot_path(const char* probe, const char* reference) {
+        const int probe_count = instruction_count(probe);
+        const int reference_count = instruction_count(reference);
+        if (probe_count < 0 || reference_count < 0) {
+            std::printf("%s: skipped, objdump unavailable\n", probe);
+            return;
+        }
+        std::printf("%s: %d instructions, hand-written: %d\n", probe, probe_count, reference_count);
+        assert(probe_count <= reference_count);
+    }
+
+    void test_hot_path() {
+        assert(probe_value(mori::expected<int, int>(3)) == 3);
+        assert(probe_hand_written(mori::expected<int, int>(3)) == 3);
+        assert(probe_string_value(std::string("four")) == 4);
+        assert(probe_string_hand_written(std::string("four")) == 4);
+        check_hot_path("probe_value", "probe_hand_written");
+        check_hot_path("probe_string_value", "probe_string_hand_written");
+    }
+
+    void on_panic(const char* message) noexcept {
+        const bool expected_message = std::strcmp(message, mori::bad_expected_access<int>(0).what()) == 0;
+        std::printf("panic handler called: %s\n", message);
+        std::fflush(stdout);
+        std::_Exit(expected_message ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    // Ends the process from the panic handler; returning from here is a failure.
+    void test_panic_handler() {
+        const mori::panic_handler previous = mori::set_panic_handler(on_panic);
+        assert(previous != nullptr && previous != on_panic);
+        assert(mori::get_panic_handler() == on_panic);
+        const mori::expected<int, int> failed = mori::unexpected(1);
+        (void)probe_value(failed);
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_hot_path();
+    test_panic_handler();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,99 @@
+// Built with exceptions and MORI_NO_EXCEPTIONS=1, as every target is with the CMake option on. The option only turns
+// a bad access into a panic: a T or E whose constructor throws must still leave the expected as it was, with its old
+// contents destroyed exactly once.
+
+#include "expected.h"
+
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+static_assert(MORI_NO_EXCEPTIONS && MORI_HAS_EXCEPTIONS, "this test must be compiled with exceptions and the option");
+
+namespace {
+    int live = 0;
+    bool fail = false;
+
+    // Owns a resource; destroying one twice shows up as a negative count.
+    struct Owned {
+        explicit Owned(int id) : id(id) { ++live; }
+        Owned(const Owned& other) : id(other.id) { ++live; }
+        Owned(Owned&& other) noexcept : id(other.id) { ++live; }
+        Owned& operator=(const Owned&) = default;
+        ~Owned() {
+            --live;
+            assert(live >= 0);
+        }
+
+        int id;
+    };
+
+    // Copies and moves throw while fail is set.
+    struct Throwing {
+        explicit Throwing(int v) : v(v) {}
+        Throwing(const Throwing& other) : v(other.v) { check(); }
+        Throwing(Throwing&& other) : v(other.v) { check(); }
+        Throwing& operator=(const Throwing&) = default;
+        Throwing& operator=(Throwing&&) = default;
+
+        static void check() {
+            if (fail) {
+                throw std::runtime_error("copy");
+            }
+        }
+
+        int v;
+    };
+
+    using Either = mori::expected<Throwing, Owned>;
+
+    template<class F>
+    void expect_throw(F&& f) {
+        fail = true;
+        bool thrown = false;
+        try {
+            f();
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        fail = false;
+        assert(thrown);
+    }
+
+    void test_assign() {
+        {
+            Either x(mori::unexpect, 7);
+            const Throwing t(1);
+            expect_throw([&] { x = t; });
+            assert(!x && x.error().id == 7 && live == 1);
+            expect_throw([&] { x = Either(std::in_place, 2); });
+            assert(!x && x.error().id == 7 && live == 1);
+            x = t;
+            assert(x && x->v == 1 && live == 0);
+        }
+        assert(live == 0);
+    }
+
+    void test_emplace_and_swap() {
+        {
+            Either x(mori::unexpect, 3);
+            const Throwing t(4);
+            expect_throw([&] { x.emplace(t); });
+            assert(!x && x.error().id == 3 && live == 1);
+
+            Either y(std::in_place, 5);
+            expect_throw([&] { swap(x, y); });
+            assert(!x && x.error().id == 3 && y && y->v == 5 && live == 1);
+            swap(x, y);
+            assert(x && x->v == 5 && !y && y.error().id == 3 && live == 1);
+        }
+        assert(live == 0);
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_assign();
+    test_emplace_and_swap();
+    return 0;
+}
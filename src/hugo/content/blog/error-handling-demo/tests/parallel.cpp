@@ -0,0 +1,149 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    enum class Fault { negative, too_big };
+
+    mori::expected<int, Fault> check(int x) {
+        if (x < 0) {
+            return mori::unexpected(Fault::negative);
+        }
+        if (x > 1'000'000) {
+            return mori::unexpected(Fault::too_big);
+        }
+        return x * 2;
+    }
+
+    std::vector<int> iota(int count) {
+        std::vector<int> v(static_cast<std::size_t>(count));
+        std::iota(v.begin(), v.end(), 0);
+        return v;
+    }
+
+    void test_values(mori::thread_pool& pool) {
+        const std::vector<int> input = iota(100'000);
+        const auto out = mori::parallel_transform(pool, input, check);
+        assert(out.has_value() && out->size() == input.size());
+        for (std::size_t i = 0; i < input.size(); ++i) {
+            assert((*out)[i] == input[i] * 2);
+        }
+        const auto empty = mori::parallel_transform(pool, std::vector<int>{}, check);
+        assert(empty.has_value() && empty->empty());
+    }
+
+    // The error reported is always the one at the lowest index, however the chunks were scheduled.
+    void test_first_error(mori::thread_pool& pool) {
+        std::vector<int> input = iota(100'000);
+        input[70'000] = 2'000'000;
+        input[40'123] = -1;
+        input[99'999] = -1;
+        for (int run = 0; run < 20; ++run) {
+            const auto out = mori::parallel_transform(pool, input, check);
+            assert(!out.has_value() && out.error() == Fault::negative);
+        }
+        input[40'123] = 0;
+        const auto out = mori::parallel_transform(pool, input, check);
+        assert(!out.has_value() && out.error() == Fault::too_big);
+    }
+
+    void test_all_errors(mori::thread_pool& pool) {
+        std::vector<int> input = iota(10'000);
+        input[9'000] = -1;
+        input[10] = 2'000'000;
+        input[5'000] = -5;
+        const auto out = mori::parallel_transform(pool, input, check, mori::all_errors);
+        assert(!out.has_value());
+        assert((out.error() == std::vector{Fault::too_big, Fault::negative, Fault::negative}));
+    }
+
+    // Once an error is found, elements after it are skipped.
+    void test_cancellation(mori::thread_pool& pool) {
+        std::vector<int> input = iota(1'000'000);
+        input[0] = -1;
+        std::atomic<std::size_t> calls{0};
+        const auto r = mori::parallel_for_each(pool, input, [&](int x) {
+            calls.fetch_add(1, std::memory_order_relaxed);
+            return check(x);
+        });
+        assert(!r.has_value() && r.error() == Fault::negative);
+        assert(calls.load() < input.size() / 2);
+        if (pool.concurrency() == 1) {
+            assert(calls.load() == 1);
+        }
+    }
+
+    void test_reduce(mori::thread_pool& pool) {
+        const std::vector<int> input = iota(100'000);
+        const auto sum = mori::parallel_transform_reduce(pool, input, 0LL, std::plus<>(),
+            [](int x) -> mori::expected<long long, Fault> { return x; });
+        assert(sum == 100'000LL * 99'999 / 2);
+
+        const auto joined = mori::parallel_transform_reduce(pool, iota(200), std::string(), std::plus<>(),
+            [](int x) -> mori::expected<std::string, Fault> { return std::to_string(x % 10); });
+        assert(joined.has_value() && joined->size() == 200 && joined->starts_with("0123456789"));
+
+        std::vector<int> bad = iota(1000);
+        bad[500] = -1;
+        const auto failed = mori::parallel_transform_reduce(pool, bad, 0LL, std::plus<>(), check);
+        assert(!failed.has_value() && failed.error() == Fault::negative);
+    }
+
+    void test_exceptions(mori::thread_pool& pool) {
+#if MORI_HAS_EXCEPTIONS
+        const std::vector<int> input = iota(10'000);
+        bool thrown = false;
+        try {
+            (void)mori::parallel_for_each(pool, input, [](int x) -> mori::expected<void, Fault> {
+                if (x == 7'777) {
+                    throw std::runtime_error("boom");
+                }
+                return {};
+            });
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+#else
+        (void)pool;
+#endif
+    }
+
+    // A callable may start parallel work of its own on the same pool without deadlocking it.
+    void test_nested(mori::thread_pool& pool) {
+        const std::vector<int> outer = iota(64);
+        const auto out = mori::parallel_transform(pool, outer, [&](int x) -> mori::expected<int, Fault> {
+            const auto inner = mori::parallel_transform_reduce(pool, iota(x + 1), 0, std::plus<>(),
+                [](int y) -> mori::expected<int, Fault> { return y; });
+            return inner;
+        });
+        assert(out.has_value() && (*out)[63] == 63 * 64 / 2);
+    }
+
+    void run(unsigned concurrency) {
+        mori::thread_pool pool(concurrency);
+        assert(pool.concurrency() == concurrency);
+        test_values(pool);
+        test_first_error(pool);
+        test_all_errors(pool);
+        test_cancellation(pool);
+        test_reduce(pool);
+        test_exceptions(pool);
+        test_nested(pool);
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    run(1);
+    run(2);
+    run(4);
+    const auto shared = mori::parallel_transform(iota(10), check);
+    assert(shared.has_value() && shared->back() == 18);
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "pipeline.h"
+#include "result.h"
+
+#include <cassert>
+#include <string>
+
+namespace {
+    struct Counts {
+        int copies = 0;
+        int moves = 0;
+    };
+    Counts counts;
+
+    // A payload that records every copy and move made of it.
+    struct Tracked {
+        explicit Tracked(int v) : v(v) {}
+        Tracked(const Tracked& other) : v(other.v) { ++counts.copies; }
+        Tracked(Tracked&& other) noexcept : v(other.v) { ++counts.moves; }
+        Tracked& operator=(const Tracked& other) {
+            v = other.v;
+            ++counts.copies;
+            return *this;
+        }
+        Tracked& operator=(Tracked&& other) noexcept {
+            v = other.v;
+            ++counts.moves;
+            return *this;
+        }
+        int v;
+    };
+
+    using Ex = mori::expected<Tracked, Tracked>;
+
+    Ex make(int v) {
+        if (v < 0) {
+            return Ex(mori::unexpect, v);
+        }
+        return Ex(std::in_place, v);
+    }
+
+    void reset() {
+        counts = {};
+    }
+
+    void test_eager() {
+        const auto twice = [](int v) { return v * 2; };
+        const auto half = [](int v) -> mori::expected<int, std::string> {
+            if (v % 2 != 0) {
+                return mori::unexpected(std::string("odd"));
+            }
+            return v / 2;
+        };
+        mori::expected<int, std::string> four = 4;
+        const mori::expected<int, std::string> odd = 3;
+        mori::expected<int, std::string> failed = mori::unexpected(std::string("failed"));
+
+        assert(four.transform(twice) == 8);
+        assert(four.and_then(half) == 2);
+        assert(odd.and_then(half) == mori::unexpected(std::string("odd")));
+        assert(failed.transform_error([](const std::string& e) { return e.size(); }) == mori::unexpected(6u));
+        assert(four.transform_error([](const std::string& e) { return e.size(); }) == 4);
+        assert(failed.or_else([](const std::string&) { return mori::expected<int, int>(7); }) == 7);
+        assert(four.or_else([](const std::string&) { return mori::expected<int, int>(7); }) == 4);
+        assert(std::move(failed).and_then(half).error() == "failed");
+
+        int seen = 0;
+        mori::expected<void, std::string> done = four.transform([&](int v) { seen = v; });
+        assert(done && seen == 4);
+        assert(done.transform([] { return 5; }) == 5);
+        assert(done.and_then([] { return mori::expected<int, std::string>(6); }) == 6);
+        mori::expected<void, int> void_failed = mori::unexpected(3);
+        assert(void_failed.transform_error([](int e) { return e + 1; }) == mori::unexpected(4));
+        assert(void_failed.or_else([](int) { return mori::expected<void, long>(); }).has_value());
+        assert(!void_failed.transform([] { return 1; }).has_value());
+    }
+
+    void test_eager_constructs_in_place() {
+        reset();
+        Ex source = make(1);
+        const auto step = [](const Tracked& t) { return Tracked(t.v + 1); };
+        Ex result = std::move(source).transform(step).transform(step).transform(step);
+        assert(result && result->v == 4);
+        assert(counts.copies == 0 && counts.moves == 0);
+    }
+
+    // The lazy pipeline must produce exactly what the eager chain produces.
+    template<class Chain>
+    void check_matches(int input, Chain chain) {
+        Ex lazy = chain(mori::pipe(make(input)));
+        Ex eager = chain(make(input));
+        assert(lazy.has_value() == eager.has_value());
+        assert((lazy ? lazy->v : lazy.error().v) == (eager ? eager->v : eager.error().v));
+    }
+
+    void test_lazy() {
+        const auto inc = [](const Tracked& t) { return Tracked(t.v + 1); };
+        const auto check = [](const Tracked& t) { return t.v % 7 == 0 ? Ex(mori::unexpect, -t.v) : Ex(std::in_place, t.v); };
+        const auto recover = [](const Tracked& e) { return Ex(std::in_place, -e.v * 10); };
+        const auto wrap = [](const Tracked& e) { return Tracked(e.v - 100); };
+        const auto chain = [&](auto&& start) -> Ex {
+            return std::move(start)
+                .transform(inc)
+                .and_then(check)
+                .transform(inc)
+                .transform_error(wrap)
+                .and_then(check)
+                .or_else(recover)
+                .transform(inc)
+                .transform(inc);
+        };
+        for (int input = -3; input < 20; ++input) {
+            check_matches(input, chain);
+        }
+
+        // An eight-step chain on the success path never copies or moves the payload.
+        reset();
+        Ex value = chain(mori::pipe(make(1)));
+        assert(value && value->v == 5);
+        assert(counts.copies == 0 && counts.moves == 0);
+
+        // The eager chain moves the value into a new expected at every step it skips.
+        reset();
+        Ex eager = chain(make(1));
+        assert(eager && eager->v == 5);
+        assert(counts.copies == 0 && counts.moves > 1);
+
+        // The error travels by reference and is moved once, into the result.
+        reset();
+        Ex error = mori::pipe(make(-1)).transform(inc).and_then(check).transform(inc).transform(inc);
+        assert(!error && error.error().v == -1);
+        assert(counts.copies == 0 && counts.moves == 1);
+
+        // A pipeline can also start from an lvalue, which it leaves untouched.
+        reset();
+        Ex source = make(2);
+        Ex copy = mori::pipe(source).transform(inc);
+        assert(copy->v == 3 && source->v == 2);
+        assert(counts.copies == 0 && counts.moves == 0);
+
+        mori::expected<void, int> ok;
+        mori::expected<int, int> from_void = mori::pipe(ok).transform([] { return 1; }).transform([](int v) { return v + 1; });
+        assert(from_void == 2);
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_eager();
+    test_eager_constructs_in_place();
+    test_lazy();
+    return 0;
+}
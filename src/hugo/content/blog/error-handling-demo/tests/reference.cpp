@@ -0,0 +1,182 @@
+#include "result.h"
+
+#include <cassert>
+#include <functional>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace {
+    int copies = 0;
+
+    // A table entry; every copy is counted.
+    struct Entry {
+        explicit Entry(std::string name, int port) : name(std::move(name)), port(port) {}
+        Entry(const Entry& other) : name(other.name), port(other.port) { ++copies; }
+        Entry& operator=(const Entry&) = delete;
+
+        std::string name;
+        int port;
+        char padding[256] = {};
+    };
+
+    struct Base {
+        int id = 0;
+    };
+    struct Derived : Base {};
+
+    struct Missing {};
+    enum class Fault { missing, refused };
+
+    using Table = std::map<int, Entry>;
+
+    [[nodiscard]] mori::expected<const Entry&, Missing> find(const Table& table, int key) {
+        const auto it = table.find(key);
+        if (it == table.end()) {
+            return mori::unexpected(Missing{});
+        }
+        return it->second;
+    }
+    [[nodiscard]] mori::expected<Entry&, Fault> find_mutable(Table& table, int key) {
+        const auto it = table.find(key);
+        if (it == table.end()) {
+            return mori::unexpected(Fault::missing);
+        }
+        return it->second;
+    }
+
+    // Pointer-sized with an empty error, and no temporary can be bound.
+    static_assert(sizeof(mori::expected<const Entry&, Missing>) == sizeof(void*));
+    static_assert(std::is_trivially_copyable_v<mori::expected<Entry&, Fault>>);
+    static_assert(mori::is_trivially_relocatable_v<mori::expected<std::string&, mori::Error>>);
+    static_assert(std::is_constructible_v<mori::expected<const int&, Fault>, int&>);
+    static_assert(std::is_constructible_v<mori::expected<const int&, Fault>, const int&>);
+    static_assert(!std::is_constructible_v<mori::expected<const int&, Fault>, int>);
+    static_assert(!std::is_constructible_v<mori::expected<const int&, Fault>, int&&>);
+    static_assert(!std::is_constructible_v<mori::expected<const int&, Fault>, long&>);
+    static_assert(!std::is_constructible_v<mori::expected<const std::string&, Fault>, const char*>);
+    static_assert(!std::is_constructible_v<mori::expected<int&, Fault>, const int&>);
+    static_assert(!std::is_assignable_v<mori::expected<const int&, Fault>&, int>);
+    static_assert(std::is_constructible_v<mori::expected<Base&, Fault>, Derived&>);
+    static_assert(std::is_constructible_v<mori::expected<int&, Fault>, std::reference_wrapper<int>>);
+    static_assert(!std::is_default_constructible_v<mori::expected<int&, Fault>>);
+
+    void test_basics() {
+        int a = 1;
+        int b = 2;
+        mori::expected<int&, Fault> r = a;
+        assert(r && *r == 1 && &r.value() == &a);
+        // Writes go through to the referent...
+        *r = 10;
+        assert(a == 10);
+        // ...but assignment rebinds.
+        r = b;
+        assert(&*r == &b && a == 10 && b == 2);
+        mori::expected<int&, Fault> s = r;
+        s.emplace(a);
+        assert(&*s == &a && &*r == &b);
+        swap(r, s);
+        assert(&*r == &a && &*s == &b);
+
+        r = mori::unexpected(Fault::refused);
+        assert(!r && r.error() == Fault::refused && r.value_or(7) == 7);
+        assert(s.value_or(7) == 2 && s.error_or(Fault::missing) == Fault::missing);
+        r = a;
+        assert(r && *r == 10);
+
+        const mori::expected<const int&, Fault> c = r;
+        assert(&*c == &a && c == 10 && c == r);
+        const mori::expected<int, Fault> v = 10;
+        assert(c == v && r != mori::unexpected(Fault::refused));
+
+        Derived d;
+        const mori::expected<Base&, Fault> base = d;
+        assert(&*base == &d);
+        assert(base->id == 0);
+    }
+
+    void test_lookup() {
+        Table table;
+        table.emplace(1, Entry("alpha", 80));
+        table.emplace(2, Entry("beta", 443));
+        copies = 0;
+
+        assert(find(table, 1)->port == 80);
+        assert(!find(table, 3));
+        const Entry& beta = *find(table, 2);
+        assert(&beta == &table.at(2));
+        find_mutable(table, 2)->port = 8443;
+        assert(table.at(2).port == 8443);
+        assert(copies == 0);
+
+        // An explicit copy is still one call away.
+        const Entry copy = find(table, 1).value();
+        assert(copy.name == "alpha" && copies == 1);
+
+#if !MORI_NO_EXCEPTIONS
+        try {
+            static_cast<void>(find_mutable(table, 5).value());
+            assert(false);
+        }
+        catch (const mori::bad_expected_access<Fault>& e) {
+            assert(e.error() == Fault::missing);
+        }
+#endif
+    }
+
+    // References flow through monadic chains without copying what they refer to.
+    void test_chains() {
+        Table table;
+        table.emplace(1, Entry("alpha", 80));
+        copies = 0;
+
+        // A member access keeps a reference into the entry.
+        mori::expected<const std::string&, Missing> name = find(table, 1).transform(&Entry::name);
+        static_assert(std::is_same_v<decltype(name), decltype(find(table, 1).transform(&Entry::name))>);
+        assert(&*name == &table.at(1).name);
+        // A function returning by value gives a value.
+        const mori::expected<int, Missing> port = find(table, 1).transform([](const Entry& e) { return e.port; });
+        assert(*port == 80);
+
+        const auto twice = find(table, 1).and_then([&](const Entry& e) { return find(table, e.port / 80); });
+        assert(&*twice == &table.at(1));
+        const auto fallback = find(table, 9).or_else([&](Missing) { return find(table, 1); });
+        assert(&*fallback == &table.at(1));
+        const mori::expected<const Entry&, Fault> converted =
+            find(table, 9).transform_error([](Missing) { return Fault::missing; });
+        assert(converted.error() == Fault::missing);
+        const mori::expected<void, Missing> checked = find(table, 1).transform([](const Entry&) {});
+        assert(checked);
+        assert(copies == 0);
+
+        // From an expected that owns its value, transform copies what the function refers to, as std::expected does,
+        // so the result cannot dangle when the source goes away.
+        const mori::expected<Entry, Missing> owned(std::in_place, "gamma", 22);
+        const auto into = owned.transform([](const Entry& e) -> const std::string& { return e.name; });
+        static_assert(std::is_same_v<decltype(into), const mori::expected<std::string, Missing>>);
+        assert(*into == "gamma" && &*into != &owned->name);
+        const auto moved = mori::expected<Entry, Missing>(std::in_place, "delta", 33)
+            .transform([](Entry&& e) -> std::string& { return e.name; });
+        static_assert(std::is_same_v<decltype(moved), const mori::expected<std::string, Missing>>);
+        assert(*moved == "delta");
+    }
+
+    constexpr int constant = [] {
+        int a = 1;
+        int b = 2;
+        mori::expected<int&, Missing> r = a;
+        r = b;
+        *r += 40;
+        const mori::expected<int&, Missing> e = mori::unexpected(Missing{});
+        return b + (e ? 1 : 0) + r.transform([](int& x) -> int& { return x; }).value();
+    }();
+    static_assert(constant == 84);
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_basics();
+    test_lookup();
+    test_chains();
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "result.h"
+
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+    int moves = 0;
+
+    // Counts moves and opts in to relocation, so the tests can see when expected copies bytes instead of moving.
+    struct Tracked {
+        explicit Tracked(int v) : value(std::make_unique<int>(v)) {}
+        Tracked(const Tracked& other) : value(std::make_unique<int>(*other.value)) {}
+        Tracked(Tracked&& other) noexcept : value(std::move(other.value)) { ++moves; }
+        Tracked& operator=(const Tracked& other) {
+            value = std::make_unique<int>(*other.value);
+            return *this;
+        }
+        Tracked& operator=(Tracked&& other) noexcept {
+            value = std::move(other.value);
+            ++moves;
+            return *this;
+        }
+
+        std::unique_ptr<int> value;
+    };
+
+    // Throws from its copy constructor on request, to check that a failed switch leaves the old state intact.
+    struct Fragile {
+        explicit Fragile(int v) : value(v) {}
+        Fragile(const Fragile& other) : value(other.value) {
+            if (value < 0) {
+                throw std::runtime_error("copy failed");
+            }
+        }
+        Fragile& operator=(const Fragile&) = default;
+
+        int value;
+    };
+
+    // An allocator of the kind that may tie a vector to its address; vectors using it are not relocatable.
+    template<class T>
+    struct Counting : std::allocator<T> {
+        using value_type = T;
+        template<class U>
+        struct rebind {
+            using other = Counting<U>;
+        };
+
+        Counting() = default;
+        template<class U>
+        Counting(const Counting<U>&) noexcept {}
+    };
+}
+
+template<>
+struct mori::trivially_relocatable<Tracked> : std::true_type {};
+
+namespace {
+    static_assert(mori::is_trivially_relocatable_v<int>);
+    static_assert(mori::is_trivially_relocatable_v<std::error_code>);
+    static_assert(mori::is_trivially_relocatable_v<std::unique_ptr<int>>);
+    static_assert(mori::is_trivially_relocatable_v<std::vector<std::string>>);
+    static_assert(!mori::is_trivially_relocatable_v<std::vector<int, Counting<int>>>);
+    static_assert(mori::is_trivially_relocatable_v<mori::Error>);
+    static_assert(mori::is_trivially_relocatable_v<mori::Result<std::unique_ptr<int>>>);
+    static_assert(mori::is_trivially_relocatable_v<mori::Result<void>>);
+    static_assert(!mori::is_trivially_relocatable_v<mori::expected<Fragile, int>>);
+#if MORI_HAS_LIBSTDCXX_RELOCATION
+    static_assert(std::__is_bitwise_relocatable<mori::Result<std::vector<int>>>::value);
+#endif
+
+    template<class T, class E>
+    void check_swap(const T& a, const T& b, const E& x, const E& y) {
+        using Ex = mori::expected<T, E>;
+        Ex v1(a), v2(b), e1(mori::unexpect, x), e2(mori::unexpect, y);
+        swap(v1, v2);
+        assert(*v1 == b && *v2 == a);
+        swap(e1, e2);
+        assert(e1.error() == y && e2.error() == x);
+        swap(v1, e1);
+        assert(!v1.has_value() && v1.error() == y && e1.has_value() && *e1 == b);
+        e1.swap(v1);
+        assert(e1.error() == y && *v1 == b);
+    }
+
+    void test_swap() {
+        check_swap(1, 2, 3, 4);
+        check_swap(std::string(40, 'a'), std::string("b"), std::string("x"), std::string(40, 'y'));
+        check_swap(std::vector{1, 2}, std::vector{3}, std::errc::io_error, std::errc::timed_out);
+        check_swap(std::string("value"), std::string(50, 'v'), mori::Error(std::errc::io_error),
+            mori::Error(std::errc::timed_out).with_payload(7));
+
+        mori::Result<void> ok;
+        mori::Result<void> failed = mori::unexpected(mori::Error(std::errc::io_error));
+        swap(ok, failed);
+        assert(!ok.has_value() && ok.error() == std::errc::io_error && failed.has_value());
+
+        struct Missing {};
+        mori::expected<std::unique_ptr<int>, Missing> found = std::make_unique<int>(5);
+        mori::expected<std::unique_ptr<int>, Missing> missing = mori::unexpected(Missing{});
+        swap(found, missing);
+        assert(!found.has_value() && **missing == 5);
+    }
+
+    void test_flips_relocate() {
+        const Tracked seed(7);
+        mori::expected<Tracked, std::string> r(mori::unexpect, "not yet");
+        moves = 0;
+        for (int i = 0; i < 10; ++i) {
+            r = seed;
+            assert(*r->value == 7);
+            r = mori::unexpected(std::string("again"));
+        }
+        assert(moves == 0);
+
+        Tracked a(1), b(2);
+        mori::expected<Tracked, std::string> x(a), y(mori::unexpect, "y");
+        moves = 0;
+        swap(x, y);
+        assert(moves == 0 && *y->value == 1 && x.error() == "y");
+    }
+
+    void test_strong_guarantee() {
+        const std::string text(64, 'e');
+        mori::expected<Fragile, std::string> r(mori::unexpect, text);
+        const Fragile bad(-1);
+        bool thrown = false;
+        try {
+            r = bad;
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown && !r.has_value() && r.error() == text);
+
+        mori::expected<std::string, Fragile> s(text);
+        thrown = false;
+        try {
+            s = mori::unexpected(bad);
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown && s.has_value() && *s == text);
+    }
+
+    void test_vector_growth() {
+        std::vector<mori::expected<Tracked, mori::Error>> results;
+        moves = 0;
+        for (int i = 0; i < 1000; ++i) {
+            results.emplace_back(std::in_place, i);
+        }
+        // Without the opt-in std::vector moves the elements as it grows, which is correct but not what is measured.
+#if MORI_HAS_LIBSTDCXX_RELOCATION
+        assert(moves == 0);
+#endif
+        for (int i = 0; i < 1000; ++i) {
+            assert(*results[static_cast<std::size_t>(i)]->value == i);
+        }
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/) {
+    test_swap();
+    test_flips_relocate();
+    test_strong_guarantee();
+    test_vector_growth();
+    return 0;
+}